@@ -0,0 +1,1205 @@
+// Microbenchmarks de PinsLib y de las rutas de sensado y control de velocidad de RoboCar.
+// Se ejecutan sobre una copia de la estructura de sysfs en un directorio temporal y los resultados
+// se emiten en JSON (latencias en ns con percentiles) para poder comparar distintas versiones en el coche.
+// Las maniobras de evasión (escape.*) se miden en el simulador, en tiempo virtual.
+//
+// USO: ./RoboCarBench.out [FICHERO_SALIDA]
+
+#include "PinsLib/Backend.h"
+#include "PinsLib/Clock.h"
+#include "PinsLib/GPIO.h"
+#include "PinsLib/PWM.h"
+#include "RoboCar/Pinout.h"
+#include "RoboCar/RoboCar.h"
+#include "RoboCar/Geometry.h"
+#include "Navigation/OccupancyGrid.h"
+#include "Navigation/DStarLite.h"
+#include "RoboCarAlgorithms.h"
+#include "RoboCar/LoopExecutor.h"
+#include "RoboCar/MissionExecutor.h"
+#include "RoboCar/MissionCar.h"
+#include "RoboCar/LiveState.h"
+#include "RoboCar/Watchdog.h"
+#include "RoboCar/BatteryMonitor.h"
+#include "RoboCar/UltrasoundArray.h"
+#include "RoboCar/Logger.h"
+#include "RoboCar/Behaviours.h"
+#include "RoboCar/ParameterStore.h"
+#include "RoboCar/MissionReport.h"
+#include "Simulator/SimBackend.h"
+#include "Simulator/Fleet.h"
+#include "Bus/Topics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <ftw.h>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <thread>
+#include <unistd.h>
+
+// Número de repeticiones de cada medida
+#define PIN_ITERATIONS              20000
+#define COMPUTE_ITERATIONS          200000
+#define GRID_ITERATIONS             20000
+#define PLAN_ITERATIONS             20
+#define REPLAN_ITERATIONS           500
+
+// Rejilla de planificación del modo goto y periodo (ns) de su bucle de decisión, que debe cubrir la replanificación
+#define PLAN_GRID_CELLS             500
+#define DECISION_PERIOD_NS          100000000.0
+#define CONSTRUCTOR_ITERATIONS      50
+
+// Bus: mensajes que se envían entre hilos y separación (ns) entre publicaciones, del orden de la de un bucle de control
+#define BUS_MESSAGES                20000
+#define BUS_PUBLISH_INTERVAL_NS     20000
+
+// Número de medidas que filtra RoboCar::getDistance()
+#define DISTANCE_SAMPLES            7
+
+// Ciclos del bucle de control sin reservas de memoria (operaciones sobre los pines y tareas de misión)
+#define LOOP_ITERATIONS             100000
+
+// Evasión de obstáculos en simulación: semillas de ruido del sensor por escenario, distancia de detección y coste
+// virtual de cada operación sobre los pines (el mismo que en las simulaciones de RoboCar.out)
+#define ESCAPE_SEEDS                5
+#define ESCAPE_LIMIT_DISTANCE       35
+#define ESCAPE_IO_COST_UMS          60
+
+// Reacción del modo simple ante una pared: distancias iniciales (CM), segundos de modo simple por simulación, paso
+// (us) con el que se comprueba la distancia real y rayos con los que se traza el haz del sensor
+#define REACTION_DISTANCES          {60.0f, 120.0f, 180.0f}
+#define REACTION_SECONDS            10
+#define REACTION_CHECK_UMS          1000
+#define REACTION_RAYS               9
+#define REACTION_MAX_RANGE_CM       400.0f
+
+// Recargas del fichero de parámetros vigilado
+#define PARAMETERS_RELOADS          50
+
+// Paradas de emergencia provocadas (cada una espera el plazo duro del sensado)
+#define WATCHDOG_TRIALS             20
+
+// Batería: lecturas del ADC, tensiones a las que se mide el error de velocidad en simulación y tiempo (us) que se
+// deja a la rueda para estabilizarse en cada velocidad
+#define BATTERY_ITERATIONS          20000
+#define BATTERY_SETTLE_UMS          1000000
+
+// Línea recta en simulación con ruedas desiguales: recorrido (CM) y tiempo máximo (us), fase y periodo (us) del
+// control de velocidad (los de las misiones), periodo (us) con el que se integran los tacos de los encoders y velocidad
+// máxima, zona muerta y constante de tiempo del motor derecho respecto a las del izquierdo
+#define STRAIGHT_DISTANCE_CM        1000.0f
+#define STRAIGHT_TIMEOUT_UMS        60000000
+#define STRAIGHT_CONTROL_PHASE_UMS  50000
+#define STRAIGHT_CONTROL_UMS        400000
+#define STRAIGHT_SAMPLE_UMS         5000
+#define STRAIGHT_SPEED_RATIO        0.9f
+#define STRAIGHT_DEAD_ZONE_RATIO    1.1f
+#define STRAIGHT_TIME_RATIO         1.3f
+
+// Registro de mensajes: muestras, mensajes por muestra (una sola medida del reloj no resuelve decenas de ns) y muestras
+// entre vaciados de las colas (fuera de la medida, para que nunca se llenen)
+#define LOG_SAMPLES                 20000
+#define LOG_RECORDS_PER_SAMPLE      16
+#define LOG_SAMPLES_PER_FLUSH       128
+
+// Array de ultrasonidos en simulación: barridos completos (una medida de cada sensor) por posición del coche
+#define ARRAY_SCANS                 100
+
+// Flota simulada: coches en el circuito rectangular, segundos de modo simple que ejecuta cada uno y repeticiones por
+// número de hilos
+#define FLEET_CARS                  16
+#define FLEET_SECONDS               20
+#define FLEET_RUNS                  3
+
+namespace {
+
+    // Backend que no realiza ninguna operación, para aislar el coste propio del código
+    class NullBackend : public PinsLib::Backend {
+    public:
+        int write(const string &/*path*/, const string &/*filename*/, const string &/*value*/) override { return 0; }
+        string read(const string &/*path*/, const string &/*filename*/) override { return "0"; }
+    };
+
+    // Resultado de un benchmark: latencia por operación (ns)
+    struct Result {
+        std::string name;
+        std::string description;
+        std::vector<double> samples;
+        double scale;       // Número de unidades que incluye cada muestra (p.e: medidas filtradas)
+    };
+
+    std::vector<Result> results;
+
+    /**
+     * @brief Ejecuta la operación el número de veces indicado, midiendo cada ejecución por separado
+     */
+    void measure(const std::string &name, const std::string &description, int iterations,
+                 const std::function<void()> &operation, double scale = 1.0) {
+        Result result = {name, description, {}, scale};
+        result.samples.reserve(iterations);
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            operation();
+            auto stop = std::chrono::steady_clock::now();
+            result.samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / scale);
+        }
+        results.push_back(result);
+        std::cerr << "  " << name << " (" << iterations << " iteraciones)" << std::endl;
+    }
+
+    double percentile(const std::vector<double> &sorted, double p) {
+        size_t index = (size_t) std::min((double) sorted.size() - 1, p * (double) sorted.size());
+        return sorted[index];
+    }
+
+    void printJson(std::ostream &out, const std::string &root) {
+        struct utsname system;
+        uname(&system);
+        out << "{" << std::endl;
+        out << "  \"machine\": \"" << system.machine << "\"," << std::endl;
+        out << "  \"kernel\": \"" << system.release << "\"," << std::endl;
+        out << "  \"sysfsRoot\": \"" << root << "\"," << std::endl;
+        out << "  \"unit\": \"ns\"," << std::endl;
+        out << "  \"benchmarks\": [" << std::endl;
+        for (size_t i = 0; i < results.size(); i++) {
+            std::vector<double> sorted = results[i].samples;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0;
+            for (double sample : sorted)
+                total += sample;
+            double mean = total / sorted.size();
+            double squares = 0;
+            for (double sample : sorted)
+                squares += (sample - mean) * (sample - mean);
+            out << "    {\"name\": \"" << results[i].name << "\", \"description\": \"" << results[i].description
+                << "\", \"iterations\": " << sorted.size()
+                << ", \"mean\": " << mean << ", \"stddev\": " << std::sqrt(squares / sorted.size())
+                << ", \"min\": " << sorted.front()
+                << ", \"p50\": " << percentile(sorted, 0.50) << ", \"p90\": " << percentile(sorted, 0.90)
+                << ", \"p99\": " << percentile(sorted, 0.99) << ", \"max\": " << sorted.back()
+                << ", \"opsPerSecond\": " << 1e9 / mean << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        out << "  ]" << std::endl;
+        out << "}" << std::endl;
+    }
+
+    // Obstáculo cuadrado: infranqueable en el centro y con coste mayor alrededor, como los que genera el modo goto.
+    // Si se indica, en previous se guardan los costes anteriores para poder retirarlo
+    void addObstacle(Navigation::DStarLite &planner, int x, int y, int size,
+                     std::vector<std::pair<int, uint8_t>> *previous = nullptr) {
+        for (int dy = -size - 3; dy <= size + 3; dy++) {
+            for (int dx = -size - 3; dx <= size + 3; dx++) {
+                int cx = x + dx, cy = y + dy;
+                if (cx < 0 || cy < 0 || cx >= planner.getWidth() || cy >= planner.getHeight())
+                    continue;
+                if (previous != nullptr)
+                    previous->push_back({cy * planner.getWidth() + cx, planner.getCost(cx, cy)});
+                bool lethal = std::abs(dx) <= size && std::abs(dy) <= size;
+                planner.setCost(cx, cy, lethal ? IMPASSABLE_CELL : std::max<uint8_t>(planner.getCost(cx, cy), 5));
+            }
+        }
+    }
+
+    // Mensaje del benchmark del bus: lleva el instante de publicación con resolución de ns
+    struct StampedMessage {
+        long long sent;
+        float distance;
+    };
+
+    /**
+     * @brief Latencia (ns) entre la publicación de un mensaje en un hilo y su recepción en otro (suscripción QUEUED
+     * que consulta el tema continuamente), con cada hilo en un núcleo si hay al menos dos. Con un solo núcleo los hilos
+     * ceden el procesador mientras esperan, por lo que la latencia incluye la planificación del sistema
+     * @return Mensajes perdidos por el suscriptor
+     */
+    unsigned long long measureCrossThread(Result &result) {
+        PinsLib::SystemClock clock;
+        Bus::Topic<StampedMessage> topic("bench", &clock);
+        Bus::Topic<StampedMessage>::Subscriber subscriber = topic.subscribe(Bus::QUEUED);
+        bool pin = std::thread::hardware_concurrency() >= 2;
+        auto nanoseconds = []() {
+            return (long long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        };
+
+        std::thread publisher([&]() {
+            if (pin)
+                RoboCar::LoopExecutor::pinToCore(0);
+            long long next = nanoseconds();
+            for (int i = 0; i < BUS_MESSAGES; i++) {
+                next += BUS_PUBLISH_INTERVAL_NS;
+                while (nanoseconds() < next) {
+                    if (!pin)
+                        std::this_thread::yield();
+                }
+                StampedMessage &message = topic.claim();
+                message.distance = (float) i;
+                message.sent = nanoseconds();
+                topic.publish();
+            }
+        });
+        if (pin)
+            RoboCar::LoopExecutor::pinToCore(1);
+        result.samples.reserve(BUS_MESSAGES);
+        StampedMessage message;
+        while ((long long) (result.samples.size() + topic.getStats().dropped) < BUS_MESSAGES) {
+            if (subscriber.receive(message))
+                result.samples.push_back((double) (nanoseconds() - message.sent));
+            else if (!pin)
+                std::this_thread::yield();
+        }
+        publisher.join();
+        return topic.getStats().dropped;
+    }
+
+    // Tarea de misión que lee un pin sin esperar (como una medida del sensor cuyo eco ya ha llegado)
+    RoboCar::Task<int> readPin(RoboCar::MissionExecutor &/*executor*/, PinsLib::GPIO &pin) {
+        co_return pin.getValue();
+    }
+
+    /**
+     * @brief Misión que crea y espera una tarea por ciclo, midiendo cada ciclo por separado
+     */
+    RoboCar::Task<> loopMission(RoboCar::MissionExecutor &executor, PinsLib::GPIO &pin, Result &result) {
+        for (int i = 0; i < LOOP_ITERATIONS; i++) {
+            auto start = std::chrono::steady_clock::now();
+            co_await readPin(executor, pin);
+            auto stop = std::chrono::steady_clock::now();
+            result.samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+        }
+    }
+
+    // Escenario de evasión: habitación de 300 x 200 CM con obstáculos opcionales y posición de salida del coche
+    struct EscapeScenario {
+        const char *name;
+        std::vector<std::vector<Simulator::Point>> obstacles;
+        Simulator::Point start;
+        float heading;      // Grados
+    };
+
+    /**
+     * @brief Tiempo simulado (ns) que tarda la maniobra de evasión en encontrar una salida, -1 si no la encuentra
+     */
+    double simulateEscape(const EscapeScenario &scenario, unsigned int seed, int scanArc) {
+        Simulator::Arena arena;
+        arena.addPolygon({{0, 0}, {300, 0}, {300, 200}, {0, 200}});
+        for (const std::vector<Simulator::Point> &obstacle : scenario.obstacles)
+            arena.addPolygon(obstacle);
+        arena.setStart(scenario.start, scenario.heading * (float) M_PI / 180.0f);
+
+        PinsLib::VirtualClock clock;
+        Simulator::SimBackend backend(arena, &clock, ESCAPE_IO_COST_UMS, seed);
+        PinsLib::Clock::set(&clock);
+        PinsLib::Backend::set(&backend);
+        double elapsed;
+        {
+            RoboCar::RoboCar car;
+            car.calibrate();
+            // La calibración mueve el coche: la evasión empieza en la posición del escenario
+            backend.setPose({scenario.start.x, scenario.start.y, scenario.heading * (float) M_PI / 180.0f});
+            Navigation::OccupancyGrid map;
+            car.setMap(&map);
+            car.setMinSpeed();
+            long long start = clock.now();
+            bool escaped = RoboCarAlgorithms::escapeObstacle(&car, ESCAPE_LIMIT_DISTANCE, scanArc);
+            elapsed = escaped ? (clock.now() - start) * 1000.0 : -1;
+            car.setMap(nullptr);
+        }
+        PinsLib::Backend::set(nullptr);
+        PinsLib::Clock::set(nullptr);
+        return elapsed;
+    }
+
+    // Backend del benchmark de reacción: registra el primer instante en que el obstáculo más cercano dentro del haz del
+    // sensor (sin ruido) queda más cerca que la distancia límite, la primera parada de los motores posterior al
+    // arranque y las lecturas de pines hasta esa parada. La física se comprueba cada REACTION_CHECK_UMS, haya o no
+    // lecturas de pines, para no favorecer a quien lee menos
+    class ReactionBackend : public Simulator::SimBackend {
+    public:
+        const Simulator::Arena &arena;
+        bool armed;
+        bool moving;
+        long long checked;
+        long long crossing;
+        long long stopped;
+        long long reads;
+
+        ReactionBackend(const Simulator::Arena &arena, PinsLib::VirtualClock *clock, unsigned int seed)
+                : Simulator::SimBackend(arena, clock, ESCAPE_IO_COST_UMS, seed), arena(arena) {
+            this->armed = false;
+            this->moving = false;
+            this->checked = 0;
+            this->crossing = -1;
+            this->stopped = -1;
+            this->reads = 0;
+        }
+
+        // A partir de aquí se cuentan las lecturas y se espera el arranque del coche
+        void arm() {
+            armed = true;
+            reads = 0;
+            checked = clock->now();
+        }
+
+        string read(const string &path, const string &filename) override {
+            if (armed && stopped < 0)
+                reads++;
+            return Simulator::SimBackend::read(path, filename);
+        }
+
+        int write(const string &path, const string &filename, const string &value) override {
+            int result = Simulator::SimBackend::write(path, filename, value);
+            bool enabled = getMotorCommand(RoboCar::LEFT).enabled;
+            if (armed && enabled)
+                moving = true;
+            if (moving && !enabled && crossing >= 0 && stopped < 0)
+                stopped = clock->now();
+            return result;
+        }
+
+    protected:
+        void update(long long now) override {
+            if (armed) {
+                for (; checked + REACTION_CHECK_UMS <= now; checked += REACTION_CHECK_UMS) {
+                    Simulator::SimBackend::update(checked + REACTION_CHECK_UMS);
+                    if (crossing < 0 && beamRange() < ESCAPE_LIMIT_DISTANCE)
+                        crossing = checked + REACTION_CHECK_UMS;
+                }
+            }
+            Simulator::SimBackend::update(now);
+        }
+
+    private:
+        float beamRange() const {
+            Simulator::Pose pose = getPose();
+            Simulator::Point origin = {pose.x + ULTRASOUND_OFFSET_CM * std::cos(pose.heading),
+                                       pose.y + ULTRASOUND_OFFSET_CM * std::sin(pose.heading)};
+            float halfAngle = ULTRASOUND_BEAM_HALF_ANGLE * (float) M_PI / 180.0f, nearest = REACTION_MAX_RANGE_CM;
+            for (int i = 0; i < REACTION_RAYS; i++) {
+                float angle = pose.heading - halfAngle + 2.0f * halfAngle * i / (REACTION_RAYS - 1);
+                nearest = std::min(nearest, arena.castRay(origin, angle, REACTION_MAX_RANGE_CM));
+            }
+            return nearest;
+        }
+    };
+
+    /**
+     * @brief Modo simple hacia una pared situada a la distancia indicada: tiempo simulado (ns) desde que el obstáculo
+     * más cercano en el haz del sensor queda más cerca que la distancia límite hasta que se detienen los motores (-1 si
+     * no se detienen) y lecturas de pines por segundo durante la aproximación
+     */
+    double simulateReaction(float distance, unsigned int seed, double &readsPerSecond) {
+        Simulator::Arena arena;
+        arena.addPolygon({{0, 0}, {600, 0}, {600, 200}, {0, 200}});
+        arena.setStart({600 - distance - ULTRASOUND_OFFSET_CM, 100}, 0);
+
+        PinsLib::VirtualClock clock;
+        ReactionBackend backend(arena, &clock, seed);
+        PinsLib::Clock::set(&clock);
+        PinsLib::Backend::set(&backend);
+        double reaction;
+        {
+            RoboCar::RoboCar car;
+            car.calibrate();
+            backend.setPose({arena.getStart().x, arena.getStart().y, 0});
+            backend.arm();
+            long long start = clock.now();
+            RoboCarAlgorithms::simpleMode(&car, REACTION_SECONDS, ESCAPE_LIMIT_DISTANCE, false, 360);
+            reaction = (backend.stopped < 0) ? -1 : (backend.stopped - backend.crossing) * 1000.0;
+            readsPerSecond = (backend.stopped < 0) ? 0 : backend.reads * 1e6 / (double) (backend.stopped - start);
+        }
+        PinsLib::Backend::set(nullptr);
+        PinsLib::Clock::set(nullptr);
+        return reaction;
+    }
+
+    /**
+     * @brief Error relativo medio (%) de la velocidad de una rueda respecto a la pedida, con la batería a la tensión
+     * indicada y la tabla de calibración tomada a la tensión nominal. En lazo abierto (solo la tabla), con o sin la
+     * compensación por la tensión medida
+     */
+    double simulateBatterySpeedError(float voltage, bool compensate) {
+        Simulator::Arena arena;
+        arena.addPolygon({{0, 0}, {300, 0}, {300, 200}, {0, 200}});
+        arena.setStart({150, 100}, 0);
+
+        PinsLib::VirtualClock clock;
+        Simulator::SimBackend backend(arena, &clock, ESCAPE_IO_COST_UMS);
+        PinsLib::Clock::set(&clock);
+        PinsLib::Backend::set(&backend);
+        double error = 0;
+        int speeds[] = {50, 70, 90};
+        {
+            RoboCar::WheelMotor wheel(RoboCar::LEFT);
+            RoboCar::BatteryMonitor monitor;
+            backend.setBattery(BATTERY_NOMINAL_VOLTAGE, 0);
+            monitor.open();
+            RoboCar::BatteryMonitor::set(&monitor);
+            wheel.calibrate();
+            std::string table = "/tmp/robocar-bench-battery.calibration";
+            wheel.saveCalibration(table);
+            wheel.loadCalibration(table);
+            remove(table.c_str());
+
+            backend.setBattery(voltage, 0);
+            RoboCar::BatteryMonitor::set(nullptr);
+            RoboCar::BatteryMonitor discharged;
+            if (compensate && discharged.open())
+                RoboCar::BatteryMonitor::set(&discharged);
+            wheel.goForward();
+            for (int speed : speeds) {
+                wheel.setSpeed(speed);
+                clock.sleep(BATTERY_SETTLE_UMS);
+                error += std::abs(wheel.getCurrentSpeed() - speed) * 100.0 / speed;
+            }
+            wheel.stop();
+            RoboCar::BatteryMonitor::set(nullptr);
+        }
+        PinsLib::Backend::set(nullptr);
+        PinsLib::Clock::set(nullptr);
+        return error / (sizeof(speeds) / sizeof(speeds[0]));
+    }
+
+    // Recorrido de simulateStraightDrift(): tacos contados en el encoder de cada rueda y orientación, desviación
+    // lateral y avance (CM) reconstruidos a partir de ellos
+    struct StraightTrack {
+        float leftTicks = 0;
+        float rightTicks = 0;
+        double heading = 0;
+        double lateral = 0;
+        double travelled = 0;
+    };
+
+    /**
+     * @brief Control de velocidad como el de las misiones: mide ambas ruedas esperando los flancos y las regula
+     */
+    RoboCar::Task<> straightControl(RoboCar::MissionCar &car) {
+        co_await car.sleep(STRAIGHT_CONTROL_PHASE_UMS);
+        for (;;) {
+            int left = co_await car.measureSpeed(RoboCar::LEFT);
+            int right = co_await car.measureSpeed(RoboCar::RIGHT);
+            car.get()->updateSpeed(left, right);
+            co_await car.sleep(STRAIGHT_CONTROL_UMS);
+        }
+    }
+
+    /**
+     * @brief Integra, con la cinemática diferencial del coche, los tacos contados desde la muestra anterior. Termina al
+     * recorrer STRAIGHT_DISTANCE_CM
+     */
+    RoboCar::Task<> straightTrack(RoboCar::MissionCar &car, StraightTrack &track) {
+        float left = track.leftTicks, right = track.rightTicks;
+        while (track.travelled < STRAIGHT_DISTANCE_CM) {
+            co_await car.sleep(STRAIGHT_SAMPLE_UMS);
+            double advance = (track.leftTicks - left + track.rightTicks - right) / 2.0 * CM_PER_TICK;
+            double rotation = (track.rightTicks - right - track.leftTicks + left) * CM_PER_TICK / WHEEL_TRACK_CM;
+            track.lateral += advance * std::sin(track.heading + rotation / 2.0);
+            track.heading += rotation;
+            track.travelled += advance;
+            left = track.leftTicks;
+            right = track.rightTicks;
+        }
+    }
+
+    RoboCar::Task<> straightMission(RoboCar::MissionCar &car, StraightTrack &track, const bool &counting) {
+        co_await RoboCar::whenAny(straightTrack(car, track), straightControl(car),
+                                  car.countTicks(RoboCar::LEFT, track.leftTicks, counting),
+                                  car.countTicks(RoboCar::RIGHT, track.rightTicks, counting));
+    }
+
+    /**
+     * @brief Recorre en línea recta STRAIGHT_DISTANCE_CM con el motor derecho más lento y perezoso que el izquierdo,
+     * como una misión: control de velocidad y cuenta de los flancos de los encoders. La desviación lateral se
+     * reconstruye a partir de los tacos contados y se compara con la real del simulador
+     * @param syncGain Constante de la sincronización de las ruedas (0 para regular cada rueda por separado)
+     * @param actual Desviación lateral real (CM por metro recorrido)
+     * @return Desviación lateral según los encoders (CM por metro recorrido)
+     */
+    double simulateStraightDrift(float syncGain, double &actual) {
+        Simulator::Arena arena;
+        arena.addPolygon({{0, 0}, {3 * STRAIGHT_DISTANCE_CM, 0}, {3 * STRAIGHT_DISTANCE_CM, 2 * STRAIGHT_DISTANCE_CM},
+                          {0, 2 * STRAIGHT_DISTANCE_CM}});
+        arena.setStart({STRAIGHT_DISTANCE_CM, STRAIGHT_DISTANCE_CM}, 0);
+
+        PinsLib::VirtualClock clock;
+        Simulator::SimBackend backend(arena, &clock, ESCAPE_IO_COST_UMS);
+        backend.setMotor(RoboCar::RIGHT, Simulator::MotorModel(DEFAULT_DEAD_ZONE * STRAIGHT_DEAD_ZONE_RATIO,
+                                                               DEFAULT_MAX_SPEED * STRAIGHT_SPEED_RATIO,
+                                                               DEFAULT_CURVE_EXPONENT,
+                                                               DEFAULT_TIME_CONSTANT * STRAIGHT_TIME_RATIO));
+        PinsLib::Clock::set(&clock);
+        PinsLib::Backend::set(&backend);
+        StraightTrack track;
+        Simulator::Pose start;
+        {
+            RoboCar::RoboCar car;
+            RoboCar::Parameters parameters;
+            parameters.syncGain = syncGain;
+            car.setParameters(parameters);
+            car.calibrate();
+            clock.sleep(BATTERY_SETTLE_UMS);
+            backend.synchronize(clock.now());
+            start = backend.getPose();
+
+            RoboCar::MissionExecutor executor(&clock);
+            RoboCar::MissionCar missionCar(&car, executor);
+            bool counting = true;
+            car.setMeanSpeed();
+            car.goForward();
+            RoboCar::Task<> mission = straightMission(missionCar, track, counting);
+            executor.run(mission, STRAIGHT_TIMEOUT_UMS);
+            car.stop();
+            backend.synchronize(clock.now());
+        }
+        Simulator::Pose end = backend.getPose();
+        PinsLib::Backend::set(nullptr);
+        PinsLib::Clock::set(nullptr);
+        double metres = track.travelled / 100.0;
+        actual = std::fabs(-(end.x - start.x) * std::sin(start.heading) + (end.y - start.y) * std::cos(start.heading))
+                 / metres;
+        return std::fabs(track.lateral) / metres;
+    }
+
+    /**
+     * @brief Barridos del array de ultrasonidos (frontal y laterales) con el coche parado en distintas posiciones de
+     * una habitación de 300 x 200 CM, con la separación mínima indicada entre sensores que disparan a la vez
+     * @param result Tiempo simulado (ns) por medida en cada barrido
+     * @return Fracción de ecos con diafonía (terminados con el pulso de otro sensor) según el simulador
+     */
+    double simulateArray(float separation, Result &result) {
+        struct Placement { Simulator::Point position; float heading; };
+        std::vector<Placement> placements = {{{150, 100}, 0}, {{45, 100}, 180}, {{35, 35}, 225}, {{270, 160}, 30}};
+        long long samples = 0, crosstalk = 0;
+        for (const Placement &placement : placements) {
+            Simulator::Arena arena;
+            arena.addPolygon({{0, 0}, {300, 0}, {300, 200}, {0, 200}});
+            arena.setStart(placement.position, placement.heading * (float) M_PI / 180.0f);
+
+            PinsLib::VirtualClock clock;
+            Simulator::SimBackend backend(arena, &clock, ESCAPE_IO_COST_UMS);
+            float side = ULTRASOUND_SIDE_MOUNT_DEG * (float) M_PI / 180.0f;
+            backend.addSensor(ULTRASOUND_LEFT_TRIGGER_PIN, ULTRASOUND_LEFT_ECHO_PIN, side);
+            backend.addSensor(ULTRASOUND_RIGHT_TRIGGER_PIN, ULTRASOUND_RIGHT_ECHO_PIN, -side);
+            PinsLib::Clock::set(&clock);
+            PinsLib::Backend::set(&backend);
+            {
+                RoboCar::UltrasoundSensor front, left(ULTRASOUND_LEFT_TRIGGER_PIN, ULTRASOUND_LEFT_ECHO_PIN),
+                        right(ULTRASOUND_RIGHT_TRIGGER_PIN, ULTRASOUND_RIGHT_ECHO_PIN);
+                RoboCar::UltrasoundArray array(separation);
+                array.addSensor(&front, 0);
+                array.addSensor(&left, side);
+                array.addSensor(&right, -side);
+                for (int i = 0; i < ARRAY_SCANS; i++) {
+                    long long start = clock.now();
+                    array.scan();
+                    result.samples.push_back((clock.now() - start) * 1000.0 / array.getSize());
+                }
+                samples += array.getStats().samples;
+            }
+            crosstalk += backend.getCrosstalkEchoes();
+            PinsLib::Backend::set(nullptr);
+            PinsLib::Clock::set(nullptr);
+        }
+        return (double) crosstalk / (double) samples;
+    }
+
+    // Creación de la estructura de directorios de sysfs que utiliza el coche
+    void makeDirectory(const std::string &path) {
+        std::string partial;
+        std::istringstream parts(path);
+        std::string part;
+        while (std::getline(parts, part, '/')) {
+            if (part.empty()) continue;
+            partial += "/" + part;
+            mkdir(partial.c_str(), 0755);
+        }
+    }
+
+    void makeSysfs(const std::string &root) {
+        int gpios[] = {LEFT_WHEEL_FORWARD_PIN, LEFT_WHEEL_BACKWARD_PIN, LEFT_WHEEL_ENCODER_PIN,
+                       RIGHT_WHEEL_FORWARD_PIN, RIGHT_WHEEL_BACKWARD_PIN, RIGHT_WHEEL_ENCODER_PIN,
+                       ULTRASOUND_TRIGGER_PIN, ULTRASOUND_ECHO_PIN, GREEN_LED_PIN_NUMBER, RED_LED_PIN_NUMBER};
+        for (int gpio : gpios) {
+            std::string directory = root + GPIO_PATH + "gpio" + std::to_string(gpio);
+            makeDirectory(directory);
+            std::ofstream(directory + "/value") << "0";
+        }
+        for (int pwm : {LEFT_WHEEL_PWM_PIN, RIGHT_WHEEL_PWM_PIN}) {
+            std::string directory = root + PWM_PATH + "pwm-2:" + std::to_string(pwm);
+            makeDirectory(directory);
+            std::ofstream(directory + "/period") << "4000";
+            std::ofstream(directory + "/duty_cycle") << "0";
+        }
+        makeDirectory(root + PWM_EXPORT_PATH);
+    }
+
+    int removeEntry(const char *path, const struct stat *, int, struct FTW *) {
+        return remove(path);
+    }
+
+    // Tabla de calibración con la forma típica de las ruedas del coche
+    void writeCalibration(const std::string &filename) {
+        std::ofstream out(filename);
+        for (int dutyCycle = 1000, speed = 30; dutyCycle <= 4000; dutyCycle += 100, speed += 3)
+            out << dutyCycle << " " << speed << std::endl;
+    }
+
+} /* namespace */
+
+int main(int argc, char **argv) {
+    char rootTemplate[] = "/tmp/robocar-bench-XXXXXX";
+    if (mkdtemp(rootTemplate) == nullptr) {
+        perror("No se pudo crear el directorio temporal");
+        return EXIT_FAILURE;
+    }
+    std::string root = rootTemplate;
+    makeSysfs(root);
+    std::string calibration = root + "/bench.calibration";
+    writeCalibration(calibration);
+
+    // Los pines se exportan sobre el directorio temporal y sin las esperas de 250 ms de la exportación
+    PinsLib::SysfsBackend sysfs(root);
+    NullBackend null;
+    PinsLib::VirtualClock virtualClock;
+    PinsLib::Backend::set(&sysfs);
+    PinsLib::Clock::set(&virtualClock);
+
+    std::cerr << "Ejecutando benchmarks sobre " << root << std::endl;
+    {
+        PinsLib::GPIO gpio(ULTRASOUND_TRIGGER_PIN);
+        measure("pins.write", "Pins::write (via GPIO::setDirection)", PIN_ITERATIONS, [&]() { gpio.setDirection(PinsLib::OUTPUT); });
+        measure("pins.read", "Pins::read (via GPIO::getDirection)", PIN_ITERATIONS, [&]() { gpio.getDirection(); });
+        measure("gpio.setValue", "GPIO::setValue", PIN_ITERATIONS, [&]() { gpio.setValue(PinsLib::HIGH); });
+        measure("gpio.getValue", "GPIO::getValue", PIN_ITERATIONS, [&]() { gpio.getValue(); });
+        gpio.streamOpen();
+        measure("gpio.streamWrite", "GPIO::streamWrite", PIN_ITERATIONS, [&]() { gpio.streamWrite(PinsLib::LOW); });
+        gpio.streamClose();
+    }
+    {
+        PinsLib::PWM pwm(LEFT_WHEEL_PWM_PIN);
+        int dutyCycle = 0;
+        measure("pwm.setDutyCycle", "PWM::setDutyCycle", PIN_ITERATIONS, [&]() { pwm.setDutyCycle(dutyCycle++ % 4000); });
+    }
+    {
+        RoboCar::WheelMotor wheel(RoboCar::LEFT);
+        wheel.loadCalibration(calibration);
+        int speed = 30;
+        measure("wheel.setSpeed", "WheelMotor::setSpeed (incluye la escritura del duty cycle)", PIN_ITERATIONS,
+                [&]() { wheel.setSpeed(30 + speed++ % 90); });
+    }
+    {
+        // Misma operación sin coste de E/S: solo la búsqueda en la tabla de calibración
+        PinsLib::Backend::set(&null);
+        RoboCar::WheelMotor wheel(RoboCar::LEFT);
+        wheel.loadCalibration(calibration);
+        int speed = 30;
+        measure("wheel.setSpeed.lookup", "WheelMotor::setSpeed sin E/S (busqueda en la tabla de calibracion)",
+                COMPUTE_ITERATIONS, [&]() { wheel.setSpeed(30 + speed++ % 90); });
+        PinsLib::Backend::set(&sysfs);
+    }
+    {
+        // Bucle de control sin reservas de memoria, sin coste de E/S para que la variación sea la del propio código:
+        // las operaciones sobre los pines de un ciclo (disparo del sensor, eco, encoders y duty cycle de ambas
+        // ruedas) y una tarea de misión creada y esperada en cada ciclo (como cada medida del sensor)
+        PinsLib::Backend::set(&null);
+        PinsLib::GPIO trigger(ULTRASOUND_TRIGGER_PIN), echo(ULTRASOUND_ECHO_PIN);
+        PinsLib::GPIO leftEncoder(LEFT_WHEEL_ENCODER_PIN), rightEncoder(RIGHT_WHEEL_ENCODER_PIN);
+        PinsLib::PWM leftPwm(LEFT_WHEEL_PWM_PIN), rightPwm(RIGHT_WHEEL_PWM_PIN);
+        int dutyCycle = 0;
+        measure("loop.pins", "Pines de un ciclo del bucle (trigger, eco, encoders y duty cycles) sin E/S",
+                LOOP_ITERATIONS, [&]() {
+                    trigger.setValue(PinsLib::HIGH);
+                    trigger.setValue(PinsLib::LOW);
+                    echo.getValue();
+                    leftEncoder.getValue();
+                    rightEncoder.getValue();
+                    leftPwm.setDutyCycle(dutyCycle++ % 4000);
+                    rightPwm.setDutyCycle(dutyCycle % 4000);
+                });
+
+        RoboCar::MissionExecutor executor(&virtualClock);
+        Result result = {"loop.task", "Tarea de mision creada y esperada en cada ciclo (lectura de un pin sin E/S)",
+                         {}, 1.0};
+        result.samples.reserve(LOOP_ITERATIONS);
+        {
+            RoboCar::Task<> mission = loopMission(executor, echo, result);
+            executor.run(mission, 1000000);
+        }
+        results.push_back(result);
+        std::cerr << "  " << result.name << " (" << LOOP_ITERATIONS << " iteraciones)" << std::endl;
+        PinsLib::Backend::set(&sysfs);
+    }
+    {
+        // Filtrado de las medidas de distancia (coste por medida)
+        std::mt19937 random(1);
+        std::normal_distribution<float> noise(100.0f, 3.0f);
+        float distances[DISTANCE_SAMPLES];
+        measure("robocar.filterDistances", "RoboCar::getDistance filtrado estadistico, por medida", COMPUTE_ITERATIONS,
+                [&]() {
+                    for (float &distance : distances)
+                        distance = noise(random);
+                    RoboCar::RoboCar::filterDistances(distances, DISTANCE_SAMPLES);
+                }, DISTANCE_SAMPLES);
+    }
+    {
+        // Integración de una medida del sensor en el mapa: posiciones aleatorias en un escenario de 10 x 10 metros
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f), heading(-M_PI, M_PI), range(10.0f, 250.0f);
+        Navigation::OccupancyGrid map;
+        measure("grid.integrate", "OccupancyGrid::integrate, cono de 30 grados hasta 200 CM", GRID_ITERATIONS, [&]() {
+            map.integrate({position(random), position(random), heading(random)}, range(random),
+                          ULTRASOUND_BEAM_HALF_ANGLE * (float) M_PI / 180.0f, 200.0f);
+        });
+        std::cerr << "Mapa de 10 x 10 metros: " << map.getAllocatedTiles() << " teselas, "
+                  << map.getMemoryUsage() / 1024 << " KB" << std::endl;
+    }
+    {
+        // Planificación en la rejilla del modo goto con obstáculos aleatorios: planificación completa y reparación
+        // del camino tras avanzar y descubrir un obstáculo nuevo delante del coche
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> cell(0, PLAN_GRID_CELLS - 1), size(2, 10);
+        Navigation::DStarLite planner(PLAN_GRID_CELLS, PLAN_GRID_CELLS);
+        for (int i = 0; i < 400; i++)
+            addObstacle(planner, cell(random), cell(random), size(random));
+        // Se despejan la salida y el destino
+        for (int corner : {10, PLAN_GRID_CELLS - 10})
+            for (int dy = -4; dy <= 4; dy++)
+                for (int dx = -4; dx <= 4; dx++)
+                    planner.setCost(corner + dx, corner + dy, 1);
+
+        measure("dstar.plan", "DStarLite::plan desde cero, rejilla de 500 x 500", PLAN_ITERATIONS, [&]() {
+            planner.setStart(10, 10);
+            planner.setGoal(PLAN_GRID_CELLS - 10, PLAN_GRID_CELLS - 10);
+            planner.plan();
+        });
+
+        // En cada iteración el obstáculo anterior desaparece (el coche lo ha dejado atrás) y aparece uno nuevo
+        std::vector<int> path;
+        std::vector<std::pair<int, uint8_t>> previous;
+        measure("dstar.replan", "DStarLite::plan tras avanzar y descubrir un obstaculo en el camino", REPLAN_ITERATIONS, [&]() {
+            planner.getPath(path, 40);
+            if (path.size() < 40) {
+                planner.setStart(10, 10);
+                planner.setGoal(PLAN_GRID_CELLS - 10, PLAN_GRID_CELLS - 10);
+                planner.plan();
+                planner.getPath(path, 40);
+            }
+            planner.setStart(path[4] % PLAN_GRID_CELLS, path[4] / PLAN_GRID_CELLS);
+            for (auto it = previous.rbegin(); it != previous.rend(); ++it)
+                planner.setCost(it->first % PLAN_GRID_CELLS, it->first / PLAN_GRID_CELLS, it->second);
+            previous.clear();
+            addObstacle(planner, path[30] % PLAN_GRID_CELLS, path[30] / PLAN_GRID_CELLS, 3, &previous);
+            planner.plan();
+        });
+        std::vector<double> replans = results.back().samples;
+        std::sort(replans.begin(), replans.end());
+        double worst = replans[(size_t) (replans.size() * 0.99)];
+        std::cerr << "Replanificacion D* Lite: p99 " << worst / 1000000.0 << " ms ("
+                  << (worst < DECISION_PERIOD_NS ? "dentro" : "FUERA") << " del periodo de decision de "
+                  << DECISION_PERIOD_NS / 1000000.0 << " ms)" << std::endl;
+    }
+    measure("wheel.constructor", "WheelMotor::WheelMotor + destructor (sin la espera de 250 ms por pin)",
+            CONSTRUCTOR_ITERATIONS, [&]() { RoboCar::WheelMotor wheel(RoboCar::RIGHT); });
+    measure("robocar.constructor", "RoboCar::RoboCar + destructor (sin la espera de 250 ms por pin)",
+            CONSTRUCTOR_ITERATIONS, [&]() { RoboCar::RoboCar car; });
+    {
+        // Resumen de la misión: coste de acumular un ciclo del árbitro (cada 5 ms, con medio taco por rueda)
+        RoboCar::RoboCar car;
+        RoboCar::MissionReport report;
+        report.begin("simple");
+        RoboCar::BehaviourInputs inputs = {};
+        measure("report.sample", "MissionReport::sample, por ciclo del arbitro", COMPUTE_ITERATIONS, [&]() {
+            inputs.time += 5000;
+            inputs.leftEncoder += 0.5f;
+            inputs.rightEncoder += 0.5f;
+            report.sample(&car, inputs);
+        });
+    }
+
+    {
+        // Bus: coste de publicar y recibir en el mismo hilo y latencia entre hilos
+        Bus::RoboCarTopics topics;
+        Bus::Topic<Bus::RangeMessage>::Subscriber latest = topics.range.subscribe(Bus::LATEST);
+        Bus::Topic<Bus::RangeMessage>::Subscriber queued = topics.range.subscribe(Bus::QUEUED);
+        Bus::RangeMessage received;
+        float distance = 0;
+        measure("bus.publish", "Topic::publish de una medida de distancia", COMPUTE_ITERATIONS, [&]() {
+            topics.range.publish({distance, 0, 0});
+            distance += 1;
+        });
+        measure("bus.roundtrip", "Topic::publish + receive por dos suscriptores (LATEST y QUEUED), mismo hilo",
+                COMPUTE_ITERATIONS, [&]() {
+            topics.range.publish({distance, 0, 0});
+            latest.receive(received);
+            queued.receive(received);
+        });
+
+        Result result = {"bus.crossThread", "Latencia de publicacion a recepcion entre dos hilos (un mensaje cada 20 us)", {}, 1.0};
+        unsigned long long dropped = measureCrossThread(result);
+        results.push_back(result);
+        std::cerr << "  bus.crossThread (" << BUS_MESSAGES << " mensajes, " << dropped << " perdidos)" << std::endl;
+    }
+
+    {
+        // Estado en memoria compartida: actualización desde el coche y lectura consistente desde el monitor
+        RoboCar::LiveState writer, reader;
+        if (writer.create("/robocar-bench") && reader.attach("/robocar-bench")) {
+            RoboCar::LiveStateData state;
+            int speed = 0;
+            measure("live.update", "LiveState::beginUpdate + endUpdate con velocidades, duty cycles y posicion",
+                    COMPUTE_ITERATIONS, [&]() {
+                RoboCar::LiveStateData &live = writer.beginUpdate();
+                live.commandedLeft = live.commandedRight = speed;
+                live.measuredLeft = live.measuredRight = speed;
+                live.dutyLeft = live.dutyRight = speed++;
+                live.x = live.y = live.heading = 0;
+                writer.endUpdate();
+            });
+            measure("live.read", "LiveState::read (copia consistente del estado completo)", COMPUTE_ITERATIONS,
+                    [&]() { reader.read(state); });
+        }
+    }
+
+    {
+        // Parámetros recargables: lectura de la versión vigente y latencia de una recarga, desde que se empieza a
+        // escribir el fichero vigilado hasta que la nueva versión es visible para los lectores
+        RoboCar::ParameterStore store;
+        int limitDistance = 0;
+        measure("parameters.read", "ParameterStore::read (version vigente de los parametros)", COMPUTE_ITERATIONS,
+                [&]() { limitDistance += store.read().limitDistance; });
+
+        std::string file = root + "/bench.params";
+        std::ofstream(file) << "limitDistance 35" << std::endl;
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        Result result = {"parameters.reload", "Recarga del fichero de parametros (inotify), desde que se escribe hasta "
+                                              "que se publica la nueva version", {}, 1.0};
+        if (store.watch(file)) {
+            for (int i = 0; i < PARAMETERS_RELOADS; i++) {
+                const RoboCar::Parameters *before = &store.read();
+                auto start = std::chrono::steady_clock::now();
+                std::ofstream out(file);
+                out << "limitDistance " << 36 + i % 10 << std::endl;
+                out.close();
+                while (&store.read() == before)
+                    std::this_thread::yield();
+                result.samples.push_back((double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+            }
+            store.stop();
+            results.push_back(result);
+        }
+        std::cout.rdbuf(output);
+        std::cerr << "  parameters.reload (" << result.samples.size() << " recargas)" << std::endl;
+    }
+
+    {
+        // Árbitro de comportamientos: un ciclo con la marcha normal (evasión y vuelta a casa se abstienen, la orden no
+        // cambia) y con una orden manual que se da y se retira en ciclos alternos (cambio de ganador y de sentido)
+        PinsLib::Backend::set(&null);
+        {
+            RoboCar::RoboCar car;
+            car.getWheel(RoboCar::LEFT)->loadCalibration(calibration);
+            car.getWheel(RoboCar::RIGHT)->loadCalibration(calibration);
+            RoboCar::ManualOverrideBehaviour manual;
+            RoboCar::ObstacleAvoidBehaviour avoid(&car, ESCAPE_LIMIT_DISTANCE, 360);
+            RoboCar::LowBatteryReturnBehaviour goHome({0, 0, 0}, car.getMinSpeed());
+            RoboCar::CruiseBehaviour cruise(car.getMinSpeed());
+            RoboCar::Arbiter arbiter;
+            arbiter.add(&manual);
+            arbiter.add(&avoid);
+            arbiter.add(&goHome);
+            arbiter.add(&cruise);
+            RoboCar::MotionOutput output(&car);
+            RoboCar::MotionCommand command;
+            RoboCar::BehaviourInputs inputs = {};
+            inputs.range = 200;
+            inputs.battery = 8.0f;
+            measure("arbiter.tick", "Arbiter::arbitrate + MotionOutput::apply con 4 comportamientos, sin cambio de orden",
+                    COMPUTE_ITERATIONS, [&]() {
+                inputs.time += 5000;
+                inputs.rangeSequence++;
+                arbiter.arbitrate(inputs, command);
+                output.apply(command);
+            });
+            bool manualTurn = false;
+            measure("arbiter.preempt", "Arbiter::arbitrate + MotionOutput::apply alternando una orden manual de giro",
+                    COMPUTE_ITERATIONS, [&]() {
+                inputs.time += 5000;
+                manualTurn = !manualTurn;
+                if (manualTurn)
+                    manual.set({-car.getMinSpeed(), car.getMinSpeed()}, inputs.time + 1);
+                else
+                    manual.release();
+                arbiter.arbitrate(inputs, command);
+                output.apply(command);
+            });
+        }
+        PinsLib::Backend::set(&sysfs);
+    }
+
+    {
+        // Watchdog: coste de la señal de vida y parada de emergencia con el eco del sensor bloqueado (el fichero del pin
+        // se queda a 1): latencia desde que vence el plazo duro hasta que se han escrito los ficheros de los motores
+        RoboCar::Watchdog idle;
+        measure("watchdog.beat", "Watchdog::beat (senal de vida del bucle)", COMPUTE_ITERATIONS,
+                [&]() { idle.beat(RoboCar::WATCHDOG_LOOP); });
+
+        RoboCar::WheelMotor left(RoboCar::LEFT), right(RoboCar::RIGHT);
+        RoboCar::UltrasoundSensor sensor;
+        std::vector<std::string> files;
+        left.getStopFiles(files);
+        right.getStopFiles(files);
+        std::string echo = root + GPIO_PATH + "gpio" + std::to_string(ULTRASOUND_ECHO_PIN) + "/value";
+        Result result = {"watchdog.stop", "Parada de emergencia con el eco bloqueado, desde el plazo duro", {}, 1.0};
+        int failures = 0;
+        for (int i = 0; i < WATCHDOG_TRIALS; i++) {
+            left.goForward();
+            right.goForward();
+            RoboCar::Watchdog watchdog;
+            for (const std::string &file : files)
+                watchdog.addStopFile(file);
+            std::ofstream(echo) << "1";
+            RoboCar::Watchdog::set(&watchdog);
+            watchdog.start();
+            // La medida empieza en un instante distinto respecto a las comprobaciones del watchdog en cada prueba
+            std::this_thread::sleep_for(std::chrono::microseconds(i * WATCHDOG_PERIOD_UMS / WATCHDOG_TRIALS));
+            sensor.getDistance();
+            watchdog.close();
+            RoboCar::Watchdog::set(nullptr);
+
+            std::string enable;
+            std::ifstream(files[0]) >> enable;
+            if (!watchdog.hasTripped() || enable != "0")
+                failures++;
+            else
+                result.samples.push_back(watchdog.getStopLatency() * 1000.0);
+        }
+        std::ofstream(echo) << "0";
+        results.push_back(result);
+        std::cerr << "  watchdog.stop (" << WATCHDOG_TRIALS << " paradas, " << failures << " fallidas)" << std::endl;
+    }
+
+    {
+        // Registro de mensajes con el reloj del sistema, como en el coche: coste en el hilo del bucle de un mensaje
+        // encolado (Logger) frente a formatearlo y escribirlo con std::endl, y coste del hilo de escritura por mensaje
+        PinsLib::Clock::set(nullptr);
+        FILE *devNull = fopen("/dev/null", "w");
+        auto *logger = new RoboCar::Logger(devNull, devNull);
+        RoboCar::Logger::set(logger);
+        int distance = 0;
+        float speed = 0;
+        Result record = {"log.record", "LOG_INFO de un mensaje con un entero y un real (solo el encolado)", {},
+                         LOG_RECORDS_PER_SAMPLE};
+        record.samples.reserve(LOG_SAMPLES);
+        for (int i = 0; i < LOG_SAMPLES; i++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int j = 0; j < LOG_RECORDS_PER_SAMPLE; j++)
+                LOG_INFO("Obstaculo a {} CM, velocidad {}", distance++, speed += 0.5f);
+            auto stop = std::chrono::steady_clock::now();
+            record.samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count()
+                                     / LOG_RECORDS_PER_SAMPLE);
+            if (i % LOG_SAMPLES_PER_FLUSH == LOG_SAMPLES_PER_FLUSH - 1)
+                logger->flush();
+        }
+        results.push_back(record);
+        std::cerr << "  log.record (" << LOG_SAMPLES * LOG_RECORDS_PER_SAMPLE << " mensajes)" << std::endl;
+
+        Result flush = {"log.flush", "Logger::flush por mensaje (formateo y escritura en bloque, hilo de escritura)",
+                        {}, LOG_RECORDS_PER_SAMPLE * LOG_SAMPLES_PER_FLUSH};
+        for (int i = 0; i < LOG_SAMPLES / LOG_SAMPLES_PER_FLUSH; i++) {
+            for (int j = 0; j < LOG_RECORDS_PER_SAMPLE * LOG_SAMPLES_PER_FLUSH; j++)
+                LOG_INFO("Obstaculo a {} CM, velocidad {}", distance++, speed += 0.5f);
+            auto start = std::chrono::steady_clock::now();
+            logger->flush();
+            auto stop = std::chrono::steady_clock::now();
+            flush.samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / flush.scale);
+        }
+        results.push_back(flush);
+        std::cerr << "  log.flush (" << LOG_SAMPLES / LOG_SAMPLES_PER_FLUSH << " vaciados)" << std::endl;
+        RoboCar::Logger::set(nullptr);
+        delete logger;
+        fclose(devNull);
+
+        std::ofstream stream("/dev/null");
+        measure("log.endl", "std::ostream << ... << std::endl del mismo mensaje (formateo y escritura en el bucle)",
+                COMPUTE_ITERATIONS, [&]() {
+            stream << "Obstaculo a " << distance++ << " CM, velocidad " << (speed += 0.5f) << std::endl;
+        });
+        PinsLib::Clock::set(&virtualClock);
+    }
+
+    {
+        // Batería: coste de una lectura del ADC con el filtrado (el reloj avanza un periodo de muestreo en cada
+        // consulta) y error de velocidad en simulación a distintas tensiones, con y sin compensación
+        std::string device = root + "/iio/";
+        makeDirectory(device);
+        std::ofstream(device + BATTERY_IIO_RAW) << "3000";
+        RoboCar::BatteryMonitor monitor(device);
+        monitor.open();
+        measure("battery.getVoltage", "BatteryMonitor::getVoltage con lectura del ADC y filtro paso bajo",
+                BATTERY_ITERATIONS, [&]() {
+            virtualClock.advance(BATTERY_SAMPLE_PERIOD_UMS);
+            monitor.getVoltage();
+        });
+
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        std::cerr << "Error de velocidad en lazo abierto (calibracion a " << BATTERY_NOMINAL_VOLTAGE << " V):";
+        for (float voltage : {8.4f, 7.8f, 7.2f, 6.6f}) {
+            double uncompensated = simulateBatterySpeedError(voltage, false);
+            double compensated = simulateBatterySpeedError(voltage, true);
+            std::cerr << " " << voltage << " V " << uncompensated << "% -> " << compensated << "%,";
+        }
+        std::cerr << std::endl;
+        std::cout.rdbuf(output);
+        PinsLib::Backend::set(&sysfs);
+        PinsLib::Clock::set(&virtualClock);
+    }
+
+    {
+        // Línea recta con ruedas desiguales, regulando cada rueda por separado y con la sincronización de las ruedas
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        double actual;
+        double independent = simulateStraightDrift(0, actual);
+        std::cerr << "Deriva lateral en linea recta (" << STRAIGHT_DISTANCE_CM / 100 << " m, ruedas desiguales): "
+                  << independent << " CM/m (real " << actual << ") -> ";
+        double synchronized = simulateStraightDrift(WHEEL_SYNC_CONSTANT, actual);
+        std::cerr << synchronized << " CM/m (real " << actual << ")" << std::endl;
+        std::cout.rdbuf(output);
+        PinsLib::Backend::set(&sysfs);
+        PinsLib::Clock::set(&virtualClock);
+    }
+
+    {
+        // Array de ultrasonidos en simulación: todos los sensores a la vez, intercalados según su separación y de uno
+        // en uno. Tiempo simulado por medida y fracción de ecos con diafonía
+        std::cerr << "Diafonia del array de ultrasonidos:";
+        for (float separation : {0.0f, ULTRASOUND_ARRAY_SEPARATION_DEG, 360.0f}) {
+            std::string name = (separation == 0) ? "ultrasound.simultaneous" :
+                               (separation >= 360) ? "ultrasound.sequential" : "ultrasound.interleaved";
+            Result result = {name, "Array de 3 sensores (0, 45 y -45 grados), separacion minima de "
+                                   + std::to_string((int) separation) + " grados, tiempo simulado por medida", {}, 1.0};
+            double crosstalk = simulateArray(separation, result);
+            results.push_back(result);
+            std::cerr << " " << name << " " << crosstalk * 100.0 << "%";
+        }
+        std::cerr << std::endl;
+        PinsLib::Backend::set(&sysfs);
+        PinsLib::Clock::set(&virtualClock);
+    }
+
+    {
+        // Evasión de obstáculos en el simulador: tiempo virtual desde que se detecta el obstáculo hasta que el coche
+        // queda orientado hacia una salida, con la maniobra de tanteo y con barridos de 180 y 360 grados
+        std::vector<EscapeScenario> scenarios = {
+                {"pared", {}, {40, 100}, 180},
+                {"esquina", {}, {35, 35}, 225},
+                {"esquina derecha", {}, {270, 35}, 0},
+                {"callejon", {{{150, 60}, {270, 60}, {270, 65}, {150, 65}}, {{150, 135}, {270, 135}, {270, 140}, {150, 140}}},
+                 {260, 100}, 0},
+        };
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        for (int scanArc : {0, 180, 360}) {
+            std::string name = (scanArc == 0) ? "escape.turns" : "escape.scan" + std::to_string(scanArc);
+            Result result = {name, (scanArc == 0) ? "Evasion por tanteo (90 grados a cada lado), tiempo simulado"
+                                                  : "Evasion por barrido de " + std::to_string(scanArc) + " grados, tiempo simulado",
+                             {}, 1.0};
+            int failures = 0;
+            for (const EscapeScenario &scenario : scenarios) {
+                for (unsigned int seed = 1; seed <= ESCAPE_SEEDS; seed++) {
+                    double elapsed = simulateEscape(scenario, seed, scanArc);
+                    if (elapsed < 0)
+                        failures++;
+                    else
+                        result.samples.push_back(elapsed);
+                }
+            }
+            results.push_back(result);
+            std::cerr << "  " << name << " (" << scenarios.size() * ESCAPE_SEEDS << " simulaciones, "
+                      << failures << " sin salida)" << std::endl;
+        }
+        std::cout.rdbuf(output);
+    }
+
+    {
+        // Reacción del modo simple: tiempo simulado desde que el obstáculo más cercano en el haz queda a menos de la
+        // distancia límite hasta que se ordena detener los motores, y lecturas de pines por segundo (en el coche, llamadas al sistema) hasta entonces
+        Result result = {"reaction.simple", "Modo simple hacia una pared, desde que queda a menos de "
+                         + std::to_string(ESCAPE_LIMIT_DISTANCE) + " CM hasta la parada, tiempo simulado", {}, 1.0};
+        Result reads = {"reaction.reads", "Lecturas de pines por segundo durante la aproximacion a la pared", {}, 1.0};
+        std::streambuf *output = std::cout.rdbuf(nullptr);
+        int failures = 0;
+        for (float distance : REACTION_DISTANCES) {
+            for (unsigned int seed = 1; seed <= ESCAPE_SEEDS; seed++) {
+                double readsPerSecond;
+                double reaction = simulateReaction(distance, seed, readsPerSecond);
+                if (reaction < 0) {
+                    failures++;
+                    continue;
+                }
+                result.samples.push_back(reaction);
+                reads.samples.push_back(readsPerSecond);
+            }
+        }
+        std::cout.rdbuf(output);
+        results.push_back(result);
+        results.push_back(reads);
+        std::cerr << "  reaction.simple (" << result.samples.size() + failures << " simulaciones, " << failures
+                  << " sin parada)" << std::endl;
+        PinsLib::Backend::set(&sysfs);
+        PinsLib::Clock::set(&virtualClock);
+    }
+
+    {
+        // Flota simulada: tiempo real (ns) por segundo de coche simulado con distinto número de hilos. La simulación
+        // no depende del número de hilos, así que el trabajo es el mismo en todos los casos
+        Simulator::Arena arena;
+        arena.addPolygon({{0, 0}, {500, 0}, {500, 300}, {0, 300}});
+        arena.addPolygon({{100, 100}, {400, 100}, {400, 200}, {100, 200}});
+        arena.setStart({50, 50}, 0);
+        writeCalibration(root + "/leftWheel.calibration");
+        writeCalibration(root + "/rightWheel.calibration");
+        std::cerr << "Flota de " << FLEET_CARS << " coches (" << std::thread::hardware_concurrency() << " nucleos):";
+        for (int threads : {1, 2, 4}) {
+            Result result = {"fleet.threads" + std::to_string(threads), "Flota de " + std::to_string(FLEET_CARS)
+                             + " coches en modo simple con " + std::to_string(threads)
+                             + " hilos, tiempo real por segundo de coche simulado", {}, 1.0};
+            for (int run = 0; run < FLEET_RUNS; run++) {
+                Simulator::Fleet fleet(arena, ESCAPE_IO_COST_UMS);
+                fleet.populate(FLEET_CARS, 1);
+                fleet.setCar(RoboCar::PinMap(), root);
+                fleet.run(threads, [](RoboCar::RoboCar *car) {
+                    car->loadCalibration();
+                    RoboCarAlgorithms::simpleMode(car, FLEET_SECONDS, ESCAPE_LIMIT_DISTANCE, false, 360);
+                    return true;
+                });
+                long long virtualTime = 0;
+                for (int car = 0; car < fleet.getSize(); car++)
+                    virtualTime += fleet.getStats(car).virtualTime;
+                result.samples.push_back(fleet.getRealTime() * 1000.0 / (virtualTime / 1000000.0));
+            }
+            results.push_back(result);
+            std::sort(result.samples.begin(), result.samples.end());
+            std::cerr << " " << threads << " hilos " << 1e9 / result.samples[FLEET_RUNS / 2] << " s/s,";
+        }
+        std::cerr << std::endl;
+    }
+
+    PinsLib::Backend::set(nullptr);
+    PinsLib::Clock::set(nullptr);
+    nftw(root.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    if (argc > 1) {
+        std::ofstream out(argv[1]);
+        printJson(out, root);
+    } else {
+        printJson(std::cout, root);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+#ifndef BUS_TOPIC_H
+#define BUS_TOPIC_H
+
+#include "PinsLib/Clock.h"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Mensajes que guarda por defecto el anillo de cada tema (ha de ser potencia de 2) y tamaño de la línea de caché del
+// Cortex-A15, para que el publicador y los suscriptores de distintos núcleos no compartan líneas
+#define DEFAULT_TOPIC_CAPACITY      16
+#define CACHE_LINE_SIZE             64
+
+namespace Bus {
+
+    // Modo de una suscripción: solo el último mensaje publicado (estado: distancia, posición, velocidades...) o todos
+    // los mensajes en orden (eventos), contando los que se pierden si el suscriptor no los consume a tiempo
+    enum SubscriptionMode { LATEST, QUEUED };
+
+    // Parte común de todos los temas: nombre y contadores, que se actualizan desde cualquier hilo
+    class TopicBase {
+    public:
+        struct TopicStats {
+            unsigned long long published;
+            unsigned long long delivered;
+            unsigned long long dropped;
+            unsigned long long totalLatency;
+            unsigned long long maxLatency;
+        };
+
+    private:
+        std::string name;
+        std::atomic<unsigned long long> published;
+        std::atomic<unsigned long long> delivered;
+        std::atomic<unsigned long long> dropped;
+        std::atomic<unsigned long long> totalLatency;
+        std::atomic<unsigned long long> maxLatency;
+
+    protected:
+        explicit TopicBase(const std::string &name);
+
+        void countPublished();
+        void countDelivered(long long latency);
+        void countDropped(unsigned long long messages);
+
+    public:
+        TopicBase(const TopicBase &) = delete;
+        TopicBase &operator=(const TopicBase &) = delete;
+
+        const std::string &getName() const;
+        TopicStats getStats() const;
+
+        // Informe de mensajes publicados, entregados y perdidos, y latencia desde la publicación hasta la entrega (us)
+        static void printReport(std::ostream &out, const std::vector<const TopicBase *> &topics);
+    };
+
+    // Tema con mensajes de tipo T sobre un anillo preasignado de CAPACITY mensajes. El publicador construye cada
+    // mensaje directamente en su hueco del anillo (claim() + publish()), sin copiarlo, y cada suscriptor copia el
+    // mensaje de ese hueco al recibirlo (receive()), sin reservas de memoria ni colas intermedias. La copia es la única
+    // y es necesaria: el publicador puede reutilizar el hueco en cuanto da la vuelta al anillo. No hay cerrojos: cada hueco lleva un número de secuencia (par cuando el
+    // mensaje está completo, impar mientras se escribe) y el suscriptor descarta la lectura si ha cambiado mientras
+    // leía, es decir, si el publicador le ha dado la vuelta al anillo.
+    // Cada tema admite un único publicador y cualquier número de suscriptores, cada uno en su propio hilo
+    template<typename T, unsigned int CAPACITY = DEFAULT_TOPIC_CAPACITY>
+    class Topic : public TopicBase {
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "La capacidad del tema ha de ser potencia de 2");
+        static_assert(std::is_trivially_copyable<T>::value, "Los mensajes han de poder copiarse byte a byte");
+
+    private:
+        struct alignas(CACHE_LINE_SIZE) Slot {
+            std::atomic<unsigned long long> sequence;
+            long long stamp;
+            T message;
+        };
+
+        Slot slots[CAPACITY];
+        alignas(CACHE_LINE_SIZE) std::atomic<unsigned long long> head;     // Mensajes publicados
+        unsigned long long claimed;                                         // Mensaje en construcción (publicador)
+        PinsLib::Clock *clock;
+
+        /**
+         * @brief Copia el mensaje indicado si sigue en el anillo y no se ha modificado durante la copia
+         * @return true si la copia es válida, false si el publicador ha sobrescrito el hueco
+         */
+        bool read(unsigned long long index, T &message, long long &stamp) const {
+            const Slot &slot = slots[index & (CAPACITY - 1)];
+            unsigned long long expected = 2 * index + 2;
+            if (slot.sequence.load(std::memory_order_acquire) != expected)
+                return false;
+            message = slot.message;
+            stamp = slot.stamp;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return slot.sequence.load(std::memory_order_relaxed) == expected;
+        }
+
+    public:
+        // Suscripción a un tema. Solo recibe los mensajes publicados a partir de su creación
+        class Subscriber {
+        private:
+            Topic *topic;
+            SubscriptionMode mode;
+            unsigned long long next;
+
+        public:
+            Subscriber(Topic *topic, SubscriptionMode mode) {
+                this->topic = topic;
+                this->mode = mode;
+                this->next = topic->head.load(std::memory_order_acquire);
+            }
+
+            /**
+             * @brief Recibe el siguiente mensaje (QUEUED) o el último publicado (LATEST), si no se había recibido ya.
+             * En modo QUEUED, si el publicador ha dado la vuelta al anillo, los mensajes sobrescritos se cuentan como
+             * perdidos y se continúa por el más antiguo que quede
+             * @param message Copia del mensaje recibido (solo válida si se devuelve true)
+             * @return true si se ha recibido un mensaje nuevo, false en caso contrario
+             */
+            bool receive(T &message) {
+                while (true) {
+                    unsigned long long head = topic->head.load(std::memory_order_acquire);
+                    if (next >= head)
+                        return false;
+                    if (mode == LATEST) {
+                        next = head - 1;
+                    } else if (head - next > CAPACITY) {
+                        topic->countDropped(head - CAPACITY - next);
+                        next = head - CAPACITY;
+                    }
+
+                    long long stamp;
+                    bool valid = topic->read(next, message, stamp);
+                    next++;
+                    if (valid) {
+                        topic->countDelivered(topic->clock->now() - stamp);
+                        return true;
+                    }
+                    if (mode == QUEUED)
+                        topic->countDropped(1);
+                }
+            }
+        };
+
+        explicit Topic(const std::string &name, PinsLib::Clock *clock = PinsLib::Clock::get()) : TopicBase(name) {
+            for (Slot &slot : slots) {
+                slot.sequence.store(0, std::memory_order_relaxed);
+                slot.stamp = 0;
+            }
+            this->head.store(0, std::memory_order_relaxed);
+            this->claimed = 0;
+            this->clock = clock;
+        }
+
+        /**
+         * @brief Reserva el hueco del siguiente mensaje para construirlo en él. El contenido previo del hueco es el
+         * de un mensaje antiguo, por lo que se han de rellenar todos los campos antes de llamar a publish()
+         * @return Mensaje a rellenar
+         */
+        T &claim() {
+            Slot &slot = slots[claimed & (CAPACITY - 1)];
+            slot.sequence.store(2 * claimed + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            return slot.message;
+        }
+
+        /**
+         * @brief Publica el mensaje reservado con claim(), que queda visible para todos los suscriptores
+         */
+        void publish() {
+            Slot &slot = slots[claimed & (CAPACITY - 1)];
+            slot.stamp = clock->now();
+            slot.sequence.store(2 * claimed + 2, std::memory_order_release);
+            claimed++;
+            head.store(claimed, std::memory_order_release);
+            countPublished();
+        }
+
+        void publish(const T &message) {
+            claim() = message;
+            publish();
+        }
+
+        Subscriber subscribe(SubscriptionMode mode) {
+            return Subscriber(this, mode);
+        }
+    };
+
+} /* namespace Bus */
+
+#endif //BUS_TOPIC_H
@@ -0,0 +1,67 @@
+#ifndef BUS_TOPICS_H
+#define BUS_TOPICS_H
+
+#include "Bus/Topic.h"
+#include "Navigation/Odometry.h"
+#include <cstdint>
+#include <ostream>
+
+// Eventos que se guardan en el anillo del tema de eventos: se consumen con una suscripción QUEUED y no deben perderse
+#define MODE_EVENTS_CAPACITY        64
+
+// Número máximo de sensores del array de ultrasonidos
+#define RANGE_ARRAY_CAPACITY        8
+
+namespace Bus {
+
+    // Tacos contados en el encoder de cada rueda desde el arranque (en valor absoluto, ver RoboCar::getWheelTicks)
+    struct WheelTicksMessage {
+        float left;
+        float right;
+    };
+
+    // Medida del sensor de ultrasonidos
+    struct RangeMessage {
+        float distance;     // CM, -1 si la medida es errónea
+        float mount;        // Orientación del sensor respecto al eje del coche (radianes)
+        long long time;     // Instante de la medida (us, en la escala del reloj del coche)
+    };
+
+    // Última medida de cada sensor del array de ultrasonidos (time: instante del disparo, -1 si aún no hay medida)
+    struct RangeArrayMessage {
+        int32_t count;
+        RangeMessage ranges[RANGE_ARRAY_CAPACITY];
+    };
+
+    // Velocidades de referencia de las ruedas (tacos/s)
+    struct SpeedSetpointMessage {
+        int16_t left;
+        int16_t right;
+    };
+
+    enum ModeEventType : uint8_t { MODE_STARTED, MODE_FINISHED, WALL_FOUND, WALL_LOST, OBSTACLE_DETECTED, OBSTACLE_AVOIDED };
+
+    // Cambio de estado del modo en ejecución
+    struct ModeEventMessage {
+        ModeEventType type;
+        int32_t value;
+    };
+
+    // Temas del coche. Las etapas del bucle (sensado, control, decisión...) solo se comunican a través de ellos,
+    // por lo que pueden repartirse entre hilos en distintos núcleos
+    struct RoboCarTopics {
+        Topic<WheelTicksMessage> wheelTicks;
+        Topic<RangeMessage> range;
+        Topic<RangeArrayMessage> ranges;
+        Topic<Navigation::Pose> pose;
+        Topic<SpeedSetpointMessage> speedSetpoints;
+        Topic<ModeEventMessage, MODE_EVENTS_CAPACITY> modeEvents;
+
+        explicit RoboCarTopics(PinsLib::Clock *clock = PinsLib::Clock::get());
+
+        void printReport(std::ostream &out) const;
+    };
+
+} /* namespace Bus */
+
+#endif //BUS_TOPICS_H
@@ -0,0 +1,58 @@
+#ifndef NAVIGATION_CIRCUITPLAN_H
+#define NAVIGATION_CIRCUITPLAN_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Tiempos (us) que se suman a la estimación de cada primitiva: respuesta de los motores al cambiar de velocidad
+// y espera hasta que el coche queda parado antes de girar sobre sí mismo
+#define PRIMITIVE_RAMP_UMS          150000
+#define SPIN_SETTLE_UMS             300000
+
+namespace Navigation {
+
+    enum PrimitiveType : uint8_t { STRAIGHT_PRIMITIVE, SPIN_PRIMITIVE, ARC_PRIMITIVE };
+
+    // Primitiva de movimiento ya compilada: todo lo que necesita el bucle de ejecución está precalculado, de forma
+    // que este solo tiene que comparar los tacos recorridos por cada rueda con el objetivo
+    struct MotionPrimitive {
+        PrimitiveType type;
+        bool untilWall;         // Recta de longitud desconocida: termina al detectar la pared
+        int16_t leftSpeed;      // Velocidad de cada rueda (tacos/s, negativa hacia atrás)
+        int16_t rightSpeed;
+        float leftTicks;        // Tacos que ha de recorrer cada rueda (0 si untilWall). No se redondean: un taco
+        float rightTicks;       // equivale a más de 8 grados en un giro sobre sí mismo
+        float wallDistance;     // Distancia a la pared (CM) que termina la primitiva antes de tiempo, -1 si no hay
+        int32_t duration;       // Duración estimada (us), 0 si untilWall
+    };
+
+    // Plan de movimiento de un circuito, compilado a partir de su fichero de descripción. Cada línea del fichero es
+    // un tramo (lo que sigue a '#' es un comentario):
+    //   straight <CM|wall> [speed <CM/s>] [wall <CM>]   recta de la longitud indicada o hasta detectar la pared
+    //   l|r <grados> [speed <CM/s>]                       giro sobre sí mismo
+    //   arc l|r <grados> <radio CM> [speed <CM/s>]        curva sin detenerse, con el radio indicado
+    // "wall" termina la recta antes de tiempo si la pared está a menos de la distancia indicada. Si el fichero solo
+    // contiene giros sobre sí mismo (formato original) antes de cada giro se avanza hasta detectar la pared
+    class CircuitPlan {
+    private:
+        std::vector<MotionPrimitive> primitives;
+
+    public:
+        // Carga y compila el fichero. Las velocidades de los tramos se limitan a las calibradas (tacos/s): las rectas
+        // y curvas van por defecto a la velocidad media y los giros sobre sí mismo a la mínima
+        bool load(const std::string &filename, int minSpeed, int maxSpeed);
+
+        const std::vector<MotionPrimitive> &getPrimitives() const;
+
+        // Tiempo estimado de una vuelta (us), sin contar las rectas hasta la pared (se indica cuántas hay)
+        long long estimateLapTime(int *unknownSegments = nullptr) const;
+
+        // Muestra el plan compilado y la estimación del tiempo de vuelta
+        void print(std::ostream &out) const;
+    };
+
+} /* namespace Navigation */
+
+#endif //NAVIGATION_CIRCUITPLAN_H
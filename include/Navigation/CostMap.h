@@ -0,0 +1,57 @@
+#ifndef NAVIGATION_COSTMAP_H
+#define NAVIGATION_COSTMAP_H
+
+#include "OccupancyGrid.h"
+#include "DStarLite.h"
+#include <cstdint>
+#include <vector>
+
+// Factor de coste de las celdas cercanas a un obstáculo (pero fuera de la zona de choque)
+#define INFLATED_CELL       5
+
+namespace Navigation {
+
+    // Rejilla de planificación: celdas más gruesas que las del mapa de ocupación, en las que los obstáculos se
+    // ensanchan para poder tratar al coche como un punto. Las celdas a menos de lethalRadius de un obstáculo son
+    // infranqueables y las que están a menos de inflationRadius se pueden atravesar con un coste mayor, de forma
+    // que los caminos se alejan de los obstáculos pero el coche puede salir de una zona ensanchada si ha
+    // terminado dentro de ella. Cada celda lleva la cuenta de los obstáculos cercanos, por lo que añadir o
+    // quitar un obstáculo solo toca su entorno
+    class CostMap {
+    private:
+        int width;
+        int height;
+        float cellSize;
+        float originX;
+        float originY;
+
+        std::vector<uint8_t> obstacles;
+        std::vector<uint16_t> lethal;
+        std::vector<uint16_t> inflation;
+
+        // Desplazamientos (x, y, infranqueable) de las celdas a menos del radio de ensanchamiento
+        std::vector<int> inflationOffsets;
+
+    public:
+        // Rejilla de width x height celdas de cellSize CM, centrada en (0, 0)
+        CostMap(int width, int height, float cellSize, float lethalRadius, float inflationRadius);
+
+        int getWidth() const;
+        int getHeight() const;
+        float getCellSize() const;
+
+        // Conversión entre coordenadas (CM) y celdas. toCell devuelve false si el punto queda fuera
+        bool toCell(float x, float y, int &cellX, int &cellY) const;
+        void toWorld(int cellX, int cellY, float &x, float &y) const;
+
+        // Vuelca los obstáculos del mapa de ocupación dentro del rectángulo indicado (CM). En changed se añaden
+        // las celdas (índices y * width + x) cuyo coste puede haber cambiado
+        void update(const OccupancyGrid &map, float x0, float y0, float x1, float y1, std::vector<int> &changed);
+
+        // Factor de coste de la celda: 1, INFLATED_CELL o IMPASSABLE_CELL
+        uint8_t getCost(int cellX, int cellY) const;
+    };
+
+} /* namespace Navigation */
+
+#endif //NAVIGATION_COSTMAP_H
@@ -0,0 +1,90 @@
+#ifndef NAVIGATION_DSTARLITE_H
+#define NAVIGATION_DSTARLITE_H
+
+#include <cstdint>
+#include <vector>
+
+// Coste de las celdas por las que no se puede pasar
+#define IMPASSABLE_CELL     255
+
+namespace Navigation {
+
+    // Planificador D* Lite sobre una rejilla de celdas con vecindad 8. Cada celda tiene un factor de coste
+    // para entrar en ella (1 en espacio libre, mayor cerca de obstáculos, IMPASSABLE_CELL si está bloqueada).
+    // La búsqueda se hace desde el destino hacia el coche, de forma que cuando este se mueve o aparecen
+    // obstáculos nuevos solo se reparan los costes afectados en lugar de planificar de nuevo desde cero.
+    // Uso: setGoal(), y en cada ciclo setStart() con la posición actual, setCost() con los cambios y plan()
+    class DStarLite {
+    private:
+        int width;
+        int height;
+
+        // Estado por celda: coste estimado (g), coste a un paso (rhs), posición en la cola y factor de coste
+        std::vector<int> g;
+        std::vector<int> rhs;
+        std::vector<int> heapIndex;
+        std::vector<uint8_t> costs;
+
+        // Cola de prioridad (montículo binario indexado) con la clave empaquetada en 64 bits. Cada celda está como mucho
+        // una vez en la cola, así que se reserva para todas al crear el planificador y planificar no reserva memoria
+        struct HeapEntry {
+            uint64_t key;
+            int cell;
+        };
+        std::vector<HeapEntry> heap;
+
+        int start;
+        int lastStart;
+        int goal;
+        int km;
+        long long expansions;
+
+    public:
+        DStarLite(int width, int height);
+
+        // Establece el destino. Reinicia la búsqueda
+        void setGoal(int x, int y);
+
+        // Posición actual del coche
+        void setStart(int x, int y);
+
+        // Cambia el factor de coste de una celda (1 por defecto). Solo tiene coste si cambia su valor
+        void setCost(int x, int y, uint8_t cost);
+        uint8_t getCost(int x, int y) const;
+
+        // Calcula (o repara) el camino más corto desde la posición actual al destino
+        // return true si existe camino
+        bool plan();
+
+        // Camino desde la posición actual (incluida) hacia el destino, con un máximo de celdas (índices y * width + x)
+        void getPath(std::vector<int> &path, int maxLength) const;
+
+        // Coste del camino (10 por paso recto y 14 por paso diagonal, por el factor de cada celda). -1 si no hay camino
+        int getPathCost() const;
+
+        // Número total de celdas expandidas desde que se estableció el destino
+        long long getExpansions() const;
+
+        int getWidth() const;
+        int getHeight() const;
+
+    private:
+        int heuristic(int from, int to) const;
+        int edgeCost(int to, int direction) const;
+        uint64_t calculateKey(int cell) const;
+        int minSuccessor(int cell, int *next) const;
+        void updateVertex(int cell);
+        void updateNeighbours(int cell);
+
+        // Operaciones de la cola de prioridad
+        void heapPush(int cell, uint64_t key);
+        void heapRemove(int cell);
+        void heapUpdate(int cell, uint64_t key);
+        void siftUp(int position);
+        void siftDown(int position);
+        void heapSwap(int a, int b);
+    };
+
+} /* namespace Navigation */
+
+#endif //NAVIGATION_DSTARLITE_H
@@ -0,0 +1,77 @@
+#ifndef NAVIGATION_OCCUPANCYGRID_H
+#define NAVIGATION_OCCUPANCYGRID_H
+
+#include "Odometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tamaño de las teselas del mapa (2^GRID_TILE_BITS celdas por lado)
+#define GRID_TILE_BITS              6
+#define GRID_TILE_SIZE              (1 << GRID_TILE_BITS)
+
+// Teselas que se reservan de una vez al crear el mapa (1 MB, unos 16 x 16 teselas), para que integrar las medidas no
+// reserve memoria mientras el coche se mueve. Las siguientes se reservan una a una
+#define GRID_RESERVED_TILES         256
+
+namespace Navigation {
+
+    // Mapa de ocupación en log-odds de punto fijo (int8_t por celda; 0 = desconocida, > 0 ocupada, < 0 libre).
+    // Las celdas se agrupan en teselas cuadradas contiguas en memoria que solo se usan cuando se observan (las
+    // primeras, de un bloque reservado al crear el mapa), de forma que un escenario de decenas de metros a resolución
+    // centimétrica ocupa unos pocos MB.
+    // Cada medida del sensor de ultrasonidos actualiza el cono de su haz fila a fila: en cada fila las celdas
+    // libres (antes del obstáculo) y ocupadas (en el arco de la distancia medida) forman tramos contiguos, que se
+    // actualizan con una suma saturada vectorizable
+    class OccupancyGrid {
+    private:
+        float resolution;           // CM por celda
+        int tilesPerSide;
+        int cellsPerSide;
+        float origin;               // Coordenada (CM) del borde de la celda 0, igual en ambos ejes
+        std::vector<int8_t *> tiles;
+        int allocatedTiles;
+        int8_t *reserved;           // Bloque de teselas reservadas de antemano, que se van entregando en orden
+        int reservedTiles;
+
+    public:
+        // El mapa está centrado en (0, 0) y cubre tilesPerSide * GRID_TILE_SIZE * resolution CM por lado
+        explicit OccupancyGrid(float resolution = 1.0f, int tilesPerSide = 64, int reservedTiles = GRID_RESERVED_TILES);
+        ~OccupancyGrid();
+
+        OccupancyGrid(const OccupancyGrid &) = delete;
+        OccupancyGrid &operator=(const OccupancyGrid &) = delete;
+
+        // Integra una medida del sensor: sensor es la posición y orientación del emisor, range la distancia
+        // medida (CM), halfAngle la semiapertura del haz (radianes) y maxRange el alcance a partir del cual no
+        // se considera que haya obstáculo
+        void integrate(const Pose &sensor, float range, float halfAngle, float maxRange);
+
+        // Valor (log-odds) de la celda que contiene el punto. 0 si es desconocida o está fuera del mapa
+        int8_t getCell(float x, float y) const;
+        bool isOccupied(float x, float y) const;
+        bool isFree(float x, float y) const;
+
+        // Distancia que se sabe libre desde el punto en la dirección indicada, hasta maxRange. Se detiene en la
+        // primera celda ocupada (blocked = true) o desconocida (blocked = false)
+        float freeDistance(float x, float y, float angle, float maxRange, bool *blocked) const;
+
+        float getResolution() const;
+        int getAllocatedTiles() const;
+        size_t getMemoryUsage() const;
+
+    private:
+        // Celda que contiene la coordenada indicada (puede quedar fuera del mapa)
+        int cellIndex(float coordinate) const;
+
+        // Tesela de la celda indicada (nullptr si no está reservada y no se pide reservarla)
+        int8_t *tile(int cellX, int cellY, bool allocate);
+        const int8_t *tile(int cellX, int cellY) const;
+
+        // Suma delta a las celdas [x0, x1] de la fila y
+        void updateSpan(int y, int x0, int x1, int delta);
+    };
+
+} /* namespace Navigation */
+
+#endif //NAVIGATION_OCCUPANCYGRID_H
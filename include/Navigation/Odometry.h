@@ -0,0 +1,38 @@
+#ifndef NAVIGATION_ODOMETRY_H
+#define NAVIGATION_ODOMETRY_H
+
+namespace Navigation {
+
+    // Posición y orientación estimadas del coche (CM, radianes en sentido antihorario)
+    struct Pose {
+        float x;
+        float y;
+        float heading;
+    };
+
+    // Estimación de la posición por odometría a partir de los tacos contados en el encoder de cada rueda (con signo,
+    // positivos hacia delante). Entre dos actualizaciones se supone que la proporción entre las ruedas se ha
+    // mantenido, por lo que conviene actualizar con frecuencia y siempre que cambien las órdenes a los motores
+    class Odometry {
+    private:
+        Pose pose;
+        double travelled;
+
+    public:
+        Odometry();
+
+        // Reinicia la estimación en la posición indicada
+        void reset(Pose pose);
+
+        // Integra el movimiento de las ruedas desde la actualización anterior (tacos con signo)
+        void addTicks(float left, float right);
+
+        Pose getPose() const;
+
+        // Distancia total recorrida por el centro del eje (CM)
+        double getTravelled() const;
+    };
+
+} /* namespace Navigation */
+
+#endif //NAVIGATION_ODOMETRY_H
@@ -0,0 +1,56 @@
+#ifndef BACKEND_H_
+#define BACKEND_H_
+
+#include <string>
+
+using std::string;
+
+// Longitud máxima de la ruta completa de un fichero de control y de su contenido (solo se lee la primera línea)
+#define SYSFS_PATH_MAX      256
+#define SYSFS_VALUE_MAX     64
+
+namespace PinsLib {
+
+    // Acceso a los ficheros de control de los pines. Por defecto se trabaja directamente sobre sysfs,
+    // pero puede sustituirse (p.e: para reproducir sesiones grabadas o simular el vehículo)
+    class Backend {
+    public:
+        virtual ~Backend() {}
+
+        // Escritura y lectura de un fichero de control (path termina en '/')
+        virtual int write(const string &path, const string &filename, const string &value) = 0;
+        virtual string read(const string &path, const string &filename) = 0;
+
+        // Ruta real en el sistema de ficheros de un fichero de control, para quien necesite mantenerlo abierto.
+        // Cadena vacía si el backend no trabaja sobre ficheros
+        virtual string locate(const string &/*path*/, const string &/*filename*/) { return ""; }
+
+        // Instante (us, en la escala del reloj) del siguiente cambio de nivel de una entrada, si el backend lo conoce
+        // de antemano (p.e: el eco de un sensor simulado). -1 si no lo conoce o si no va a cambiar
+        virtual long long nextChange(const string &/*path*/, const string &/*filename*/) { return -1; }
+
+        // Backend que utilizarán los pines que se creen a partir de ahora. Por defecto sysfs
+        static Backend *get();
+        static void set(Backend *backend);
+
+        // Backend propio del hilo actual, que prevalece sobre el anterior (nullptr para volver a él)
+        static void setForThread(Backend *backend);
+    };
+
+    // Backend por defecto, que escribe en los ficheros reales (sin reservar memoria). Se le puede indicar un directorio
+    // raíz distinto de "/" para trabajar sobre una copia de la estructura de sysfs
+    class SysfsBackend : public Backend {
+    private:
+        string root;
+
+    public:
+        explicit SysfsBackend(const string &root = "");
+
+        int write(const string &path, const string &filename, const string &value) override;
+        string read(const string &path, const string &filename) override;
+        string locate(const string &path, const string &filename) override;
+    };
+
+} /* namespace PinsLib */
+
+#endif /* BACKEND_H_ */
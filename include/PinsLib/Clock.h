@@ -0,0 +1,57 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+namespace PinsLib {
+
+    // Fuente de tiempo utilizada por los pines y por todo el código que esté por encima de ellos.
+    // Todos los tiempos se expresan en microsegundos
+    class Clock {
+    public:
+        virtual ~Clock() {}
+
+        // Tiempo actual (monótono) en microsegundos
+        virtual long long now() = 0;
+
+        // Espera durante el tiempo indicado en microsegundos
+        virtual void sleep(long long ums) = 0;
+
+        // Espera hasta el instante absoluto indicado (en la escala de now())
+        virtual void sleepUntil(long long time) = 0;
+
+        // Reloj utilizado actualmente. Por defecto es el reloj del sistema
+        static Clock *get();
+        static void set(Clock *clock);
+
+        // Reloj propio del hilo actual, que prevalece sobre el anterior (nullptr para volver a él). Permite ejecutar
+        // en un mismo proceso varios coches, cada uno con su reloj
+        static void setForThread(Clock *clock);
+    };
+
+    // Reloj real del sistema (CLOCK_MONOTONIC)
+    class SystemClock : public Clock {
+    public:
+        long long now() override;
+        void sleep(long long ums) override;
+        void sleepUntil(long long time) override;
+    };
+
+    // Reloj virtual: el tiempo solo avanza cuando alguien espera o cuando se le hace avanzar explícitamente.
+    // Permite ejecutar los algoritmos tan rápido como lo permita la CPU
+    class VirtualClock : public Clock {
+    protected:
+        long long time;
+
+    public:
+        explicit VirtualClock(long long start = 0);
+
+        long long now() override;
+        void sleep(long long ums) override;
+        void sleepUntil(long long time) override;
+
+        // Hace avanzar el tiempo sin que nadie espere (p.e: coste de una operación de E/S)
+        virtual void advance(long long ums);
+    };
+
+} /* namespace PinsLib */
+
+#endif /* CLOCK_H_ */
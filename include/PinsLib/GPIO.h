@@ -76,6 +76,9 @@ namespace PinsLib {
         virtual int waitForEdge(CallbackType callback); // threaded with callback
         virtual void waitForEdgeCancel() { this->threadRunning = false; }
 
+        // Instante del siguiente flanco de la entrada, si el backend lo conoce de antemano (-1 en otro caso)
+        virtual long long nextEdge();
+
         virtual ~GPIO();  //destructor will unexport the pin
 
     private:
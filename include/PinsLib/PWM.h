@@ -5,6 +5,9 @@
 #include <fstream>
 #include "Pins.h"
 
+#define PWM_PATH            "/sys/class/pwm/"
+#define PWM_EXPORT_PATH     PWM_PATH"pwmchip2/"
+
 namespace PinsLib {
 
     class PWM : virtual public Pins {
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <fstream>
+#include "Backend.h"
 
 using std::string;
 using std::ofstream;
@@ -18,6 +19,9 @@ namespace PinsLib {
         string name, path, exportPath;
         ofstream stream;
 
+        // Backend por el que se realizan las lecturas y escrituras del pin
+        Backend *backend;
+
     public:
         // Constructor general que también exportará el pin indicado
         Pins(int number, string exportPath);
@@ -27,15 +31,22 @@ namespace PinsLib {
 
         int getNumber() { return number; }
 
+        // Ruta real de un fichero de control del pin, para mantenerlo abierto. Vacía si el backend no usa ficheros
+        string locate(const string &filename);
+
+        // Lecturas y escrituras de ficheros de control de los pines realizadas desde el hilo actual
+        static long long getOperations();
+
     private:
-        // Operaciones de escritura sobre los ficheros de manejo del pin
-        int write(string filename, string value);
-        int write(string filename, int value);
-        int write(string path, string filename, string value);
-        int write(string path, string filename, int value);
-
-        string read(string filename);
-        string read(string path, string filename);
+        // Operaciones de escritura sobre los ficheros de manejo del pin. No reservan memoria: los nombres y valores de
+        // los ficheros de control caben en una cadena sin memoria dinámica
+        int write(const string &filename, const string &value);
+        int write(const string &filename, int value);
+        int write(const string &path, const string &filename, const string &value);
+        int write(const string &path, const string &filename, int value);
+
+        string read(const string &filename);
+        string read(const string &path, const string &filename);
 
         // Exporta el pin para poder ser utilizado
         int exportPin();
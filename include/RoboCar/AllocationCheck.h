@@ -0,0 +1,40 @@
+#ifndef ROBOCAR_ALLOCATIONCHECK_H
+#define ROBOCAR_ALLOCATIONCHECK_H
+
+// Comprobación de que el bucle de control no reserva memoria dinámica una vez arrancado. Compilando con
+// -DALLOCATION_CHECK (make check-allocations) se sustituyen malloc y operator new: cualquier reserva dentro de una
+// región marcada con ALLOCATION_FREE termina el programa indicando la región y la pila de llamadas. Sin la opción,
+// las regiones no cuestan nada
+#ifdef ALLOCATION_CHECK
+#define ALLOCATION_FREE(name)   ::RoboCar::AllocationFreeRegion allocationFreeRegion(name)
+#else
+#define ALLOCATION_FREE(name)
+#endif
+
+namespace RoboCar {
+
+    // Región (ámbito) del hilo actual en la que no se permite reservar memoria. Las regiones se pueden anidar. Con un
+    // nombre nullptr no se marca nada (p.e: mientras arranca el bucle)
+    class AllocationFreeRegion {
+    private:
+        const char *previous;
+
+    public:
+        explicit AllocationFreeRegion(const char *name);
+        ~AllocationFreeRegion();
+
+        AllocationFreeRegion(const AllocationFreeRegion &) = delete;
+        AllocationFreeRegion &operator=(const AllocationFreeRegion &) = delete;
+
+        // Veces que se ha entrado en una región sin reservas (en todos los hilos)
+        static long long getCount();
+
+        // Región del hilo actual (nullptr fuera de ellas) y cambio de región, para quien cambia de contexto dentro de
+        // una región (p.e: los coches de una flota, que comparten los hilos)
+        static const char *getCurrent();
+        static void setCurrent(const char *name);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_ALLOCATIONCHECK_H
@@ -0,0 +1,54 @@
+#ifndef ROBOCAR_BATTERYMONITOR_H
+#define ROBOCAR_BATTERYMONITOR_H
+
+#include <string>
+
+// Dispositivo IIO del ADC de la BeagleBone AI y ficheros del canal al que está conectada la batería (a través de un
+// divisor de tensión). Si el dispositivo no publica la escala, se usa la del ADC de 12 bits con referencia de 1.8 V
+#define BATTERY_IIO_DEVICE              "/sys/bus/iio/devices/iio:device0/"
+#define BATTERY_IIO_RAW                 "in_voltage0_raw"
+#define BATTERY_IIO_SCALE               "in_voltage_scale"
+#define BATTERY_ADC_MV_PER_LSB          (1800.0f / 4095.0f)
+#define BATTERY_DIVIDER                 6.0f
+
+// Tensión (V) a la que se refieren las tablas de calibración una vez combinadas (batería 2S cargada)
+#define BATTERY_NOMINAL_VOLTAGE         8.4f
+
+// Periodo (us) entre lecturas del ADC y constante de tiempo (us) del filtro paso bajo
+#define BATTERY_SAMPLE_PERIOD_UMS       100000
+#define BATTERY_FILTER_UMS              2000000
+
+namespace RoboCar {
+
+    // Monitor de la tensión de la batería a través de la interfaz sysfs de IIO. La tensión se filtra con un paso bajo
+    // de primer orden (el consumo de los motores produce caídas muy breves) y se lee como mucho cada
+    // BATTERY_SAMPLE_PERIOD_UMS, por lo que se puede consultar desde el bucle de control sin coste apreciable
+    class BatteryMonitor {
+    private:
+        std::string device;
+        float scale;            // V por unidad del ADC, incluido el divisor
+        float voltage;          // Tensión filtrada, -1 si aún no hay ninguna lectura válida
+        long long lastSample;
+
+    public:
+        // La ruta del dispositivo es configurable para poder probarlo sobre un directorio con ficheros falsos
+        explicit BatteryMonitor(const std::string &device = BATTERY_IIO_DEVICE);
+
+        // Comprueba que el canal se puede leer y toma la primera lectura
+        bool open();
+
+        // Tensión filtrada (V), tomando antes una lectura si ha pasado el periodo de muestreo. -1 si no hay lecturas
+        float getVoltage();
+
+        // Monitor activo (nullptr si no se mide la batería)
+        static BatteryMonitor *get();
+        static void set(BatteryMonitor *monitor);
+
+    private:
+        // Lectura del ADC convertida a voltios, -1 si no se ha podido leer
+        float readVoltage();
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_BATTERYMONITOR_H
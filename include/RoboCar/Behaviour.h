@@ -0,0 +1,123 @@
+#ifndef ROBOCAR_BEHAVIOUR_H
+#define ROBOCAR_BEHAVIOUR_H
+
+#include "RoboCar.h"
+#include "Navigation/Odometry.h"
+#include <ostream>
+
+// Comportamientos que puede combinar un árbitro y medidas del sensor de las que se toma la mediana para decidir
+#define ARBITER_MAX_BEHAVIOURS      8
+#define BEHAVIOUR_RANGE_WINDOW      3
+
+namespace RoboCar {
+
+    // Orden de movimiento: velocidad de cada rueda (tacos/s, negativa hacia atrás). Ambas a 0 detienen el coche
+    struct MotionCommand {
+        int left;
+        int right;
+    };
+
+    // Propuesta de un comportamiento en un ciclo. Gana la de mayor prioridad; las de igual prioridad se mezclan
+    // ponderando cada orden por su peso
+    struct Proposal {
+        MotionCommand command;
+        int priority;
+        float weight;
+    };
+
+    // Estado del coche en un ciclo, el mismo para todos los comportamientos. Las medidas del sensor llegan sueltas
+    // (cada comportamiento filtra las que le interesan): rangeSequence cambia con cada medida nueva
+    struct BehaviourInputs {
+        long long time;                 // us
+        Navigation::Pose pose;
+        float leftTicks;                // Tacos recorridos por cada rueda desde el arranque (según la odometría)
+        float rightTicks;
+        float leftEncoder;              // Tacos contados en el encoder de cada rueda (en valor absoluto)
+        float rightEncoder;
+        float range;                    // Última medida del sensor principal (CM, -1 si es errónea)
+        float rangeEncoders;            // Suma de ambos encoders a mitad de esa medida
+        long long rangeSequence;
+        float battery;                  // Tensión de la batería (V), -1 si no se mide
+    };
+
+    // Mediana de las últimas medidas del sensor, en un buffer fijo
+    class RangeWindow {
+    private:
+        float ranges[BEHAVIOUR_RANGE_WINDOW];
+        int count;
+        int next;
+
+    public:
+        RangeWindow();
+
+        void add(float range);
+        void clear();
+        bool isFull() const;
+
+        // Mediana de las medidas válidas, -1 si no hay ninguna
+        float getRange() const;
+    };
+
+    // Comportamiento del coche: en cada ciclo del árbitro propone una orden de movimiento o se abstiene. No debe
+    // reservar memoria ni bloquear: el árbitro los consulta todos en cada ciclo
+    class Behaviour {
+    public:
+        virtual ~Behaviour() = default;
+
+        virtual const char *getName() const = 0;
+
+        // Devuelve false si el comportamiento no quiere intervenir en este ciclo
+        virtual bool propose(const BehaviourInputs &inputs, Proposal &proposal) = 0;
+    };
+
+    // Árbitro por prioridades: consulta los comportamientos en cada ciclo y combina sus propuestas en una única orden
+    // para las ruedas. Los comportamientos se guardan en un array fijo y no son propiedad del árbitro
+    class Arbiter {
+    private:
+        Behaviour *behaviours[ARBITER_MAX_BEHAVIOURS];
+        long long wins[ARBITER_MAX_BEHAVIOURS];
+        int count;
+        int winner;
+        long long ticks;
+        long long switches;
+        long long idle;
+
+    public:
+        Arbiter();
+
+        // Añade un comportamiento. Devuelve false si el árbitro está completo
+        bool add(Behaviour *behaviour);
+
+        // Un ciclo: combina las propuestas en la orden indicada. Devuelve false si ningún comportamiento propone
+        // nada (la orden queda a 0)
+        bool arbitrate(const BehaviourInputs &inputs, MotionCommand &command);
+
+        // Comportamiento ganador del último ciclo (el de más peso entre los de mayor prioridad), nullptr si ninguno
+        Behaviour *getWinner() const;
+
+        // Ciclos ejecutados y proporción ganada por cada comportamiento
+        void printReport(std::ostream &out) const;
+    };
+
+    // Aplica las órdenes del árbitro a los motores del coche. Solo se dan órdenes a los pines cuando cambian la
+    // velocidad de alguna rueda o el sentido de giro; las velocidades se limitan a las calibradas
+    class MotionOutput {
+    private:
+        RoboCar *car;
+        MotionCommand applied;
+        int appliedLeft;
+        int appliedRight;
+
+    public:
+        explicit MotionOutput(RoboCar *car);
+
+        void apply(const MotionCommand &command);
+        const MotionCommand &getApplied() const;
+
+        // Ambas ruedas hacia delante: el control de velocidad puede regularlas
+        bool isForward() const;
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_BEHAVIOUR_H
@@ -0,0 +1,225 @@
+#ifndef ROBOCAR_BEHAVIOURS_H
+#define ROBOCAR_BEHAVIOURS_H
+
+#include "Behaviour.h"
+#include "Navigation/CircuitPlan.h"
+#include <atomic>
+#include <vector>
+
+// Tiempo máximo (us) de un giro sobre sí mismo controlado por odometría
+#define BEHAVIOUR_TURN_TIMEOUT_UMS  4000000
+
+// Prioridades de los comportamientos: la orden manual se impone a todo, la evasión de obstáculos a la vuelta a casa
+// y esta a la marcha normal (seguir el circuito o avanzar)
+#define PRIORITY_MANUAL             100
+#define PRIORITY_AVOID              50
+#define PRIORITY_RETURN             30
+#define PRIORITY_CIRCUIT            20
+#define PRIORITY_CRUISE             10
+
+// Evasión de obstáculos: espera (us) hasta que el coche queda parado antes de barrer, marcha atrás si no hay salida y
+// tiempo máximo de la evasión completa. El barrido agrupa las medidas en sectores de 10 grados y
+// valora cada dirección con los sectores vecinos (30 grados, lo que ocupa el coche a la distancia de detección)
+#define AVOID_SETTLE_UMS            300000
+#define AVOID_REVERSE_UMS           500000
+#define AVOID_TIMEOUT_UMS           60000000
+#define AVOID_SCAN_SECTORS          36
+#define AVOID_SCAN_WINDOW_SECTORS   1
+#define AVOID_MAX_STEPS             4
+
+// Velocidad (tacos/s) de los giros y la marcha atrás de la evasión, sin bajar de la mínima calibrada: cerca de la zona
+// muerta las ruedas responden de forma desigual y el giro sobre sí mismo desplaza el coche contra lo que tenga al lado.
+// Giro por inercia (radianes) que se descuenta del primer giro, hasta medirlo (en el simulador, a esta velocidad)
+#define AVOID_SPEED                 45
+#define AVOID_TURN_COAST            0.3f
+
+// Atasco: avance (CM según la odometría) tras el que la distancia al frente ha de haber bajado al menos una cuarta
+// parte, salvo que el coche haya girado más de AVOID_STUCK_TURN (radianes) y esté apuntando a otro sitio
+#define AVOID_STUCK_CM              15.0f
+#define AVOID_STUCK_TURN            0.3f
+
+// Vuelta a casa con la batería baja: tensión (V) por debajo de la que se vuelve (2S, 3.4 V por celda), distancia (CM)
+// a la salida a la que se da por llegado y error de orientación (grados) a partir del cual se gira sobre sí mismo
+#define RETURN_VOLTAGE              6.8f
+#define RETURN_TOLERANCE_CM         15.0f
+#define RETURN_HEADING_DEG          20.0f
+
+namespace RoboCar {
+
+    // Marcha hacia delante a la velocidad indicada
+    class CruiseBehaviour : public Behaviour {
+    private:
+        int speed;
+
+    public:
+        explicit CruiseBehaviour(int speed);
+
+        const char *getName() const override;
+        bool propose(const BehaviourInputs &inputs, Proposal &proposal) override;
+        void setSpeed(int speed);
+    };
+
+    // Evasión de obstáculos: cuando la distancia filtrada baja del límite (o todas las medidas recientes son erróneas,
+    // o una sola baja de la mitad del límite, o el coche avanza sin acercarse a lo que tiene delante) toma el control
+    // hasta que el coche queda orientado hacia una salida. La maniobra es una secuencia de pasos (esperar parado, girar
+    // por odometría, barrer, retroceder, medir) que avanzan con cada ciclo, sin bloquear. Con el array de sensores,
+    // primero se gira hacia el lateral más despejado; si no, se barre el arco indicado y se gira hacia la dirección más
+    // despejada o, con un arco de 0, se tantea a la derecha y a la izquierda consultando antes el mapa de ocupación
+    class ObstacleAvoidBehaviour : public Behaviour {
+    private:
+        enum StepType { SETTLE_STEP, TURN_STEP, SWEEP_STEP, REVERSE_STEP, MEASURE_STEP };
+
+        struct Step {
+            StepType type;
+            float value;        // Giro (radianes) o barrido (radianes)
+        };
+
+        RoboCar *car;
+        float limitDistance;
+        float scanArc;
+
+        RangeWindow window;
+        long long lastSequence;
+        bool active;
+        long long start;
+        float reference;        // Orientación al detectar el obstáculo (según la odometría)
+        float lastEncoders;
+        int rotation;           // Sentido del último giro ordenado (1 a la izquierda, -1 a la derecha, 0 sin girar)
+        float turned;           // Giro acumulado desde la detección según los encoders (radianes, positivo a la izquierda)
+        int attempts;
+        bool sidesTried;
+
+        // Pasos pendientes de la maniobra y estado del paso en curso
+        Step steps[AVOID_MAX_STEPS];
+        int stepCount;
+        int stepIndex;
+        long long stepStart;
+        float stepTurned;
+
+        // Perfil polar del último barrido (la menor distancia de cada sector, -1 sin medidas), giro acumulado y
+        // encoders al empezarlo
+        float profile[AVOID_SCAN_SECTORS];
+        float sweepOrigin;
+        float sweepEncoders;
+
+        // Distancia filtrada, avance y diferencia entre ruedas (tacos según la odometría) de referencia para detectar
+        // atascos
+        float progressRange;
+        float progressTicks;
+        float progressSteer;
+
+        // Giro por inercia (radianes) medido tras detener el último giro, que se descuenta del siguiente
+        float coast;
+        bool coasting;
+
+        long long detections;
+        long long escapes;
+        long long failures;
+
+    public:
+        // scanArc: arco de barrido en grados (0 para tantear los lados)
+        ObstacleAvoidBehaviour(RoboCar *car, int limitDistance, int scanArc);
+
+        const char *getName() const override;
+        bool propose(const BehaviourInputs &inputs, Proposal &proposal) override;
+
+        // Empieza la evasión sin esperar a detectar el obstáculo (p.e: si el coche ya está parado delante de él)
+        void trigger(const BehaviourInputs &inputs);
+        bool isActive() const;
+
+        // Distancia de detección (p.e: al recargar los parámetros). Una evasión en curso termina con la nueva
+        void setLimitDistance(int limitDistance);
+
+        // Obstáculos detectados (evasiones empezadas), evasiones terminadas con una salida y abandonadas por tiempo
+        long long getDetections() const;
+        long long getEscapes() const;
+        long long getFailures() const;
+
+    private:
+        bool blocked(float range) const;
+        bool stuck(const BehaviourInputs &inputs);
+        void plan(const BehaviourInputs &inputs);
+        void push(StepType type, float value = 0);
+        void beginStep(const BehaviourInputs &inputs);
+        bool planSides();
+        void planTurns(const Navigation::Pose &pose);
+        void chooseDirection();
+        bool blockedByMap(const Navigation::Pose &pose, float angle) const;
+        void finish(bool escaped);
+    };
+
+    // Recorrido en bucle de las primitivas de un circuito: cada una termina al recorrer sus tacos (según la
+    // odometría) o al detectar la pared, y los giros sobre sí mismo empiezan desde parado
+    class FollowCircuitBehaviour : public Behaviour {
+    private:
+        const std::vector<Navigation::MotionPrimitive> &primitives;
+        float limitDistance;
+        size_t current;
+        bool started;
+        long long primitiveStart;
+        float startTicks;
+        RangeWindow window;
+        long long lastSequence;
+        long long curves;
+        long long laps;
+
+    public:
+        // Las primitivas no se copian: han de existir mientras se use el comportamiento
+        FollowCircuitBehaviour(const std::vector<Navigation::MotionPrimitive> &primitives, int limitDistance);
+
+        const char *getName() const override;
+        bool propose(const BehaviourInputs &inputs, Proposal &proposal) override;
+
+        // Primitiva en curso y si es un giro sobre sí mismo
+        int getSegment() const;
+        bool isTurning() const;
+
+        // Curvas (giros sobre sí mismo y arcos) y vueltas completadas
+        long long getCurves() const;
+        long long getLaps() const;
+
+        // Distancia de detección de la pared en las rectas que no indican otra
+        void setLimitDistance(int limitDistance);
+
+    private:
+        void begin(const BehaviourInputs &inputs);
+        bool finished(const Navigation::MotionPrimitive &primitive, const BehaviourInputs &inputs) const;
+    };
+
+    // Vuelta a la posición de salida cuando la tensión de la batería baja del umbral: gira hacia la salida y avanza,
+    // y se detiene al llegar. Una vez empieza no se abandona aunque la tensión se recupere (la caída es por el consumo)
+    class LowBatteryReturnBehaviour : public Behaviour {
+    private:
+        Navigation::Pose home;
+        float threshold;
+        int speed;
+        bool returning;
+
+    public:
+        LowBatteryReturnBehaviour(const Navigation::Pose &home, int speed, float threshold = RETURN_VOLTAGE);
+
+        const char *getName() const override;
+        bool propose(const BehaviourInputs &inputs, Proposal &proposal) override;
+        bool isReturning() const;
+    };
+
+    // Orden manual que se impone a los demás comportamientos mientras no caduque. Se puede dar desde cualquier hilo
+    class ManualOverrideBehaviour : public Behaviour {
+    private:
+        std::atomic<long long> command;     // Velocidades de ambas ruedas (32 bits cada una)
+        std::atomic<long long> expiry;      // Instante en el que caduca (us), -1 sin orden
+
+    public:
+        ManualOverrideBehaviour();
+
+        const char *getName() const override;
+        bool propose(const BehaviourInputs &inputs, Proposal &proposal) override;
+
+        // Orden vigente hasta el instante indicado (en la escala del reloj del coche) y liberación anticipada
+        void set(const MotionCommand &motion, long long until);
+        void release();
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_BEHAVIOURS_H
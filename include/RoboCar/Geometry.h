@@ -0,0 +1,27 @@
+#ifndef ROBOCAR_GEOMETRY_H
+#define ROBOCAR_GEOMETRY_H
+
+// Medidas físicas del montaje de RoboCar, necesarias para convertir tacos del encoder en distancias
+
+// Distancia recorrida por la rueda en cada taco del encoder (20 ranuras, rueda de 6.5 CM de diámetro)
+#define CM_PER_TICK                 1.02f
+
+// Distancia entre los puntos de apoyo de ambas ruedas
+#define WHEEL_TRACK_CM              14.0f
+
+// Radio del círculo que envuelve al coche, medido desde el centro del eje
+#define BODY_RADIUS_CM              10.0f
+
+// Posición del sensor de ultrasonidos respecto al centro del eje (hacia delante) y apertura de su haz
+#define ULTRASOUND_OFFSET_CM        10.0f
+#define ULTRASOUND_BEAM_HALF_ANGLE  15.0f
+
+// Orientación del sensor para el seguimiento de paredes: girado hacia la derecha (ángulos positivos hacia la
+// izquierda), de forma que ve la pared lateral y, antes de llegar a una esquina, también la de enfrente
+#define WALL_FOLLOW_MOUNT_DEG       -45.0f
+
+// Orientación de los sensores laterales del array de ultrasonidos (el izquierdo a +, el derecho a -). Todos los
+// sensores del array están montados en el frontal del coche, como el principal
+#define ULTRASOUND_SIDE_MOUNT_DEG   45.0f
+
+#endif //ROBOCAR_GEOMETRY_H
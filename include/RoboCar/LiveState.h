@@ -0,0 +1,120 @@
+#ifndef ROBOCAR_LIVESTATE_H
+#define ROBOCAR_LIVESTATE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Segmento de memoria compartida POSIX con el estado del coche en ejecución. La disposición es fija: cualquier cambio
+// en las estructuras de este fichero ha de incrementar LIVE_STATE_VERSION
+#define LIVE_STATE_NAME             "/robocar"
+#define LIVE_STATE_MAGIC            0x534C4352      // "RCLS" en little-endian
+#define LIVE_STATE_VERSION          1
+#define LIVE_MAX_STAGES             8
+#define LIVE_STAGE_NAME_SIZE        12
+#define LIVE_MODE_NAME_SIZE         16
+
+// Bits del estado de los LEDs
+#define LIVE_GREEN_LED              0x01
+#define LIVE_RED_LED                0x02
+
+namespace RoboCar {
+
+    // Temporización de una etapa del bucle principal (us)
+    struct LiveStage {
+        char name[LIVE_STAGE_NAME_SIZE];
+        int32_t period;
+        uint32_t runs;
+        uint32_t overruns;
+        int32_t lastJitter;
+        int32_t maxJitter;
+        int32_t lastDuration;
+    };
+
+    // Estado del coche. Las velocidades están en tacos/s (con signo las medidas) y las distancias en CM
+    struct LiveStateData {
+        int64_t time;                       // Instante de la última actualización (us, reloj del coche)
+        uint32_t updates;
+        int32_t commandedLeft;              // Velocidades de referencia
+        int32_t commandedRight;
+        int32_t measuredLeft;               // Última velocidad estimada a partir de los encoders
+        int32_t measuredRight;
+        int32_t dutyLeft;                   // Duty cycle de cada motor (ns)
+        int32_t dutyRight;
+        float distance;                     // Última distancia filtrada, -1 si errónea
+        float x;                            // Posición estimada por odometría
+        float y;
+        float heading;                      // Radianes
+        uint8_t leds;                       // LIVE_GREEN_LED | LIVE_RED_LED
+        uint8_t reserved[3];
+        char mode[LIVE_MODE_NAME_SIZE];
+        int32_t segment;                    // Tramo del circuito en curso, -1 si no se sigue un circuito
+        int32_t stageCount;
+        LiveStage stages[LIVE_MAX_STAGES];
+    };
+
+    // Órdenes de un proceso externo. Son estado, no eventos: permanecen hasta que el proceso las cambia
+    struct LiveCommands {
+        std::atomic<uint32_t> stop;         // Distinto de 0: detener el coche y terminar el modo en curso
+        std::atomic<int32_t> speedLimit;    // Velocidad máxima de las ruedas (tacos/s), 0 sin límite
+    };
+
+    // Segmento completo. El estado se protege con un seqlock: sequence es impar mientras se escribe, y el lector
+    // repite la copia si ha cambiado durante ella. El coche nunca espera al lector ni realiza llamadas al sistema
+    struct LiveStateSegment {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;
+        alignas(64) std::atomic<uint32_t> sequence;
+        LiveStateData state;
+        alignas(64) LiveCommands commands;
+    };
+
+    // Publicación del estado del coche en memoria compartida (lado del coche) y acceso a él desde otro proceso
+    // (lado del monitor)
+    class LiveState {
+    private:
+        LiveStateSegment *segment;
+        std::string name;
+        bool owner;
+
+    public:
+        LiveState();
+        ~LiveState();
+
+        // Crea el segmento (coche) o se conecta a uno existente comprobando su versión (monitor)
+        bool create(const std::string &name = LIVE_STATE_NAME);
+        bool attach(const std::string &name = LIVE_STATE_NAME);
+        void close();
+
+        // Actualización del estado (coche). Entre beginUpdate() y endUpdate() los lectores no ven el estado a medias.
+        // Admite varios hilos escritores, que se esperan entre sí
+        LiveStateData &beginUpdate();
+        void endUpdate();
+
+        // Actualizaciones sueltas de uso habitual
+        void setMode(const std::string &mode);
+        void setSegment(int segment);
+        void setDistance(float distance);
+        void setLed(uint8_t led, bool on);
+        int registerStage(const std::string &name, long long period);
+        void updateStage(int stage, unsigned long long runs, unsigned long long overruns, long long jitter,
+                         long long maxJitter, long long duration);
+
+        // Lectura consistente del estado (monitor)
+        bool read(LiveStateData &state) const;
+
+        // Órdenes
+        bool stopRequested() const;
+        int getSpeedLimit() const;
+        void requestStop(bool stop);
+        void setSpeedLimit(int speedLimit);
+
+        // Estado publicado actualmente (nullptr si no se publica)
+        static LiveState *get();
+        static void set(LiveState *liveState);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_LIVESTATE_H
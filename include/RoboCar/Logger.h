@@ -0,0 +1,167 @@
+#ifndef ROBOCAR_LOGGER_H
+#define ROBOCAR_LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Niveles de los mensajes. Los de nivel inferior a LOG_LEVEL no se compilan (p.e: make DEFINES=-DLOG_LEVEL=2)
+#define LOG_LEVEL_DEBUG             0
+#define LOG_LEVEL_INFO              1
+#define LOG_LEVEL_WARNING           2
+#define LOG_LEVEL_ERROR             3
+#ifndef LOG_LEVEL
+#define LOG_LEVEL                   LOG_LEVEL_INFO
+#endif
+
+// Registros de la cola de cada hilo (potencia de 2), argumentos por registro y periodo (us, tiempo real) con el que el
+// hilo de escritura vuelca las colas
+#define LOG_RING_CAPACITY           4096
+#define LOG_MAX_ARGS                6
+#define LOG_FLUSH_PERIOD_UMS        10000
+
+// Longitud que se reserva en cada hilo para los mensajes que se escriben directamente, sin registro activo
+#define LOG_DIRECT_TEXT_RESERVE     256
+
+// Mensajes del bucle de control: el formato ha de ser un literal en el que cada "{}" se sustituye por un argumento
+// (entero, real o cadena que viva hasta que se escriba, p.e: otro literal)
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)              ::RoboCar::Logger::log(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)              ((void) 0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...)               ::RoboCar::Logger::log(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...)               ((void) 0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...)            ::RoboCar::Logger::log(LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...)            ((void) 0)
+#endif
+#define LOG_ERROR(...)              ::RoboCar::Logger::log(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+namespace RoboCar {
+
+    // Mensaje sin formatear: formato, instante (us, reloj de PinsLib), nivel y argumentos con su tipo
+    struct LogRecord {
+        enum Type : uint8_t { INTEGER, REAL, TEXT };
+
+        const char *format;
+        long long time;
+        uint8_t level;
+        uint8_t count;
+        Type types[LOG_MAX_ARGS];
+        union {
+            long long integer;
+            double real;
+            const char *text;
+        } values[LOG_MAX_ARGS];
+    };
+
+    // Registro de mensajes asíncrono. Quien escribe un mensaje solo copia el formato y los argumentos en la cola de su
+    // hilo (un anillo sin bloqueos con un único productor y un único consumidor), sin formatear ni hacer E/S. Un hilo
+    // aparte vuelca periódicamente todas las colas, ordenando los mensajes por instante, y los escribe en bloque: los
+    // de error y aviso en la salida de errores y el resto en la estándar. Si una cola se llena, los mensajes nuevos
+    // se descartan (el bucle de control nunca espera). Sin un registro activo los mensajes se escriben al momento en
+    // std::cout y std::cerr, como antes
+    class Logger {
+    private:
+        // Cola de un hilo. Las posiciones crecen sin fin y se reducen al índice con la máscara de la capacidad
+        struct Ring {
+            alignas(64) std::atomic<unsigned long long> head;
+            alignas(64) std::atomic<unsigned long long> tail;
+            unsigned long long dropped;
+            LogRecord records[LOG_RING_CAPACITY];
+        };
+
+        FILE *out;
+        FILE *err;
+
+        // Colas registradas (una por hilo que ha escrito algún mensaje)
+        std::mutex ringsMutex;
+        std::vector<Ring *> rings;
+
+        // Vaciado de las colas (un único consumidor a la vez) y mensajes recogidos en cada vaciado
+        std::mutex flushMutex;
+        std::vector<LogRecord> batch;
+        std::string outText;
+        std::string errText;
+        unsigned long long written;
+
+        std::thread writer;
+        std::atomic<bool> running;
+
+    public:
+        explicit Logger(FILE *out = stdout, FILE *err = stderr);
+
+        // Vuelca los mensajes pendientes, detiene el hilo de escritura e informa de los mensajes descartados
+        ~Logger();
+
+        // Arranca el hilo de escritura
+        void start();
+
+        // Escribe ya los mensajes pendientes (p.e: al terminar un bucle, antes de mostrar sus estadísticas)
+        void flush();
+
+        // Reserva ya la cola del hilo actual en el registro activo (o, si no lo hay, el texto de los mensajes directos),
+        // para que su primer mensaje no reserve memoria (p.e: antes de un bucle)
+        static void prepareThread();
+
+        unsigned long long getWritten() const;
+        unsigned long long getDropped();
+
+        // Registro activo (nullptr para escribir los mensajes al momento)
+        static Logger *get();
+        static void set(Logger *logger);
+
+        // Añade un mensaje (ver LOG_INFO y el resto de macros)
+        template<typename... Args>
+        static void log(int level, const char *format, Args... args) {
+            static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Demasiados argumentos para un mensaje");
+            LogRecord record;
+            record.format = format;
+            record.level = (uint8_t) level;
+            record.count = 0;
+            (void) std::initializer_list<int>{(pack(record, args), 0)...};
+            submit(record);
+        }
+
+        // Formatea un mensaje (sin salto de línea final)
+        static void format(const LogRecord &record, std::string &text);
+
+    private:
+        static void pack(LogRecord &record, long long value) {
+            record.types[record.count] = LogRecord::INTEGER;
+            record.values[record.count++].integer = value;
+        }
+        static void pack(LogRecord &record, int value) { pack(record, (long long) value); }
+        static void pack(LogRecord &record, long value) { pack(record, (long long) value); }
+        static void pack(LogRecord &record, unsigned int value) { pack(record, (long long) value); }
+        static void pack(LogRecord &record, unsigned long value) { pack(record, (long long) value); }
+        static void pack(LogRecord &record, double value) {
+            record.types[record.count] = LogRecord::REAL;
+            record.values[record.count++].real = value;
+        }
+        static void pack(LogRecord &record, float value) { pack(record, (double) value); }
+        static void pack(LogRecord &record, const char *value) {
+            record.types[record.count] = LogRecord::TEXT;
+            record.values[record.count++].text = value;
+        }
+
+        // Pone el instante al mensaje y lo añade a la cola del hilo actual (o lo escribe, sin registro activo)
+        static void submit(LogRecord &record);
+
+        Ring *registerRing();
+        void run();
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_LOGGER_H
@@ -0,0 +1,82 @@
+#ifndef ROBOCAR_LOOPEXECUTOR_H
+#define ROBOCAR_LOOPEXECUTOR_H
+
+#include "PinsLib/Clock.h"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace RoboCar {
+
+    // Importancia de una etapa cuando el watchdog ordena reducir la carga: las críticas no cambian, las prescindibles
+    // (p.e: el sensado) se lanzan con menor frecuencia y las opcionales (p.e: los LEDs) no se lanzan
+    enum StagePriority { STAGE_CRITICAL, STAGE_SHEDDABLE, STAGE_OPTIONAL };
+
+    // Ejecutor del bucle principal con etapas periódicas (sensado, control, decisión, LEDs...). Cada etapa se lanza
+    // en instantes absolutos (inicio + fase + k * periodo), por lo que el periodo no depende de lo que tarden las
+    // demás etapas. Se registra el retraso de cada lanzamiento (jitter), las veces que una ejecución sobrepasa su
+    // siguiente lanzamiento (overrun) y los lanzamientos que se han tenido que saltar
+    class LoopExecutor {
+    public:
+        // Estadísticas de una etapa
+        struct StageStats {
+            long long runs;
+            long long overruns;
+            long long skipped;
+            long long totalJitter;
+            long long maxJitter;
+            long long totalDuration;
+            long long maxDuration;
+        };
+
+    private:
+        struct Stage {
+            std::string name;
+            long long period;
+            long long phase;
+            std::function<void()> function;
+            StagePriority priority;
+            long long nextRelease;
+            StageStats stats;
+            int liveStage;      // Entrada en el estado publicado en memoria compartida, -1 si no se publica
+        };
+
+        PinsLib::Clock *clock;
+        std::vector<Stage> stages;
+        bool running;
+        bool resyncRequested;
+        long long startTime;
+
+    public:
+        explicit LoopExecutor(PinsLib::Clock *clock = PinsLib::Clock::get());
+
+        // Registra una etapa que se ejecutará cada period us, desplazada phase us respecto al inicio.
+        // Las etapas que coinciden en el mismo instante se ejecutan en orden de registro
+        int addStage(const std::string &name, long long period, long long phase, std::function<void()> function,
+                     StagePriority priority = STAGE_CRITICAL);
+
+        // Ejecuta las etapas durante el tiempo indicado (us), hasta que se invoque stop(), hasta que se ordene
+        // detener el coche desde el monitor o hasta que lo detenga el watchdog. Si se publica el estado del coche,
+        // incluye la temporización de las etapas; si hay watchdog, le da una señal de vida tras cada etapa. Al terminar
+        // escribe los mensajes pendientes del registro (Logger). Salvo en su primer lanzamiento, las etapas no pueden
+        // reservar memoria (ALLOCATION_FREE)
+        void run(long long duration);
+        void stop();
+
+        // Indica, desde una etapa, que esta ha realizado una espera intencionada (p.e: un giro) y que todas las
+        // etapas deben volver a programarse a partir del instante en que termine, sin contarlo como overrun
+        void resync();
+
+        const StageStats &getStats(int stage) const;
+
+        // Informe de temporización de todas las etapas
+        void printReport(std::ostream &out) const;
+
+        // Fija el hilo actual al núcleo indicado, para ejecutar en él un bucle sin que compita con los demás
+        static bool pinToCore(int core);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_LOOPEXECUTOR_H
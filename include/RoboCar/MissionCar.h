@@ -0,0 +1,87 @@
+#ifndef ROBOCAR_MISSIONCAR_H
+#define ROBOCAR_MISSIONCAR_H
+
+#include "MissionExecutor.h"
+#include "RoboCar.h"
+
+// Medidas del sensor desde una misión: separación mínima (us) entre disparos, para que se extinga el eco anterior
+// (el HC-SR04 necesita unos 25 ms), tiempo máximo de eco (us, unos 4 metros) y medidas de las que se toma la mediana
+#define MISSION_PING_UMS            30000
+#define MISSION_ECHO_TIMEOUT_UMS    25000
+#define MISSION_RANGE_WINDOW        3
+
+// Espera (us) entre consultas de la odometría mientras se recorren unos tacos: se duerme lo que se estima que falta
+// según la velocidad de las ruedas, dentro de estos márgenes
+#define MISSION_TRAVEL_MIN_WAIT_UMS 1000
+#define MISSION_TRAVEL_MAX_WAIT_UMS 50000
+
+// Medida de la velocidad de una rueda: tacos del encoder que se cronometran y espera máxima (us) de cada flanco, tras
+// la que se considera que la rueda está parada
+#define MISSION_SPEED_TICKS         5
+#define MISSION_SPEED_TIMEOUT_UMS   100000
+
+// Cuenta de tacos: periodo (us) con el que se comprueba si se ha habilitado mientras está deshabilitada
+#define MISSION_COUNT_IDLE_UMS      5000
+
+namespace RoboCar {
+
+    // Acciones del coche que se esperan desde una misión (co_await). Las órdenes inmediatas (avanzar, detenerse,
+    // LEDs...) se dan directamente al coche (get()). El sensor se mide sin bloquear: se dispara y se esperan los
+    // flancos del eco, de forma que mientras vuelve el eco se atienden las demás tareas. Las últimas medidas se
+    // filtran con su mediana, como en un único getDistance() pero sin detenerse a tomarlas seguidas
+    class MissionCar {
+    private:
+        RoboCar *car;
+        MissionExecutor &executor;
+
+        // Últimas medidas del sensor (-1 las erróneas) e instante en el que se puede volver a disparar
+        float ranges[MISSION_RANGE_WINDOW];
+        int rangeCount;
+        int rangeNext;
+        long long nextPing;
+
+    public:
+        MissionCar(RoboCar *car, MissionExecutor &executor);
+
+        RoboCar *get() const;
+        MissionExecutor &getExecutor() const;
+
+        // Espera el tiempo indicado (us)
+        MissionExecutor::SleepAwaiter sleep(long long ums);
+
+        // Una medida del sensor principal (CM, -1 si es errónea), que se añade a las filtradas
+        Task<float> ping();
+
+        // Mide continuamente hasta que la distancia filtrada baja de la indicada. Si se indica, también termina si todas
+        // las medidas recientes son erróneas (como en los modos que tratan así el -1 de getDistance()). Devuelve la
+        // distancia filtrada
+        Task<float> distanceBelow(float limit, bool errorsAsNear = true);
+
+        // Distancia filtrada de las últimas medidas (-1 si no hay ninguna válida) y descarte de las medidas (p.e: tras
+        // girar, ya no corresponden a lo que hay delante)
+        float getRange() const;
+        void clearRanges();
+
+        // Velocidad de una rueda (tacos/s, 0 si está parada), cronometrando los flancos de su encoder sin bloquear
+        Task<int> measureSpeed(Wheel wheel);
+
+        // Cuenta los tacos de una rueda (en valor absoluto) esperando cada flanco de su encoder, mientras esté
+        // habilitado. No termina
+        Task<> countTicks(Wheel wheel, float &ticks, const bool &enabled);
+
+        // Espera a que ambas ruedas hayan recorrido, entre las dos, los tacos indicados (según la odometría)
+        Task<> travel(float ticks);
+
+        // Gira sobre sí mismo el ángulo indicado (grados, positivo hacia la izquierda) a la velocidad vigente,
+        // deteniéndose cuando la odometría indica que lo ha alcanzado
+        Task<> rotate(float angle);
+    };
+
+    // Las tareas del coche toman sus marcos de la reserva de su ejecutor
+    inline FramePool *framePoolOf(MissionCar &car) {
+        return car.getExecutor().getFramePool();
+    }
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_MISSIONCAR_H
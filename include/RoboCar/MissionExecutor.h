@@ -0,0 +1,352 @@
+#ifndef ROBOCAR_MISSIONEXECUTOR_H
+#define ROBOCAR_MISSIONEXECUTOR_H
+
+#include "PinsLib/Clock.h"
+#include "PinsLib/GPIO.h"
+#include <coroutine>
+#include <exception>
+#include <map>
+#include <ostream>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Eventos de pines que se recogen en cada espera y periodo (us) con el que se sondea un pin si no se pueden esperar
+// sus flancos (ni el backend ni el sistema de ficheros los notifican)
+#define MISSION_MAX_EVENTS          8
+#define MISSION_PIN_POLL_UMS        100
+
+// Con un reloj virtual, periodo (us) con el que se vuelve a preguntar al backend por los flancos previstos mientras se
+// esperan: pueden adelantarse (p.e: el pulso de otro coche termina antes el eco)
+#define MISSION_EDGE_RECHECK_UMS    1000
+
+// Espera máxima (us) del bucle de eventos si se publica el estado del coche, para atender las órdenes de parada
+#define MISSION_CHECK_PERIOD_UMS    100000
+
+// Memoria que cada ejecutor reserva al crearse para que el bucle no reserve más: marcos de corrutinas (tamaño máximo
+// en bytes y número) y esperas registradas a la vez. Los marcos mayores o que no quepan se reservan aparte
+#define MISSION_FRAME_SIZE          512
+#define MISSION_FRAME_COUNT         32
+#define MISSION_MAX_WAITS           32
+
+namespace RoboCar {
+
+    class MissionExecutor;
+
+    // Marcos de corrutinas de tamaño fijo, reservados en un único bloque al crear el ejecutor. Los libres forman una
+    // lista enlazada sobre los propios marcos. No se protege entre hilos: solo la usan las tareas de su ejecutor
+    class FramePool {
+    private:
+        char *memory;
+        void *freeFrames;
+
+    public:
+        FramePool();
+        ~FramePool();
+
+        FramePool(const FramePool &) = delete;
+        FramePool &operator=(const FramePool &) = delete;
+
+        // Marco para una corrutina de la reserva indicada o, si no la hay (nullptr) o no cabe, del heap. Cada marco
+        // recuerda su origen para devolverlo a él
+        static void *allocate(FramePool *pool, size_t size);
+        static void release(void *frame);
+    };
+
+    // Reserva de marcos del ejecutor al que da acceso un argumento de una corrutina: el propio ejecutor o un
+    // MissionCar (también como objeto de una función miembro). Se busca el primero que dé acceso a uno
+    template<typename T>
+    FramePool *framePoolOf(T &) { return nullptr; }
+    FramePool *framePoolOf(MissionExecutor &executor);
+
+    inline FramePool *findFramePool() { return nullptr; }
+
+    template<typename First, typename... Rest>
+    FramePool *findFramePool(First &first, Rest &... rest) {
+        FramePool *pool = framePoolOf(first);
+        return (pool != nullptr) ? pool : findFramePool(rest...);
+    }
+
+    // Promesa común de las tareas: empiezan suspendidas y, al terminar, reanudan a quien las esperaba. Sus marcos se
+    // toman de la reserva del ejecutor, de forma que crear una tarea en el bucle (p.e: cada medida) no reserva memoria
+    struct TaskPromiseBase {
+        std::coroutine_handle<> continuation;
+
+        template<typename... Args>
+        static void *operator new(size_t size, Args &... args) {
+            return FramePool::allocate(findFramePool(args...), size);
+        }
+
+        static void *operator new(size_t size) {
+            return FramePool::allocate(nullptr, size);
+        }
+
+        static void operator delete(void *frame) {
+            FramePool::release(frame);
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                std::coroutine_handle<> next = handle.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    template<typename T>
+    struct TaskPromise : TaskPromiseBase {
+        T value{};
+
+        void return_value(T value) { this->value = value; }
+        T result() { return value; }
+    };
+
+    template<>
+    struct TaskPromise<void> : TaskPromiseBase {
+        void return_void() {}
+        void result() {}
+    };
+
+    // Tarea de una misión (corrutina de C++20) que devuelve un T. No empieza hasta que otra tarea la espera con
+    // co_await o hasta que se entrega al ejecutor (MissionExecutor::run). Destruir una tarea suspendida la cancela,
+    // junto con las tareas y esperas en las que esté detenida; las órdenes ya dadas al coche siguen vigentes
+    template<typename T = void>
+    class Task {
+    public:
+        struct promise_type : TaskPromise<T> {
+            Task get_return_object() {
+                return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        template<typename...> friend class WhenAny;
+        friend class MissionExecutor;
+
+    public:
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task() {
+            if (handle)
+                handle.destroy();
+        }
+
+        bool isDone() const {
+            return !handle || handle.done();
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    // Espera registrada en el ejecutor: un instante (plazo) y, opcionalmente, un fichero cuyo aviso la adelanta
+    struct MissionWait {
+        enum State { IDLE, WAITING, READY };
+
+        MissionExecutor *executor;
+        std::coroutine_handle<> handle;
+        long long time;
+        long long deadline;
+        PinsLib::GPIO *pin;     // Pin cuyo flanco previsto por el backend se espera (con un reloj virtual)
+        int fd;
+        bool pinEvent;          // Se ha despertado por un flanco (y no por el plazo)
+        State state;
+        long long sequence;
+
+        explicit MissionWait(MissionExecutor *executor) : executor(executor), time(0), deadline(0), pin(nullptr),
+                                                           fd(-1), pinEvent(false), state(IDLE), sequence(0) {}
+    };
+
+    // Bucle de eventos de un solo hilo sobre el que se ejecutan las misiones del coche. Las tareas quedan
+    // suspendidas en esperas hasta un instante (sleep, timeout) o hasta un flanco de un pin (edge), sin hilos por
+    // comportamiento ni etapas periódicas que sondeen su estado. Con el reloj del sistema la espera se hace con epoll
+    // sobre un timerfd con el siguiente vencimiento y los ficheros value de los pines (sus flancos se notifican con
+    // EPOLLPRI); con un reloj virtual se avanza directamente al siguiente vencimiento, y los flancos son los que
+    // anuncia el backend (nextChange). Una vez lanzada la misión, el bucle y las tareas no reservan memoria: los marcos y
+    // las esperas se toman de lo reservado al crear el ejecutor, que ha de destruirse después de sus tareas
+    class MissionExecutor {
+    public:
+        // Estadísticas de la última ejecución
+        struct Stats {
+            long long resumes;
+            long long timerWakeups;
+            long long pinWakeups;
+            long long totalLatency;     // Retraso desde el vencimiento de una espera hasta que se reanuda la tarea
+            long long maxLatency;
+            long long busy;             // Tiempo ejecutando tareas (sin contar las maniobras bloqueantes)
+            long long blocked;          // Tiempo en maniobras bloqueantes
+            long long elapsed;
+        };
+
+    private:
+        PinsLib::Clock *clock;
+        bool realTime;
+        int epollFd;
+        int timerFd;
+        std::map<PinsLib::GPIO *, int> pinFds;
+
+        // Esperas registradas, listas y vencidas en la última espera (con capacidad para MISSION_MAX_WAITS)
+        std::vector<MissionWait *> waits;
+        std::vector<MissionWait *> ready;
+        std::vector<MissionWait *> due;
+        FramePool frames;
+        long long sequence;
+        bool running;
+        bool started;
+        bool blockRequested;
+        long long blockedUntil;
+        Stats stats;
+
+    public:
+        explicit MissionExecutor(PinsLib::Clock *clock = PinsLib::Clock::get());
+        ~MissionExecutor();
+
+        // Ejecuta la tarea hasta que termine, durante como mucho el tiempo indicado (us), hasta que se invoque stop(),
+        // hasta que se ordene detener el coche desde el monitor o hasta que lo detenga el watchdog. Si la tarea no ha
+        // terminado, queda suspendida (se cancela al destruirla). Al terminar escribe los mensajes pendientes del
+        // registro (Logger)
+        void run(Task<> &task, long long duration);
+        void stop();
+
+        // Indica, desde una tarea, que acaba de ejecutar una maniobra bloqueante (p.e: un giro por tiempo): su
+        // duración no cuenta como ocupación ni como retraso de las esperas que vencieron mientras tanto
+        void blocked();
+
+        PinsLib::Clock *getClock() const;
+        const Stats &getStats() const;
+        FramePool *getFramePool();
+
+        // Informe de la última ejecución: reanudaciones, despertares, retraso y ocupación
+        void printReport(std::ostream &out) const;
+
+        // Espera hasta un instante (en la escala del reloj) o durante un tiempo (us)
+        class SleepAwaiter {
+        private:
+            MissionWait wait;
+
+        public:
+            SleepAwaiter(MissionExecutor *executor, long long time);
+            SleepAwaiter(SleepAwaiter &&other) noexcept;
+            ~SleepAwaiter();
+            bool await_ready() const;
+            void await_suspend(std::coroutine_handle<> handle);
+            void await_resume() {}
+        };
+        SleepAwaiter sleepUntil(long long time);
+        SleepAwaiter sleep(long long ums);
+
+        // Espera a un flanco de un pin de entrada, como mucho hasta el instante indicado. Devuelve false si vence el
+        // plazo. Puede despertar sin que haya cambiado el nivel (si el pin se sondea): quien espera vuelve a leerlo
+        class EdgeAwaiter {
+        private:
+            MissionWait wait;
+            PinsLib::GPIO *pin;
+
+        public:
+            EdgeAwaiter(MissionExecutor *executor, PinsLib::GPIO *pin, long long deadline);
+            EdgeAwaiter(EdgeAwaiter &&other) noexcept;
+            ~EdgeAwaiter();
+            bool await_ready() const;
+            void await_suspend(std::coroutine_handle<> handle);
+            bool await_resume() const;
+        };
+        EdgeAwaiter edge(PinsLib::GPIO *pin, long long deadline);
+
+        // Tarea que termina tras el tiempo indicado (us), para combinarla con otras en whenAny()
+        Task<> timeout(long long ums);
+
+    private:
+        friend class SleepAwaiter;
+        friend class EdgeAwaiter;
+
+        // Registro de las esperas y paso de las vencidas a la cola de tareas listas
+        void add(MissionWait *wait);
+        void cancel(MissionWait *wait);
+        void wake(MissionWait *wait, bool pinEvent);
+
+        // Fichero value del pin, abierto y registrado en epoll para recibir sus flancos (-1 si no es posible)
+        int pinDescriptor(PinsLib::GPIO *pin);
+
+        // Espera hasta el instante indicado o hasta el aviso de un pin
+        void waitUntil(long long time);
+
+        // Adelanta las esperas de flancos previstos si el backend ya prevé uno antes. Devuelve si alguna ha vencido
+        bool recheckEdges();
+        void resume(MissionWait *wait);
+    };
+
+    // Tarea de whenAny(): espera a la tarea que se le entrega e indica, si es la primera en terminar, su índice.
+    // Las demás ya no terminan (se quedan suspendidas hasta que whenAny las destruye)
+    template<typename T>
+    Task<> whenAnyBranch(Task<T> task, int *winner, int index) {
+        co_await task;
+        if (*winner >= 0)
+            co_await std::suspend_always();
+        *winner = index;
+    }
+
+    // Espera a varias tareas a la vez y se reanuda cuando termina la primera, devolviendo su índice. El resto se
+    // cancelan. Ha de esperarse directamente (co_await whenAny(...)), sin guardarlo
+    template<typename... T>
+    class WhenAny {
+    private:
+        std::tuple<Task<T>...> tasks;
+        std::vector<Task<>> branches;
+        int winner;
+
+    public:
+        explicit WhenAny(Task<T> &&... tasks) : tasks(std::move(tasks)...), winner(-1) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> awaiting) {
+            // Las ramas se crean aquí, con el objeto ya en su sitio definitivo (guardan la dirección de winner)
+            branches.reserve(sizeof...(T));
+            std::apply([this](Task<T> &... task) {
+                int index = 0;
+                (branches.push_back(whenAnyBranch(std::move(task), &winner, index++)), ...);
+            }, tasks);
+
+            // Una rama puede terminar sin llegar a suspenderse: entonces no se lanzan las siguientes
+            for (Task<> &branch : branches) {
+                branch.handle.resume();
+                if (winner >= 0)
+                    return false;
+            }
+            for (Task<> &branch : branches)
+                branch.handle.promise().continuation = awaiting;
+            return true;
+        }
+
+        int await_resume() const { return winner; }
+    };
+
+    template<typename... T>
+    WhenAny<T...> whenAny(Task<T> &&... tasks) {
+        return WhenAny<T...>(std::move(tasks)...);
+    }
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_MISSIONEXECUTOR_H
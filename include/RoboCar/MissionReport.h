@@ -0,0 +1,89 @@
+#ifndef ROBOCAR_MISSIONREPORT_H
+#define ROBOCAR_MISSIONREPORT_H
+
+#include "Behaviour.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Resumen de la misión: ventana (us) sobre la que se mide la velocidad para obtener la máxima (con menos, la
+// resolución de medio taco del encoder la falsea) y periodos del bucle que se guardan para calcular los percentiles
+#define MISSION_REPORT_SPEED_WINDOW_UMS     200000
+#define MISSION_REPORT_PERIOD_SAMPLES       120000
+
+namespace RoboCar {
+
+    // Resumen de una misión de los modos simple y circuito, que se acumula en cada ciclo del árbitro sin reservar
+    // memoria y se escribe en JSON al terminar: recorrido y velocidad media y máxima (según la odometría), giro de cada
+    // rueda (según los encoders), reparto del tiempo entre marcha, giros y paradas, obstáculos y evasiones, curvas y
+    // vueltas del circuito, percentiles del periodo del bucle y operaciones sobre los ficheros de los pines por segundo
+    class MissionReport {
+    private:
+        // Estado de las ruedas en el último ciclo: marcha (ambas en el mismo sentido y a la misma velocidad), giro
+        // (cualquier otra combinación, incluidas las curvas) o parada (ninguna rueda en marcha)
+        enum Motion { CRUISE_MOTION, TURN_MOTION, STOPPED_MOTION };
+
+        std::string mode;
+        bool started;
+        long long startTime;
+        long long lastTime;
+        Motion lastMotion;
+        float startLeft;
+        float startRight;
+        float lastLeft;
+        float lastRight;
+        float startTravelled;
+        float lastTravelled;
+
+        // Tiempo (us) en cada estado de las ruedas
+        long long motionTime[3];
+
+        // Ventana en curso para la velocidad máxima (inicio y recorrido al empezarla) y máxima (CM/s)
+        long long windowStart;
+        float windowTravelled;
+        float peakSpeed;
+
+        // Contadores de los comportamientos, que el modo indica al terminar
+        long long obstacles;
+        long long escapes;
+        long long failures;
+        long long curves;
+        long long laps;
+
+        // Periodos del bucle (us): los primeros MISSION_REPORT_PERIOD_SAMPLES, para los percentiles, y número, suma y
+        // máximo de todos ellos. Operaciones sobre los pines (del hilo del modo) al empezar y en el último ciclo
+        std::vector<int> periods;
+        long long periodCount;
+        long long periodTotal;
+        int periodMax;
+        long long startOperations;
+        long long operations;
+
+    public:
+        MissionReport();
+
+        // Empieza el resumen del modo indicado. El primer ciclo que se acumule fija el estado inicial
+        void begin(const std::string &mode);
+
+        // Acumula un ciclo del árbitro con su estado y con la orden que se acaba de aplicar a las ruedas
+        void sample(RoboCar *car, const BehaviourInputs &inputs);
+
+        // Contadores de los comportamientos de evasión y de circuito
+        void setObstacles(long long obstacles, long long escapes, long long failures);
+        void setCircuit(long long curves, long long laps);
+
+        // Escritura del resumen en JSON
+        bool save(const std::string &filename) const;
+        void print(std::ostream &out) const;
+
+        // Resumen activo (nullptr si no se pide)
+        static MissionReport *get();
+        static void set(MissionReport *report);
+
+    private:
+        static Motion classify(RoboCar *car);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_MISSIONREPORT_H
@@ -0,0 +1,69 @@
+#ifndef ROBOCAR_PARAMETERSTORE_H
+#define ROBOCAR_PARAMETERSTORE_H
+
+#include "Parameters.h"
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tiempo máximo (ms) que el hilo de vigilancia espera un cambio antes de comprobar si debe terminar
+#define PARAMETERS_WATCH_POLL_MS        100
+
+namespace RoboCar {
+
+    // Parámetros de comportamiento que se pueden cambiar con el coche en marcha. Cada versión de los parámetros es
+    // una copia inmutable que se publica cambiando un puntero atómico (como en RCU): quien lee obtiene siempre una
+    // versión completa y coherente, sin cerrojos ni copias, y nunca se modifica una versión ya publicada.
+    // Las versiones anteriores no se liberan hasta destruir el almacén, porque un lector puede seguir usándolas (cada
+    // una ocupa unas decenas de bytes y solo se publica una por cambio del fichero)
+    class ParameterStore {
+    private:
+        std::atomic<const Parameters *> current;
+        std::vector<const Parameters *> versions;
+        std::mutex publishMutex;
+
+        // Fichero vigilado y parámetros que prevalecen sobre él (p.e: los indicados en la línea de comandos), con el
+        // formato del fichero
+        std::string filename;
+        std::string overrides;
+
+        int inotifyFd;
+        std::thread watcher;
+        std::atomic<bool> running;
+        std::atomic<long long> reloads;
+        std::atomic<long long> rejected;
+
+    public:
+        explicit ParameterStore(const Parameters &initial = Parameters());
+        ~ParameterStore();
+
+        // Versión vigente. La referencia sigue siendo válida mientras exista el almacén
+        const Parameters &read() const;
+
+        // Publica una nueva versión de los parámetros
+        void publish(const Parameters &parameters);
+
+        // Parámetros que se aplican tras los del fichero en cada recarga
+        void setOverrides(const std::string &overrides);
+
+        // Vigila el fichero indicado (aunque aún no exista) y lo recarga cada vez que se guarda. Devuelve false si no
+        // se puede vigilar
+        bool watch(const std::string &filename);
+        void stop();
+
+        // Vuelve a leer el fichero: si algún parámetro es inválido se conserva la versión vigente
+        bool reload();
+
+        // Recargas aplicadas y rechazadas
+        void printReport(std::ostream &out) const;
+
+    private:
+        void run();
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_PARAMETERSTORE_H
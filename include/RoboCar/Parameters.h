@@ -0,0 +1,63 @@
+#ifndef ROBOCAR_PARAMETERS_H
+#define ROBOCAR_PARAMETERS_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Valores por defecto de los parámetros, obtenidos a mano
+// Giro temporizado: tiempo (us) que tarda en girar TURN_ANGLE_REFERENCE grados a TURN_SPEED_REFERENCE, más el retraso
+// con que arrancan los motores
+#define TURN_SPEED_REFERENCE            55
+#define TURN_ANGLE_REFERENCE            90
+#define TURN_TIMEUMS_REFERENCE          500000
+#define DELAY_TIMEUMS_TO_START_TURN     100000
+
+// Constante de PID proporcional (K) para la modificación del duty cycle
+#define DUTYCYCLE_CONSTANT              5
+
+// Constante (1/s) de la sincronización de las ruedas: corrección de la velocidad de referencia (tacos/s) por cada taco
+// de diferencia acumulada entre las ruedas desde que empezó el tramo. 0 regula cada rueda por separado
+#define WHEEL_SYNC_CONSTANT             2.0f
+
+// Medidas que se filtran en cada RoboCar::getDistance() y máximo que se puede configurar (se guardan en un array fijo)
+#define NUM_DISTANCE_MEASURES           7
+#define MAX_DISTANCE_MEASURES           32
+
+// Periodo (us) de las etapas de sensado y decisión de los modos
+#define DELAY_BETWEEN_ITERATIONS        100000
+
+// Distancia (CM) a la que se detectan obstáculos si no se indica otra
+#define DEFAULT_LIMIT_DISTANCE          35
+
+// Fichero de parámetros que se carga al arrancar, si existe y no se indica otro
+#define DEFAULT_PARAMETERS_FILE         "robocar.params"
+
+namespace RoboCar {
+
+    // Parámetros del comportamiento del coche que se pueden cambiar sin recompilar (p.e: con los que encuentra
+    // RoboCarTune.out). Por defecto, los valores ajustados a mano. Formato del fichero ('#' inicia un comentario):
+    //     <nombre> <valor>
+    struct Parameters {
+        long long turnTime = TURN_TIMEUMS_REFERENCE;
+        long long turnStartDelay = DELAY_TIMEUMS_TO_START_TURN;
+        float speedGain = DUTYCYCLE_CONSTANT;
+        float syncGain = WHEEL_SYNC_CONSTANT;
+        int distanceMeasures = NUM_DISTANCE_MEASURES;
+        long long loopPeriod = DELAY_BETWEEN_ITERATIONS;
+        int limitDistance = DEFAULT_LIMIT_DISTANCE;
+        bool maxSpeed = false;
+
+        // Tiempo (us) que se mantiene un giro temporizado del ángulo indicado (grados)
+        long long turnDuration(int angle) const;
+
+        // Carga (solo los parámetros que aparecen en el fichero) y guardado en un fichero de texto
+        bool load(const std::string &filename);
+        bool parse(std::istream &in, const std::string &source);
+        bool save(const std::string &filename) const;
+        void print(std::ostream &out) const;
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_PARAMETERS_H
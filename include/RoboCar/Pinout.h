@@ -0,0 +1,60 @@
+#ifndef ROBOCAR_PINOUT_H
+#define ROBOCAR_PINOUT_H
+
+// Pines utilizados por el montaje físico de RoboCar. Se comparten entre los componentes del coche y los
+// backends que los sustituyen (reproducción de sesiones), por lo que deben coincidir con el conexionado real.
+// Son los valores por defecto de PinMap, que permite a cada coche (p.e: los de una flota simulada) usar otros
+
+// Ruedas: pines GPIO de dirección y encoder, y pin PWM de velocidad
+#define LEFT_WHEEL_FORWARD_PIN      178
+#define LEFT_WHEEL_BACKWARD_PIN     164
+#define LEFT_WHEEL_ENCODER_PIN      208
+#define LEFT_WHEEL_PWM_PIN          1
+
+#define RIGHT_WHEEL_FORWARD_PIN     166
+#define RIGHT_WHEEL_BACKWARD_PIN    165
+#define RIGHT_WHEEL_ENCODER_PIN     177
+#define RIGHT_WHEEL_PWM_PIN         0
+
+// Sensor de ultrasonidos
+#define ULTRASOUND_TRIGGER_PIN      234
+#define ULTRASOUND_ECHO_PIN         209
+
+// Sensores de ultrasonidos laterales (opcionales, solo con --array): girados hacia la izquierda y hacia la derecha
+#define ULTRASOUND_LEFT_TRIGGER_PIN     203
+#define ULTRASOUND_LEFT_ECHO_PIN        204
+#define ULTRASOUND_RIGHT_TRIGGER_PIN    172
+#define ULTRASOUND_RIGHT_ECHO_PIN       171
+
+// LEDs
+#define GREEN_LED_PIN_NUMBER        105
+#define RED_LED_PIN_NUMBER          242
+
+namespace RoboCar {
+
+    // Pines de un coche concreto. Por defecto, los del montaje físico
+    struct PinMap {
+        int leftForward = LEFT_WHEEL_FORWARD_PIN;
+        int leftBackward = LEFT_WHEEL_BACKWARD_PIN;
+        int leftEncoder = LEFT_WHEEL_ENCODER_PIN;
+        int leftPwm = LEFT_WHEEL_PWM_PIN;
+
+        int rightForward = RIGHT_WHEEL_FORWARD_PIN;
+        int rightBackward = RIGHT_WHEEL_BACKWARD_PIN;
+        int rightEncoder = RIGHT_WHEEL_ENCODER_PIN;
+        int rightPwm = RIGHT_WHEEL_PWM_PIN;
+
+        int ultrasoundTrigger = ULTRASOUND_TRIGGER_PIN;
+        int ultrasoundEcho = ULTRASOUND_ECHO_PIN;
+        int leftUltrasoundTrigger = ULTRASOUND_LEFT_TRIGGER_PIN;
+        int leftUltrasoundEcho = ULTRASOUND_LEFT_ECHO_PIN;
+        int rightUltrasoundTrigger = ULTRASOUND_RIGHT_TRIGGER_PIN;
+        int rightUltrasoundEcho = ULTRASOUND_RIGHT_ECHO_PIN;
+
+        int greenLed = GREEN_LED_PIN_NUMBER;
+        int redLed = RED_LED_PIN_NUMBER;
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_PINOUT_H
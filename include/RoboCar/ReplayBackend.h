@@ -0,0 +1,38 @@
+#ifndef ROBOCAR_REPLAYBACKEND_H
+#define ROBOCAR_REPLAYBACKEND_H
+
+#include "VirtualBackend.h"
+#include "Session.h"
+#include <vector>
+
+namespace RoboCar {
+
+    // Backend de pines que reproduce una sesión grabada sobre un reloj virtual. Las lecturas del encoder y del eco
+    // del sensor de ultrasonidos se sintetizan a partir de las muestras grabadas
+    class ReplayBackend : public VirtualBackend {
+    private:
+        // Muestras de la sesión separadas por tipo (ordenadas por tiempo)
+        std::vector<SessionRecord> ranges;
+        std::vector<SessionRecord> leftSpeeds;
+        std::vector<SessionRecord> rightSpeeds;
+        long long duration;
+
+    public:
+        // ioCost: tiempo virtual (us) que consume cada operación sobre los pines
+        ReplayBackend(const std::vector<SessionRecord> &records, PinsLib::VirtualClock *clock, long long ioCost);
+
+        // Duración de la sesión grabada (us)
+        long long getDuration() const;
+
+    protected:
+        float echoDistance(int sensor, long long now) override;
+        bool encoderLevel(Wheel wheel, long long now) override;
+
+    private:
+        // Valor de la muestra vigente en el instante indicado
+        static float sampleAt(const std::vector<SessionRecord> &samples, long long time);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_REPLAYBACKEND_H
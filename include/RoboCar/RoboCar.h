@@ -4,6 +4,12 @@
 #include "Led.h"
 #include "WheelMotor.h"
 #include "UltrasoundSensor.h"
+#include "UltrasoundArray.h"
+#include "Pinout.h"
+#include "Parameters.h"
+#include "ParameterStore.h"
+#include "Navigation/Odometry.h"
+#include "Navigation/OccupancyGrid.h"
 
 using namespace std;
 
@@ -20,19 +26,68 @@ namespace RoboCar {
         Led* greenLed;
         Led* redLed;
 
-        // Parámetros para el control de la velocidad
+        // Pines del coche y directorio (con '/' final, vacío para el actual) de sus ficheros de calibración
+        PinMap pins;
+        string calibrationPath;
+
+        // Parámetros de comportamiento (por defecto, los ajustados a mano), almacén del que se leen si se indica uno y
+        // versión de la que se ha aplicado la ganancia del control de velocidad a las ruedas
+        Parameters parameters;
+        ParameterStore *parameterStore;
+        const Parameters *appliedParameters;
+
+        // Parámetros para el control de la velocidad. Cada rueda tiene su propia velocidad de referencia, que
+        // coincide con la del coche salvo al trazar curvas
         int speed;
+        int leftSpeed;
+        int rightSpeed;
         int maxSpeed;
         int minSpeed;
 
+        // Sincronización de las ruedas (control cruzado): velocidades de referencia con signo del tramo actual (se
+        // empieza otro al cambiar el sentido o las velocidades) y tacos contados en el encoder de cada rueda al empezarlo
+        int syncLeftSpeed;
+        int syncRightSpeed;
+        float syncLeftTicks;
+        float syncRightTicks;
+
+        // Estimación de la posición a partir de los tacos contados en los encoders: tacos de cada rueda en la última
+        // actualización, en valor absoluto y con signo (WheelMotor::getPosition)
+        Navigation::Odometry odometry;
+        float leftTicks;
+        float rightTicks;
+        float leftPosition;
+        float rightPosition;
+
+        // Mapa en el que se integran las medidas del sensor de ultrasonidos (opcional, no es propiedad del coche)
+        Navigation::OccupancyGrid *map;
+
+        // Orientación del sensor de ultrasonidos respecto al eje del coche (radianes, 0 hacia delante)
+        float sensorMount;
+
+        // Array de sensores de ultrasonidos (opcional): el sensor principal más los laterales
+        UltrasoundArray *ultrasoundArray;
+        std::vector<UltrasoundSensor *> sideSensors;
+
     public:
-        // Constructor. Inicializa sensores y pines necesarios para la configuración que hemos establecido
-        // Nota: solo puede existir una misma instancia simultáneamente
-        RoboCar();
+        // Constructor. Inicializa sensores y pines necesarios para la configuración que hemos establecido. Los pines
+        // se crean sobre el backend y el reloj vigentes en el hilo que lo construye (ver PinsLib::Clock::setForThread)
+        // Nota: solo puede existir una instancia por cada mapa de pines y backend simultáneamente
+        explicit RoboCar(const PinMap &pins = PinMap(), const string &calibrationPath = "");
 
         // Destructor. Libera todos los recursos utilizados por el coche
         ~RoboCar();
 
+        // Parámetros de comportamiento del coche: los fijados o, si se indica un almacén (no es propiedad del coche),
+        // su versión vigente
+        void setParameters(const Parameters &parameters);
+        void setParameterStore(ParameterStore *store);
+        const Parameters &getParameters() const;
+
+        // Aplica a las ruedas los parámetros del almacén si han cambiado. Los modos lo llaman en cada iteración;
+        // devuelve true si hay una versión nueva (p.e: para cambiar la distancia de detección)
+        bool refreshParameters();
+
         // Funcionalidad respectiva al movimiento del vehículo
         void goForward();
         void goBackward();
@@ -40,6 +95,8 @@ namespace RoboCar {
         void goRight(int angle);
         void goLeft();
         void goLeft(int angle);
+        void goBackRight();
+        void goBackLeft();
         void rotateRight();
         void rotateRight(int angle);
         void rotateLeft();
@@ -48,16 +105,48 @@ namespace RoboCar {
 
         // Funciones para el control y gestión de la velocidad de movimiento
         void setSpeed(int speed);
+        void setWheelSpeeds(int leftSpeed, int rightSpeed);
         void setMaxSpeed();
         void setMinSpeed();
         void setMeanSpeed();
         int getSpeed() const;
         int getMaxSpeed() const;
         int getMinSpeed() const;
+        void getWheelSpeeds(int &left, int &right) const;
         void updateSpeed();
 
+        // Regulación con las velocidades ya medidas de cada rueda (tacos/s), p.e: sin bloquear desde una misión
+        WheelMotor *getWheel(Wheel wheel) const;
+        void updateSpeed(int leftMeasured, int rightMeasured);
+
         // Funciones para la medida de distancias desde el vehículo al siguiente obstáculo
         float getDistance();
+        float getSingleDistance();
+        static float filterDistances(float *distances, int count);
+        void setSensorMount(float angle);
+
+        // Sensor principal, para medir sin bloquear (fire() y poll()). Sus medidas se entregan con registerRange() para
+        // que se graben en la sesión y se integren en el mapa como las de getSingleDistance()
+        UltrasoundSensor *getUltrasoundSensor() const;
+        void registerRange(float distance);
+
+        // Funciones para el array de sensores de ultrasonidos: añade los sensores laterales y toma una medida de todos
+        // los sensores (devuelve la del principal)
+        void enableUltrasoundArray();
+        UltrasoundArray *getUltrasoundArray() const;
+        float scanRanges();
+
+        // Funciones para la localización y el mapeado del entorno
+        Navigation::Pose getPose();
+        float getTravelled();
+        void getWheelTicks(float &left, float &right);
+        void getWheelVelocities(int &left, int &right) const;
+        void pollEncoders(float &left, float &right);
+        void setMap(Navigation::OccupancyGrid *map);
+        Navigation::OccupancyGrid *getMap() const;
+
+        // Ficheros de control que detienen ambas ruedas, para la parada de emergencia del watchdog
+        void getStopFiles(std::vector<string> &files);
 
         // Funciones para el control de los leds
         void turnOnLed(LEDS_COLOR color);
@@ -69,6 +158,28 @@ namespace RoboCar {
         pair<int, int> calibrate();
         bool saveCalibration();
         pair<int, int> loadCalibration();
+
+    private:
+        // Integra en el mapa (si lo hay) una medida tomada por un sensor con la orientación indicada
+        void integrateRange(float distance, float mount);
+
+        // Actualiza la odometría con los tacos contados desde la actualización anterior (y el estado publicado, si lo
+        // hay). Se invoca tras cada orden a los motores
+        void updateOdometry();
+        void integrateEncoders();
+
+        // Limita las velocidades de las ruedas a la indicada desde el monitor, si la hay, manteniendo su proporción
+        void applySpeedLimit(int &left, int &right) const;
+
+        // Reparte entre las ruedas la corrección de la diferencia de tacos acumulada en el tramo actual
+        void synchronizeWheels(int &left, int &right);
+
+        // Publica en memoria compartida las velocidades, duty cycles y posición del coche
+        void publishState();
+
+        // Señal de vida y esperas intencionadas del bucle principal, para el watchdog
+        void heartbeat();
+        void allowWait(long long duration);
     };
 
 } /* namespace RoboCar */
@@ -0,0 +1,55 @@
+#ifndef ROBOCAR_SESSION_H
+#define ROBOCAR_SESSION_H
+
+#include "WheelMotor.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace RoboCar {
+
+    // Tipos de muestra que se almacenan en una sesión
+    enum SessionRecordType : uint8_t { RANGE_SAMPLE = 1, LEFT_SPEED_SAMPLE = 2, RIGHT_SPEED_SAMPLE = 3 };
+
+    // Muestra de una sesión ya decodificada
+    struct SessionRecord {
+        long long time;             // Microsegundos desde el inicio de la grabación
+        SessionRecordType type;
+        float value;                // Distancia en CM (-1 si errónea) o velocidad en tacos/s
+    };
+
+    // Graba en un fichero binario las medidas que toman los sensores del coche durante una ejecución.
+    // Formato: cabecera "RCSN" + versión (uint16) + reservado (uint16), seguida de registros de 12 bytes
+    // little-endian: tiempo (uint64, us), tipo (uint8), reservado (uint8), valor (int16, mm o tacos/s)
+    class SessionRecorder {
+    private:
+        std::ofstream out;
+        long long startTime;
+
+    public:
+        SessionRecorder();
+        ~SessionRecorder();
+
+        // Abre el fichero de sesión y comienza la grabación
+        bool open(const std::string &filename);
+        void close();
+
+        // Registro de muestras de los sensores
+        void recordRange(float distance);
+        void recordSpeed(Wheel wheel, int speed);
+
+        // Grabador activo (nullptr si no se está grabando)
+        static SessionRecorder *get();
+        static void set(SessionRecorder *recorder);
+
+    private:
+        void record(SessionRecordType type, int value);
+    };
+
+    // Carga todas las muestras de un fichero de sesión
+    bool loadSession(const std::string &filename, std::vector<SessionRecord> &records);
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_SESSION_H
@@ -0,0 +1,111 @@
+#ifndef ROBOCAR_TELEOPPROTOCOL_H
+#define ROBOCAR_TELEOPPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Protocolo de teleoperación sobre un socket UNIX local. Cada trama es: tipo (uint8) + longitud del contenido (uint8)
+// + contenido. Al ser un socket local, los campos van en el orden de bytes del sistema
+#define TELEOP_SOCKET_PATH          "/tmp/robocar.sock"
+#define TELEOP_PROTOCOL_VERSION     1
+#define TELEOP_HEADER_SIZE          2
+#define TELEOP_MAX_PAYLOAD          32
+#define TELEOP_MAX_FRAME            (TELEOP_HEADER_SIZE + TELEOP_MAX_PAYLOAD)
+
+namespace RoboCar {
+
+    enum TeleopFrameType : uint8_t {
+        // Del cliente al coche
+        TELEOP_VELOCITY = 0x01,     // TeleopVelocity
+        TELEOP_MANEUVER = 0x02,     // TeleopManeuverCommand
+        TELEOP_SET_SPEED = 0x03,    // TeleopSetSpeed
+        TELEOP_LED = 0x04,          // TeleopLedCommand
+        TELEOP_SUBSCRIBE = 0x05,    // TeleopSubscribe
+        TELEOP_PING = 0x06,         // TeleopPing
+        TELEOP_STATS = 0x07,        // Sin contenido
+        // Del coche al cliente
+        TELEOP_HELLO = 0x81,        // TeleopHello, al conectarse
+        TELEOP_TELEMETRY = 0x82,    // TeleopTelemetry
+        TELEOP_PONG = 0x83,         // TeleopPing (el mismo que se recibió)
+        TELEOP_STATS_REPLY = 0x84   // TeleopStats
+    };
+
+    // Maniobras de RoboCar
+    enum TeleopManeuver : uint8_t { MANEUVER_STOP, MANEUVER_FORWARD, MANEUVER_BACKWARD, MANEUVER_ROTATE_LEFT, MANEUVER_ROTATE_RIGHT };
+
+    enum TeleopLedAction : uint8_t { LED_OFF, LED_ON, LED_TOGGLE };
+
+#pragma pack(push, 1)
+    // Velocidad de cada rueda (tacos/s, negativa hacia atrás; 0 en ambas detiene el coche)
+    struct TeleopVelocity {
+        int16_t left;
+        int16_t right;
+    };
+
+    struct TeleopManeuverCommand {
+        uint8_t maneuver;           // TeleopManeuver
+    };
+
+    struct TeleopSetSpeed {
+        int16_t speed;              // Tacos/s
+    };
+
+    struct TeleopLedCommand {
+        uint8_t color;              // LEDS_COLOR
+        uint8_t action;             // TeleopLedAction
+    };
+
+    // Periodo (ms) con el que se quiere recibir la telemetría, 0 para cancelar la suscripción
+    struct TeleopSubscribe {
+        uint16_t period;
+    };
+
+    // Marca que el coche devuelve tal cual, una vez atendidas todas las órdenes anteriores
+    struct TeleopPing {
+        uint32_t sequence;
+        int64_t clientTime;
+    };
+
+    struct TeleopHello {
+        uint8_t version;
+        int16_t minSpeed;
+        int16_t maxSpeed;
+    };
+
+    struct TeleopTelemetry {
+        int64_t time;               // us, reloj del coche
+        float x;                    // CM
+        float y;
+        float heading;              // Radianes
+        float distance;             // CM, -1 si no hay medida
+        int16_t leftVelocity;       // Tacos/s con signo
+        int16_t rightVelocity;
+    };
+
+    // Estadísticas del servidor: órdenes ejecutadas, descartadas por llegar otra velocidad en la misma ráfaga, ráfagas
+    // y latencia (us) desde la recepción de la orden hasta que se ha actuado sobre el coche
+    struct TeleopStats {
+        uint32_t commands;
+        uint32_t coalesced;
+        uint32_t batches;
+        float meanLatency;
+        float maxLatency;
+    };
+#pragma pack(pop)
+
+    // Trama ya separada del flujo de bytes
+    struct TeleopFrame {
+        TeleopFrameType type;
+        uint8_t length;
+        const uint8_t *payload;
+    };
+
+    // Escribe una trama en buffer (al menos TELEOP_MAX_FRAME bytes). Devuelve su tamaño total
+    size_t encodeTeleopFrame(uint8_t *buffer, TeleopFrameType type, const void *payload, uint8_t length);
+
+    // Extrae la siguiente trama completa de data. Devuelve los bytes que ocupa, 0 si aún no ha llegado entera
+    size_t decodeTeleopFrame(const uint8_t *data, size_t size, TeleopFrame &frame);
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_TELEOPPROTOCOL_H
@@ -0,0 +1,87 @@
+#ifndef ROBOCAR_TELEOPSERVER_H
+#define ROBOCAR_TELEOPSERVER_H
+
+#include "RoboCar/RoboCar.h"
+#include "RoboCar/TeleopProtocol.h"
+#include "PinsLib/Clock.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Clientes simultáneos y bytes pendientes de procesar por cliente (caben varias tramas de tamaño máximo)
+#define TELEOP_MAX_CLIENTS          4
+#define TELEOP_BUFFER_SIZE          4096
+
+namespace RoboCar {
+
+    // Servidor de teleoperación: un bucle de eventos (epoll) atiende el socket de escucha, los clientes y un
+    // temporizador periódico para la telemetría y la parada de seguridad. Todas las tramas que llegan juntas se
+    // procesan como una ráfaga, en la que solo se aplica la última orden de velocidad
+    class TeleopServer {
+    private:
+        struct Client {
+            int fd;
+            uint8_t buffer[TELEOP_BUFFER_SIZE];
+            size_t used;
+            long long telemetryPeriod;      // us, 0 sin suscripción
+            long long nextTelemetry;
+        };
+
+        RoboCar *car;
+        PinsLib::Clock *clock;
+        PinsLib::SystemClock realClock;
+        std::string path;
+        int listenFd;
+        int epollFd;
+        int timerFd;
+        Client clients[TELEOP_MAX_CLIENTS];
+
+        // Estado de la conducción: sentido de giro de las ruedas (3 * izquierda + derecha, -1 si lo ha fijado una
+        // maniobra), velocidades aplicadas, última orden de velocidad (para la parada de seguridad) y última distancia
+        int motion;
+        int appliedLeft;
+        int appliedRight;
+        bool velocityActive;
+        long long lastVelocity;
+        long long nextSensing;
+        float distance;
+
+        // Estadísticas
+        unsigned long long commands;
+        unsigned long long coalesced;
+        unsigned long long batches;
+        unsigned long long invalid;
+        unsigned long long telemetrySent;
+        unsigned long long telemetryDropped;
+        long long totalLatency;
+        long long maxLatency;
+        std::vector<long long> latencies;
+
+    public:
+        TeleopServer(RoboCar *car, const std::string &path);
+        ~TeleopServer();
+
+        // Crea el socket de escucha en la ruta indicada
+        bool open();
+        void close();
+
+        // Atiende a los clientes durante el tiempo indicado (us)
+        void run(long long duration);
+
+        // Órdenes atendidas y latencia de actuación (media, percentiles y máximo)
+        void printReport(std::ostream &out) const;
+
+    private:
+        void acceptClient();
+        void closeClient(Client &client);
+        void readClient(Client &client);
+        void execute(Client &client, const TeleopFrame &frame, long long received);
+        void applyVelocity(int left, int right);
+        void tick();
+        bool send(Client &client, TeleopFrameType type, const void *payload, uint8_t length);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_TELEOPSERVER_H
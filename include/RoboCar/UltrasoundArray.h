@@ -0,0 +1,86 @@
+#ifndef ROBOCAR_ULTRASOUNDARRAY_H
+#define ROBOCAR_ULTRASOUNDARRAY_H
+
+#include "UltrasoundSensor.h"
+#include "Bus/Topics.h"
+#include "PinsLib/Clock.h"
+#include <ostream>
+#include <vector>
+
+// Alcance (CM) de las medidas del array: cada pulso se considera en vuelo durante su tiempo de ida y vuelta hasta esa
+// distancia (17.5 ms para 300 CM) y los ecos más largos se descartan sin esperarlos
+#define ULTRASOUND_ARRAY_RANGE_CM       300.0f
+
+// Separación angular mínima (grados) entre dos sensores para que puedan tener pulsos en vuelo a la vez: los más
+// próximos se oyen entre sí (el receptor capta en un cono más ancho que el haz) y se disparan por turnos
+#define ULTRASOUND_ARRAY_SEPARATION_DEG 90.0f
+
+namespace RoboCar {
+
+    // Array de sensores de ultrasonidos, cada uno con sus pines y su orientación. Los disparos se planifican sin
+    // bloquearse: un sensor se dispara en cuanto ni él ni ningún sensor próximo (separados menos de la separación
+    // mínima) tiene un pulso en vuelo, empezando por el que lleva más tiempo sin medir. Así, los sensores que no se
+    // oyen entre sí escuchan a la vez y los próximos se intercalan, sin diafonía entre ellos
+    class UltrasoundArray {
+    public:
+        struct Stats {
+            long long samples;
+            long long invalid;
+            long long scanTime;     // Tiempo total dentro de scan() (us)
+        };
+
+    private:
+        struct Sensor {
+            UltrasoundSensor *sensor;   // No es propiedad del array
+            float mount;                // Orientación respecto al eje del coche (radianes, positivo a la izquierda)
+            long long fired;            // Último disparo (us), -1 si todavía no se ha disparado
+            bool inFlight;
+            Bus::RangeMessage latest;
+            long long samples;
+            long long invalid;
+        };
+
+        PinsLib::Clock *clock;
+        std::vector<Sensor> sensors;
+        std::vector<std::vector<bool>> conflicts;
+        float separation;
+        long long window;
+        long long scanTime;
+        Bus::Topic<Bus::RangeArrayMessage> *topic;
+
+    public:
+        // separation: separación mínima (grados) para disparar a la vez (0 para dispararlos todos a la vez, 360 para
+        // dispararlos de uno en uno). range: alcance de las medidas (CM)
+        explicit UltrasoundArray(float separation = ULTRASOUND_ARRAY_SEPARATION_DEG,
+                                 float range = ULTRASOUND_ARRAY_RANGE_CM);
+
+        // Añade un sensor con la orientación indicada (radianes). Devuelve su índice, -1 si el array está completo
+        int addSensor(UltrasoundSensor *sensor, float mount);
+        int getSize() const;
+
+        // Tema en el que se publican las últimas medidas de todos los sensores cada vez que termina alguna (opcional)
+        void setTopic(Bus::Topic<Bus::RangeArrayMessage> *topic);
+
+        // Paso del planificador: consulta una vez los ecos en curso y dispara los sensores que puedan hacerlo.
+        // Devuelve el número de medidas terminadas
+        int update();
+
+        // Ejecuta el planificador hasta que todos los sensores tienen una medida tomada después de la llamada
+        void scan();
+
+        // Última medida de un sensor (distancia -1 si es errónea, instante -1 si aún no hay ninguna)
+        const Bus::RangeMessage &getReading(int index) const;
+        void getReadings(Bus::RangeArrayMessage &message) const;
+
+        Stats getStats() const;
+        void printReport(std::ostream &out) const;
+
+    private:
+        bool canFire(int index, long long now) const;
+        long long nextFireTime() const;
+        bool anyInFlight() const;
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_ULTRASOUNDARRAY_H
@@ -2,24 +2,51 @@
 #define ROBOCAR_ULTRASOUNDSENSOR_H
 
 #include "PinsLib/GPIO.h"
+#include "Pinout.h"
+
+// Velocidad del sonido
+#define CM_PER_SECOND           34300.0f
 
 namespace RoboCar {
 
+    // Estado de una medida no bloqueante: esperando el inicio del eco, midiendo su duración o, tras agotar la
+    // ventana de escucha, esperando a que el sensor baje el eco para poder disparar de nuevo
+    enum UltrasoundState { ULTRASOUND_IDLE, ULTRASOUND_WAITING, ULTRASOUND_ECHO, ULTRASOUND_DRAINING };
+
     class UltrasoundSensor {
     private:
         // Pines utilizados para realizar las mediciones
         PinsLib::GPIO *triggerPin;
         PinsLib::GPIO *echoPin;
 
+        // Medida no bloqueante en curso
+        UltrasoundState state;
+        long long echoStart;
+        int attempts;
+
     public:
         // Constructor. Inicializa los pines y configura el sensor
-        // Nota: solo puede existir una instancia de sensor simultáneamente
-        UltrasoundSensor();
+        // Nota: solo puede existir una instancia por cada par de pines de un mismo backend simultáneamente
+        UltrasoundSensor(int triggerPinNumber = ULTRASOUND_TRIGGER_PIN, int echoPinNumber = ULTRASOUND_ECHO_PIN);
 
         ~UltrasoundSensor();
 
         // Obtiene la distancia, en centímetros, que mide el sensor
         float getDistance();
+
+        // Medida no bloqueante, para atender varios sensores a la vez: fire() emite el pulso y poll() consulta una
+        // vez el eco. poll() devuelve true cuando la medida ha terminado (distancia -1 si es errónea o si el eco
+        // supera la ventana de escucha, en us)
+        void fire();
+        bool poll(long long window, float &distance);
+        bool isIdle() const;
+
+        // Pin del eco, para esperar sus flancos en lugar de sondearlo (ver MissionExecutor::edge)
+        PinsLib::GPIO *getEchoPin() const;
+
+    private:
+        // Realiza una única medición sobre los pines
+        float measureDistance();
     };
 
 } /* namespace RoboCar */
@@ -0,0 +1,99 @@
+#ifndef ROBOCAR_VIRTUALBACKEND_H
+#define ROBOCAR_VIRTUALBACKEND_H
+
+#include "PinsLib/Backend.h"
+#include "PinsLib/Clock.h"
+#include "WheelMotor.h"
+#include "Pinout.h"
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace RoboCar {
+
+    // Base común para los backends que sustituyen al hardware del coche sobre un reloj virtual (reproducción de
+    // sesiones, simulación). Cada operación sobre los pines consume un tiempo virtual fijo, se mantiene el estado
+    // de los actuadores y se delega en las clases hijas la generación de las señales del encoder y del eco
+    class VirtualBackend : public PinsLib::Backend {
+    public:
+        // Estado de las órdenes enviadas al motor de una rueda
+        struct MotorCommand {
+            bool forward;
+            bool backward;
+            bool enabled;
+            int dutyCycle;
+            int period;
+        };
+
+    protected:
+        PinsLib::VirtualClock *clock;
+        long long ioCost;
+
+    private:
+        std::ostream *commands;
+        long long commandCount;
+
+        // Contenido de los ficheros de control escritos (por ruta y nombre, para no concatenarlos en cada operación) y
+        // nombre de los actuadores por ruta
+        std::map<string, std::map<string, string>> files;
+        std::map<string, string> actuators;
+
+        // Rutas de los pines que se interpretan
+        string leftEncoderPath, rightEncoderPath;
+        string leftForwardPath, leftBackwardPath, leftPwmPath;
+        string rightForwardPath, rightBackwardPath, rightPwmPath;
+
+        // Órdenes actuales de cada motor (índice: Wheel)
+        MotorCommand motors[2];
+
+        // Sensores de ultrasonidos (el 0 es el frontal) y estado de su pulso de eco en curso
+        struct Echo {
+            string triggerPath;
+            string echoPath;
+            bool triggerHigh;
+            long long start;
+            long long end;
+        };
+        std::vector<Echo> echoes;
+
+    public:
+        // ioCost: tiempo virtual (us) que consume cada operación sobre los pines. pins: pines del coche sustituido
+        VirtualBackend(PinsLib::VirtualClock *clock, long long ioCost, const PinMap &pins = PinMap());
+
+        int write(const string &path, const string &filename, const string &value) override;
+        string read(const string &path, const string &filename) override;
+
+        // Los flancos del eco de los sensores de ultrasonidos se conocen al disparar: así se pueden esperar sin sondear
+        long long nextChange(const string &path, const string &filename) override;
+
+        // Flujo donde se escriben, con su marca de tiempo virtual, las órdenes enviadas a los actuadores
+        void setCommandLog(std::ostream *commands);
+        long long getCommandCount() const;
+
+        const MotorCommand &getMotorCommand(Wheel wheel) const;
+
+        // Añade un sensor de ultrasonidos con los pines indicados. Devuelve su índice
+        int addUltrasound(int triggerPin, int echoPin);
+
+    protected:
+        // Se invoca antes de cada operación para que el modelo avance hasta el instante indicado
+        virtual void update(long long /*now*/) {}
+
+        // Distancia (CM) que devolverá el eco de un disparo del sensor indicado realizado en el instante indicado.
+        // -1 si no hay eco
+        virtual float echoDistance(int sensor, long long now) = 0;
+
+        // Adelanta el final del eco en curso de un sensor (p.e: le llega antes el pulso de otro sensor)
+        bool isListening(int sensor, long long now) const;
+        void endEcho(int sensor, long long end);
+
+        // Nivel del encoder de una rueda en el instante indicado
+        virtual bool encoderLevel(Wheel wheel, long long now) = 0;
+
+        // Instante previsto del siguiente flanco del encoder de una rueda (-1 si no se puede prever)
+        virtual long long nextEncoderEdge(Wheel wheel, long long now);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_VIRTUALBACKEND_H
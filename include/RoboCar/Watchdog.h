@@ -0,0 +1,122 @@
+#ifndef ROBOCAR_WATCHDOG_H
+#define ROBOCAR_WATCHDOG_H
+
+#include "PinsLib/Clock.h"
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Periodo (us) con el que el hilo del watchdog comprueba los plazos
+#define WATCHDOG_PERIOD_UMS             5000
+
+// Plazos (us) de cada canal: al superar el blando se reduce la carga, al superar el duro se detiene el coche.
+// El bucle principal ha de dar señales de vida al menos cada WATCHDOG_LOOP_SOFT_UMS (las maniobras que esperan más
+// lo anuncian con allow()). Una medida del sensor no debería superar los 38 ms del tiempo máximo de eco
+#define WATCHDOG_LOOP_SOFT_UMS          750000
+#define WATCHDOG_LOOP_HARD_UMS          2000000
+#define WATCHDOG_SENSING_SOFT_UMS       40000
+#define WATCHDOG_SENSING_HARD_UMS       150000
+
+// Tiempo (us) cumpliendo todos los plazos tras el que se vuelve al funcionamiento normal
+#define WATCHDOG_RECOVERY_UMS           1000000
+
+// Mientras se reduce la carga, las etapas prescindibles se lanzan con un periodo WATCHDOG_SHED_FACTOR veces mayor
+#define WATCHDOG_SHED_FACTOR            2
+
+namespace RoboCar {
+
+    // Canales vigilados: el bucle principal (señal de vida periódica) y el sensado (cada medida en curso)
+    enum WatchdogChannel { WATCHDOG_LOOP, WATCHDOG_SENSING };
+    #define WATCHDOG_CHANNELS           2
+
+    // Watchdog de plazos del bucle de control. Un hilo independiente comprueba periódicamente que los canales
+    // vigilados cumplen sus plazos. Ante un retraso se entra en modo degradado (el ejecutor del bucle descarta las
+    // etapas opcionales y espacia las prescindibles, como el sensado); si el retraso llega al plazo duro se detiene el
+    // coche desde el propio hilo del watchdog, escribiendo directamente en los ficheros de los motores abiertos de
+    // antemano, sin pasar por las clases de los pines (que pueden ser las que se han quedado bloqueadas)
+    class Watchdog {
+    public:
+        struct ChannelStats {
+            long long softMisses;
+            long long hardMisses;
+            long long maxDelay;         // Mayor retraso observado respecto al plazo blando (us)
+        };
+
+    private:
+        struct Channel {
+            const char *name;
+            long long soft;
+            long long hard;
+            std::atomic<long long> deadline;    // Vencimiento del plazo blando (us, reloj real), 0 si no se vigila
+            bool late;
+            ChannelStats stats;
+        };
+
+        PinsLib::SystemClock clock;
+        Channel channels[WATCHDOG_CHANNELS];
+        std::vector<int> stopFiles;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<bool> degraded;
+        std::atomic<bool> tripped;
+
+        // Estadísticas de la degradación y de la parada de emergencia
+        long long lastLate;
+        long long degradedSince;
+        long long degradedTime;
+        long long degradations;
+        std::atomic<long long> shedLaunches;
+        int trippedChannel;
+        long long stopLatency;
+
+    public:
+        Watchdog();
+        ~Watchdog();
+
+        // Abre de antemano un fichero de control en el que se escribirá "0" para detener el coche (duty cycle o
+        // sentido de giro de un motor). Devuelve false si no se puede abrir
+        bool addStopFile(const std::string &file);
+        bool hasFastStop() const;
+
+        // Arranca y detiene el hilo del watchdog
+        bool start();
+        void close();
+
+        // Señal de vida de un canal: el siguiente plazo vence dentro de su plazo blando. Nunca adelanta un plazo
+        // ampliado con allow()
+        void beat(WatchdogChannel channel);
+
+        // Amplía el plazo de un canal antes de una espera intencionada de la duración indicada (us)
+        void allow(WatchdogChannel channel, long long duration);
+
+        // Inicio y fin de una operación acotada (p.e: una medida del sensor). Fuera de ellas el canal no se vigila
+        void begin(WatchdogChannel channel);
+        void end(WatchdogChannel channel);
+
+        // Estado consultado desde el bucle principal
+        bool isDegraded() const;
+        bool hasTripped() const;
+        void countShed();
+
+        const ChannelStats &getStats(WatchdogChannel channel) const;
+        long long getDegradations() const;
+        long long getStopLatency() const;
+
+        // Plazos incumplidos, degradaciones y latencia de la parada de emergencia
+        void printReport(std::ostream &out) const;
+
+        // Watchdog activo (nullptr si no se vigila el bucle)
+        static Watchdog *get();
+        static void set(Watchdog *watchdog);
+
+    private:
+        void watch();
+        void check(long long now);
+        void emergencyStop(int channel, long long hardDeadline);
+    };
+
+} /* namespace RoboCar */
+
+#endif //ROBOCAR_WATCHDOG_H
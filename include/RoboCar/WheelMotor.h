@@ -3,6 +3,7 @@
 
 #include "PinsLib/GPIO.h"
 #include "PinsLib/PWM.h"
+#include "Pinout.h"
 #include <vector>
 
 // Macros auxiliares para el acceso al pair<int,int> con el mínimo y máximo valor de velocidad
@@ -19,6 +20,16 @@ namespace RoboCar {
 
     class WheelMotor {
     private:
+        // Tabla de calibración duty cycle -> velocidad, con la tensión de la batería a la que se tomó (-1 si se
+        // desconoce)
+        struct CalibrationTable {
+            float voltage;
+            std::vector<std::pair<int, int>> speeds;
+        };
+
+        // Rueda que representa esta instancia
+        Wheel wheel;
+
         // Pines utilizados para la dirección de movimiento de la rueda
         PinsLib::GPIO *forwardPin;
         PinsLib::GPIO *backwardPin;
@@ -31,6 +42,7 @@ namespace RoboCar {
 
         // Parámetros respectivos a la velocidad y sus configuraciones
         std::vector<std::pair<int, int>> speeds;
+        float speedsVoltage;        // Tensión a la que corresponden los duty cycles de la tabla (-1 si se desconoce)
         int minSpeed;
         int maxSpeed;
 
@@ -38,11 +50,44 @@ namespace RoboCar {
         bool moving;
         bool calibrated;
         int dutyCycle;
+        int tableDutyCycle;         // Duty cycle referido a la tensión de la tabla, antes de compensar por la batería
+
+        // Constante (K) del PID proporcional con el que se regula el duty cycle
+        float speedGain;
+
+        // Sentido de giro actual (1 adelante, -1 atrás, 0 parada) y última estimación de la velocidad (tacos/s):
+        // la de referencia al establecerla y la medida cada vez que se consulta el encoder
+        int direction;
+        int estimatedSpeed;
+
+        // Recuento de tacos por sondeo del encoder: último nivel leído, flancos contados, instantes de la última
+        // consulta y del último flanco (y tiempo sin consultar antes de verlo), y semiperiodo de la señal (us) según la
+        // última velocidad medida o los últimos flancos observados
+        int encoderLevel;
+        long long encoderEdges;
+        long long lastPoll;
+        long long lastEdge;
+        long long edgeGap;
+        long long halfPeriod;
+
+        // Recorrido con signo (flancos, positivos hacia adelante). El encoder no indica el sentido de giro, así que se
+        // toma el de la orden; al invertirla con la rueda en marcha los flancos conservan el sentido anterior
+        // (travel) hasta que el intervalo entre ellos, tras crecer, vuelve a decrecer: la rueda se ha detenido y
+        // acelera al revés. Mientras, se guarda el intervalo más largo y los flancos contados desde él
+        long long positionEdges;
+        int travel;
+        bool reversing;
+        long long edgeInterval;
+        long long reversalEdges;
+
+        // Rueda cuyo encoder se consulta también en cada lectura de este (p.e: mientras se mide la velocidad de forma
+        // bloqueante), para no perder sus tacos
+        WheelMotor *companion;
 
     public:
-        // Inicializa la rueda indicada (LEFT, RIGHT)
-        // Nota: solo se puede crear una instancia de cada tipo
-        WheelMotor(Wheel wheel);
+        // Inicializa la rueda indicada (LEFT, RIGHT) sobre sus pines del mapa indicado
+        // Nota: solo puede existir una instancia por cada rueda de un mismo mapa de pines y backend
+        WheelMotor(Wheel wheel, const PinMap &pins = PinMap());
 
         // Desvincula los pines de la rueda
         ~WheelMotor();
@@ -56,6 +101,40 @@ namespace RoboCar {
         bool setSpeed(int speed);
         int getCurrentSpeed();
         void updateSpeed(int referenceSpeed);
+        void setSpeedGain(float speedGain);
+
+        // Regulación con una velocidad medida fuera de la rueda (p.e: esperando los flancos del encoder desde una
+        // misión, sin bloquear): se registra como las de getCurrentSpeed() y se corrige el duty cycle
+        PinsLib::GPIO *getEncoderPin() const;
+        bool isMoving() const;
+        void updateSpeed(int referenceSpeed, int currentSpeed);
+
+        // Velocidad estimada con signo (tacos/s), sin leer el encoder
+        int getVelocity() const;
+
+        // Sentido de giro ordenado (1 adelante, -1 atrás, 0 parada)
+        int getDirection() const;
+
+        // Duty cycle aplicado actualmente al motor (ns)
+        int getDutyCycle() const;
+
+        // Ficheros de control en los que escribir "0" detiene la rueda (vacío si el backend no usa ficheros)
+        void getStopFiles(std::vector<string> &files);
+
+        // Consulta el encoder y devuelve los tacos contados desde que se creó la rueda. Ha de invocarse con
+        // frecuencia (al menos una vez por semiperiodo de la señal) mientras se quieran contar los tacos
+        float countTicks();
+
+        // Tacos recorridos con signo (positivos hacia adelante) desde que se creó la rueda, según los contados en la
+        // última consulta del encoder. Utilizada para la odometría
+        float getPosition() const;
+
+        // Lee el nivel del encoder contando a la vez los tacos, para quien espera los flancos por su cuenta (p.e: las
+        // misiones)
+        int readEncoder();
+
+        // Rueda cuyos tacos se siguen contando mientras se lee el encoder de esta
+        void setCompanion(WheelMotor *companion);
 
         // Funciones de calibración
         pair<int, int> calibrate();
@@ -64,7 +143,23 @@ namespace RoboCar {
 
     private:
         // Función utilizada para la regulación de la velocidad
+        void setDirection(int direction);
         void setDutyCycle(int dutyCycle);
+        void correctDutyCycle(int referenceSpeed, int currentSpeed);
+
+        // Medición de la velocidad sobre el encoder
+        int measureSpeed();
+        void registerSpeed(int speed);
+
+        // Detección del instante en que una rueda invertida con inercia empieza a girar en el nuevo sentido
+        void detectReversal(long long now, long long edges);
+
+        // Compensación del duty cycle de la tabla según la tensión actual de la batería (si se está midiendo)
+        int compensateDutyCycle(int dutyCycle);
+
+        // Lectura de las tablas de un fichero de calibración y combinación de varias tablas en una sola
+        static bool readCalibrationTables(const string &filename, std::vector<CalibrationTable> &tables);
+        static std::vector<std::pair<int, int>> combineCalibrationTables(const std::vector<CalibrationTable> &tables);
     };
 
 } /* namespace RoboCar */
@@ -7,12 +7,24 @@ using namespace std;
 
 namespace RoboCarAlgorithms {
 
-    void simpleMode(RoboCar::RoboCar *car, int time, int limitDistance, bool maxSpeed);
+    void simpleMode(RoboCar::RoboCar *car, int time, int limitDistance, bool maxSpeed, int scanArc);
+
+    bool escapeObstacle(RoboCar::RoboCar *car, int limitDistance, int scanArc);
 
     void twisterMode(RoboCar::RoboCar *car, int time);
 
     void circuitMode(RoboCar::RoboCar *car, int time, int limitDistance, const string& circuitFilename);
 
+    bool circuitDryRun(RoboCar::RoboCar *car, const string& circuitFilename);
+
+    void raceMode(RoboCar::RoboCar *car, int time, int limitDistance, const string& circuitFilename);
+
+    void wallFollowMode(RoboCar::RoboCar *car, int time, int limitDistance, bool maxSpeed, bool threads);
+
+    void gotoMode(RoboCar::RoboCar *car, int time, int limitDistance, float goalX, float goalY);
+
+    void teleopMode(RoboCar::RoboCar *car, int time, const string &socketPath);
+
 } /* namespace RoboCarAlgorithms */
 
 
@@ -0,0 +1,58 @@
+#ifndef SIMULATOR_ARENA_H
+#define SIMULATOR_ARENA_H
+
+#include <string>
+#include <vector>
+
+namespace Simulator {
+
+    // Punto o vector en el plano (CM)
+    struct Point {
+        float x;
+        float y;
+    };
+
+    // Tramo de pared entre dos puntos
+    struct Segment {
+        Point a;
+        Point b;
+    };
+
+    // Escenario 2D formado por polígonos (paredes y obstáculos) sobre el que se mueve el coche simulado.
+    // Formato del fichero (unidades en CM y grados, '#' inicia un comentario):
+    //     start <x> <y> <orientación>
+    //     polygon <x1> <y1> <x2> <y2> <x3> <y3> ...
+    class Arena {
+    private:
+        std::vector<Segment> walls;
+        Point start;
+        float startHeading;
+
+    public:
+        Arena();
+
+        // Carga el escenario desde un fichero
+        bool load(const std::string &filename);
+
+        // Construcción del escenario desde código
+        void addPolygon(const std::vector<Point> &vertices);
+        void setStart(Point position, float heading);
+
+        Point getStart() const;
+        float getStartHeading() const;
+        const std::vector<Segment> &getWalls() const;
+
+        // Distancia desde el origen hasta la primera pared en la dirección indicada (radianes).
+        // Devuelve maxRange si no se encuentra ninguna pared antes
+        float castRay(Point origin, float angle, float maxRange) const;
+
+        // Distancia desde un punto a la pared más cercana
+        float clearance(Point position) const;
+
+        // Si un punto queda dentro del recinto (el primer polígono) y fuera de los obstáculos
+        bool contains(Point position) const;
+    };
+
+} /* namespace Simulator */
+
+#endif //SIMULATOR_ARENA_H
@@ -0,0 +1,133 @@
+#ifndef SIMULATOR_FLEET_H
+#define SIMULATOR_FLEET_H
+
+#include "PinsLib/Clock.h"
+#include "RoboCar/RoboCar.h"
+#include "SimBackend.h"
+#include <functional>
+#include <ostream>
+#include <streambuf>
+#include <ucontext.h>
+#include <vector>
+
+// Intervalo (tiempo virtual) entre sincronizaciones de la flota. Los pulsos de ultrasonidos de un coche afectan a los
+// demás a partir de la siguiente sincronización, por lo que no debe ser mucho menor que un eco (17.5 ms a 300 CM)
+#define FLEET_SYNC_INTERVAL_UMS     5000
+
+// Pila de cada coche de la flota
+#define FLEET_STACK_SIZE            (1 << 20)
+
+// Colocación inicial de los coches: separación mínima entre ellos y respecto a las paredes, e intentos por coche
+#define FLEET_START_SEPARATION_CM   40.0f
+#define FLEET_START_CLEARANCE_CM    25.0f
+#define FLEET_START_ATTEMPTS        10000
+
+namespace Simulator {
+
+    // Reloj virtual de un coche de la flota, que ejecuta al coche en su propia pila (ucontext). Cada vez que el
+    // tiempo del coche alcanza el final del intervalo en curso, el reloj lo suspende y devuelve el control a quien
+    // lo reanudó; el coche continúa, quizás en otro hilo, cuando se le da el siguiente intervalo
+    class FleetClock : public PinsLib::VirtualClock {
+    private:
+        std::function<void()> body;
+        long long boundary;
+        bool finished;
+        char *stack;
+        ucontext_t context;
+        ucontext_t caller;
+
+    public:
+        explicit FleetClock(std::function<void()> body);
+        ~FleetClock();
+
+        // Ejecuta el coche hasta el instante indicado o hasta que termine. Devuelve false si ya ha terminado
+        bool resume(long long boundary);
+        bool isFinished() const;
+
+        void sleep(long long ums) override;
+        void sleepUntil(long long time) override;
+        void advance(long long ums) override;
+
+    private:
+        void yield();
+        static void start(unsigned int high, unsigned int low);
+    };
+
+    // Flota de coches simulados en un mismo escenario y en un mismo proceso. Cada coche tiene su propio reloj,
+    // backend, pines y coche (RoboCar), y ejecuta su comportamiento como si estuviera solo. Los coches avanzan a la
+    // vez por intervalos de tiempo virtual, repartidos entre los hilos de un TaskPool; entre intervalos se comparten
+    // sus posiciones y sus pulsos de ultrasonidos (Traffic), por lo que el resultado no depende del número de hilos
+    class Fleet {
+    public:
+        // Resultado de un coche
+        struct CarStats {
+            bool completed;
+            long long virtualTime;
+            Pose pose;
+            double travelled;
+            long long collisions;
+            long long crosstalkEchoes;
+            long long interferenceEchoes;
+        };
+
+    private:
+        struct Member {
+            FleetClock *clock;
+            SimBackend *backend;
+            bool completed;
+        };
+
+        const Arena &arena;
+        long long ioCost;
+        std::vector<Member> members;
+        Traffic traffic;
+
+        // Comportamiento de cada coche, con sus pines y su directorio de calibración
+        std::function<bool(RoboCar::RoboCar *)> behaviour;
+        RoboCar::PinMap pins;
+        std::string calibrationPath;
+
+        // Estadísticas de la última ejecución
+        int threads;
+        long long syncs;
+        long long realTime;
+
+        // Destino de std::cout mientras se ejecutan los coches, para descartar sus mensajes
+        class NullBuffer : public std::streambuf {
+        protected:
+            int overflow(int c) override { return c; }
+        };
+        NullBuffer nullBuffer;
+
+    public:
+        // ioCost: tiempo virtual (us) que consume cada operación sobre los pines
+        Fleet(const Arena &arena, long long ioCost);
+        ~Fleet();
+
+        // Crea los coches: el primero en la salida del escenario y el resto en posiciones libres elegidas al azar
+        // (con la semilla indicada, que también da las semillas del ruido de cada coche)
+        bool populate(int size, unsigned int seed);
+        int getSize() const;
+
+        // Backend de un coche, para configurarlo (sensores, batería...) antes de la ejecución
+        SimBackend *getBackend(int car) const;
+
+        // Pines y directorio de calibración con que se crea cada coche
+        void setCar(const RoboCar::PinMap &pins, const std::string &calibrationPath);
+
+        // Ejecuta el comportamiento indicado en todos los coches, con el número de hilos indicado, hasta que terminen.
+        // El comportamiento recibe el coche recién creado y devuelve false si no ha podido ejecutarse
+        void run(int threads, std::function<bool(RoboCar::RoboCar *)> behaviour);
+
+        CarStats getStats(int car) const;
+
+        // Tiempo real (us) que ha durado la última ejecución
+        long long getRealTime() const;
+
+        // Resultado de cada coche y rendimiento: segundos de coche simulados por segundo real
+        void printReport(std::ostream &out) const;
+    };
+
+} /* namespace Simulator */
+
+#endif //SIMULATOR_FLEET_H
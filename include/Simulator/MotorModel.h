@@ -0,0 +1,47 @@
+#ifndef SIMULATOR_MOTORMODEL_H
+#define SIMULATOR_MOTORMODEL_H
+
+// Parámetros por defecto, aproximados a partir de las calibraciones del coche real
+#define DEFAULT_DEAD_ZONE           0.25f
+#define DEFAULT_MAX_SPEED           110.0f
+#define DEFAULT_CURVE_EXPONENT      0.6f
+#define DEFAULT_TIME_CONSTANT       0.15f
+
+namespace Simulator {
+
+    // Modelo de un motor de continua con su encoder. La velocidad en régimen permanente sigue una curva
+    // duty cycle -> velocidad con zona muerta (la misma forma que descubre WheelMotor::calibrate()) y la
+    // respuesta ante cambios es de primer orden con la constante de tiempo indicada
+    class MotorModel {
+    private:
+        // Parámetros del modelo
+        float deadZone;         // Fracción del periodo por debajo de la cual el motor no se mueve [0, 1]
+        float maxSpeed;         // Velocidad con duty cycle máximo (tacos/s)
+        float curveExponent;    // Forma de la curva (< 1: cóncava, 1: lineal)
+        float timeConstant;     // Constante de tiempo (s)
+
+        // Estado
+        float speed;            // Velocidad actual con signo (tacos/s)
+        double ticks;           // Tacos recorridos (sin signo, el encoder no distingue el sentido)
+
+    public:
+        MotorModel();
+        MotorModel(float deadZone, float maxSpeed, float curveExponent, float timeConstant);
+
+        // Velocidad en régimen permanente para un duty cycle dado
+        float steadySpeed(int dutyCycle, int period) const;
+
+        // Avanza el modelo dt segundos con la orden indicada (direction: 1 adelante, -1 atrás, 0 sin tensión).
+        // supply: tensión de alimentación relativa a aquella con la que se ajustó la curva
+        void step(int direction, int dutyCycle, int period, float dt, float supply = 1.0f);
+
+        float getSpeed() const;
+        double getTicks() const;
+
+        // Nivel actual del encoder (un ciclo 1-0 por taco)
+        bool encoderLevel() const;
+    };
+
+} /* namespace Simulator */
+
+#endif //SIMULATOR_MOTORMODEL_H
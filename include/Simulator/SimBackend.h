@@ -0,0 +1,133 @@
+#ifndef SIMULATOR_SIMBACKEND_H
+#define SIMULATOR_SIMBACKEND_H
+
+#include "RoboCar/VirtualBackend.h"
+#include "Arena.h"
+#include "MotorModel.h"
+#include <random>
+#include <vector>
+
+namespace Simulator {
+
+    // Posición y orientación del coche en el escenario (CM, radianes en sentido antihorario)
+    struct Pose {
+        float x;
+        float y;
+        float heading;
+    };
+
+    // Pulso de ultrasonidos emitido por un sensor: mientras no se extingue puede llegar, reflejado en el obstáculo que
+    // alcanzó, a cualquier sensor que lo tenga dentro de su cono de recepción (diafonía)
+    struct Ping {
+        long long fired;
+        long long expires;
+        Point origin;
+        Point hit;
+    };
+
+    // Coches que comparten el escenario (flota) tal y como estaban al final del último intervalo de sincronización:
+    // posición de cada uno y pulsos emitidos que no se han extinguido. Durante un intervalo los coches solo lo leen
+    struct Traffic {
+        std::vector<Pose> poses;
+        std::vector<std::vector<Ping>> pings;
+    };
+
+    // Backend de pines que simula el coche completo: motores y encoders, cinemática diferencial sobre el
+    // escenario 2D y eco del sensor de ultrasonidos mediante trazado de rayos con apertura de haz y ruido
+    class SimBackend : public RoboCar::VirtualBackend {
+    private:
+        const Arena &arena;
+        MotorModel motors[2];       // Índice: RoboCar::Wheel
+        Pose pose;
+        long long lastUpdate;
+
+        // Orientación de cada sensor de ultrasonidos respecto al eje del coche (radianes, el 0 es el frontal)
+        std::vector<float> sensorMounts;
+
+        // Último pulso emitido por cada sensor y si su eco ha terminado con el pulso de otro sensor
+        std::vector<Ping> pings;
+        std::vector<bool> contaminated;
+        long long crosstalkEchoes;
+
+        // Resto de coches del escenario (opcional): índice de este coche, pulsos emitidos desde la última
+        // sincronización y ecos que han terminado con el pulso de otro coche
+        const Traffic *traffic;
+        int trafficIndex;
+        std::vector<Ping> emitted;
+        long long interferenceEchoes;
+
+        // Generador de ruido de las medidas (semilla fija para que las simulaciones sean reproducibles)
+        std::mt19937 random;
+
+        // Batería: tensión inicial (V, 0 si no se simula y los motores reciben siempre la nominal), descarga (V/s) y
+        // ruido de las lecturas del ADC, con su propio generador para no alterar el resto de medidas
+        float batteryStart;
+        float batteryDrain;
+        long long batteryStartTime;
+        std::mt19937 adcRandom;
+
+        // Estadísticas de la simulación
+        long long collisions;
+        bool inContact;
+        double travelled;
+
+    public:
+        SimBackend(const Arena &arena, PinsLib::VirtualClock *clock, long long ioCost, unsigned int seed = 1,
+                   const RoboCar::PinMap &pins = RoboCar::PinMap());
+
+        Pose getPose() const;
+        void setPose(Pose pose);
+        long long getCollisions() const;
+        double getTravelled() const;
+        const MotorModel &getMotor(RoboCar::Wheel wheel) const;
+
+        // Sustituye el modelo del motor de una rueda (p.e: para simular ruedas desiguales). Ha de hacerse antes de
+        // calibrar el coche
+        void setMotor(RoboCar::Wheel wheel, const MotorModel &motor);
+
+        void setSensorMount(float angle);
+
+        // Añade un sensor de ultrasonidos con los pines y la orientación (radianes) indicados. Devuelve su índice
+        int addSensor(int triggerPin, int echoPin, float mount);
+
+        // Ecos que han terminado con el pulso de otro sensor en lugar del propio
+        long long getCrosstalkEchoes() const;
+
+        // Comparte el escenario con otros coches: son obstáculos para el movimiento y para el sensor, y sus pulsos
+        // pueden terminar los ecos de este coche. collectPings() entrega (y olvida) los pulsos emitidos desde la
+        // última llamada, para incorporarlos al tráfico, y synchronize() avanza la física hasta el instante indicado
+        void joinTraffic(const Traffic *traffic, int index);
+        void collectPings(std::vector<Ping> &out);
+        void synchronize(long long now);
+        long long getInterferenceEchoes() const;
+
+        // Simula la batería desde la tensión indicada, descargándose linealmente (V/min). El ADC del monitor de la
+        // batería se lee a través de este backend en cualquier ruta
+        void setBattery(float voltage, float drainPerMinute);
+        float getBatteryVoltage(long long now) const;
+
+        string read(const string &path, const string &filename) override;
+
+    protected:
+        void update(long long now) override;
+        float echoDistance(int sensor, long long now) override;
+        bool encoderLevel(RoboCar::Wheel wheel, long long now) override;
+        long long nextEncoderEdge(RoboCar::Wheel wheel, long long now) override;
+
+    private:
+        // Integra un paso de dt segundos de los motores y del movimiento del coche
+        void step(float dt);
+
+        // Posición de los sensores (todos en el frontal del coche) y llegada (us) a uno de ellos del pulso de otro
+        // sensor, -1 si no lo capta
+        Point sensorPosition() const;
+        long long crosstalkArrival(const Ping &ping, int sensor) const;
+
+        // Trazado de un rayo contra las paredes y contra el resto de coches, y si el coche puede ocupar una posición
+        float castRay(Point origin, float angle, float maxRange) const;
+        bool blockedByTraffic(Point next) const;
+    };
+
+} /* namespace Simulator */
+
+#endif //SIMULATOR_SIMBACKEND_H
@@ -0,0 +1,67 @@
+#ifndef SIMULATOR_TASKPOOL_H
+#define SIMULATOR_TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace Simulator {
+
+    // Conjunto de hilos que ejecutan tareas con robo de trabajo: cada hilo tiene su propia cola y toma de ella las
+    // últimas tareas que ha recibido; cuando se queda sin ellas, roba la más antigua de la cola de otro hilo. Así
+    // ningún hilo queda parado mientras otro tiene trabajo pendiente, aunque las tareas duren tiempos muy distintos
+    class TaskPool {
+    private:
+        // Cola de un hilo y tareas que ha ejecutado (de ellas, robadas a otros hilos)
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+            long long executed;
+            long long stolen;
+        };
+
+        std::vector<Queue *> queues;
+        std::vector<std::thread> threads;
+
+        // Tareas en las colas y tareas sin terminar. Los hilos sin trabajo esperan a que haya tareas en las colas, y
+        // wait() a que no quede ninguna sin terminar
+        std::mutex mutex;
+        std::condition_variable available;
+        std::condition_variable finished;
+        std::atomic<long long> queued;
+        std::atomic<long long> pending;
+        bool stopping;
+        int nextQueue;
+
+    public:
+        // Arranca el número de hilos indicado (al menos uno)
+        explicit TaskPool(int threads);
+
+        // Espera a que terminen las tareas pendientes y detiene los hilos
+        ~TaskPool();
+
+        // Añade una tarea. Las que se añaden desde fuera de los hilos se reparten por turnos entre sus colas
+        void submit(std::function<void()> task);
+
+        // Espera a que terminen todas las tareas añadidas
+        void wait();
+
+        int getThreads() const;
+
+        // Tareas ejecutadas y robadas por cada hilo
+        void printReport(std::ostream &out) const;
+
+    private:
+        // Bucle de cada hilo y obtención de su siguiente tarea (propia o robada)
+        void work(int index);
+        bool take(int index, std::function<void()> &task);
+    };
+
+} /* namespace Simulator */
+
+#endif //SIMULATOR_TASKPOOL_H
@@ -0,0 +1,62 @@
+#include "Bus/Topic.h"
+#include <iomanip>
+
+namespace Bus {
+
+    TopicBase::TopicBase(const std::string &name) : name(name) {
+        published.store(0, std::memory_order_relaxed);
+        delivered.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+        totalLatency.store(0, std::memory_order_relaxed);
+        maxLatency.store(0, std::memory_order_relaxed);
+    }
+
+    void TopicBase::countPublished() {
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Cuenta la entrega de un mensaje a un suscriptor
+     * @param latency Tiempo (us) transcurrido desde que se publicó
+     */
+    void TopicBase::countDelivered(long long latency) {
+        unsigned long long value = (latency > 0) ? (unsigned long long) latency : 0;
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        totalLatency.fetch_add(value, std::memory_order_relaxed);
+        unsigned long long current = maxLatency.load(std::memory_order_relaxed);
+        while (value > current && !maxLatency.compare_exchange_weak(current, value, std::memory_order_relaxed));
+    }
+
+    void TopicBase::countDropped(unsigned long long messages) {
+        dropped.fetch_add(messages, std::memory_order_relaxed);
+    }
+
+    const std::string &TopicBase::getName() const {
+        return name;
+    }
+
+    TopicBase::TopicStats TopicBase::getStats() const {
+        return {published.load(std::memory_order_relaxed), delivered.load(std::memory_order_relaxed),
+                dropped.load(std::memory_order_relaxed), totalLatency.load(std::memory_order_relaxed),
+                maxLatency.load(std::memory_order_relaxed)};
+    }
+
+    /**
+     * @brief Muestra, por cada tema, los mensajes publicados, entregados (a todos los suscriptores) y perdidos, y la
+     * latencia media y máxima de las entregas (us)
+     */
+    void TopicBase::printReport(std::ostream &out, const std::vector<const TopicBase *> &topics) {
+        out << "Temas del bus (latencias en us):" << std::endl;
+        out << std::left << std::setw(16) << "tema" << std::right
+            << std::setw(10) << "publicados" << std::setw(11) << "entregados" << std::setw(10) << "perdidos"
+            << std::setw(10) << "lat.med" << std::setw(10) << "lat.max" << std::endl;
+        for (const TopicBase *topic : topics) {
+            TopicStats stats = topic->getStats();
+            unsigned long long delivered = stats.delivered > 0 ? stats.delivered : 1;
+            out << std::left << std::setw(16) << topic->getName() << std::right
+                << std::setw(10) << stats.published << std::setw(11) << stats.delivered << std::setw(10) << stats.dropped
+                << std::setw(10) << stats.totalLatency / delivered << std::setw(10) << stats.maxLatency << std::endl;
+        }
+    }
+
+} /* namespace Bus */
@@ -0,0 +1,14 @@
+#include "Bus/Topics.h"
+
+namespace Bus {
+
+    RoboCarTopics::RoboCarTopics(PinsLib::Clock *clock)
+            : wheelTicks("tacos", clock), range("distancia", clock), ranges("distancias", clock), pose("posicion", clock),
+              speedSetpoints("velocidades", clock), modeEvents("eventos", clock) {
+    }
+
+    void RoboCarTopics::printReport(std::ostream &out) const {
+        TopicBase::printReport(out, {&wheelTicks, &range, &ranges, &pose, &speedSetpoints, &modeEvents});
+    }
+
+} /* namespace Bus */
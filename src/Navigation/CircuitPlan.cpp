@@ -0,0 +1,286 @@
+#include "Navigation/CircuitPlan.h"
+#include "RoboCar/Geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace Navigation {
+
+    // Tramo del circuito tal y como se describe en el fichero, antes de compilarlo
+    struct CircuitStep {
+        PrimitiveType type;
+        bool untilWall;
+        float length;           // CM (rectas)
+        int direction;          // 1 izquierda, -1 derecha (giros y curvas)
+        float angle;            // Radianes (giros y curvas)
+        float radius;           // CM (curvas)
+        float speed;            // CM/s, -1 para la velocidad por defecto
+        float wallDistance;     // CM, -1 si no se indica
+        int line;
+    };
+
+    /**
+     * @brief Lee un número del tramo, comprobando que esté dentro del rango indicado
+     * @return true si se ha leído correctamente, false en caso contrario
+     */
+    static bool readNumber(std::istringstream &tokens, float min, float max, float &value) {
+        return (tokens >> value) && value >= min && value <= max;
+    }
+
+    /**
+     * @brief Lee la dirección de un giro o curva (l, L, r, R)
+     * @return true si se ha leído correctamente, false en caso contrario
+     */
+    static bool readDirection(const std::string &token, int &direction) {
+        if (token == "l" || token == "L")
+            direction = 1;
+        else if (token == "r" || token == "R")
+            direction = -1;
+        else
+            return false;
+        return true;
+    }
+
+    /**
+     * @brief Convierte una velocidad en CM/s a tacos/s limitada a las velocidades calibradas
+     * @param speed Velocidad solicitada (CM/s), -1 para la velocidad por defecto
+     * @return Velocidad en tacos/s, -1 si la velocidad solicitada es menor que la mínima calibrada
+     */
+    static int toTickSpeed(float speed, int defaultSpeed, int minSpeed, int maxSpeed) {
+        if (speed < 0)
+            return defaultSpeed;
+        int ticks = (int) std::lround(speed / CM_PER_TICK);
+        if (ticks < minSpeed)
+            return -1;
+        return std::min(ticks, maxSpeed);
+    }
+
+    /**
+     * @brief Carga el fichero del circuito y lo compila a una lista de primitivas de movimiento
+     * @param filename Nombre del fichero con la descripción del circuito
+     * @param minSpeed, maxSpeed Velocidades calibradas del coche (tacos/s)
+     * @return true si se ha cargado correctamente, false en caso contrario
+     */
+    bool CircuitPlan::load(const std::string &filename, int minSpeed, int maxSpeed) {
+        std::ifstream in(filename);
+        if (!in.is_open()) {
+            std::cerr << "No se pudo abrir el fichero de configuracion del circuito < " << filename << " >" << std::endl;
+            return false;
+        }
+
+        // Lectura y parseo del fichero
+        std::vector<CircuitStep> steps;
+        std::string line;
+        int lineNumber = 0;
+        bool onlySpins = true;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            std::string::size_type comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+
+            std::istringstream tokens(line);
+            std::string keyword;
+            if (!(tokens >> keyword))
+                continue;
+
+            CircuitStep step = {STRAIGHT_PRIMITIVE, false, 0, 0, 0, 0, -1, -1, lineNumber};
+            int direction;
+            float degrees;
+            if (keyword == "straight") {
+                std::string length;
+                tokens >> length;
+                std::istringstream number(length);
+                if (length == "wall") {
+                    step.untilWall = true;
+                } else if (!readNumber(number, 1, 100000, step.length)) {
+                    std::cerr << "Circuito " << filename << ":" << lineNumber << ": straight <CM|wall>" << std::endl;
+                    return false;
+                }
+            } else if (readDirection(keyword, direction)) {
+                step.type = SPIN_PRIMITIVE;
+                step.direction = direction;
+                if (!readNumber(tokens, 0, 360, degrees)) {
+                    std::cerr << "Circuito " << filename << ":" << lineNumber << ": el angulo ha de estar entre 0 y 360" << std::endl;
+                    return false;
+                }
+                step.angle = degrees * (float) M_PI / 180.0f;
+            } else if (keyword == "arc") {
+                std::string token;
+                step.type = ARC_PRIMITIVE;
+                if (!(tokens >> token) || !readDirection(token, step.direction) ||
+                    !readNumber(tokens, 0, 360, degrees) || !readNumber(tokens, 0, 100000, step.radius)) {
+                    std::cerr << "Circuito " << filename << ":" << lineNumber << ": arc <l|r> <grados> <radio>" << std::endl;
+                    return false;
+                }
+                step.angle = degrees * (float) M_PI / 180.0f;
+            } else {
+                std::cerr << "Circuito " << filename << ":" << lineNumber << ": tramo desconocido " << keyword << std::endl;
+                return false;
+            }
+
+            // Opciones del tramo
+            std::string option;
+            while (tokens >> option) {
+                if (option == "speed") {
+                    if (!readNumber(tokens, 1, 10000, step.speed)) {
+                        std::cerr << "Circuito " << filename << ":" << lineNumber << ": speed <CM/s>" << std::endl;
+                        return false;
+                    }
+                } else if (option == "wall" && step.type == STRAIGHT_PRIMITIVE) {
+                    if (!readNumber(tokens, 1, 10000, step.wallDistance)) {
+                        std::cerr << "Circuito " << filename << ":" << lineNumber << ": wall <CM>" << std::endl;
+                        return false;
+                    }
+                } else {
+                    std::cerr << "Circuito " << filename << ":" << lineNumber << ": opcion desconocida " << option << std::endl;
+                    return false;
+                }
+            }
+            onlySpins = onlySpins && step.type == SPIN_PRIMITIVE;
+            steps.push_back(step);
+        }
+        if (steps.empty()) {
+            std::cerr << "El fichero de configuracion del circuito < " << filename << " > esta vacio" << std::endl;
+            return false;
+        }
+
+        // Formato original: solo giros, antes de los cuales se avanza hasta la pared
+        if (onlySpins) {
+            std::vector<CircuitStep> expanded;
+            for (const CircuitStep &step : steps) {
+                expanded.push_back({STRAIGHT_PRIMITIVE, true, 0, 0, 0, 0, -1, -1, step.line});
+                expanded.push_back(step);
+            }
+            steps.swap(expanded);
+        }
+
+        // Compilación: velocidades y tacos objetivo de cada rueda
+        int meanSpeed = (minSpeed + maxSpeed) / 2;
+        float halfTrack = WHEEL_TRACK_CM / 2.0f;
+        primitives.clear();
+        for (const CircuitStep &step : steps) {
+            MotionPrimitive primitive = {step.type, step.untilWall, 0, 0, 0, 0, step.wallDistance, 0};
+            int speed = toTickSpeed(step.speed, step.type == SPIN_PRIMITIVE ? minSpeed : meanSpeed, minSpeed, maxSpeed);
+            if (speed == -1) {
+                std::cerr << "Circuito " << filename << ":" << step.line << ": la velocidad " << step.speed
+                          << " CM/s es menor que la minima calibrada (" << minSpeed * CM_PER_TICK << " CM/s)" << std::endl;
+                return false;
+            }
+
+            float leftDistance = 0, rightDistance = 0, leftSpeed = speed, rightSpeed = speed;
+            switch (step.type) {
+                case STRAIGHT_PRIMITIVE:
+                    leftDistance = rightDistance = step.length;
+                    break;
+                case SPIN_PRIMITIVE:
+                    leftDistance = rightDistance = step.angle * halfTrack;
+                    leftSpeed = -step.direction * speed;
+                    rightSpeed = step.direction * speed;
+                    break;
+                case ARC_PRIMITIVE: {
+                    // La rueda exterior recorre un arco de radio mayor; la velocidad indicada es la del centro del
+                    // eje y se ajusta para que ninguna rueda quede fuera del rango calibrado
+                    if (step.radius <= halfTrack) {
+                        std::cerr << "Circuito " << filename << ":" << step.line << ": el radio ha de ser mayor que "
+                                  << halfTrack << " CM (para radios menores se ha de girar sobre si mismo)" << std::endl;
+                        return false;
+                    }
+                    float outer = speed * (step.radius + halfTrack) / step.radius;
+                    float inner = speed * (step.radius - halfTrack) / step.radius;
+                    if (outer > maxSpeed) {
+                        inner *= maxSpeed / outer;
+                        outer = maxSpeed;
+                    }
+                    if (inner < minSpeed) {
+                        outer *= minSpeed / inner;
+                        inner = minSpeed;
+                    }
+                    if (outer > maxSpeed) {
+                        std::cerr << "Circuito " << filename << ":" << step.line << ": el radio " << step.radius
+                                  << " CM es demasiado cerrado para las velocidades calibradas" << std::endl;
+                        return false;
+                    }
+                    float outerDistance = step.angle * (step.radius + halfTrack);
+                    float innerDistance = step.angle * (step.radius - halfTrack);
+                    leftDistance = (step.direction > 0) ? innerDistance : outerDistance;
+                    rightDistance = (step.direction > 0) ? outerDistance : innerDistance;
+                    leftSpeed = (step.direction > 0) ? inner : outer;
+                    rightSpeed = (step.direction > 0) ? outer : inner;
+                    break;
+                }
+            }
+            primitive.leftSpeed = (int16_t) std::lround(leftSpeed);
+            primitive.rightSpeed = (int16_t) std::lround(rightSpeed);
+            primitive.leftTicks = leftDistance / CM_PER_TICK;
+            primitive.rightTicks = rightDistance / CM_PER_TICK;
+
+            // Ambas ruedas tardan lo mismo en recorrer sus tacos, salvo por el redondeo de las velocidades
+            if (!step.untilWall) {
+                double seconds = std::max(primitive.leftTicks / std::fabs(leftSpeed), primitive.rightTicks / std::fabs(rightSpeed));
+                primitive.duration = (int32_t) (seconds * 1000000.0) + PRIMITIVE_RAMP_UMS;
+                if (step.type == SPIN_PRIMITIVE)
+                    primitive.duration += SPIN_SETTLE_UMS;
+            }
+            primitives.push_back(primitive);
+        }
+        return true;
+    }
+
+    const std::vector<MotionPrimitive> &CircuitPlan::getPrimitives() const {
+        return primitives;
+    }
+
+    long long CircuitPlan::estimateLapTime(int *unknownSegments) const {
+        long long total = 0;
+        int unknown = 0;
+        for (const MotionPrimitive &primitive : primitives) {
+            total += primitive.duration;
+            unknown += primitive.untilWall;
+        }
+        if (unknownSegments != nullptr)
+            *unknownSegments = unknown;
+        return total;
+    }
+
+    void CircuitPlan::print(std::ostream &out) const {
+        out << "Plan del circuito (" << primitives.size() << " primitivas):" << std::endl;
+        for (size_t i = 0; i < primitives.size(); i++) {
+            const MotionPrimitive &primitive = primitives[i];
+            out << "  " << i << ": ";
+            switch (primitive.type) {
+                case STRAIGHT_PRIMITIVE:
+                    if (primitive.untilWall)
+                        out << "recta hasta la pared";
+                    else
+                        out << "recta de " << primitive.leftTicks << " tacos";
+                    out << " a " << primitive.leftSpeed << " tacos/s";
+                    if (primitive.wallDistance > 0)
+                        out << " (termina con la pared a " << primitive.wallDistance << " CM)";
+                    break;
+                case SPIN_PRIMITIVE:
+                    out << "giro sobre si mismo a la " << (primitive.rightSpeed > 0 ? "izquierda" : "derecha") << ": "
+                        << primitive.leftTicks << " tacos por rueda a " << std::abs(primitive.leftSpeed) << " tacos/s";
+                    break;
+                case ARC_PRIMITIVE:
+                    out << "curva a la " << (primitive.rightSpeed > primitive.leftSpeed ? "izquierda" : "derecha") << ": "
+                        << primitive.leftTicks << "/" << primitive.rightTicks << " tacos a " << primitive.leftSpeed
+                        << "/" << primitive.rightSpeed << " tacos/s";
+                    break;
+            }
+            if (!primitive.untilWall)
+                out << ", " << primitive.duration / 1000 << " ms";
+            out << std::endl;
+        }
+
+        int unknown;
+        long long lapTime = estimateLapTime(&unknown);
+        out << "Tiempo estimado de vuelta: " << lapTime / 1000000.0 << " s";
+        if (unknown > 0)
+            out << " (sin contar " << unknown << " rectas hasta la pared)";
+        out << std::endl;
+    }
+
+} /* namespace Navigation */
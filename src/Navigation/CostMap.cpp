@@ -0,0 +1,100 @@
+#include "Navigation/CostMap.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Navigation {
+
+    CostMap::CostMap(int width, int height, float cellSize, float lethalRadius, float inflationRadius) {
+        this->width = width;
+        this->height = height;
+        this->cellSize = cellSize;
+        this->originX = -width * cellSize / 2.0f;
+        this->originY = -height * cellSize / 2.0f;
+        obstacles.assign((size_t) width * height, 0);
+        lethal.assign((size_t) width * height, 0);
+        inflation.assign((size_t) width * height, 0);
+
+        int radius = (int) std::ceil(inflationRadius / cellSize);
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                float distance2 = (dx * dx + dy * dy) * cellSize * cellSize;
+                if (distance2 <= inflationRadius * inflationRadius) {
+                    inflationOffsets.push_back(dx);
+                    inflationOffsets.push_back(dy);
+                    inflationOffsets.push_back(distance2 <= lethalRadius * lethalRadius);
+                }
+            }
+        }
+    }
+
+    int CostMap::getWidth() const {
+        return width;
+    }
+
+    int CostMap::getHeight() const {
+        return height;
+    }
+
+    float CostMap::getCellSize() const {
+        return cellSize;
+    }
+
+    bool CostMap::toCell(float x, float y, int &cellX, int &cellY) const {
+        cellX = (int) std::floor((x - originX) / cellSize);
+        cellY = (int) std::floor((y - originY) / cellSize);
+        return cellX >= 0 && cellY >= 0 && cellX < width && cellY < height;
+    }
+
+    void CostMap::toWorld(int cellX, int cellY, float &x, float &y) const {
+        x = originX + (cellX + 0.5f) * cellSize;
+        y = originY + (cellY + 0.5f) * cellSize;
+    }
+
+    /**
+     * @brief Una celda es obstáculo si lo es alguno de los cuatro puntos del mapa de ocupación que la muestrean
+     */
+    void CostMap::update(const OccupancyGrid &map, float x0, float y0, float x1, float y1, std::vector<int> &changed) {
+        int firstX, firstY, lastX, lastY;
+        toCell(x0, y0, firstX, firstY);
+        toCell(x1, y1, lastX, lastY);
+        firstX = std::max(firstX, 0);
+        firstY = std::max(firstY, 0);
+        lastX = std::min(lastX, width - 1);
+        lastY = std::min(lastY, height - 1);
+
+        float quarter = cellSize / 4.0f;
+        for (int cellY = firstY; cellY <= lastY; cellY++) {
+            for (int cellX = firstX; cellX <= lastX; cellX++) {
+                float x, y;
+                toWorld(cellX, cellY, x, y);
+                bool obstacle = map.isOccupied(x - quarter, y - quarter) || map.isOccupied(x + quarter, y - quarter) ||
+                                map.isOccupied(x - quarter, y + quarter) || map.isOccupied(x + quarter, y + quarter);
+                int cell = cellY * width + cellX;
+                if (obstacles[cell] == (uint8_t) obstacle)
+                    continue;
+                obstacles[cell] = (uint8_t) obstacle;
+
+                // Se ensancha (o se retira) el obstáculo. Una celda cambia de coste cuando su contador pasa por 0
+                int delta = obstacle ? 1 : -1;
+                for (size_t i = 0; i < inflationOffsets.size(); i += 3) {
+                    int nx = cellX + inflationOffsets[i], ny = cellY + inflationOffsets[i + 1];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    int neighbour = ny * width + nx;
+                    uint16_t &counter = inflationOffsets[i + 2] ? lethal[neighbour] : inflation[neighbour];
+                    counter += delta;
+                    if (counter == (obstacle ? 1 : 0))
+                        changed.push_back(neighbour);
+                }
+            }
+        }
+    }
+
+    uint8_t CostMap::getCost(int cellX, int cellY) const {
+        int cell = cellY * width + cellX;
+        if (lethal[cell] != 0)
+            return IMPASSABLE_CELL;
+        return (inflation[cell] != 0) ? INFLATED_CELL : 1;
+    }
+
+} /* namespace Navigation */
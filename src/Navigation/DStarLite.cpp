@@ -0,0 +1,294 @@
+#include "Navigation/DStarLite.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Costes de los desplazamientos entre celdas (aproximación entera de 1 y raíz de 2)
+#define STRAIGHT_COST       10
+#define DIAGONAL_COST       14
+#define INFINITE_COST       (1 << 28)
+
+namespace Navigation {
+
+    // Desplazamientos a las 8 celdas vecinas (las impares son diagonales)
+    static const int NEIGHBOUR_X[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+    static const int NEIGHBOUR_Y[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+    DStarLite::DStarLite(int width, int height) {
+        this->width = width;
+        this->height = height;
+        g.assign((size_t) width * height, INFINITE_COST);
+        rhs.assign((size_t) width * height, INFINITE_COST);
+        heapIndex.assign((size_t) width * height, -1);
+        costs.assign((size_t) width * height, 1);
+        heap.reserve((size_t) width * height);
+        start = lastStart = goal = 0;
+        km = 0;
+        expansions = 0;
+    }
+
+    void DStarLite::setGoal(int x, int y) {
+        std::fill(g.begin(), g.end(), INFINITE_COST);
+        std::fill(rhs.begin(), rhs.end(), INFINITE_COST);
+        std::fill(heapIndex.begin(), heapIndex.end(), -1);
+        heap.clear();
+        km = 0;
+        expansions = 0;
+        lastStart = start;
+
+        goal = y * width + x;
+        rhs[goal] = 0;
+        heapPush(goal, calculateKey(goal));
+    }
+
+    /**
+     * @brief Actualiza la posición actual. El desplazamiento se acumula en km para que las claves que ya están
+     * en la cola sigan siendo cotas inferiores válidas sin tener que recalcularlas
+     */
+    void DStarLite::setStart(int x, int y) {
+        start = y * width + x;
+        if (start != lastStart) {
+            km += heuristic(lastStart, start);
+            lastStart = start;
+        }
+    }
+
+    /**
+     * @brief Cambia el coste de una celda. Al cambiar el coste de entrar en ella, se recalcula el coste a
+     * un paso de sus vecinas
+     */
+    void DStarLite::setCost(int x, int y, uint8_t cost) {
+        int cell = y * width + x;
+        if (costs[cell] == cost)
+            return;
+        costs[cell] = cost;
+        updateNeighbours(cell);
+    }
+
+    uint8_t DStarLite::getCost(int x, int y) const {
+        return costs[y * width + x];
+    }
+
+    /**
+     * @brief Expande celdas hasta que el coste de la posición actual es consistente y ninguna celda de la cola
+     * puede mejorarlo
+     */
+    bool DStarLite::plan() {
+        while (!heap.empty() && (heap[0].key < calculateKey(start) || rhs[start] > g[start])) {
+            int cell = heap[0].cell;
+            uint64_t oldKey = heap[0].key;
+            uint64_t newKey = calculateKey(cell);
+            expansions++;
+
+            if (oldKey < newKey) {
+                // La clave estaba desactualizada (el coche se ha movido desde que se insertó)
+                heapUpdate(cell, newKey);
+            } else if (g[cell] > rhs[cell]) {
+                // Celda sobreconsistente: su coste baja y se propaga a las vecinas
+                g[cell] = rhs[cell];
+                heapRemove(cell);
+                if (costs[cell] == IMPASSABLE_CELL)
+                    continue;
+                int x = cell % width, y = cell / width;
+                for (int i = 0; i < 8; i++) {
+                    int nx = x + NEIGHBOUR_X[i], ny = y + NEIGHBOUR_Y[i];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    int neighbour = ny * width + nx;
+                    if (neighbour == goal)
+                        continue;
+                    int cost = g[cell] + edgeCost(cell, i);
+                    if (cost < rhs[neighbour]) {
+                        rhs[neighbour] = cost;
+                        updateVertex(neighbour);
+                    }
+                }
+            } else {
+                // Celda infraconsistente: su coste sube, por lo que se revisan ella y las vecinas que dependían de ella
+                int oldG = g[cell];
+                g[cell] = INFINITE_COST;
+                int x = cell % width, y = cell / width;
+                for (int i = 0; i < 8; i++) {
+                    int nx = x + NEIGHBOUR_X[i], ny = y + NEIGHBOUR_Y[i];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    int neighbour = ny * width + nx;
+                    if (neighbour == goal || costs[cell] == IMPASSABLE_CELL)
+                        continue;
+                    if (rhs[neighbour] == oldG + edgeCost(cell, i)) {
+                        rhs[neighbour] = minSuccessor(neighbour, nullptr);
+                        updateVertex(neighbour);
+                    }
+                }
+                if (cell != goal)
+                    rhs[cell] = minSuccessor(cell, nullptr);
+                updateVertex(cell);
+            }
+        }
+        return rhs[start] < INFINITE_COST;
+    }
+
+    /**
+     * @brief Sigue el camino de menor coste desde la posición actual
+     */
+    void DStarLite::getPath(std::vector<int> &path, int maxLength) const {
+        path.clear();
+        int cell = start;
+        while ((int) path.size() < maxLength) {
+            path.push_back(cell);
+            if (cell == goal)
+                break;
+            int next;
+            if (minSuccessor(cell, &next) >= INFINITE_COST)
+                break;
+            cell = next;
+        }
+    }
+
+    int DStarLite::getPathCost() const {
+        return (rhs[start] < INFINITE_COST) ? rhs[start] : -1;
+    }
+
+    long long DStarLite::getExpansions() const {
+        return expansions;
+    }
+
+    int DStarLite::getWidth() const {
+        return width;
+    }
+
+    int DStarLite::getHeight() const {
+        return height;
+    }
+
+    /**
+     * @brief Distancia octil entre dos celdas (admisible y consistente, ya que el factor de coste es al menos 1)
+     */
+    int DStarLite::heuristic(int from, int to) const {
+        int dx = std::abs(from % width - to % width);
+        int dy = std::abs(from / width - to / width);
+        return STRAIGHT_COST * (dx + dy) + (DIAGONAL_COST - 2 * STRAIGHT_COST) * std::min(dx, dy);
+    }
+
+    // Coste de entrar en una celda desde la vecina en la dirección indicada (impar: diagonal)
+    int DStarLite::edgeCost(int to, int direction) const {
+        return ((direction & 1) ? DIAGONAL_COST : STRAIGHT_COST) * costs[to];
+    }
+
+    // Clave [min(g, rhs) + h + km ; min(g, rhs)], empaquetada para compararse lexicográficamente de una vez
+    uint64_t DStarLite::calculateKey(int cell) const {
+        uint64_t cost = (uint64_t) std::min(g[cell], rhs[cell]);
+        return ((cost + heuristic(start, cell) + km) << 32) | cost;
+    }
+
+    /**
+     * @brief Menor coste de llegar al destino pasando por una vecina (coste a un paso)
+     * @param next Si no es nullptr, se devuelve en él la vecina elegida
+     */
+    int DStarLite::minSuccessor(int cell, int *next) const {
+        int best = INFINITE_COST;
+        int x = cell % width, y = cell / width;
+        for (int i = 0; i < 8; i++) {
+            int nx = x + NEIGHBOUR_X[i], ny = y + NEIGHBOUR_Y[i];
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                continue;
+            int neighbour = ny * width + nx;
+            if (costs[neighbour] == IMPASSABLE_CELL || g[neighbour] >= INFINITE_COST)
+                continue;
+            int cost = g[neighbour] + edgeCost(neighbour, i);
+            if (cost < best) {
+                best = cost;
+                if (next != nullptr)
+                    *next = neighbour;
+            }
+        }
+        return best;
+    }
+
+    // Mete en la cola, actualiza o saca la celda según sea inconsistente o no
+    void DStarLite::updateVertex(int cell) {
+        bool queued = heapIndex[cell] >= 0;
+        if (g[cell] != rhs[cell]) {
+            if (queued)
+                heapUpdate(cell, calculateKey(cell));
+            else
+                heapPush(cell, calculateKey(cell));
+        } else if (queued) {
+            heapRemove(cell);
+        }
+    }
+
+    // Recalcula el coste a un paso de las vecinas de una celda cuyo coste de entrada ha cambiado
+    void DStarLite::updateNeighbours(int cell) {
+        int x = cell % width, y = cell / width;
+        for (int i = 0; i < 8; i++) {
+            int nx = x + NEIGHBOUR_X[i], ny = y + NEIGHBOUR_Y[i];
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                continue;
+            int neighbour = ny * width + nx;
+            if (neighbour == goal)
+                continue;
+            rhs[neighbour] = minSuccessor(neighbour, nullptr);
+            updateVertex(neighbour);
+        }
+    }
+
+    void DStarLite::heapPush(int cell, uint64_t key) {
+        heap.push_back({key, cell});
+        heapIndex[cell] = (int) heap.size() - 1;
+        siftUp((int) heap.size() - 1);
+    }
+
+    void DStarLite::heapRemove(int cell) {
+        int position = heapIndex[cell];
+        int last = (int) heap.size() - 1;
+        if (position != last) {
+            heapSwap(position, last);
+            heap.pop_back();
+            siftUp(position);
+            siftDown(position);
+        } else {
+            heap.pop_back();
+        }
+        heapIndex[cell] = -1;
+    }
+
+    void DStarLite::heapUpdate(int cell, uint64_t key) {
+        int position = heapIndex[cell];
+        heap[position].key = key;
+        siftUp(position);
+        siftDown(position);
+    }
+
+    void DStarLite::siftUp(int position) {
+        while (position > 0) {
+            int parent = (position - 1) / 2;
+            if (heap[parent].key <= heap[position].key)
+                break;
+            heapSwap(parent, position);
+            position = parent;
+        }
+    }
+
+    void DStarLite::siftDown(int position) {
+        int size = (int) heap.size();
+        while (true) {
+            int smallest = position;
+            int left = 2 * position + 1, right = left + 1;
+            if (left < size && heap[left].key < heap[smallest].key)
+                smallest = left;
+            if (right < size && heap[right].key < heap[smallest].key)
+                smallest = right;
+            if (smallest == position)
+                break;
+            heapSwap(smallest, position);
+            position = smallest;
+        }
+    }
+
+    void DStarLite::heapSwap(int a, int b) {
+        std::swap(heap[a], heap[b]);
+        heapIndex[heap[a].cell] = a;
+        heapIndex[heap[b].cell] = b;
+    }
+
+} /* namespace Navigation */
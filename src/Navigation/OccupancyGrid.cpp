@@ -0,0 +1,215 @@
+#include "Navigation/OccupancyGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Modelo inverso del sensor en log-odds de punto fijo
+#define LOG_ODDS_OCCUPIED           20
+#define LOG_ODDS_FREE               -6
+#define LOG_ODDS_MIN                -120
+#define LOG_ODDS_MAX                120
+#define OCCUPIED_THRESHOLD          30
+#define FREE_THRESHOLD              -12
+
+// Grosor, en celdas, del arco que se marca como ocupado
+#define OBSTACLE_THICKNESS_CELLS    2.0f
+
+// Longitud de arco (CM) a partir de la cual el peso de una detección se reparte: el obstáculo está en algún punto
+// del arco, por lo que cuanto más ancho es, menos evidencia aporta cada celda
+#define OCCUPIED_ARC_REFERENCE_CM   10.0f
+
+namespace Navigation {
+
+    /**
+     * @brief El bloque de teselas reservadas no se inicializa: cada tesela se pone a 0 al entregarla, de forma que el
+     * sistema solo aporta las páginas que se llegan a usar
+     */
+    OccupancyGrid::OccupancyGrid(float resolution, int tilesPerSide, int reservedTiles) {
+        this->resolution = resolution;
+        this->tilesPerSide = tilesPerSide;
+        this->cellsPerSide = tilesPerSide * GRID_TILE_SIZE;
+        this->origin = -cellsPerSide * resolution / 2.0f;
+        this->tiles.assign((size_t) tilesPerSide * tilesPerSide, nullptr);
+        this->allocatedTiles = 0;
+        this->reservedTiles = std::max(reservedTiles, 0);
+        this->reserved = new int8_t[(size_t) this->reservedTiles * GRID_TILE_SIZE * GRID_TILE_SIZE];
+    }
+
+    OccupancyGrid::~OccupancyGrid() {
+        int8_t *reservedEnd = reserved + (size_t) reservedTiles * GRID_TILE_SIZE * GRID_TILE_SIZE;
+        for (int8_t *cells : tiles) {
+            if (cells < reserved || cells >= reservedEnd)
+                delete[] cells;
+        }
+        delete[] reserved;
+    }
+
+    int OccupancyGrid::cellIndex(float coordinate) const {
+        return (int) std::floor((coordinate - origin) / resolution);
+    }
+
+    int8_t *OccupancyGrid::tile(int cellX, int cellY, bool allocate) {
+        int8_t *&cells = tiles[(size_t) (cellY >> GRID_TILE_BITS) * tilesPerSide + (cellX >> GRID_TILE_BITS)];
+        if (cells == nullptr && allocate) {
+            if (allocatedTiles < reservedTiles)
+                cells = reserved + (size_t) allocatedTiles * GRID_TILE_SIZE * GRID_TILE_SIZE;
+            else
+                cells = new int8_t[GRID_TILE_SIZE * GRID_TILE_SIZE];
+            std::memset(cells, 0, GRID_TILE_SIZE * GRID_TILE_SIZE);
+            allocatedTiles++;
+        }
+        return cells;
+    }
+
+    const int8_t *OccupancyGrid::tile(int cellX, int cellY) const {
+        return tiles[(size_t) (cellY >> GRID_TILE_BITS) * tilesPerSide + (cellX >> GRID_TILE_BITS)];
+    }
+
+    /**
+     * @brief Suma saturada sobre un tramo de celdas de una fila, tesela a tesela. El bucle interno trabaja sobre
+     * memoria contigua y sin dependencias, por lo que el compilador lo vectoriza
+     */
+    void OccupancyGrid::updateSpan(int y, int x0, int x1, int delta) {
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, cellsPerSide - 1);
+        if (y < 0 || y >= cellsPerSide)
+            return;
+
+        int row = (y & (GRID_TILE_SIZE - 1)) * GRID_TILE_SIZE;
+        for (int x = x0; x <= x1;) {
+            int end = std::min(x1, (x | (GRID_TILE_SIZE - 1)));
+            int8_t *cells = tile(x, y, true) + row + (x & (GRID_TILE_SIZE - 1));
+            int count = end - x + 1;
+            for (int i = 0; i < count; i++) {
+                int value = cells[i] + delta;
+                cells[i] = (int8_t) (value > LOG_ODDS_MAX ? LOG_ODDS_MAX : (value < LOG_ODDS_MIN ? LOG_ODDS_MIN : value));
+            }
+            x = end + 1;
+        }
+    }
+
+    // Restringe el intervalo [lo, hi] de dx a los valores que cumplen a * dx <= b
+    static void constrain(float a, float b, float &lo, float &hi) {
+        if (a > 0)
+            hi = std::min(hi, b / a);
+        else if (a < 0)
+            lo = std::max(lo, b / a);
+        else if (b < 0)
+            hi = lo - 1;   // Ningún valor cumple la restricción
+    }
+
+    /**
+     * @brief Actualiza el cono del haz: celdas libres hasta la distancia medida y ocupadas en el arco de esa distancia
+     */
+    void OccupancyGrid::integrate(const Pose &sensor, float range, float halfAngle, float maxRange) {
+        if (range < 0)
+            return;
+        bool hit = range < maxRange;
+        range = std::min(range, maxRange);
+        float thickness = OBSTACLE_THICKNESS_CELLS * resolution;
+        float freeRadius = std::max(0.0f, range - thickness / 2.0f);
+        float outerRadius = hit ? range + thickness / 2.0f : freeRadius;
+        float arc = 2.0f * halfAngle * range;
+        int occupied = (int) std::lround(LOG_ODDS_OCCUPIED * std::fmin(1.0f, OCCUPIED_ARC_REFERENCE_CM / std::fmax(arc, 1.0f)));
+        occupied = std::max(occupied, 1);
+
+        // Bordes del haz (derecho e izquierdo)
+        float rightX = std::cos(sensor.heading - halfAngle), rightY = std::sin(sensor.heading - halfAngle);
+        float leftX = std::cos(sensor.heading + halfAngle), leftY = std::sin(sensor.heading + halfAngle);
+
+        int firstRow = cellIndex(sensor.y - outerRadius), lastRow = cellIndex(sensor.y + outerRadius);
+        for (int row = firstRow; row <= lastRow; row++) {
+            float dy = origin + (row + 0.5f) * resolution - sensor.y;
+            if (std::fabs(dy) > outerRadius)
+                continue;
+
+            // Intervalo de dx dentro de la cuña del haz: a la izquierda del borde derecho y a la derecha del izquierdo
+            float lo = -outerRadius, hi = outerRadius;
+            constrain(rightY, rightX * dy, lo, hi);
+            constrain(-leftY, -leftX * dy, lo, hi);
+            if (lo > hi)
+                continue;
+
+            // Intersección con los círculos libre y exterior
+            float outerHalf = std::sqrt(outerRadius * outerRadius - dy * dy);
+            float outerLo = std::max(lo, -outerHalf), outerHi = std::min(hi, outerHalf);
+            if (outerLo > outerHi)
+                continue;
+            int outer0 = (int) std::ceil((sensor.x + outerLo - origin) / resolution - 0.5f);
+            int outer1 = (int) std::floor((sensor.x + outerHi - origin) / resolution - 0.5f);
+
+            int free0 = outer1 + 1, free1 = outer1;
+            if (std::fabs(dy) <= freeRadius) {
+                float freeHalf = std::sqrt(freeRadius * freeRadius - dy * dy);
+                float freeLo = std::max(lo, -freeHalf), freeHi = std::min(hi, freeHalf);
+                if (freeLo <= freeHi) {
+                    free0 = (int) std::ceil((sensor.x + freeLo - origin) / resolution - 0.5f);
+                    free1 = (int) std::floor((sensor.x + freeHi - origin) / resolution - 0.5f);
+                }
+            }
+
+            if (free0 <= free1) {
+                updateSpan(row, free0, free1, LOG_ODDS_FREE);
+                if (hit) {
+                    updateSpan(row, outer0, free0 - 1, occupied);
+                    updateSpan(row, free1 + 1, outer1, occupied);
+                }
+            } else if (hit) {
+                updateSpan(row, outer0, outer1, occupied);
+            }
+        }
+    }
+
+    int8_t OccupancyGrid::getCell(float x, float y) const {
+        int cellX = cellIndex(x), cellY = cellIndex(y);
+        if (cellX < 0 || cellY < 0 || cellX >= cellsPerSide || cellY >= cellsPerSide)
+            return 0;
+        const int8_t *cells = tile(cellX, cellY);
+        if (cells == nullptr)
+            return 0;
+        return cells[(cellY & (GRID_TILE_SIZE - 1)) * GRID_TILE_SIZE + (cellX & (GRID_TILE_SIZE - 1))];
+    }
+
+    bool OccupancyGrid::isOccupied(float x, float y) const {
+        return getCell(x, y) >= OCCUPIED_THRESHOLD;
+    }
+
+    bool OccupancyGrid::isFree(float x, float y) const {
+        return getCell(x, y) <= FREE_THRESHOLD;
+    }
+
+    /**
+     * @brief Recorre el rayo en pasos de media celda hasta encontrar una celda ocupada o desconocida
+     */
+    float OccupancyGrid::freeDistance(float x, float y, float angle, float maxRange, bool *blocked) const {
+        float dx = std::cos(angle), dy = std::sin(angle);
+        float step = resolution / 2.0f;
+        float distance = 0;
+        if (blocked != nullptr)
+            *blocked = false;
+        for (; distance < maxRange; distance += step) {
+            int8_t value = getCell(x + dx * distance, y + dy * distance);
+            if (value >= OCCUPIED_THRESHOLD) {
+                if (blocked != nullptr)
+                    *blocked = true;
+                return distance;
+            }
+            if (value > FREE_THRESHOLD && distance > resolution)
+                return distance;
+        }
+        return maxRange;
+    }
+
+    float OccupancyGrid::getResolution() const {
+        return resolution;
+    }
+
+    int OccupancyGrid::getAllocatedTiles() const {
+        return allocatedTiles;
+    }
+
+    size_t OccupancyGrid::getMemoryUsage() const {
+        return sizeof(*this) + tiles.size() * sizeof(int8_t *) + (size_t) allocatedTiles * GRID_TILE_SIZE * GRID_TILE_SIZE;
+    }
+
+} /* namespace Navigation */
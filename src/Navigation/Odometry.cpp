@@ -0,0 +1,48 @@
+#include "Navigation/Odometry.h"
+#include "RoboCar/Geometry.h"
+#include <cmath>
+
+namespace Navigation {
+
+    Odometry::Odometry() {
+        reset({0, 0, 0});
+    }
+
+    void Odometry::reset(Pose pose) {
+        this->pose = pose;
+        this->travelled = 0;
+    }
+
+    /**
+     * @brief Integración exacta del movimiento de un coche diferencial cuyas ruedas recorren las distancias indicadas
+     * en proporción constante (arco de circunferencia)
+     * @param left, right Tacos de cada rueda desde la actualización anterior, negativos hacia atrás
+     */
+    void Odometry::addTicks(float left, float right) {
+        if (left == 0 && right == 0)
+            return;
+        float leftDistance = left * CM_PER_TICK, rightDistance = right * CM_PER_TICK;
+        float linear = (leftDistance + rightDistance) / 2.0f;
+        float rotation = (rightDistance - leftDistance) / WHEEL_TRACK_CM;
+
+        if (std::fabs(rotation) < 1e-6f) {
+            pose.x += linear * std::cos(pose.heading);
+            pose.y += linear * std::sin(pose.heading);
+        } else {
+            float radius = linear / rotation;
+            pose.x += radius * (std::sin(pose.heading + rotation) - std::sin(pose.heading));
+            pose.y -= radius * (std::cos(pose.heading + rotation) - std::cos(pose.heading));
+        }
+        pose.heading = std::remainder(pose.heading + rotation, 2.0f * (float) M_PI);
+        travelled += std::fabs(linear);
+    }
+
+    Pose Odometry::getPose() const {
+        return pose;
+    }
+
+    double Odometry::getTravelled() const {
+        return travelled;
+    }
+
+} /* namespace Navigation */
@@ -0,0 +1,87 @@
+#include "PinsLib/Backend.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace PinsLib {
+
+    static SysfsBackend sysfsBackend;
+    static Backend *currentBackend = &sysfsBackend;
+    static thread_local Backend *threadBackend = nullptr;
+
+    Backend *Backend::get() {
+        return (threadBackend != nullptr) ? threadBackend : currentBackend;
+    }
+
+    void Backend::set(Backend *backend) {
+        currentBackend = (backend != nullptr) ? backend : &sysfsBackend;
+    }
+
+    void Backend::setForThread(Backend *backend) {
+        threadBackend = backend;
+    }
+
+    SysfsBackend::SysfsBackend(const string &root) {
+        this->root = root;
+    }
+
+    /**
+     * @brief Ruta completa de un fichero de control en un buffer fijo, sin reservar memoria
+     * @return false si la ruta no cabe en el buffer
+     */
+    static bool joinPath(char (&buffer)[SYSFS_PATH_MAX], const string &root, const string &path,
+                         const string &filename) {
+        size_t length = root.size() + path.size() + filename.size();
+        if (length >= SYSFS_PATH_MAX)
+            return false;
+        memcpy(buffer, root.data(), root.size());
+        memcpy(buffer + root.size(), path.data(), path.size());
+        memcpy(buffer + root.size() + path.size(), filename.data(), filename.size());
+        buffer[length] = '\0';
+        return true;
+    }
+
+    /**
+     * @brief Se escribe directamente sobre el descriptor, sin flujos ni concatenaciones: el control de los motores y
+     * de los sensores no reserva memoria
+     */
+    int SysfsBackend::write(const string &path, const string &filename, const string &value) {
+        char file[SYSFS_PATH_MAX];
+        int fd = joinPath(file, root, path, filename) ? open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+        if (fd < 0) {
+            perror("PinsLib: write failed to open file ");
+            return -1;
+        }
+        ssize_t written = ::write(fd, value.data(), value.size());
+        close(fd);
+        return (written == (ssize_t) value.size()) ? 0 : -1;
+    }
+
+    /**
+     * @brief Se lee la primera línea del fichero en un buffer fijo. Los valores de los ficheros de control caben en una
+     * cadena sin memoria dinámica
+     */
+    string SysfsBackend::read(const string &path, const string &filename) {
+        char file[SYSFS_PATH_MAX];
+        int fd = joinPath(file, root, path, filename) ? open(file, O_RDONLY | O_CLOEXEC) : -1;
+        if (fd < 0) {
+            perror("PinsLib: read failed to open file ");
+            return string();
+        }
+        char value[SYSFS_VALUE_MAX];
+        ssize_t length = ::read(fd, value, sizeof(value));
+        close(fd);
+        if (length <= 0)
+            return string();
+        const char *end = (const char *) memchr(value, '\n', length);
+        return string(value, (end != nullptr) ? end - value : length);
+    }
+
+    string SysfsBackend::locate(const string &path, const string &filename) {
+        return root + path + filename;
+    }
+
+} /* namespace PinsLib */
@@ -0,0 +1,66 @@
+#include "PinsLib/Clock.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace PinsLib {
+
+    static SystemClock systemClock;
+    static Clock *currentClock = &systemClock;
+    static thread_local Clock *threadClock = nullptr;
+
+    Clock *Clock::get() {
+        return (threadClock != nullptr) ? threadClock : currentClock;
+    }
+
+    void Clock::set(Clock *clock) {
+        currentClock = (clock != nullptr) ? clock : &systemClock;
+    }
+
+    void Clock::setForThread(Clock *clock) {
+        threadClock = clock;
+    }
+
+    long long SystemClock::now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long) ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+    }
+
+    void SystemClock::sleep(long long ums) {
+        if (ums > 0)
+            usleep(ums);
+    }
+
+    void SystemClock::sleepUntil(long long time) {
+        // Espera absoluta: no acumula el retraso de quien la invoca y se reanuda si la interrumpe una señal
+        struct timespec ts;
+        ts.tv_sec = time / 1000000LL;
+        ts.tv_nsec = (time % 1000000LL) * 1000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+    }
+
+    VirtualClock::VirtualClock(long long start) {
+        this->time = start;
+    }
+
+    long long VirtualClock::now() {
+        return time;
+    }
+
+    void VirtualClock::sleep(long long ums) {
+        if (ums > 0)
+            time += ums;
+    }
+
+    void VirtualClock::sleepUntil(long long time) {
+        if (time > this->time)
+            this->time = time;
+    }
+
+    void VirtualClock::advance(long long ums) {
+        if (ums > 0)
+            time += ums;
+    }
+
+} /* namespace PinsLib */
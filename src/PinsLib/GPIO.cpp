@@ -121,10 +121,13 @@ namespace PinsLib {
     }
 
     int GPIO::streamOpen(){
-        stream.open((path + "value").c_str());
-        return 0;
+        string file = backend->locate(path, "value");
+        if (file.empty()) return 0; // backend without files: streamWrite falls back to write()
+        stream.open(file.c_str());
+        return stream.is_open() ? 0 : -1;
     }
     int GPIO::streamWrite(GPIO_VALUE value){
+        if (!stream.is_open()) return this->setValue(value);
         stream << value << std::flush;
         return 0;
     }
@@ -223,6 +226,10 @@ namespace PinsLib {
         return 0;
     }
 
+    long long GPIO::nextEdge() {
+        return this->backend->nextChange(this->path, "value");
+    }
+
     GPIO::~GPIO() {
         this->unexportPin();
     }
@@ -10,9 +10,6 @@
 
 using namespace std;
 
-#define PWM_PATH            "/sys/class/pwm/"
-#define PWM_EXPORT_PATH     PWM_PATH"pwmchip2/"
-
 #define PERIOD_FILENAME     "period"
 #define DUTYCYCLE_FILENAME  "duty_cycle"
 #define ENABLE_FILENAME     "enable"
@@ -1,68 +1,70 @@
 #include "PinsLib/Pins.h"
-#include <sstream>
-#include <unistd.h>
+#include "PinsLib/Clock.h"
+#include <charconv>
 
 using namespace std;
 
 namespace PinsLib {
 
+    // Operaciones sobre los ficheros de control de cada hilo: cada coche de una flota simulada usa los pines desde su
+    // propio hilo, y así el recuento no se comparte entre núcleos
+    static thread_local long long operations = 0;
+
     Pins::Pins(int number, string exportPath) {
         this->number = number;
         this->exportPath = exportPath;
+        this->backend = Backend::get();
 
         // Exportamos el pin creado
         this->exportPin();
         
         // need to give Linux time to set up the sysfs structure
-        usleep(250000); // 250ms delay
+        Clock::get()->sleep(250000); // 250ms delay
     }
 
     Pins::~Pins() {
         this->unexportPin();
     }
 
-    int Pins::write(string path, string filename, string value) {
-        ofstream fs;
-        fs.open((path + filename).c_str());
-        if (!fs.is_open()) {
-            perror("PinsLib: write failed to open file ");
-            return -1;
-        }
-        fs << value;
-        fs.close();
-        return 0;
+    int Pins::write(const string &path, const string &filename, const string &value) {
+        operations++;
+        return backend->write(path, filename, value);
     }
 
-    int Pins::write(string path, string filename, int value) {
-        stringstream s;
-        s << value;
-        return this->write(path, filename, s.str());
+    /**
+     * @brief El número se convierte en un buffer fijo: cabe en una cadena sin memoria dinámica
+     */
+    int Pins::write(const string &path, const string &filename, int value) {
+        char buffer[16];
+        std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return this->write(path, filename, string(buffer, result.ptr));
     }
 
-    int Pins::write(string filename, string value) {
+    int Pins::write(const string &filename, const string &value) {
         return this->write(path, filename, value);
     }
 
-    int Pins::write(string filename, int value) {
+    int Pins::write(const string &filename, int value) {
         return this->write(path, filename, value);
     }
 
-    string Pins::read(string path, string filename) {
-        ifstream fs;
-        fs.open((path + filename).c_str());
-        if (!fs.is_open()) {
-            perror("PinsLib: read failed to open file ");
-        }
-        string input;
-        getline(fs, input);
-        fs.close();
-        return input;
+    string Pins::read(const string &path, const string &filename) {
+        operations++;
+        return backend->read(path, filename);
     }
 
-    string Pins::read(string filename) {
+    string Pins::read(const string &filename) {
         return read(path, filename);
     }
 
+    long long Pins::getOperations() {
+        return operations;
+    }
+
+    string Pins::locate(const string &filename) {
+        return backend->locate(path, filename);
+    }
+
     int Pins::exportPin() {
         // Desexportamos previamente el pin para evitar posibles fallos
         this->write(exportPath, "unexport", this->number);
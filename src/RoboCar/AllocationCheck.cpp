@@ -0,0 +1,154 @@
+#include "RoboCar/AllocationCheck.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef ALLOCATION_CHECK
+#include <cerrno>
+#include <execinfo.h>
+#include <unistd.h>
+
+// Llamadas de la pila que se muestran al detectar una reserva
+#define ALLOCATION_BACKTRACE_FRAMES     32
+
+// Funciones de reserva de glibc, a las que se delega tras comprobar la región
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+}
+#endif
+
+namespace RoboCar {
+
+    static thread_local const char *currentRegion = nullptr;
+    static std::atomic<long long> regionCount(0);
+
+    AllocationFreeRegion::AllocationFreeRegion(const char *name) {
+        previous = currentRegion;
+        if (name == nullptr)
+            return;
+        currentRegion = name;
+        regionCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    AllocationFreeRegion::~AllocationFreeRegion() {
+        currentRegion = previous;
+    }
+
+    long long AllocationFreeRegion::getCount() {
+        return regionCount.load(std::memory_order_relaxed);
+    }
+
+    const char *AllocationFreeRegion::getCurrent() {
+        return currentRegion;
+    }
+
+    void AllocationFreeRegion::setCurrent(const char *name) {
+        currentRegion = name;
+    }
+
+#ifdef ALLOCATION_CHECK
+    /**
+     * @brief Reserva dentro de una región: se indica la región y la pila (direcciones que se pueden traducir con
+     * addr2line) y se aborta. Lo que se hace a partir de aquí ya puede reservar memoria (backtrace carga libgcc)
+     */
+    static void allocationFailure(size_t size) {
+        const char *region = currentRegion;
+        currentRegion = nullptr;
+        char message[256];
+        int length = snprintf(message, sizeof(message), "Reserva de %zu bytes en la region sin reservas \"%s\"\n",
+                              size, region);
+        if (::write(STDERR_FILENO, message, length) < 0)
+            abort();
+        void *frames[ALLOCATION_BACKTRACE_FRAMES];
+        int count = backtrace(frames, ALLOCATION_BACKTRACE_FRAMES);
+        backtrace_symbols_fd(frames, count, STDERR_FILENO);
+        abort();
+    }
+
+    static inline void checkAllocation(size_t size) {
+        if (currentRegion != nullptr)
+            allocationFailure(size);
+    }
+
+    // Resumen al terminar, para confirmar que se han comprobado las regiones
+    static struct AllocationReport {
+        ~AllocationReport() {
+            fprintf(stderr, "Comprobacion de reservas: %lld ejecuciones de regiones sin reservas\n",
+                    AllocationFreeRegion::getCount());
+        }
+    } allocationReport;
+#endif
+
+} /* namespace RoboCar */
+
+#ifdef ALLOCATION_CHECK
+// Sustitutos de las funciones de reserva de la biblioteca de C, que también usan las de C++ (operator new, los
+// contenedores, los flujos...)
+extern "C" {
+
+    void *malloc(size_t size) {
+        RoboCar::checkAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size) {
+        RoboCar::checkAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *pointer, size_t size) {
+        RoboCar::checkAllocation(size);
+        return __libc_realloc(pointer, size);
+    }
+
+    void *memalign(size_t alignment, size_t size) {
+        RoboCar::checkAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size) {
+        RoboCar::checkAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **pointer, size_t alignment, size_t size) {
+        RoboCar::checkAllocation(size);
+        *pointer = __libc_memalign(alignment, size);
+        return (*pointer != nullptr) ? 0 : ENOMEM;
+    }
+
+}
+
+// operator new se sustituye también, para que la reserva se vea en la pila aunque la biblioteca de C++ se enlace de
+// forma estática
+void *operator new(size_t size) {
+    void *pointer = malloc(size);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    free(pointer);
+}
+#endif
@@ -0,0 +1,88 @@
+#include "RoboCar/BatteryMonitor.h"
+#include "PinsLib/Backend.h"
+#include "PinsLib/Clock.h"
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+namespace RoboCar {
+
+    static BatteryMonitor *activeMonitor = nullptr;
+
+    BatteryMonitor *BatteryMonitor::get() {
+        return activeMonitor;
+    }
+
+    void BatteryMonitor::set(BatteryMonitor *monitor) {
+        activeMonitor = monitor;
+    }
+
+    /**
+     * @param device Directorio del dispositivo IIO (terminado en '/')
+     */
+    BatteryMonitor::BatteryMonitor(const std::string &device) {
+        this->device = device;
+        this->scale = BATTERY_ADC_MV_PER_LSB / 1000.0f * BATTERY_DIVIDER;
+        this->voltage = -1;
+        this->lastSample = 0;
+    }
+
+    /**
+     * @brief Lee la escala del canal (si el dispositivo la publica) y toma la primera lectura, que inicializa el filtro.
+     * Las lecturas pasan por el backend de los pines, por lo que en simulación la tensión la proporciona el simulador
+     * @return true si se ha obtenido una tensión válida, false en caso contrario
+     */
+    bool BatteryMonitor::open() {
+        PinsLib::Backend *backend = PinsLib::Backend::get();
+        std::string file = backend->locate(device, BATTERY_IIO_SCALE);
+        if (file.empty() || access(file.c_str(), R_OK) == 0) {
+            float millivolts = std::strtof(backend->read(device, BATTERY_IIO_SCALE).c_str(), nullptr);
+            if (millivolts > 0)
+                scale = millivolts / 1000.0f * BATTERY_DIVIDER;
+        }
+
+        voltage = readVoltage();
+        lastSample = PinsLib::Clock::get()->now();
+        if (voltage <= 0) {
+            std::cerr << "No se pudo leer la tension de la bateria en " << device << BATTERY_IIO_RAW << std::endl;
+            voltage = -1;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Tensión de la batería filtrada. Si ha pasado el periodo de muestreo se toma una lectura y se integra con
+     * un filtro paso bajo de primer orden (alfa = dt / (tau + dt)). Las lecturas erróneas se descartan
+     * @return Tensión en V, -1 si todavía no hay ninguna lectura válida
+     */
+    float BatteryMonitor::getVoltage() {
+        long long now = PinsLib::Clock::get()->now();
+        if (now - lastSample < BATTERY_SAMPLE_PERIOD_UMS)
+            return voltage;
+
+        float sample = readVoltage();
+        if (sample <= 0) {
+            lastSample = now;
+            return voltage;
+        }
+        if (voltage <= 0) {
+            voltage = sample;
+        } else {
+            float dt = (float) (now - lastSample);
+            voltage += (sample - voltage) * dt / (BATTERY_FILTER_UMS + dt);
+        }
+        lastSample = now;
+        return voltage;
+    }
+
+    float BatteryMonitor::readVoltage() {
+        std::string raw = PinsLib::Backend::get()->read(device, BATTERY_IIO_RAW);
+        char *end;
+        long value = std::strtol(raw.c_str(), &end, 10);
+        if (end == raw.c_str() || value <= 0)
+            return -1;
+        return (float) value * scale;
+    }
+
+} /* namespace RoboCar */
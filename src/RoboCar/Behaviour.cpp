@@ -0,0 +1,177 @@
+#include "RoboCar/Behaviour.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RoboCar {
+
+    RangeWindow::RangeWindow() {
+        clear();
+    }
+
+    void RangeWindow::add(float range) {
+        ranges[next] = range;
+        next = (next + 1) % BEHAVIOUR_RANGE_WINDOW;
+        count = std::min(count + 1, BEHAVIOUR_RANGE_WINDOW);
+    }
+
+    void RangeWindow::clear() {
+        count = 0;
+        next = 0;
+    }
+
+    bool RangeWindow::isFull() const {
+        return count == BEHAVIOUR_RANGE_WINDOW;
+    }
+
+    float RangeWindow::getRange() const {
+        float valid[BEHAVIOUR_RANGE_WINDOW];
+        int validCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (ranges[i] != -1)
+                valid[validCount++] = ranges[i];
+        }
+        if (validCount == 0)
+            return -1;
+        std::sort(valid, valid + validCount);
+        return valid[validCount / 2];
+    }
+
+    Arbiter::Arbiter() {
+        this->count = 0;
+        this->winner = -1;
+        this->ticks = 0;
+        this->switches = 0;
+        this->idle = 0;
+    }
+
+    bool Arbiter::add(Behaviour *behaviour) {
+        if (count == ARBITER_MAX_BEHAVIOURS)
+            return false;
+        behaviours[count] = behaviour;
+        wins[count] = 0;
+        count++;
+        return true;
+    }
+
+    /**
+     * @brief Se consultan todos los comportamientos (aunque pierdan, siguen viendo cada ciclo para mantener su estado)
+     * y se mezclan las propuestas de la mayor prioridad. Sin reservas de memoria: las propuestas van en la pila
+     */
+    bool Arbiter::arbitrate(const BehaviourInputs &inputs, MotionCommand &command) {
+        Proposal proposals[ARBITER_MAX_BEHAVIOURS];
+        bool active[ARBITER_MAX_BEHAVIOURS];
+        bool any = false;
+        int priority = 0;
+        for (int i = 0; i < count; i++) {
+            active[i] = behaviours[i]->propose(inputs, proposals[i]);
+            if (active[i] && (!any || proposals[i].priority > priority)) {
+                priority = proposals[i].priority;
+                any = true;
+            }
+        }
+        ticks++;
+
+        int best = -1;
+        float left = 0, right = 0, total = 0;
+        for (int i = 0; any && i < count; i++) {
+            if (!active[i] || proposals[i].priority != priority)
+                continue;
+            float weight = std::max(proposals[i].weight, 0.0f);
+            left += proposals[i].command.left * weight;
+            right += proposals[i].command.right * weight;
+            total += weight;
+            if (best < 0 || weight > proposals[best].weight)
+                best = i;
+        }
+        if (best >= 0 && total > 0) {
+            command.left = (int) std::lround(left / total);
+            command.right = (int) std::lround(right / total);
+        } else if (best >= 0) {
+            command = proposals[best].command;
+        } else {
+            command = {0, 0};
+            idle++;
+        }
+
+        if (best != winner)
+            switches++;
+        winner = best;
+        if (best >= 0)
+            wins[best]++;
+        return best >= 0;
+    }
+
+    Behaviour *Arbiter::getWinner() const {
+        return (winner >= 0) ? behaviours[winner] : nullptr;
+    }
+
+    void Arbiter::printReport(std::ostream &out) const {
+        out << "Arbitraje: " << ticks << " ciclos, " << switches << " cambios de comportamiento" << std::endl;
+        if (ticks == 0)
+            return;
+        for (int i = 0; i < count; i++)
+            out << "  " << behaviours[i]->getName() << ": " << 100.0 * wins[i] / ticks << "% de los ciclos" << std::endl;
+        if (idle > 0)
+            out << "  (ninguno): " << 100.0 * idle / ticks << "% de los ciclos" << std::endl;
+    }
+
+    MotionOutput::MotionOutput(RoboCar *car) {
+        this->car = car;
+        this->applied = {0, 0};
+        this->appliedLeft = 0;
+        this->appliedRight = 0;
+    }
+
+    static int sign(int value) {
+        return (value > 0) - (value < 0);
+    }
+
+    /**
+     * @brief Igual que las órdenes de velocidad de la teleoperación: las ruedas paradas o en sentidos distintos
+     * se traducen en las maniobras equivalentes del coche
+     */
+    void MotionOutput::apply(const MotionCommand &command) {
+        if (command.left == 0 && command.right == 0) {
+            if (applied.left != 0 || applied.right != 0)
+                car->stop();
+            applied = command;
+            return;
+        }
+
+        auto clamp = [this](int speed) {
+            return std::max(car->getMinSpeed(), std::min(car->getMaxSpeed(), std::abs(speed)));
+        };
+        int leftSpeed = clamp(command.left), rightSpeed = clamp(command.right);
+        if (leftSpeed != appliedLeft || rightSpeed != appliedRight) {
+            car->setWheelSpeeds(leftSpeed, rightSpeed);
+            appliedLeft = leftSpeed;
+            appliedRight = rightSpeed;
+        }
+
+        bool changed = sign(command.left) != sign(applied.left) || sign(command.right) != sign(applied.right);
+        applied = command;
+        if (!changed)
+            return;
+        if (command.left > 0 && command.right > 0)
+            car->goForward();
+        else if (command.left < 0 && command.right < 0)
+            car->goBackward();
+        else if (command.left < 0 && command.right > 0)
+            car->rotateLeft();
+        else if (command.left > 0 && command.right < 0)
+            car->rotateRight();
+        else if (command.right == 0)
+            (command.left > 0) ? car->goRight() : car->goBackRight();
+        else
+            (command.right > 0) ? car->goLeft() : car->goBackLeft();
+    }
+
+    const MotionCommand &MotionOutput::getApplied() const {
+        return applied;
+    }
+
+    bool MotionOutput::isForward() const {
+        return applied.left > 0 && applied.right > 0;
+    }
+
+} /* namespace RoboCar */
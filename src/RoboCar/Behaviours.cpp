@@ -0,0 +1,552 @@
+#include "RoboCar/Behaviours.h"
+#include "RoboCar/Geometry.h"
+#include "RoboCar/Logger.h"
+#include "Navigation/OccupancyGrid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RoboCar {
+
+    CruiseBehaviour::CruiseBehaviour(int speed) {
+        this->speed = speed;
+    }
+
+    const char *CruiseBehaviour::getName() const {
+        return "avance";
+    }
+
+    bool CruiseBehaviour::propose(const BehaviourInputs &/*inputs*/, Proposal &proposal) {
+        proposal = {{speed, speed}, PRIORITY_CRUISE, 1.0f};
+        return true;
+    }
+
+    void CruiseBehaviour::setSpeed(int speed) {
+        this->speed = speed;
+    }
+
+    ObstacleAvoidBehaviour::ObstacleAvoidBehaviour(RoboCar *car, int limitDistance, int scanArc) {
+        this->car = car;
+        this->limitDistance = (float) limitDistance;
+        this->scanArc = std::min(scanArc, 360) * (float) M_PI / 180.0f;
+        this->lastSequence = -1;
+        this->active = false;
+        this->start = 0;
+        this->reference = 0;
+        this->lastEncoders = 0;
+        this->rotation = 0;
+        this->turned = 0;
+        this->attempts = 0;
+        this->sidesTried = false;
+        this->stepCount = 0;
+        this->stepIndex = 0;
+        this->stepStart = 0;
+        this->stepTurned = 0;
+        this->sweepOrigin = 0;
+        this->sweepEncoders = 0;
+        this->progressRange = -1;
+        this->progressTicks = 0;
+        this->progressSteer = 0;
+        this->coast = AVOID_TURN_COAST;
+        this->coasting = false;
+        this->detections = 0;
+        this->escapes = 0;
+        this->failures = 0;
+        std::fill(profile, profile + AVOID_SCAN_SECTORS, -1.0f);
+    }
+
+    const char *ObstacleAvoidBehaviour::getName() const {
+        return "evasion";
+    }
+
+    bool ObstacleAvoidBehaviour::blocked(float range) const {
+        return range == -1 || range < limitDistance;
+    }
+
+    /**
+     * @brief Mientras no hay obstáculo solo se filtran las medidas (salvo una muy cercana, p.e: otro coche que se
+     * acerca de frente, que no espera a la mediana) y se comprueba que el coche no esté atascado. Durante la evasión,
+     * cada ciclo avanza el paso en curso y, al terminar todos, se planifican los siguientes según lo medido. Girando
+     * sobre sí mismo, la orientación cambia en la suma de los tacos de ambas ruedas entre la vía; tras un giro, también
+     * cuentan los tacos de la inercia hasta que el coche se detiene, y los medidos se descuentan del giro siguiente
+     */
+    bool ObstacleAvoidBehaviour::propose(const BehaviourInputs &inputs, Proposal &proposal) {
+        bool fresh = inputs.rangeSequence != lastSequence;
+        lastSequence = inputs.rangeSequence;
+        if (fresh)
+            window.add(inputs.range);
+        float encoders = inputs.leftEncoder + inputs.rightEncoder;
+        float delta = rotation * (encoders - lastEncoders) * CM_PER_TICK / WHEEL_TRACK_CM;
+        lastEncoders = encoders;
+        turned += delta;
+        stepTurned += delta;
+
+        if (!active) {
+            bool imminent = fresh && inputs.range != -1 && inputs.range < limitDistance / 2.0f;
+            bool stalled = fresh && !imminent && window.isFull() && !blocked(window.getRange()) && stuck(inputs);
+            if (!imminent && !stalled && (!window.isFull() || !blocked(window.getRange())))
+                return false;
+            if (stalled)
+                LOG_INFO("El coche no avanza. Buscando otra direccion...");
+            trigger(inputs);
+        }
+        if (inputs.time - start > AVOID_TIMEOUT_UMS) {
+            finish(false);
+            return false;
+        }
+
+        int speed = std::max(car->getMinSpeed(), AVOID_SPEED);
+        for (;;) {
+            if (stepIndex == stepCount) {
+                plan(inputs);
+                if (!active)
+                    return false;
+            }
+            const Step &step = steps[stepIndex];
+            MotionCommand command = {0, 0};
+            bool done = false;
+            switch (step.type) {
+                case SETTLE_STEP:
+                    done = inputs.time - stepStart >= AVOID_SETTLE_UMS;
+                    break;
+                case REVERSE_STEP:
+                    command = {-speed, -speed};
+                    rotation = 0;
+                    done = inputs.time - stepStart >= AVOID_REVERSE_UMS;
+                    break;
+                case TURN_STEP:
+                    command = (step.value > 0) ? MotionCommand{-speed, speed} : MotionCommand{speed, -speed};
+                    rotation = (step.value > 0) ? 1 : -1;
+                    done = std::fabs(stepTurned) >= std::fabs(step.value) - coast ||
+                           inputs.time - stepStart >= BEHAVIOUR_TURN_TIMEOUT_UMS;
+                    break;
+                case SWEEP_STEP: {
+                    // Cada medida se etiqueta con la orientación a mitad de ella, respecto al inicio del barrido. Las
+                    // que empezaron antes del barrido se descartan
+                    float sector = 2.0f * (float) M_PI / AVOID_SCAN_SECTORS;
+                    float swept = turned - sweepOrigin;
+                    float tag = (inputs.rangeEncoders - sweepEncoders) * CM_PER_TICK / WHEEL_TRACK_CM;
+                    if (fresh && inputs.range != -1 && tag >= 0) {
+                        int index = std::min(AVOID_SCAN_SECTORS - 1, (int) (std::fmod(tag, 2.0f * (float) M_PI) / sector));
+                        profile[index] = (profile[index] < 0) ? inputs.range : std::min(profile[index], inputs.range);
+                    }
+                    command = {-speed, speed};
+                    rotation = 1;
+                    done = swept >= step.value || inputs.time - stepStart >= BEHAVIOUR_TURN_TIMEOUT_UMS;
+                    break;
+                }
+                case MEASURE_STEP:
+                    done = window.isFull();
+                    break;
+            }
+            if (!done) {
+                proposal = {command, PRIORITY_AVOID, 1.0f};
+                return true;
+            }
+            // El giro por inercia tras detener un giro se mide en el paso parado siguiente
+            if (step.type == TURN_STEP || step.type == SWEEP_STEP) {
+                coasting = true;
+            } else {
+                if (coasting && step.type != REVERSE_STEP)
+                    coast = std::fabs(stepTurned);
+                coasting = false;
+            }
+            stepIndex++;
+            if (stepIndex < stepCount)
+                beginStep(inputs);
+        }
+    }
+
+    /**
+     * @brief Avanzando, la distancia hacia delante baja lo mismo que se avanza (menos cuanto más oblicua sea la pared).
+     * Si la odometría indica que se han recorrido AVOID_STUCK_CM casi en línea recta y la distancia filtrada no ha
+     * bajado ni la cuarta parte, el coche está empujando contra algo que el sensor no ve (p.e: otro coche a un lado,
+     * fuera del haz) y las ruedas patinan. Si ha girado, la distancia es a otro obstáculo y no se compara
+     */
+    bool ObstacleAvoidBehaviour::stuck(const BehaviourInputs &inputs) {
+        float ticks = (inputs.leftTicks + inputs.rightTicks) / 2.0f;
+        float steer = inputs.leftTicks - inputs.rightTicks;
+        float range = window.getRange();
+        float advanced = (ticks - progressTicks) * CM_PER_TICK;
+        if (progressRange < 0 || range == -1 || advanced < 0) {
+            progressRange = range;
+            progressTicks = ticks;
+            progressSteer = steer;
+            return false;
+        }
+        if (advanced < AVOID_STUCK_CM)
+            return false;
+        float turned = std::fabs(steer - progressSteer) * CM_PER_TICK / WHEEL_TRACK_CM;
+        bool stalled = turned < AVOID_STUCK_TURN && progressRange - range < advanced / 4.0f;
+        progressRange = range;
+        progressTicks = ticks;
+        progressSteer = steer;
+        return stalled;
+    }
+
+    void ObstacleAvoidBehaviour::trigger(const BehaviourInputs &inputs) {
+        LOG_INFO("Obstaculo detectado a {} CM", window.getRange());
+        detections++;
+        active = true;
+        start = inputs.time;
+        reference = inputs.pose.heading;
+        lastEncoders = inputs.leftEncoder + inputs.rightEncoder;
+        rotation = 0;
+        turned = 0;
+        attempts = 0;
+        sidesTried = false;
+        stepCount = 0;
+        stepIndex = 0;
+    }
+
+    bool ObstacleAvoidBehaviour::isActive() const {
+        return active;
+    }
+
+    void ObstacleAvoidBehaviour::setLimitDistance(int limitDistance) {
+        this->limitDistance = (float) limitDistance;
+    }
+
+    long long ObstacleAvoidBehaviour::getEscapes() const {
+        return escapes;
+    }
+
+    long long ObstacleAvoidBehaviour::getDetections() const {
+        return detections;
+    }
+
+    long long ObstacleAvoidBehaviour::getFailures() const {
+        return failures;
+    }
+
+    void ObstacleAvoidBehaviour::push(StepType type, float value) {
+        steps[stepCount++] = {type, value};
+    }
+
+    void ObstacleAvoidBehaviour::beginStep(const BehaviourInputs &inputs) {
+        stepStart = inputs.time;
+        stepTurned = 0;
+        if (steps[stepIndex].type == MEASURE_STEP) {
+            window.clear();
+        } else if (steps[stepIndex].type == SWEEP_STEP) {
+            std::fill(profile, profile + AVOID_SCAN_SECTORS, -1.0f);
+            sweepOrigin = turned;
+            sweepEncoders = lastEncoders;
+        }
+    }
+
+    /**
+     * @brief Tras una medida con salida, la evasión termina. Si no, se sigue con la estrategia: primero los laterales
+     * del array (una sola vez) y después el barrido (barrer y, con el perfil, girar o retroceder) o el tanteo
+     */
+    void ObstacleAvoidBehaviour::plan(const BehaviourInputs &inputs) {
+        StepType last = (stepCount > 0) ? steps[stepCount - 1].type : MEASURE_STEP;
+        if (stepCount > 0 && last == MEASURE_STEP && !blocked(window.getRange())) {
+            finish(true);
+            return;
+        }
+        stepCount = 0;
+        stepIndex = 0;
+        if (!sidesTried) {
+            sidesTried = true;
+            if (planSides()) {
+                beginStep(inputs);
+                return;
+            }
+        }
+        if (scanArc <= 0) {
+            planTurns(inputs.pose);
+        } else if (last == SETTLE_STEP) {
+            chooseDirection();
+        } else {
+            LOG_INFO("Barriendo {} grados...", (int) std::lround(scanArc * 180.0f / (float) M_PI));
+            push(SETTLE_STEP);
+            if (scanArc < 2.0f * (float) M_PI)
+                push(TURN_STEP, -scanArc / 2.0f);
+            push(SWEEP_STEP, scanArc);
+            push(SETTLE_STEP);
+        }
+        beginStep(inputs);
+    }
+
+    /**
+     * @brief Con el array de sensores se conoce la distancia libre hacia los lados sin girar: se gira hacia el sensor
+     * lateral con más espacio libre, si supera la distancia límite, y se comprueba midiendo de nuevo
+     */
+    bool ObstacleAvoidBehaviour::planSides() {
+        UltrasoundArray *array = car->getUltrasoundArray();
+        if (array == nullptr)
+            return false;
+        int best = -1;
+        for (int i = 1; i < array->getSize(); i++) {
+            float distance = array->getReading(i).distance;
+            if (distance >= limitDistance && (best < 0 || distance > array->getReading(best).distance))
+                best = i;
+        }
+        if (best < 0)
+            return false;
+        LOG_INFO("Girando {} grados hacia un hueco de {} CM...", array->getReading(best).mount * 180.0f / (float) M_PI,
+                 array->getReading(best).distance);
+        push(TURN_STEP, array->getReading(best).mount - array->getReading(0).mount);
+        push(MEASURE_STEP);
+        return true;
+    }
+
+    /**
+     * @brief Tanteo: se gira 90 grados a la derecha y se mide, después a la izquierda y, si ninguno de los lados está
+     * libre, se vuelve a la orientación inicial, se retrocede y se empieza de nuevo. Los lados que el mapa ya sabe que
+     * están bloqueados se saltan
+     */
+    void ObstacleAvoidBehaviour::planTurns(const Navigation::Pose &pose) {
+        float quarter = (float) M_PI / 2.0f;
+        while (attempts <= 1) {
+            float target = (attempts == 0) ? -quarter : quarter;
+            attempts++;
+            if (blockedByMap(pose, reference + target)) {
+                LOG_INFO("El mapa indica que la {} esta bloqueada", target < 0 ? "derecha" : "izquierda");
+                continue;
+            }
+            LOG_INFO("Girando a la {}...", target < 0 ? "derecha" : "izquierda");
+            push(TURN_STEP, target - turned);
+            push(MEASURE_STEP);
+            return;
+        }
+        LOG_INFO("Camino no encontrado. Retrocediendo...");
+        push(TURN_STEP, -turned);
+        push(REVERSE_STEP);
+        push(TURN_STEP, -quarter);
+        push(MEASURE_STEP);
+        attempts = 1;
+    }
+
+    /**
+     * @brief Elige la dirección con más espacio libre (la menor distancia de los sectores vecinos) y, a igualdad, la
+     * que requiere menos giro. Si ninguna supera el límite se retrocede
+     */
+    void ObstacleAvoidBehaviour::chooseDirection() {
+        float sector = 2.0f * (float) M_PI / AVOID_SCAN_SECTORS;
+        float heading = turned - sweepOrigin;
+        float best = -1, turn = 0;
+        for (int i = 0; i < AVOID_SCAN_SECTORS; i++) {
+            if (profile[i] < 0)
+                continue;
+            float free = profile[i];
+            for (int j = -AVOID_SCAN_WINDOW_SECTORS; j <= AVOID_SCAN_WINDOW_SECTORS; j++) {
+                float value = profile[(i + j + AVOID_SCAN_SECTORS) % AVOID_SCAN_SECTORS];
+                if (value >= 0)
+                    free = std::min(free, value);
+            }
+            float candidate = std::remainder((i + 0.5f) * sector - heading, 2.0f * (float) M_PI);
+            if (free > best || (free == best && std::fabs(candidate) < std::fabs(turn))) {
+                best = free;
+                turn = candidate;
+            }
+        }
+        if (best < limitDistance) {
+            LOG_INFO("Camino no encontrado. Retrocediendo...");
+            push(REVERSE_STEP);
+        } else {
+            LOG_INFO("Girando {} grados hacia un hueco de {} CM...", turn * 180.0f / (float) M_PI, best);
+            push(TURN_STEP, turn);
+        }
+        push(MEASURE_STEP);
+    }
+
+    /**
+     * @brief Consulta en el mapa si el coche podría avanzar en la dirección indicada tras girar sobre sí mismo: se
+     * recorren tres rayos paralelos (centro y ambos laterales del coche) hasta la distancia límite
+     * @param angle Dirección absoluta (radianes, en el sistema de la odometría)
+     * @return true si algún rayo encuentra un obstáculo conocido (false si no hay mapa)
+     */
+    bool ObstacleAvoidBehaviour::blockedByMap(const Navigation::Pose &pose, float angle) const {
+        Navigation::OccupancyGrid *map = car->getMap();
+        if (map == nullptr)
+            return false;
+        float range = limitDistance + ULTRASOUND_OFFSET_CM;
+        for (int side = -1; side <= 1; side++) {
+            float x = pose.x - side * BODY_RADIUS_CM * std::sin(angle);
+            float y = pose.y + side * BODY_RADIUS_CM * std::cos(angle);
+            bool blocked;
+            if (map->freeDistance(x, y, angle, range, &blocked) < range && blocked)
+                return true;
+        }
+        return false;
+    }
+
+    void ObstacleAvoidBehaviour::finish(bool escaped) {
+        if (escaped) {
+            escapes++;
+            LOG_INFO("Obstaculo evitado. Continuando...");
+        } else {
+            failures++;
+            LOG_INFO("No se ha encontrado salida. Continuando...");
+        }
+        active = false;
+        stepCount = 0;
+        stepIndex = 0;
+        progressRange = -1;
+        window.clear();
+    }
+
+    FollowCircuitBehaviour::FollowCircuitBehaviour(const std::vector<Navigation::MotionPrimitive> &primitives,
+                                                   int limitDistance) : primitives(primitives) {
+        this->limitDistance = (float) limitDistance;
+        this->current = 0;
+        this->started = false;
+        this->primitiveStart = 0;
+        this->startTicks = 0;
+        this->lastSequence = -1;
+        this->curves = 0;
+        this->laps = 0;
+    }
+
+    const char *FollowCircuitBehaviour::getName() const {
+        return "circuito";
+    }
+
+    /**
+     * @brief Cada primitiva propone las velocidades de sus ruedas; los giros sobre sí mismo, tras esperar parado a
+     * que el coche se detenga. Al terminar una curva (giro sobre sí mismo o arco) o la última primitiva se cuentan
+     */
+    bool FollowCircuitBehaviour::propose(const BehaviourInputs &inputs, Proposal &proposal) {
+        if (primitives.empty())
+            return false;
+        if (inputs.rangeSequence != lastSequence) {
+            lastSequence = inputs.rangeSequence;
+            window.add(inputs.range);
+        }
+        if (!started) {
+            begin(inputs);
+        } else if (finished(primitives[current], inputs)) {
+            if (primitives[current].type != Navigation::STRAIGHT_PRIMITIVE)
+                curves++;
+            current = (current + 1) % primitives.size();
+            if (current == 0)
+                laps++;
+            begin(inputs);
+        }
+
+        const Navigation::MotionPrimitive &primitive = primitives[current];
+        MotionCommand command = {primitive.leftSpeed, primitive.rightSpeed};
+        if (primitive.type == Navigation::SPIN_PRIMITIVE && inputs.time - primitiveStart < SPIN_SETTLE_UMS) {
+            // Los tacos de la inercia mientras se detiene no cuentan para el giro
+            command = {0, 0};
+            startTicks = inputs.leftTicks + inputs.rightTicks;
+        }
+        proposal = {command, PRIORITY_CIRCUIT, 1.0f};
+        return true;
+    }
+
+    int FollowCircuitBehaviour::getSegment() const {
+        return (int) current;
+    }
+
+    bool FollowCircuitBehaviour::isTurning() const {
+        return !primitives.empty() && primitives[current].type == Navigation::SPIN_PRIMITIVE;
+    }
+
+    long long FollowCircuitBehaviour::getCurves() const {
+        return curves;
+    }
+
+    long long FollowCircuitBehaviour::getLaps() const {
+        return laps;
+    }
+
+    void FollowCircuitBehaviour::setLimitDistance(int limitDistance) {
+        this->limitDistance = (float) limitDistance;
+    }
+
+    void FollowCircuitBehaviour::begin(const BehaviourInputs &inputs) {
+        const Navigation::MotionPrimitive &primitive = primitives[current];
+        if (primitive.type == Navigation::SPIN_PRIMITIVE)
+            LOG_INFO("Girando a la {}...", primitive.rightSpeed > 0 ? "izquierda" : "derecha");
+        started = true;
+        primitiveStart = inputs.time;
+        startTicks = inputs.leftTicks + inputs.rightTicks;
+        window.clear();
+    }
+
+    /**
+     * @brief Las rectas hasta la pared terminan al verla (o si todas las medidas recientes son erróneas); las demás al
+     * recorrer sus tacos o, si se indica, al ver la pared antes
+     */
+    bool FollowCircuitBehaviour::finished(const Navigation::MotionPrimitive &primitive,
+                                          const BehaviourInputs &inputs) const {
+        float ticks = inputs.leftTicks + inputs.rightTicks - startTicks;
+        float target = primitive.leftTicks + primitive.rightTicks;
+        float range = window.getRange();
+        if (primitive.type == Navigation::SPIN_PRIMITIVE)
+            return ticks >= target || inputs.time - primitiveStart >= SPIN_SETTLE_UMS + BEHAVIOUR_TURN_TIMEOUT_UMS;
+        if (primitive.untilWall) {
+            float wall = (primitive.wallDistance > 0) ? primitive.wallDistance : limitDistance;
+            return window.isFull() && (range == -1 || range < wall);
+        }
+        if (primitive.wallDistance > 0 && window.isFull() && range != -1 && range < primitive.wallDistance)
+            return true;
+        return ticks >= target;
+    }
+
+    LowBatteryReturnBehaviour::LowBatteryReturnBehaviour(const Navigation::Pose &home, int speed, float threshold) {
+        this->home = home;
+        this->speed = speed;
+        this->threshold = threshold;
+        this->returning = false;
+    }
+
+    const char *LowBatteryReturnBehaviour::getName() const {
+        return "vuelta a casa";
+    }
+
+    bool LowBatteryReturnBehaviour::propose(const BehaviourInputs &inputs, Proposal &proposal) {
+        if (!returning) {
+            if (inputs.battery < 0 || inputs.battery >= threshold)
+                return false;
+            LOG_WARNING("Bateria baja ({} V): volviendo a la salida", inputs.battery);
+            returning = true;
+        }
+
+        float dx = home.x - inputs.pose.x, dy = home.y - inputs.pose.y;
+        MotionCommand command = {0, 0};
+        if (std::hypot(dx, dy) >= RETURN_TOLERANCE_CM) {
+            float error = std::remainder(std::atan2(dy, dx) - inputs.pose.heading, 2.0f * (float) M_PI);
+            if (std::fabs(error) * 180.0f / (float) M_PI > RETURN_HEADING_DEG)
+                command = (error > 0) ? MotionCommand{-speed, speed} : MotionCommand{speed, -speed};
+            else
+                command = {speed, speed};
+        }
+        proposal = {command, PRIORITY_RETURN, 1.0f};
+        return true;
+    }
+
+    bool LowBatteryReturnBehaviour::isReturning() const {
+        return returning;
+    }
+
+    ManualOverrideBehaviour::ManualOverrideBehaviour() : command(0), expiry(-1) {}
+
+    const char *ManualOverrideBehaviour::getName() const {
+        return "manual";
+    }
+
+    bool ManualOverrideBehaviour::propose(const BehaviourInputs &inputs, Proposal &proposal) {
+        long long until = expiry.load(std::memory_order_acquire);
+        if (until < 0 || inputs.time >= until)
+            return false;
+        long long packed = command.load(std::memory_order_relaxed);
+        proposal = {{(int) (packed >> 32), (int) (int32_t) (packed & 0xFFFFFFFF)}, PRIORITY_MANUAL, 1.0f};
+        return true;
+    }
+
+    /**
+     * @brief La orden se escribe antes que su caducidad, de forma que quien lee la caducidad ya ve la orden nueva
+     */
+    void ManualOverrideBehaviour::set(const MotionCommand &motion, long long until) {
+        command.store(((long long) motion.left << 32) | (uint32_t) motion.right, std::memory_order_relaxed);
+        expiry.store(until, std::memory_order_release);
+    }
+
+    void ManualOverrideBehaviour::release() {
+        expiry.store(-1, std::memory_order_release);
+    }
+
+} /* namespace RoboCar */
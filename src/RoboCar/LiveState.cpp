@@ -0,0 +1,230 @@
+#include "RoboCar/LiveState.h"
+#include "PinsLib/Clock.h"
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Intentos de lectura del estado antes de desistir (el coche lo está actualizando continuamente)
+#define LIVE_READ_ATTEMPTS          1000
+
+namespace RoboCar {
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "El seqlock del segmento necesita atomicos sin cerrojos");
+
+    static LiveState *activeLiveState = nullptr;
+
+    LiveState *LiveState::get() {
+        return activeLiveState;
+    }
+
+    void LiveState::set(LiveState *liveState) {
+        activeLiveState = liveState;
+    }
+
+    LiveState::LiveState() {
+        segment = nullptr;
+        owner = false;
+    }
+
+    LiveState::~LiveState() {
+        close();
+    }
+
+    /**
+     * @brief Crea (o reinicia) el segmento de memoria compartida y lo inicializa
+     * @param name Nombre del segmento POSIX (empieza por '/')
+     * @return true si se ha creado correctamente, false en caso contrario
+     */
+    bool LiveState::create(const std::string &name) {
+        close();
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd == -1) {
+            perror("LiveState: shm_open failed ");
+            return false;
+        }
+        if (ftruncate(fd, sizeof(LiveStateSegment)) == -1) {
+            perror("LiveState: ftruncate failed ");
+            ::close(fd);
+            return false;
+        }
+        void *memory = mmap(nullptr, sizeof(LiveStateSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            perror("LiveState: mmap failed ");
+            return false;
+        }
+
+        segment = (LiveStateSegment *) memory;
+        memset(memory, 0, sizeof(LiveStateSegment));
+        segment->state.distance = -1;
+        segment->state.segment = -1;
+        segment->magic = LIVE_STATE_MAGIC;
+        segment->version = LIVE_STATE_VERSION;
+        segment->size = sizeof(LiveStateSegment);
+        this->name = name;
+        this->owner = true;
+        return true;
+    }
+
+    /**
+     * @brief Se conecta a un segmento existente, comprobando que su formato coincide con el de este programa
+     * @param name Nombre del segmento POSIX
+     * @return true si se ha conectado correctamente, false en caso contrario
+     */
+    bool LiveState::attach(const std::string &name) {
+        close();
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd == -1) {
+            std::cerr << "No se encuentra el estado del coche " << name << " (se ha de ejecutar con --live)" << std::endl;
+            return false;
+        }
+        void *memory = mmap(nullptr, sizeof(LiveStateSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            perror("LiveState: mmap failed ");
+            return false;
+        }
+
+        segment = (LiveStateSegment *) memory;
+        if (segment->magic != LIVE_STATE_MAGIC || segment->version != LIVE_STATE_VERSION ||
+            segment->size != sizeof(LiveStateSegment)) {
+            std::cerr << "El estado del coche " << name << " tiene un formato distinto (version " << segment->version
+                      << ", se esperaba " << LIVE_STATE_VERSION << ")" << std::endl;
+            close();
+            return false;
+        }
+        this->name = name;
+        this->owner = false;
+        return true;
+    }
+
+    /**
+     * @brief Libera el segmento. Si lo creó este proceso, además lo elimina
+     */
+    void LiveState::close() {
+        if (segment == nullptr)
+            return;
+        munmap(segment, sizeof(LiveStateSegment));
+        if (owner)
+            shm_unlink(name.c_str());
+        segment = nullptr;
+        owner = false;
+    }
+
+    /**
+     * @brief Comienza una actualización del estado: marca la secuencia como impar (si otro hilo está escribiendo,
+     * espera a que termine)
+     * @return Estado a modificar, hasta llamar a endUpdate()
+     */
+    LiveStateData &LiveState::beginUpdate() {
+        uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+        while ((sequence & 1) || !segment->sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+            sequence = segment->sequence.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return segment->state;
+    }
+
+    void LiveState::endUpdate() {
+        segment->state.time = PinsLib::Clock::get()->now();
+        segment->state.updates++;
+        segment->sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    void LiveState::setMode(const std::string &mode) {
+        LiveStateData &state = beginUpdate();
+        strncpy(state.mode, mode.c_str(), LIVE_MODE_NAME_SIZE - 1);
+        state.mode[LIVE_MODE_NAME_SIZE - 1] = '\0';
+        endUpdate();
+    }
+
+    void LiveState::setSegment(int segment) {
+        beginUpdate().segment = segment;
+        endUpdate();
+    }
+
+    void LiveState::setDistance(float distance) {
+        beginUpdate().distance = distance;
+        endUpdate();
+    }
+
+    void LiveState::setLed(uint8_t led, bool on) {
+        LiveStateData &state = beginUpdate();
+        state.leds = on ? (state.leds | led) : (state.leds & ~led);
+        endUpdate();
+    }
+
+    /**
+     * @brief Reserva una entrada para la temporización de una etapa del bucle. Si ya hay una etapa con el mismo
+     * nombre (p.e: al volver a lanzar el bucle) se reutiliza su entrada
+     * @return Índice de la etapa, -1 si no quedan entradas libres
+     */
+    int LiveState::registerStage(const std::string &name, long long period) {
+        LiveStateData &state = beginUpdate();
+        int stage = -1;
+        for (int i = 0; i < state.stageCount && stage == -1; i++) {
+            if (strncmp(state.stages[i].name, name.c_str(), LIVE_STAGE_NAME_SIZE - 1) == 0)
+                stage = i;
+        }
+        if (stage != -1) {
+            state.stages[stage].period = (int32_t) period;
+        } else if (state.stageCount < LIVE_MAX_STAGES) {
+            stage = state.stageCount++;
+            LiveStage &entry = state.stages[stage];
+            memset(&entry, 0, sizeof(entry));
+            strncpy(entry.name, name.c_str(), LIVE_STAGE_NAME_SIZE - 1);
+            entry.period = (int32_t) period;
+        }
+        endUpdate();
+        return stage;
+    }
+
+    void LiveState::updateStage(int stage, unsigned long long runs, unsigned long long overruns, long long jitter,
+                                long long maxJitter, long long duration) {
+        if (stage < 0)
+            return;
+        LiveStage &entry = beginUpdate().stages[stage];
+        entry.runs = (uint32_t) runs;
+        entry.overruns = (uint32_t) overruns;
+        entry.lastJitter = (int32_t) jitter;
+        entry.maxJitter = (int32_t) maxJitter;
+        entry.lastDuration = (int32_t) duration;
+        endUpdate();
+    }
+
+    /**
+     * @brief Copia el estado completo, repitiendo la copia si el coche lo ha modificado mientras tanto
+     * @param state Estado leído
+     * @return true si se ha obtenido una copia consistente, false en caso contrario
+     */
+    bool LiveState::read(LiveStateData &state) const {
+        for (int attempt = 0; attempt < LIVE_READ_ATTEMPTS; attempt++) {
+            uint32_t before = segment->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            memcpy(&state, &segment->state, sizeof(LiveStateData));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment->sequence.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        return false;
+    }
+
+    bool LiveState::stopRequested() const {
+        return segment->commands.stop.load(std::memory_order_relaxed) != 0;
+    }
+
+    int LiveState::getSpeedLimit() const {
+        return segment->commands.speedLimit.load(std::memory_order_relaxed);
+    }
+
+    void LiveState::requestStop(bool stop) {
+        segment->commands.stop.store(stop ? 1 : 0, std::memory_order_relaxed);
+    }
+
+    void LiveState::setSpeedLimit(int speedLimit) {
+        segment->commands.speedLimit.store(speedLimit, std::memory_order_relaxed);
+    }
+
+} /* namespace RoboCar */
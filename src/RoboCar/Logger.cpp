@@ -0,0 +1,189 @@
+#include "RoboCar/Logger.h"
+#include "PinsLib/Clock.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace RoboCar {
+
+    static Logger *activeLogger = nullptr;
+
+    // Cola del hilo actual y registro al que pertenece (si cambia el registro activo, se crea otra)
+    static thread_local Logger *currentOwner = nullptr;
+    static thread_local void *currentRing = nullptr;
+
+    // Texto de los mensajes que se escriben directamente, que conserva su capacidad entre mensajes
+    static thread_local std::string directText;
+
+    Logger *Logger::get() {
+        return activeLogger;
+    }
+
+    void Logger::set(Logger *logger) {
+        activeLogger = logger;
+    }
+
+    Logger::Logger(FILE *out, FILE *err) : running(false) {
+        this->out = out;
+        this->err = err;
+        this->written = 0;
+    }
+
+    Logger::~Logger() {
+        if (activeLogger == this)
+            activeLogger = nullptr;
+        if (running) {
+            running = false;
+            writer.join();
+        }
+        flush();
+        unsigned long long dropped = getDropped();
+        if (dropped > 0)
+            std::cerr << "Log: " << dropped << " mensajes descartados por colas llenas" << std::endl;
+        for (Ring *ring : rings)
+            delete ring;
+    }
+
+    void Logger::start() {
+        if (running)
+            return;
+        running = true;
+        writer = std::thread(&Logger::run, this);
+    }
+
+    /**
+     * @brief Añade el mensaje a la cola del hilo actual. Solo el primer mensaje de cada hilo reserva memoria (su cola),
+     * salvo que se haya preparado antes el hilo
+     */
+    void Logger::submit(LogRecord &record) {
+        record.time = PinsLib::Clock::get()->now();
+        Logger *logger = activeLogger;
+        if (logger == nullptr) {
+            directText.clear();
+            format(record, directText);
+            (record.level >= LOG_LEVEL_WARNING ? std::cerr : std::cout) << directText << std::endl;
+            return;
+        }
+
+        Ring *ring = (currentOwner == logger) ? (Ring *) currentRing : logger->registerRing();
+        unsigned long long tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail - ring->head.load(std::memory_order_acquire) >= LOG_RING_CAPACITY) {
+            ring->dropped++;
+            return;
+        }
+        ring->records[tail & (LOG_RING_CAPACITY - 1)] = record;
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    void Logger::prepareThread() {
+        Logger *logger = activeLogger;
+        if (logger == nullptr)
+            directText.reserve(LOG_DIRECT_TEXT_RESERVE);
+        else if (currentOwner != logger)
+            logger->registerRing();
+    }
+
+    Logger::Ring *Logger::registerRing() {
+        auto *ring = new Ring();
+        ring->head = 0;
+        ring->tail = 0;
+        ring->dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(ring);
+        }
+        currentOwner = this;
+        currentRing = ring;
+        return ring;
+    }
+
+    /**
+     * @brief Recoge los mensajes de todas las colas, los ordena por instante (los de un mismo hilo ya lo están) y los
+     * escribe con una única escritura por salida
+     */
+    void Logger::flush() {
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for (Ring *ring : rings) {
+                unsigned long long head = ring->head.load(std::memory_order_relaxed);
+                unsigned long long tail = ring->tail.load(std::memory_order_acquire);
+                for (; head < tail; head++)
+                    batch.push_back(ring->records[head & (LOG_RING_CAPACITY - 1)]);
+                ring->head.store(head, std::memory_order_release);
+            }
+        }
+        if (batch.empty())
+            return;
+        std::stable_sort(batch.begin(), batch.end(),
+                         [](const LogRecord &a, const LogRecord &b) { return a.time < b.time; });
+
+        outText.clear();
+        errText.clear();
+        for (const LogRecord &record : batch) {
+            std::string &text = (record.level >= LOG_LEVEL_WARNING) ? errText : outText;
+            format(record, text);
+            text += '\n';
+        }
+        if (!outText.empty()) {
+            fwrite(outText.data(), 1, outText.size(), out);
+            fflush(out);
+        }
+        if (!errText.empty()) {
+            fwrite(errText.data(), 1, errText.size(), err);
+            fflush(err);
+        }
+        written += batch.size();
+    }
+
+    unsigned long long Logger::getWritten() const {
+        return written;
+    }
+
+    unsigned long long Logger::getDropped() {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        unsigned long long dropped = 0;
+        for (Ring *ring : rings)
+            dropped += ring->dropped;
+        return dropped;
+    }
+
+    /**
+     * @brief Sustituye cada "{}" del formato por el siguiente argumento. Los reales se escriben como lo haría
+     * std::ostream (6 cifras significativas)
+     */
+    void Logger::format(const LogRecord &record, std::string &text) {
+        int argument = 0;
+        for (const char *c = record.format; *c != '\0'; c++) {
+            if (c[0] != '{' || c[1] != '}' || argument >= record.count) {
+                text += *c;
+                continue;
+            }
+            char number[32];
+            switch (record.types[argument]) {
+                case LogRecord::INTEGER:
+                    snprintf(number, sizeof(number), "%lld", record.values[argument].integer);
+                    text += number;
+                    break;
+                case LogRecord::REAL:
+                    snprintf(number, sizeof(number), "%g", record.values[argument].real);
+                    text += number;
+                    break;
+                case LogRecord::TEXT:
+                    text += record.values[argument].text;
+                    break;
+            }
+            argument++;
+            c++;
+        }
+    }
+
+    void Logger::run() {
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::microseconds(LOG_FLUSH_PERIOD_UMS));
+            flush();
+        }
+    }
+
+} /* namespace RoboCar */
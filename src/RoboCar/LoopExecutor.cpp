@@ -0,0 +1,191 @@
+#include "RoboCar/LoopExecutor.h"
+#include "RoboCar/AllocationCheck.h"
+#include "RoboCar/LiveState.h"
+#include "RoboCar/Logger.h"
+#include "RoboCar/Watchdog.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+
+namespace RoboCar {
+
+    LoopExecutor::LoopExecutor(PinsLib::Clock *clock) {
+        this->clock = clock;
+        this->running = false;
+        this->resyncRequested = false;
+        this->startTime = 0;
+    }
+
+    /**
+     * @brief Registra una nueva etapa periódica
+     * @param name Nombre de la etapa (para el informe)
+     * @param period Periodo en us
+     * @param phase Desplazamiento, en us, del primer lanzamiento respecto al inicio de la ejecución
+     * @param function Función que se ejecuta en cada lanzamiento
+     * @param priority Tratamiento de la etapa cuando el watchdog ordena reducir la carga
+     * @return Identificador de la etapa
+     */
+    int LoopExecutor::addStage(const std::string &name, long long period, long long phase, std::function<void()> function,
+                               StagePriority priority) {
+        stages.push_back({name, period, phase, function, priority, 0, {0, 0, 0, 0, 0, 0, 0}, -1});
+        return (int) stages.size() - 1;
+    }
+
+    /**
+     * @brief Bucle principal: espera (de forma absoluta) al siguiente lanzamiento, ejecuta la etapa y la reprograma
+     * @param duration Tiempo total de ejecución en us
+     */
+    void LoopExecutor::run(long long duration) {
+        if (stages.empty())
+            return;
+
+        LiveState *live = LiveState::get();
+        Watchdog *watchdog = Watchdog::get();
+        Logger::prepareThread();
+        running = true;
+        startTime = clock->now();
+        for (Stage &stage : stages) {
+            stage.nextRelease = startTime + stage.phase;
+            if (live != nullptr)
+                stage.liveStage = live->registerStage(stage.name, stage.period);
+        }
+        long long endTime = startTime + duration;
+
+        while (running) {
+            // Siguiente etapa a lanzar (a igualdad de instante, la registrada antes)
+            Stage *stage = &stages[0];
+            for (Stage &candidate : stages) {
+                if (candidate.nextRelease < stage->nextRelease)
+                    stage = &candidate;
+            }
+            long long release = stage->nextRelease;
+            if (release >= endTime)
+                break;
+
+            clock->sleepUntil(release);
+
+            // En modo degradado las etapas opcionales no se lanzan
+            bool degraded = watchdog != nullptr && watchdog->isDegraded();
+            if (degraded && stage->priority == STAGE_OPTIONAL) {
+                watchdog->countShed();
+                stage->nextRelease = release + stage->period;
+                continue;
+            }
+
+            long long begin = clock->now();
+            {
+                // El primer lanzamiento de cada etapa puede preparar lo que necesite
+                ALLOCATION_FREE(stage->stats.runs > 0 ? "etapa del bucle" : nullptr);
+                stage->function();
+            }
+            long long end = clock->now();
+
+            StageStats &stats = stage->stats;
+            long long jitter = begin - release;
+            stats.runs++;
+            stats.totalJitter += jitter;
+            stats.maxJitter = std::max(stats.maxJitter, jitter);
+
+            if (live != nullptr) {
+                live->updateStage(stage->liveStage, stats.runs, stats.overruns, jitter, stats.maxJitter, end - begin);
+                if (live->stopRequested()) {
+                    std::cerr << "Detenido desde el monitor" << std::endl;
+                    break;
+                }
+            }
+            if (watchdog != nullptr) {
+                watchdog->beat(WATCHDOG_LOOP);
+                if (watchdog->hasTripped()) {
+                    std::cerr << "Detenido por el watchdog" << std::endl;
+                    break;
+                }
+            }
+
+            if (resyncRequested) {
+                // La etapa ha esperado de forma intencionada: se reprograma todo a partir de ahora
+                resyncRequested = false;
+                for (Stage &other : stages)
+                    other.nextRelease = end + other.phase;
+                continue;
+            }
+
+            stats.totalDuration += end - begin;
+            stats.maxDuration = std::max(stats.maxDuration, end - begin);
+
+            // Si se ha sobrepasado el siguiente lanzamiento se cuenta el overrun y se saltan los lanzamientos perdidos,
+            // manteniendo la fase original. En modo degradado las etapas prescindibles se espacian
+            stage->nextRelease = release + stage->period;
+            if (degraded && stage->priority == STAGE_SHEDDABLE) {
+                stage->nextRelease += (WATCHDOG_SHED_FACTOR - 1) * stage->period;
+                watchdog->countShed();
+            }
+            if (end > stage->nextRelease) {
+                long long missed = (end - stage->nextRelease) / stage->period + 1;
+                stats.overruns++;
+                stats.skipped += missed;
+                stage->nextRelease += missed * stage->period;
+            }
+        }
+        running = false;
+
+        // Los mensajes del bucle se escriben antes de que se muestren sus estadísticas
+        Logger *logger = Logger::get();
+        if (logger != nullptr)
+            logger->flush();
+    }
+
+    void LoopExecutor::stop() {
+        running = false;
+    }
+
+    void LoopExecutor::resync() {
+        resyncRequested = true;
+    }
+
+    const LoopExecutor::StageStats &LoopExecutor::getStats(int stage) const {
+        return stages[stage].stats;
+    }
+
+    /**
+     * @brief Muestra, por cada etapa, su periodo y fase, ejecuciones, overruns, lanzamientos saltados,
+     * retraso de lanzamiento (jitter) y duración (medias y máximos en us)
+     */
+    void LoopExecutor::printReport(std::ostream &out) const {
+        out << "Temporizacion del bucle (us):" << std::endl;
+        out << std::left << std::setw(10) << "etapa" << std::right
+            << std::setw(9) << "periodo" << std::setw(8) << "fase" << std::setw(8) << "ejec"
+            << std::setw(9) << "overrun" << std::setw(9) << "saltos"
+            << std::setw(10) << "jit.med" << std::setw(10) << "jit.max"
+            << std::setw(10) << "dur.med" << std::setw(10) << "dur.max" << std::endl;
+        for (const Stage &stage : stages) {
+            const StageStats &stats = stage.stats;
+            long long runs = stats.runs > 0 ? stats.runs : 1;
+            out << std::left << std::setw(10) << stage.name << std::right
+                << std::setw(9) << stage.period << std::setw(8) << stage.phase << std::setw(8) << stats.runs
+                << std::setw(9) << stats.overruns << std::setw(9) << stats.skipped
+                << std::setw(10) << stats.totalJitter / runs << std::setw(10) << stats.maxJitter
+                << std::setw(10) << stats.totalDuration / runs << std::setw(10) << stats.maxDuration << std::endl;
+        }
+    }
+
+    /**
+     * @brief Fija el hilo que la invoca al núcleo indicado
+     * @param core Número de núcleo (0 o 1 en la BeagleBone AI)
+     * @return true si se ha fijado correctamente, false en caso contrario
+     */
+    bool LoopExecutor::pinToCore(int core) {
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(core, &cores);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+        if (error != 0) {
+            std::cerr << "No se pudo fijar el hilo al nucleo " << core << ": " << strerror(error) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+} /* namespace RoboCar */
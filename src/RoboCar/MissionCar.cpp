@@ -0,0 +1,176 @@
+#include "RoboCar/MissionCar.h"
+#include "RoboCar/Geometry.h"
+#include "RoboCar/LiveState.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RoboCar {
+
+    MissionCar::MissionCar(RoboCar *car, MissionExecutor &executor) : executor(executor) {
+        this->car = car;
+        this->rangeCount = 0;
+        this->rangeNext = 0;
+        this->nextPing = 0;
+    }
+
+    RoboCar *MissionCar::get() const {
+        return car;
+    }
+
+    MissionExecutor &MissionCar::getExecutor() const {
+        return executor;
+    }
+
+    MissionExecutor::SleepAwaiter MissionCar::sleep(long long ums) {
+        return executor.sleep(ums);
+    }
+
+    /**
+     * @brief Dispara el sensor y espera los flancos del eco (el inicio y el final) sin bloquear el bucle de eventos.
+     * Si el eco no termina dentro del plazo, la medida es errónea y el sensor se vuelve a disparar más adelante
+     * @return Distancia en CM, -1 en caso de medida errónea
+     */
+    Task<float> MissionCar::ping() {
+        PinsLib::Clock *clock = executor.getClock();
+        if (clock->now() < nextPing)
+            co_await executor.sleepUntil(nextPing);
+
+        UltrasoundSensor *sensor = car->getUltrasoundSensor();
+        sensor->fire();
+        long long fired = clock->now();
+        nextPing = fired + MISSION_PING_UMS;
+        float distance = -1;
+        while (!sensor->poll(MISSION_ECHO_TIMEOUT_UMS, distance)) {
+            if (!co_await executor.edge(sensor->getEchoPin(), fired + MISSION_ECHO_TIMEOUT_UMS)) {
+                distance = -1;
+                break;
+            }
+        }
+        car->registerRange(distance);
+
+        ranges[rangeNext] = distance;
+        rangeNext = (rangeNext + 1) % MISSION_RANGE_WINDOW;
+        rangeCount = std::min(rangeCount + 1, MISSION_RANGE_WINDOW);
+        LiveState *live = LiveState::get();
+        if (live != nullptr)
+            live->setDistance(getRange());
+        co_return distance;
+    }
+
+    /**
+     * @brief Hasta tener la ventana completa no se decide, para que una única medida con ruido no detenga el coche
+     */
+    Task<float> MissionCar::distanceBelow(float limit, bool errorsAsNear) {
+        for (;;) {
+            co_await ping();
+            float distance = getRange();
+            if (rangeCount == MISSION_RANGE_WINDOW && (distance == -1 ? errorsAsNear : distance < limit))
+                co_return distance;
+        }
+    }
+
+    float MissionCar::getRange() const {
+        float valid[MISSION_RANGE_WINDOW];
+        int count = 0;
+        for (int i = 0; i < rangeCount; i++) {
+            if (ranges[i] != -1)
+                valid[count++] = ranges[i];
+        }
+        if (count == 0)
+            return -1;
+        std::sort(valid, valid + count);
+        return valid[count / 2];
+    }
+
+    void MissionCar::clearRanges() {
+        rangeCount = 0;
+        rangeNext = 0;
+    }
+
+    /**
+     * @brief Como WheelMotor::getCurrentSpeed(), pero esperando cada flanco del encoder en lugar de leerlo en bucle.
+     * Las lecturas pasan por el recuento de tacos de la rueda
+     */
+    Task<int> MissionCar::measureSpeed(Wheel wheel) {
+        WheelMotor *motor = car->getWheel(wheel);
+        if (!motor->isMoving())
+            co_return 0;
+        PinsLib::GPIO *encoder = motor->getEncoderPin();
+        PinsLib::Clock *clock = executor.getClock();
+        long long start = 0;
+        // Cada taco es una alteración del encoder entre 0 y 1. Los dos primeros flancos sitúan el inicio en un flanco
+        // de bajada, para no medir un taco parcial
+        for (int edge = 0; edge < 2 * MISSION_SPEED_TICKS + 2; edge++) {
+            int level = (edge % 2 == 0) ? 1 : 0;
+            long long deadline = clock->now() + MISSION_SPEED_TIMEOUT_UMS;
+            while (motor->readEncoder() != level) {
+                if (!co_await executor.edge(encoder, deadline))
+                    co_return 0;
+            }
+            if (edge == 1)
+                start = clock->now();
+        }
+        long long stop = clock->now();
+        co_return (stop > start) ? (int) (1000000.0f * MISSION_SPEED_TICKS / (float) (stop - start)) : 0;
+    }
+
+    /**
+     * @brief Cuenta cada flanco del encoder en cuanto se produce, incluida la inercia al arrancar y al detenerse. Cada
+     * flanco es un despertar, por lo que solo se cuenta cuando se necesita. Los tacos se cuentan en la rueda
+     * (WheelMotor::countTicks), de donde los toman también la odometría y la sincronización de las ruedas
+     */
+    Task<> MissionCar::countTicks(Wheel wheel, float &ticks, const bool &enabled) {
+        WheelMotor *motor = car->getWheel(wheel);
+        PinsLib::GPIO *encoder = motor->getEncoderPin();
+        PinsLib::Clock *clock = executor.getClock();
+        for (;;) {
+            if (!enabled) {
+                co_await executor.sleep(MISSION_COUNT_IDLE_UMS);
+                continue;
+            }
+            float last = motor->countTicks();
+            while (enabled) {
+                co_await executor.edge(encoder, clock->now() + MISSION_SPEED_TIMEOUT_UMS);
+                float current = motor->countTicks();
+                ticks += current - last;
+                last = current;
+            }
+        }
+    }
+
+    /**
+     * @brief La odometría cuenta los tacos por sondeo, así que se despierta con cada flanco del encoder izquierdo (como
+     * mucho, tras lo que falta para alcanzar los tacos a la velocidad actual) y se comprueba al despertar
+     */
+    Task<> MissionCar::travel(float ticks) {
+        PinsLib::GPIO *encoder = car->getWheel(LEFT)->getEncoderPin();
+        PinsLib::Clock *clock = executor.getClock();
+        float startLeft, startRight, left, right;
+        car->getWheelTicks(startLeft, startRight);
+        for (;;) {
+            car->getWheelTicks(left, right);
+            float remaining = ticks - ((left - startLeft) + (right - startRight));
+            if (remaining <= 0)
+                break;
+            int leftVelocity, rightVelocity;
+            car->getWheelVelocities(leftVelocity, rightVelocity);
+            float rate = (float) (std::abs(leftVelocity) + std::abs(rightVelocity));
+            long long wait = (rate > 0) ? (long long) (remaining / rate * 1000000.0f) : MISSION_TRAVEL_MAX_WAIT_UMS;
+            co_await executor.edge(encoder, clock->now() + std::clamp(wait, (long long) MISSION_TRAVEL_MIN_WAIT_UMS,
+                                                                      (long long) MISSION_TRAVEL_MAX_WAIT_UMS));
+        }
+    }
+
+    /**
+     * @brief Girando sobre sí mismo, la orientación cambia en la suma de los tacos de ambas ruedas entre la vía
+     */
+    Task<> MissionCar::rotate(float angle) {
+        if (angle > 0)
+            car->rotateLeft();
+        else
+            car->rotateRight();
+        co_await travel(std::fabs(angle) * (float) M_PI / 180.0f * WHEEL_TRACK_CM / CM_PER_TICK);
+        car->stop();
+    }
+
+} /* namespace RoboCar */
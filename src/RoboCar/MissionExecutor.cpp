@@ -0,0 +1,470 @@
+#include "RoboCar/MissionExecutor.h"
+#include "RoboCar/AllocationCheck.h"
+#include "RoboCar/LiveState.h"
+#include "RoboCar/Logger.h"
+#include "RoboCar/Watchdog.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Cabecera de cada marco de corrutina con la reserva de la que procede (nullptr si procede del heap), manteniendo la
+// alineación del marco
+#define FRAME_HEADER_SIZE           alignof(std::max_align_t)
+#define FRAME_BLOCK_SIZE            (FRAME_HEADER_SIZE + MISSION_FRAME_SIZE)
+
+namespace RoboCar {
+
+    FramePool::FramePool() {
+        memory = new char[(size_t) FRAME_BLOCK_SIZE * MISSION_FRAME_COUNT];
+        freeFrames = nullptr;
+        for (int i = MISSION_FRAME_COUNT - 1; i >= 0; i--) {
+            void *block = memory + (size_t) i * FRAME_BLOCK_SIZE;
+            *(void **) block = freeFrames;
+            freeFrames = block;
+        }
+    }
+
+    FramePool::~FramePool() {
+        delete[] memory;
+    }
+
+    void *FramePool::allocate(FramePool *pool, size_t size) {
+        void *block = nullptr;
+        if (pool != nullptr && size <= MISSION_FRAME_SIZE && pool->freeFrames != nullptr) {
+            block = pool->freeFrames;
+            pool->freeFrames = *(void **) block;
+        } else {
+            pool = nullptr;
+            block = ::operator new(FRAME_HEADER_SIZE + size);
+        }
+        *(FramePool **) block = pool;
+        return (char *) block + FRAME_HEADER_SIZE;
+    }
+
+    void FramePool::release(void *frame) {
+        void *block = (char *) frame - FRAME_HEADER_SIZE;
+        FramePool *pool = *(FramePool **) block;
+        if (pool == nullptr) {
+            ::operator delete(block);
+            return;
+        }
+        *(void **) block = pool->freeFrames;
+        pool->freeFrames = block;
+    }
+
+    FramePool *framePoolOf(MissionExecutor &executor) {
+        return executor.getFramePool();
+    }
+
+    /**
+     * @brief Con el reloj del sistema se preparan epoll y el timerfd de los vencimientos; con un reloj virtual no
+     * hace falta ningún recurso del sistema
+     */
+    MissionExecutor::MissionExecutor(PinsLib::Clock *clock) {
+        this->clock = clock;
+        this->realTime = dynamic_cast<PinsLib::SystemClock *>(clock) != nullptr;
+        this->epollFd = -1;
+        this->timerFd = -1;
+        this->sequence = 0;
+        this->running = false;
+        this->started = false;
+        this->blockRequested = false;
+        this->blockedUntil = 0;
+        this->stats = {0, 0, 0, 0, 0, 0, 0, 0};
+        waits.reserve(MISSION_MAX_WAITS);
+        ready.reserve(MISSION_MAX_WAITS);
+        due.reserve(MISSION_MAX_WAITS);
+
+        if (!realTime)
+            return;
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (epollFd == -1 || timerFd == -1) {
+            perror("No se pudo preparar el bucle de eventos");
+            realTime = false;
+            return;
+        }
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = timerFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+    }
+
+    MissionExecutor::~MissionExecutor() {
+        for (const std::pair<PinsLib::GPIO *const, int> &pin : pinFds) {
+            if (pin.second != -1)
+                close(pin.second);
+        }
+        if (timerFd != -1)
+            close(timerFd);
+        if (epollFd != -1)
+            close(epollFd);
+    }
+
+    /**
+     * @brief Bucle de eventos: reanuda las tareas listas y, cuando no queda ninguna, espera al siguiente vencimiento
+     * o flanco. Tras cada reanudación se da una señal de vida al watchdog; las esperas del bucle se le anuncian.
+     * Tras la primera reanudación de la tarea principal (que crea las demás tareas) el bucle no reserva memoria
+     * @param task Tarea principal de la misión
+     * @param duration Tiempo máximo de ejecución en us
+     */
+    void MissionExecutor::run(Task<> &task, long long duration) {
+        LiveState *live = LiveState::get();
+        Watchdog *watchdog = Watchdog::get();
+        Logger *logger = Logger::get();
+        Logger::prepareThread();
+        stats = {0, 0, 0, 0, 0, 0, 0, 0};
+        running = true;
+        started = false;
+        long long start = clock->now();
+        long long endTime = start + duration;
+
+        // La tarea principal se lanza como si hubiera vencido una espera en el instante inicial
+        MissionWait first(this);
+        first.handle = task.handle;
+        first.time = start;
+        first.state = MissionWait::READY;
+        ready.push_back(&first);
+
+        while (running && !task.isDone()) {
+            if (!ready.empty()) {
+                MissionWait *wait = ready.front();
+                ready.erase(ready.begin());
+                resume(wait);
+                if (live != nullptr && live->stopRequested()) {
+                    std::cerr << "Detenido desde el monitor" << std::endl;
+                    break;
+                }
+                if (watchdog != nullptr) {
+                    watchdog->beat(WATCHDOG_LOOP);
+                    if (watchdog->hasTripped()) {
+                        std::cerr << "Detenido por el watchdog" << std::endl;
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            long long now = clock->now();
+            if (now >= endTime)
+                break;
+            long long next = endTime;
+            for (MissionWait *wait : waits)
+                next = std::min(next, wait->time);
+            if (live != nullptr)
+                next = std::min(next, now + MISSION_CHECK_PERIOD_UMS);
+            if (next > now) {
+                if (watchdog != nullptr)
+                    watchdog->allow(WATCHDOG_LOOP, next - now);
+                waitUntil(next);
+            }
+
+            // Las esperas vencidas pasan a la cola en orden de vencimiento (a igualdad, en el de registro)
+            ALLOCATION_FREE("MissionExecutor::run");
+            now = clock->now();
+            due.clear();
+            for (MissionWait *wait : waits) {
+                if (wait->time <= now)
+                    due.push_back(wait);
+            }
+            std::sort(due.begin(), due.end(), [](const MissionWait *a, const MissionWait *b) {
+                return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+            });
+            for (MissionWait *wait : due)
+                wake(wait, false);
+            if (live != nullptr && live->stopRequested()) {
+                std::cerr << "Detenido desde el monitor" << std::endl;
+                break;
+            }
+        }
+        running = false;
+        if (first.state == MissionWait::READY)
+            cancel(&first);
+        stats.elapsed = clock->now() - start;
+
+        // Los mensajes de la misión se escriben antes de que se muestren sus estadísticas
+        if (logger != nullptr)
+            logger->flush();
+    }
+
+    void MissionExecutor::stop() {
+        running = false;
+    }
+
+    void MissionExecutor::blocked() {
+        blockRequested = true;
+    }
+
+    PinsLib::Clock *MissionExecutor::getClock() const {
+        return clock;
+    }
+
+    const MissionExecutor::Stats &MissionExecutor::getStats() const {
+        return stats;
+    }
+
+    FramePool *MissionExecutor::getFramePool() {
+        return &frames;
+    }
+
+    void MissionExecutor::printReport(std::ostream &out) const {
+        long long wakeups = stats.timerWakeups + stats.pinWakeups;
+        long long active = stats.elapsed - stats.blocked;
+        out << "Ejecutor de misiones: " << stats.resumes << " reanudaciones (" << stats.timerWakeups
+            << " por tiempo, " << stats.pinWakeups << " por flancos de pines). Retraso medio "
+            << (wakeups > 0 ? stats.totalLatency / wakeups : 0) << " us, maximo " << stats.maxLatency
+            << " us. Ocupado " << (active > 0 ? 100.0 * stats.busy / active : 0) << "% del tiempo fuera de "
+            << "maniobras bloqueantes (" << stats.blocked / 1000 << " ms)" << std::endl;
+    }
+
+    MissionExecutor::SleepAwaiter::SleepAwaiter(MissionExecutor *executor, long long time) : wait(executor) {
+        wait.time = time;
+    }
+
+    MissionExecutor::SleepAwaiter::SleepAwaiter(SleepAwaiter &&other) noexcept : wait(other.wait.executor) {
+        wait.time = other.wait.time;
+    }
+
+    MissionExecutor::SleepAwaiter::~SleepAwaiter() {
+        wait.executor->cancel(&wait);
+    }
+
+    bool MissionExecutor::SleepAwaiter::await_ready() const {
+        return wait.executor->clock->now() >= wait.time;
+    }
+
+    void MissionExecutor::SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        wait.handle = handle;
+        wait.executor->add(&wait);
+    }
+
+    MissionExecutor::SleepAwaiter MissionExecutor::sleepUntil(long long time) {
+        return SleepAwaiter(this, time);
+    }
+
+    MissionExecutor::SleepAwaiter MissionExecutor::sleep(long long ums) {
+        return SleepAwaiter(this, clock->now() + ums);
+    }
+
+    MissionExecutor::EdgeAwaiter::EdgeAwaiter(MissionExecutor *executor, PinsLib::GPIO *pin, long long deadline)
+            : wait(executor) {
+        this->pin = pin;
+        wait.time = deadline;
+    }
+
+    MissionExecutor::EdgeAwaiter::EdgeAwaiter(EdgeAwaiter &&other) noexcept : wait(other.wait.executor) {
+        pin = other.pin;
+        wait.time = other.wait.time;
+    }
+
+    MissionExecutor::EdgeAwaiter::~EdgeAwaiter() {
+        wait.executor->cancel(&wait);
+    }
+
+    bool MissionExecutor::EdgeAwaiter::await_ready() const {
+        return false;
+    }
+
+    /**
+     * @brief Según lo que permitan el reloj y el backend, se espera al aviso del fichero del pin, al instante en que
+     * el backend sabe que cambiará o, si no, al siguiente sondeo
+     */
+    void MissionExecutor::EdgeAwaiter::await_suspend(std::coroutine_handle<> handle) {
+        MissionExecutor *executor = wait.executor;
+        wait.handle = handle;
+        wait.fd = executor->pinDescriptor(pin);
+        if (wait.fd == -1) {
+            long long edge = pin->nextEdge();
+            if (edge >= 0) {
+                wait.pin = pin;
+                wait.deadline = wait.time;
+                wait.pinEvent = edge <= wait.time;
+                wait.time = std::min(wait.time, edge);
+            } else {
+                long long poll = executor->clock->now() + MISSION_PIN_POLL_UMS;
+                wait.pinEvent = poll <= wait.time;
+                wait.time = std::min(wait.time, poll);
+            }
+        }
+        executor->add(&wait);
+    }
+
+    bool MissionExecutor::EdgeAwaiter::await_resume() const {
+        return wait.pinEvent;
+    }
+
+    MissionExecutor::EdgeAwaiter MissionExecutor::edge(PinsLib::GPIO *pin, long long deadline) {
+        return EdgeAwaiter(this, pin, deadline);
+    }
+
+    Task<> MissionExecutor::timeout(long long ums) {
+        co_await sleep(ums);
+    }
+
+    void MissionExecutor::add(MissionWait *wait) {
+        wait->state = MissionWait::WAITING;
+        wait->sequence = sequence++;
+        waits.push_back(wait);
+    }
+
+    /**
+     * @brief Retira una espera, esté pendiente o lista (p.e: al destruirse la tarea que espera, cancelada por whenAny)
+     */
+    void MissionExecutor::cancel(MissionWait *wait) {
+        if (wait->state == MissionWait::WAITING)
+            waits.erase(std::find(waits.begin(), waits.end(), wait));
+        else if (wait->state == MissionWait::READY)
+            ready.erase(std::find(ready.begin(), ready.end(), wait));
+        wait->state = MissionWait::IDLE;
+    }
+
+    /**
+     * @brief Pasa una espera a la cola de tareas listas. Las esperas que el backend ha resuelto de antemano ya saben si
+     * terminan por un flanco; las de un fichero solo si ha llegado su aviso
+     */
+    void MissionExecutor::wake(MissionWait *wait, bool pinEvent) {
+        waits.erase(std::find(waits.begin(), waits.end(), wait));
+        if (wait->fd != -1)
+            wait->pinEvent = pinEvent;
+        if (wait->pinEvent)
+            stats.pinWakeups++;
+        else
+            stats.timerWakeups++;
+        wait->state = MissionWait::READY;
+        ready.push_back(wait);
+    }
+
+    /**
+     * @brief Abre el fichero value del pin y lo registra en epoll. El kernel notifica los flancos configurados en edge
+     * con EPOLLPRI, que se mantiene hasta que se vuelve a leer el fichero
+     */
+    int MissionExecutor::pinDescriptor(PinsLib::GPIO *pin) {
+        if (!realTime)
+            return -1;
+        std::map<PinsLib::GPIO *, int>::iterator known = pinFds.find(pin);
+        if (known != pinFds.end())
+            return known->second;
+
+        int fd = -1;
+        string path = pin->locate("value");
+        if (!path.empty() && pin->setEdgeType(PinsLib::BOTH) == 0)
+            fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd != -1) {
+            char value[8];
+            if (read(fd, value, sizeof(value)) < 0)
+                perror("No se pudo leer el pin");
+            struct epoll_event event = {};
+            event.events = EPOLLPRI | EPOLLERR;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+                perror("No se pudieron vigilar los flancos del pin");
+                close(fd);
+                fd = -1;
+            }
+        }
+        pinFds[pin] = fd;
+        return fd;
+    }
+
+    /**
+     * @brief Con el reloj del sistema se programa el timerfd al instante indicado (absoluto, CLOCK_MONOTONIC) y se
+     * espera en epoll; los avisos de los pines despiertan a quien espera su fichero
+     */
+    void MissionExecutor::waitUntil(long long time) {
+        if (!realTime) {
+            bool edges = std::any_of(waits.begin(), waits.end(), [](MissionWait *wait) { return wait->pin != nullptr; });
+            if (!edges) {
+                clock->sleepUntil(time);
+                return;
+            }
+            while (clock->now() < time) {
+                clock->sleepUntil(std::min(time, clock->now() + MISSION_EDGE_RECHECK_UMS));
+                if (recheckEdges())
+                    return;
+            }
+            return;
+        }
+
+        struct itimerspec timer = {};
+        timer.it_value.tv_sec = time / 1000000LL;
+        timer.it_value.tv_nsec = (time % 1000000LL) * 1000;
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &timer, nullptr);
+
+        struct epoll_event events[MISSION_MAX_EVENTS];
+        int count;
+        while ((count = epoll_wait(epollFd, events, MISSION_MAX_EVENTS, -1)) == -1 && errno == EINTR);
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            char buffer[8];
+            if (fd == timerFd) {
+                if (read(timerFd, buffer, sizeof(buffer)) < 0 && errno != EAGAIN)
+                    perror("No se pudo leer el temporizador");
+                continue;
+            }
+            lseek(fd, 0, SEEK_SET);
+            if (read(fd, buffer, sizeof(buffer)) < 0)
+                perror("No se pudo leer el pin");
+            due.clear();
+            for (MissionWait *wait : waits) {
+                if (wait->fd == fd)
+                    due.push_back(wait);
+            }
+            for (MissionWait *wait : due)
+                wake(wait, true);
+        }
+    }
+
+    /**
+     * @brief Un flanco que el backend ya no prevé (-1) puede haberse producido: la espera vence en ese momento
+     */
+    bool MissionExecutor::recheckEdges() {
+        long long now = clock->now();
+        bool due = false;
+        for (MissionWait *wait : waits) {
+            if (wait->pin == nullptr)
+                continue;
+            long long edge = wait->pin->nextEdge();
+            edge = (edge >= 0) ? edge : now;
+            if (edge < wait->time && edge <= wait->deadline) {
+                wait->time = edge;
+                wait->pinEvent = true;
+            }
+            due = due || wait->time <= now;
+        }
+        return due;
+    }
+
+    /**
+     * @brief Reanuda la tarea de una espera, registrando su retraso y lo que ha tardado en volver a suspenderse
+     */
+    void MissionExecutor::resume(MissionWait *wait) {
+        long long begin = clock->now();
+        long long latency = begin - std::max(wait->time, blockedUntil);
+        if (latency > 0) {
+            stats.totalLatency += latency;
+            stats.maxLatency = std::max(stats.maxLatency, latency);
+        }
+        wait->state = MissionWait::IDLE;
+        stats.resumes++;
+        {
+            ALLOCATION_FREE(started ? "tarea de la mision" : nullptr);
+            wait->handle.resume();
+        }
+        started = true;
+
+        long long end = clock->now();
+        if (blockRequested) {
+            blockRequested = false;
+            blockedUntil = end;
+            stats.blocked += end - begin;
+        } else {
+            stats.busy += end - begin;
+        }
+    }
+
+} /* namespace RoboCar */
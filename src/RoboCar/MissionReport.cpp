@@ -0,0 +1,173 @@
+#include "RoboCar/MissionReport.h"
+#include "RoboCar/Geometry.h"
+#include "PinsLib/Pins.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace RoboCar {
+
+    static MissionReport *activeReport = nullptr;
+
+    MissionReport *MissionReport::get() {
+        return activeReport;
+    }
+
+    void MissionReport::set(MissionReport *report) {
+        activeReport = report;
+    }
+
+    /**
+     * @brief Reserva de antemano los periodos del bucle, de forma que acumular un ciclo no reserve memoria
+     */
+    MissionReport::MissionReport() {
+        periods.reserve(MISSION_REPORT_PERIOD_SAMPLES);
+        begin("");
+    }
+
+    /**
+     * @brief Olvida lo acumulado hasta ahora. El estado inicial es el del primer ciclo que se acumule
+     * @param mode Nombre del modo, para el resumen
+     */
+    void MissionReport::begin(const std::string &mode) {
+        this->mode = mode;
+        started = false;
+        startTime = 0;
+        lastTime = 0;
+        lastMotion = STOPPED_MOTION;
+        startLeft = 0;
+        startRight = 0;
+        lastLeft = 0;
+        lastRight = 0;
+        startTravelled = 0;
+        lastTravelled = 0;
+        std::fill(motionTime, motionTime + 3, 0LL);
+        windowStart = 0;
+        windowTravelled = 0;
+        peakSpeed = 0;
+        obstacles = 0;
+        escapes = 0;
+        failures = 0;
+        curves = 0;
+        laps = 0;
+        periods.clear();
+        periodCount = 0;
+        periodTotal = 0;
+        periodMax = 0;
+        startOperations = 0;
+        operations = 0;
+    }
+
+    /**
+     * @brief El tiempo desde el ciclo anterior se asigna al estado en que quedaron entonces las ruedas. La velocidad
+     * máxima se mide por ventanas de MISSION_REPORT_SPEED_WINDOW_UMS sobre el recorrido de la odometría, de forma que
+     * los giros sobre sí mismo no cuentan. Si ya no caben más periodos del bucle, los percentiles se calculan con los
+     * primeros (el resumen lo indica), pero la media y el máximo siguen contando todos
+     */
+    void MissionReport::sample(RoboCar *car, const BehaviourInputs &inputs) {
+        long long now = inputs.time;
+        Motion motion = classify(car);
+        operations = PinsLib::Pins::getOperations();
+        if (!started) {
+            started = true;
+            startTime = lastTime = windowStart = now;
+            startLeft = lastLeft = inputs.leftEncoder;
+            startRight = lastRight = inputs.rightEncoder;
+            startTravelled = lastTravelled = windowTravelled = car->getTravelled();
+            lastMotion = motion;
+            startOperations = operations;
+            return;
+        }
+
+        long long period = now - lastTime;
+        if (periods.size() < periods.capacity())
+            periods.push_back((int) period);
+        periodCount++;
+        periodTotal += period;
+        periodMax = std::max(periodMax, (int) period);
+        motionTime[lastMotion] += period;
+        lastMotion = motion;
+        lastTime = now;
+        lastLeft = inputs.leftEncoder;
+        lastRight = inputs.rightEncoder;
+        lastTravelled = car->getTravelled();
+
+        if (now - windowStart >= MISSION_REPORT_SPEED_WINDOW_UMS) {
+            float speed = (lastTravelled - windowTravelled) * 1000000.0f / (float) (now - windowStart);
+            peakSpeed = std::max(peakSpeed, speed);
+            windowStart = now;
+            windowTravelled = lastTravelled;
+        }
+    }
+
+    void MissionReport::setObstacles(long long obstacles, long long escapes, long long failures) {
+        this->obstacles = obstacles;
+        this->escapes = escapes;
+        this->failures = failures;
+    }
+
+    void MissionReport::setCircuit(long long curves, long long laps) {
+        this->curves = curves;
+        this->laps = laps;
+    }
+
+    /**
+     * @brief Las curvas (ruedas a distinta velocidad) cuentan como giros
+     */
+    MissionReport::Motion MissionReport::classify(RoboCar *car) {
+        int left = car->getWheel(LEFT)->getDirection(), right = car->getWheel(RIGHT)->getDirection();
+        if (left == 0 && right == 0)
+            return STOPPED_MOTION;
+        int leftSpeed, rightSpeed;
+        car->getWheelSpeeds(leftSpeed, rightSpeed);
+        return (left == right && leftSpeed == rightSpeed) ? CRUISE_MOTION : TURN_MOTION;
+    }
+
+    bool MissionReport::save(const std::string &filename) const {
+        std::ofstream out(filename);
+        if (!out.is_open()) {
+            std::cerr << "No se pudo abrir el fichero " << filename << " para escritura" << std::endl;
+            return false;
+        }
+        print(out);
+        return true;
+    }
+
+    /**
+     * @brief Escribe el resumen en JSON. Unidades: distancias en CM, velocidades en CM/s, tiempos en s y periodos del
+     * bucle en us. El giro de cada rueda incluye los giros sobre sí mismo; el recorrido y las velocidades, no
+     */
+    void MissionReport::print(std::ostream &out) const {
+        double duration = (lastTime - startTime) / 1000000.0;
+        double travelled = lastTravelled - startTravelled;
+        double left = (lastLeft - startLeft) * CM_PER_TICK, right = (lastRight - startRight) * CM_PER_TICK;
+        std::vector<int> sorted = periods;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) {
+            return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+        };
+
+        out << "{" << std::endl;
+        out << "  \"mode\": \"" << mode << "\"," << std::endl;
+        out << "  \"duration\": " << duration << "," << std::endl;
+        out << "  \"distance\": " << travelled << "," << std::endl;
+        out << "  \"wheelRotation\": {\"left\": " << left << ", \"right\": " << right << "}," << std::endl;
+        out << "  \"speed\": {\"mean\": " << (duration > 0 ? travelled / duration : 0)
+            << ", \"peak\": " << peakSpeed << "}," << std::endl;
+        out << "  \"time\": {\"cruise\": " << motionTime[CRUISE_MOTION] / 1000000.0 << ", \"turn\": "
+            << motionTime[TURN_MOTION] / 1000000.0 << ", \"stopped\": " << motionTime[STOPPED_MOTION] / 1000000.0
+            << "}," << std::endl;
+        out << "  \"obstacles\": {\"detected\": " << obstacles << ", \"escapes\": " << escapes << ", \"failures\": "
+            << failures << "}," << std::endl;
+        out << "  \"circuit\": {\"curves\": " << curves << ", \"laps\": " << laps << "}," << std::endl;
+        out << "  \"loopPeriod\": {\"samples\": " << periodCount << ", \"mean\": "
+            << (periodCount > 0 ? periodTotal / periodCount : 0) << ", \"p50\": " << percentile(0.50)
+            << ", \"p90\": " << percentile(0.90) << ", \"p99\": " << percentile(0.99) << ", \"max\": "
+            << periodMax << ", \"percentileSamples\": " << sorted.size() << ", \"truncated\": "
+            << ((long long) sorted.size() < periodCount ? "true" : "false") << "}," << std::endl;
+        out << "  \"sysfs\": {\"operations\": " << operations - startOperations << ", \"opsPerSecond\": "
+            << (duration > 0 ? (operations - startOperations) / duration : 0) << "}" << std::endl;
+        out << "}" << std::endl;
+    }
+
+} /* namespace RoboCar */
@@ -0,0 +1,127 @@
+#include "RoboCar/ParameterStore.h"
+#include <cstdio>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace RoboCar {
+
+    ParameterStore::ParameterStore(const Parameters &initial) : current(nullptr), running(false), reloads(0),
+                                                                rejected(0) {
+        this->inotifyFd = -1;
+        publish(initial);
+    }
+
+    ParameterStore::~ParameterStore() {
+        stop();
+        for (const Parameters *version : versions)
+            delete version;
+    }
+
+    const Parameters &ParameterStore::read() const {
+        return *current.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief La versión se completa antes de publicar el puntero, de forma que quien lo lee ya ve todos sus campos
+     */
+    void ParameterStore::publish(const Parameters &parameters) {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        auto *version = new Parameters(parameters);
+        versions.push_back(version);
+        current.store(version, std::memory_order_release);
+    }
+
+    void ParameterStore::setOverrides(const std::string &overrides) {
+        this->overrides = overrides;
+    }
+
+    /**
+     * @brief Se vigila el directorio y no el fichero: los editores suelen guardar escribiendo otro fichero y
+     * renombrándolo, con lo que el fichero vigilado dejaría de existir
+     */
+    bool ParameterStore::watch(const std::string &filename) {
+        if (running)
+            return false;
+        std::string::size_type slash = filename.rfind('/');
+        std::string directory = (slash == std::string::npos) ? "." : filename.substr(0, slash + 1);
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0) {
+            perror("No se pudo iniciar la vigilancia de los parametros");
+            return false;
+        }
+        if (inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            perror(("No se pudo vigilar el directorio " + directory).c_str());
+            close(inotifyFd);
+            inotifyFd = -1;
+            return false;
+        }
+        this->filename = filename;
+        running = true;
+        watcher = std::thread(&ParameterStore::run, this);
+        return true;
+    }
+
+    void ParameterStore::stop() {
+        if (running) {
+            running = false;
+            watcher.join();
+        }
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+            inotifyFd = -1;
+        }
+    }
+
+    /**
+     * @brief Cada recarga parte de los valores por defecto, de forma que borrar una línea del fichero devuelve el
+     * parámetro a su valor por defecto. Se lee sobre una copia: la versión vigente no cambia si hay algún error
+     */
+    bool ParameterStore::reload() {
+        Parameters parameters;
+        std::istringstream commandLine(overrides);
+        if (!parameters.load(filename) || !parameters.parse(commandLine, "de la linea de comandos")) {
+            rejected++;
+            std::cerr << "Parametros no recargados: se mantienen los anteriores" << std::endl;
+            return false;
+        }
+        publish(parameters);
+        reloads++;
+        std::cout << "Parametros recargados de " << filename << std::endl;
+        return true;
+    }
+
+    void ParameterStore::printReport(std::ostream &out) const {
+        out << "Parametros: " << reloads << " recargas, " << rejected << " rechazadas" << std::endl;
+    }
+
+    /**
+     * @brief Hilo de vigilancia: espera los eventos del directorio y recarga cuando se ha terminado de escribir el
+     * fichero o se ha movido sobre él. Varios eventos seguidos se atienden con una sola recarga
+     */
+    void ParameterStore::run() {
+        std::string::size_type slash = filename.rfind('/');
+        std::string name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+        alignas(struct inotify_event) char buffer[4096];
+        struct pollfd descriptor = {inotifyFd, POLLIN, 0};
+        while (running) {
+            if (poll(&descriptor, 1, PARAMETERS_WATCH_POLL_MS) <= 0)
+                continue;
+            bool changed = false;
+            ssize_t length;
+            while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (char *event = buffer; event < buffer + length;) {
+                    auto *notification = (struct inotify_event *) event;
+                    if (notification->len > 0 && name == notification->name)
+                        changed = true;
+                    event += sizeof(struct inotify_event) + notification->len;
+                }
+            }
+            if (changed)
+                reload();
+        }
+    }
+
+} /* namespace RoboCar */
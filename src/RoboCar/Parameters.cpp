@@ -0,0 +1,94 @@
+#include "RoboCar/Parameters.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace RoboCar {
+
+    long long Parameters::turnDuration(int angle) const {
+        return angle * turnTime / TURN_ANGLE_REFERENCE + turnStartDelay;
+    }
+
+    /**
+     * @brief Carga los parámetros de un fichero. Los que no aparecen conservan su valor
+     * @return true si se ha cargado correctamente, false si no se ha podido abrir o tiene algún error
+     */
+    bool Parameters::load(const std::string &filename) {
+        std::ifstream in(filename);
+        if (!in.is_open()) {
+            std::cerr << "No se pudo abrir el fichero de parametros " << filename << std::endl;
+            return false;
+        }
+
+        return parse(in, filename);
+    }
+
+    /**
+     * @brief Lee los parámetros de un flujo con el formato del fichero
+     * @param source Origen de los parámetros, para los mensajes de error
+     * @return true si se han leído correctamente, false si alguno es desconocido o tiene un valor inválido
+     */
+    bool Parameters::parse(std::istream &in, const std::string &source) {
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            std::string::size_type comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+
+            std::istringstream tokens(line);
+            std::string name;
+            if (!(tokens >> name))
+                continue;
+            bool valid;
+            if (name == "turnTime")
+                valid = (bool) (tokens >> turnTime) && turnTime > 0;
+            else if (name == "turnStartDelay")
+                valid = (bool) (tokens >> turnStartDelay) && turnStartDelay >= 0;
+            else if (name == "speedGain")
+                valid = (bool) (tokens >> speedGain) && speedGain >= 0;
+            else if (name == "syncGain")
+                valid = (bool) (tokens >> syncGain) && syncGain >= 0;
+            else if (name == "distanceMeasures")
+                valid = (bool) (tokens >> distanceMeasures) && distanceMeasures > 0 &&
+                        distanceMeasures <= MAX_DISTANCE_MEASURES;
+            else if (name == "loopPeriod")
+                valid = (bool) (tokens >> loopPeriod) && loopPeriod > 0;
+            else if (name == "limitDistance")
+                valid = (bool) (tokens >> limitDistance) && limitDistance > 0;
+            else if (name == "maxSpeed")
+                valid = (bool) (tokens >> maxSpeed);
+            else
+                valid = false;
+            if (!valid) {
+                std::cerr << "Parametros " << source << ":" << lineNumber << ": parametro desconocido o valor invalido"
+                          << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Parameters::save(const std::string &filename) const {
+        std::ofstream out(filename);
+        if (!out.is_open()) {
+            std::cerr << "No se pudo abrir el fichero " << filename << " para escritura" << std::endl;
+            return false;
+        }
+        print(out);
+        return true;
+    }
+
+    void Parameters::print(std::ostream &out) const {
+        out << "turnTime " << turnTime << std::endl;
+        out << "turnStartDelay " << turnStartDelay << std::endl;
+        out << "speedGain " << speedGain << std::endl;
+        out << "syncGain " << syncGain << std::endl;
+        out << "distanceMeasures " << distanceMeasures << std::endl;
+        out << "loopPeriod " << loopPeriod << std::endl;
+        out << "limitDistance " << limitDistance << std::endl;
+        out << "maxSpeed " << maxSpeed << std::endl;
+    }
+
+} /* namespace RoboCar */
@@ -0,0 +1,63 @@
+#include "RoboCar/ReplayBackend.h"
+#include <algorithm>
+
+namespace RoboCar {
+
+    /**
+     * @brief Prepara la reproducción de una sesión
+     * @param records Muestras de la sesión grabada
+     * @param clock Reloj virtual que se hará avanzar con cada operación
+     * @param ioCost Tiempo virtual, en us, que consume cada lectura o escritura de un pin
+     */
+    ReplayBackend::ReplayBackend(const std::vector<SessionRecord> &records, PinsLib::VirtualClock *clock,
+                                 long long ioCost) : VirtualBackend(clock, ioCost) {
+        this->duration = 0;
+        for (const SessionRecord &record : records) {
+            switch (record.type) {
+                case RANGE_SAMPLE: ranges.push_back(record); break;
+                case LEFT_SPEED_SAMPLE: leftSpeeds.push_back(record); break;
+                case RIGHT_SPEED_SAMPLE: rightSpeeds.push_back(record); break;
+            }
+            duration = std::max(duration, record.time);
+        }
+    }
+
+    long long ReplayBackend::getDuration() const {
+        return duration;
+    }
+
+    /**
+     * @brief El eco corresponde a la distancia grabada en el instante del disparo
+     */
+    float ReplayBackend::echoDistance(int sensor, long long now) {
+        // Las sesiones solo graban el sensor frontal
+        if (sensor != 0)
+            return -1;
+        return sampleAt(ranges, now);
+    }
+
+    /**
+     * @brief Genera la señal cuadrada del encoder: un taco (ciclo completo 1-0) por cada 1/velocidad segundos
+     */
+    bool ReplayBackend::encoderLevel(Wheel wheel, long long now) {
+        float speed = sampleAt(wheel == LEFT ? leftSpeeds : rightSpeeds, now);
+        if (speed <= 0)
+            return false;
+        long long halfCycles = (long long) ((double) now * speed * 2.0 / 1000000.0);
+        return halfCycles % 2 == 0;
+    }
+
+    /**
+     * @brief Busca la última muestra anterior o igual al instante indicado (o la primera, si todavía no hay ninguna)
+     * @return Valor de la muestra, 0 si no hay muestras
+     */
+    float ReplayBackend::sampleAt(const std::vector<SessionRecord> &samples, long long time) {
+        if (samples.empty())
+            return 0;
+        std::vector<SessionRecord>::const_iterator next = std::upper_bound(
+                samples.begin(), samples.end(), time,
+                [](long long t, const SessionRecord &record) { return t < record.time; });
+        return (next == samples.begin()) ? next->value : (next - 1)->value;
+    }
+
+} /* namespace RoboCar */
@@ -1,26 +1,23 @@
 #include "RoboCar/RoboCar.h"
+#include "RoboCar/Pinout.h"
+#include "RoboCar/Geometry.h"
+#include "RoboCar/LiveState.h"
+#include "RoboCar/Watchdog.h"
+#include "RoboCar/Session.h"
+#include "PinsLib/Clock.h"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <vector>
-#include <unistd.h>
 
-// Parámetros de configuración para la toma de medidas de distancias
-#define NUM_DISTANCE_MEASURES           7
+// Alcance máximo (CM) de las medidas que se integran en el mapa. Más allá, el sensor no es fiable
+#define MAP_MAX_RANGE_CM                200.0f
 
-// Parámetros de configuración, obtenidos a mano, para el giro
-#define TURN_SPEED_REFERENCE            55
-#define TURN_ANGLE_REFERENCE            90
-#define TURN_TIMEUMS_REFERENCE          500000
-#define DELAY_TIMEUMS_TO_START_TURN     100000
-#define CALCULATE_TURN_TIMEUMS(angle)   ((angle * TURN_TIMEUMS_REFERENCE / TURN_ANGLE_REFERENCE) + DELAY_TIMEUMS_TO_START_TURN)
+// Corrección máxima de la sincronización de las ruedas, como fracción de la velocidad de referencia de cada una
+#define WHEEL_SYNC_MAX_CORRECTION       0.25f
 
-// Pines para los LEDs
-#define GREEN_LED_PIN_NUMBER            105
-#define RED_LED_PIN_NUMBER              242
-
-// Nombres de los ficheros para almacenar las calibraciones
+// Nombres de los ficheros para almacenar las calibraciones (dentro del directorio de calibración del coche)
 #define LEFT_WHEEL_CALIBRATION_NAME     "leftWheel.calibration"
 #define RIGHT_WHEEL_CALIBRATION_NAME    "rightWheel.calibration"
 
@@ -30,22 +27,84 @@ namespace RoboCar{
 
     /**
      * @brief Inicializa sensores y pines necesarios para la configuración que hemos establecido
-     * Nota: solo puede existir una misma instancia simultáneamente
+     * Nota: solo puede existir una instancia por cada mapa de pines y backend simultáneamente
+     * @param pins Pines a los que están conectados los sensores y actuadores del coche
+     * @param calibrationPath Directorio donde se guardan y se buscan los ficheros de calibración del coche
      */
-    RoboCar::RoboCar() {
+    RoboCar::RoboCar(const PinMap &pins, const string &calibrationPath) {
+        this->pins = pins;
+        this->calibrationPath = calibrationPath;
+        if (!this->calibrationPath.empty() && this->calibrationPath.back() != '/')
+            this->calibrationPath += "/";
+
         // Ruedas
-        leftWheel = new WheelMotor(LEFT);
-        rightWheel = new WheelMotor(RIGHT);
+        leftWheel = new WheelMotor(LEFT, pins);
+        rightWheel = new WheelMotor(RIGHT, pins);
+        leftWheel->setCompanion(rightWheel);
+        rightWheel->setCompanion(leftWheel);
         // Sensor de ultrasonidos
-        ultrasoundSensor = new UltrasoundSensor();
+        ultrasoundSensor = new UltrasoundSensor(pins.ultrasoundTrigger, pins.ultrasoundEcho);
         // LEDS
-        greenLed = new Led(GREEN_LED_PIN_NUMBER);
-        redLed = new Led(RED_LED_PIN_NUMBER);
+        greenLed = new Led(pins.greenLed);
+        redLed = new Led(pins.redLed);
 
         // Parámetros por defecto
+        parameterStore = nullptr;
+        appliedParameters = &parameters;
         speed = 0;
+        leftSpeed = 0;
+        rightSpeed = 0;
         maxSpeed = 0;
         minSpeed = 0;
+        syncLeftSpeed = 0;
+        syncRightSpeed = 0;
+        syncLeftTicks = 0;
+        syncRightTicks = 0;
+
+        // Localización y mapeado: el coche parte del origen mirando hacia el eje X
+        odometry.reset({0, 0, 0});
+        leftTicks = 0;
+        rightTicks = 0;
+        leftPosition = 0;
+        rightPosition = 0;
+        map = nullptr;
+        sensorMount = 0;
+        ultrasoundArray = nullptr;
+    }
+
+    /**
+     * @brief Establece los parámetros de comportamiento del coche (giros, regulación de la velocidad, medidas...)
+     */
+    void RoboCar::setParameters(const Parameters &parameters) {
+        this->parameters = parameters;
+        leftWheel->setSpeedGain(parameters.speedGain);
+        rightWheel->setSpeedGain(parameters.speedGain);
+    }
+
+    void RoboCar::setParameterStore(ParameterStore *store) {
+        parameterStore = store;
+        appliedParameters = nullptr;
+        refreshParameters();
+    }
+
+    /**
+     * @brief Con almacén, una lectura atómica del puntero a la versión vigente
+     */
+    const Parameters &RoboCar::getParameters() const {
+        return (parameterStore != nullptr) ? parameterStore->read() : parameters;
+    }
+
+    /**
+     * @brief Las versiones del almacén no se liberan mientras existe, así que basta con comparar punteros
+     */
+    bool RoboCar::refreshParameters() {
+        const Parameters &current = getParameters();
+        if (&current == appliedParameters)
+            return false;
+        appliedParameters = &current;
+        leftWheel->setSpeedGain(current.speedGain);
+        rightWheel->setSpeedGain(current.speedGain);
+        return true;
     }
 
     /**
@@ -54,6 +113,9 @@ namespace RoboCar{
     RoboCar::~RoboCar() {
         delete leftWheel;
         delete rightWheel;
+        delete ultrasoundArray;
+        for (UltrasoundSensor *sensor : sideSensors)
+            delete sensor;
         delete ultrasoundSensor;
         delete greenLed;
         delete redLed;
@@ -66,6 +128,7 @@ namespace RoboCar{
     void RoboCar::goForward() {
         leftWheel->goForward();
         rightWheel->goForward();
+        updateOdometry();
     }
 
     /**
@@ -75,6 +138,7 @@ namespace RoboCar{
     void RoboCar::goBackward() {
         leftWheel->goBackward();
         rightWheel->goBackward();
+        updateOdometry();
     }
 
     /**
@@ -84,6 +148,7 @@ namespace RoboCar{
     void RoboCar::goRight() {
         stop();
         leftWheel->goForward();
+        updateOdometry();
     }
 
     /**
@@ -94,13 +159,14 @@ namespace RoboCar{
     void RoboCar::goRight(int angle) {
         // Se detiene el vehiculo por completo
         int lastSpeed = speed;
+        allowWait(1000000 + getParameters().turnDuration(angle));
         stop();
-        sleep(1);
+        PinsLib::Clock::get()->sleep(1000000);
 
         // Y se gira el ángulo indicado, apoyándose en las medidas tomadas previamente
         setSpeed(TURN_SPEED_REFERENCE);
         goRight();
-        usleep(CALCULATE_TURN_TIMEUMS(angle));
+        PinsLib::Clock::get()->sleep(getParameters().turnDuration(angle));
 
         // Se vuelve a establecer la velocidad anterior y se detiene
         stop();
@@ -114,6 +180,7 @@ namespace RoboCar{
     void RoboCar::goLeft() {
         stop();
         rightWheel->goForward();
+        updateOdometry();
     }
 
     /**
@@ -124,19 +191,40 @@ namespace RoboCar{
     void RoboCar::goLeft(int angle) {
         // Se detiene el vehiculo por completo
         int lastSpeed = speed;
+        allowWait(1000000 + getParameters().turnDuration(angle));
         stop();
-        sleep(1);
+        PinsLib::Clock::get()->sleep(1000000);
 
         // Y se gira el ángulo indicado, apoyándose en las medidas tomadas previamente
         setSpeed(TURN_SPEED_REFERENCE);
         goLeft();
-        usleep(CALCULATE_TURN_TIMEUMS(angle));
+        PinsLib::Clock::get()->sleep(getParameters().turnDuration(angle));
 
         // Se vuelve a establecer la velocidad anterior y se detiene
         stop();
         setSpeed(lastSpeed);
     }
 
+    /**
+     * @brief El vehículo comienza a moverse hacia atrás a la velocidad configurada.
+     * Se mueve de forma indefinida, rotando sobre su rueda derecha.
+     */
+    void RoboCar::goBackRight() {
+        stop();
+        leftWheel->goBackward();
+        updateOdometry();
+    }
+
+    /**
+     * @brief El vehículo comienza a moverse hacia atrás a la velocidad configurada.
+     * Se mueve de forma indefinida, rotando sobre su rueda izquierda.
+     */
+    void RoboCar::goBackLeft() {
+        stop();
+        rightWheel->goBackward();
+        updateOdometry();
+    }
+
     /**
      * @brief El vehículo comienza a moverse hacia la derecha a la velocidad configurada.
      * Se mueve de forma indefinida, rotando sobre su propio eje.
@@ -145,6 +233,7 @@ namespace RoboCar{
         stop();
         leftWheel->goForward();
         rightWheel->goBackward();
+        updateOdometry();
     }
 
     /**
@@ -155,13 +244,14 @@ namespace RoboCar{
     void RoboCar::rotateRight(int angle) {
         // Se detiene el vehiculo por completo
         int lastSpeed = speed;
+        allowWait(1000000 + getParameters().turnDuration(angle));
         stop();
-        sleep(1);
+        PinsLib::Clock::get()->sleep(1000000);
 
         // Y se gira el ángulo indicado, apoyándose en las medidas tomadas previamente
         setSpeed(TURN_SPEED_REFERENCE);
         rotateRight();
-        usleep(CALCULATE_TURN_TIMEUMS(angle));
+        PinsLib::Clock::get()->sleep(getParameters().turnDuration(angle));
 
         // Se vuelve a establecer la velocidad anterior y se detiene
         stop();
@@ -176,6 +266,7 @@ namespace RoboCar{
         stop();
         rightWheel->goForward();
         leftWheel->goBackward();
+        updateOdometry();
     }
 
     /**
@@ -186,13 +277,14 @@ namespace RoboCar{
     void RoboCar::rotateLeft(int angle) {
         // Se detiene el vehiculo por completo
         int lastSpeed = speed;
+        allowWait(1000000 + getParameters().turnDuration(angle));
         stop();
-        sleep(1);
+        PinsLib::Clock::get()->sleep(1000000);
 
         // Y se gira el ángulo indicado, apoyándose en las medidas tomadas previamente
         setSpeed(TURN_SPEED_REFERENCE);
         rotateLeft();
-        usleep(CALCULATE_TURN_TIMEUMS(angle));
+        PinsLib::Clock::get()->sleep(getParameters().turnDuration(angle));
 
         // Se vuelve a establecer la velocidad anterior y se detiene
         stop();
@@ -205,6 +297,7 @@ namespace RoboCar{
     void RoboCar::stop() {
         leftWheel->stop();
         rightWheel->stop();
+        updateOdometry();
     }
 
     /**
@@ -213,8 +306,37 @@ namespace RoboCar{
      */
     void RoboCar::setSpeed(int speed) {
         this->speed = speed;
-        leftWheel->setSpeed(speed);
-        rightWheel->setSpeed(speed);
+        this->leftSpeed = speed;
+        this->rightSpeed = speed;
+        int left = speed, right = speed;
+        applySpeedLimit(left, right);
+        leftWheel->setSpeed(left);
+        rightWheel->setSpeed(right);
+        updateOdometry();
+    }
+
+    /**
+     * @brief Se establece una velocidad distinta a cada rueda (p.e: para trazar una curva sin detenerse). La velocidad
+     * del coche pasa a ser la media de ambas
+     * @param leftSpeed, rightSpeed Velocidades a establecer. Deben estar comprendidas en el rango de velocidades
+     * mínima y máxima
+     */
+    void RoboCar::setWheelSpeeds(int leftSpeed, int rightSpeed) {
+        this->speed = (leftSpeed + rightSpeed) / 2;
+        this->leftSpeed = leftSpeed;
+        this->rightSpeed = rightSpeed;
+        applySpeedLimit(leftSpeed, rightSpeed);
+        leftWheel->setSpeed(leftSpeed);
+        rightWheel->setSpeed(rightSpeed);
+        updateOdometry();
+    }
+
+    /**
+     * @brief Velocidades de referencia de cada rueda (tacos/s, sin signo: el sentido lo indica cada rueda)
+     */
+    void RoboCar::getWheelSpeeds(int &left, int &right) const {
+        left = leftSpeed;
+        right = rightSpeed;
     }
 
     /**
@@ -264,55 +386,384 @@ namespace RoboCar{
 
     /**
      * @brief Actualiza la velocidad de las ruedas, para así regularlas y que estás vuelvan a alcanzar la velocidad
-     * indicada inicialmente. Es recomendable que esta función sea llamada de forma periódica mientras el vehículo se
-     * encuentra en movimiento.
+     * indicada inicialmente. Además de la velocidad de cada rueda, se corrige la diferencia de tacos acumulada entre
+     * ambas (ver synchronizeWheels). Es recomendable que esta función sea llamada de forma periódica mientras el
+     * vehículo se encuentra en movimiento. Si se ha ordenado detener el coche desde el monitor o lo ha detenido el
+     * watchdog, se mantiene detenido
      */
     void RoboCar::updateSpeed() {
-        leftWheel->updateSpeed(speed);
-        rightWheel->updateSpeed(speed);
+        LiveState *live = LiveState::get();
+        Watchdog *watchdog = Watchdog::get();
+        if ((live != nullptr && live->stopRequested()) || (watchdog != nullptr && watchdog->hasTripped())) {
+            stop();
+            return;
+        }
+        int left = leftSpeed, right = rightSpeed;
+        applySpeedLimit(left, right);
+        synchronizeWheels(left, right);
+        leftWheel->updateSpeed(left);
+        rightWheel->updateSpeed(right);
+        updateOdometry();
+    }
+
+    WheelMotor *RoboCar::getWheel(Wheel wheel) const {
+        return (wheel == LEFT) ? leftWheel : rightWheel;
+    }
+
+    /**
+     * @brief Igual que updateSpeed(), pero con las velocidades de las ruedas ya medidas
+     */
+    void RoboCar::updateSpeed(int leftMeasured, int rightMeasured) {
+        LiveState *live = LiveState::get();
+        Watchdog *watchdog = Watchdog::get();
+        if ((live != nullptr && live->stopRequested()) || (watchdog != nullptr && watchdog->hasTripped())) {
+            stop();
+            return;
+        }
+        int left = leftSpeed, right = rightSpeed;
+        applySpeedLimit(left, right);
+        synchronizeWheels(left, right);
+        leftWheel->updateSpeed(left, leftMeasured);
+        rightWheel->updateSpeed(right, rightMeasured);
+        updateOdometry();
     }
 
     /**
      * @brief Se toma una medida de la distancia, en CM, desde el vehículo al siguiente obstáculo que se encuentre
      * en frente de él. Debido a la variación en las medidas que ofrece el sensor, se realizan varias medidas y se
-     * seleccionan las que, estadísticamente, se consideran más correctas.
+     * seleccionan las que, estadísticamente, se consideran más correctas. Si hay un mapa asociado, cada medida
+     * válida se integra en él desde la posición en la que se tomó.
      * @return Distancia, en CM, a la que se encuentra el pŕoximo obstáculo
      */
     float RoboCar::getDistance() {
-        // Tomamos NUM_DISTANCE_MEASURES (p.e: 11), comprobando que no se estén tomando medidas erróneas
-        std::vector<float> distances;
-        for (int i = 0; i < NUM_DISTANCE_MEASURES; i++) {
-            float distance = ultrasoundSensor->getDistance();
-            if (distance != -1) {
-                distances.push_back(distance);
-            }
+        // Tomamos parameters.distanceMeasures (p.e: 11), comprobando que no se estén tomando medidas erróneas. Se
+        // guardan en un array fijo, sin reservar memoria
+        float distances[MAX_DISTANCE_MEASURES];
+        int count = 0;
+        int measures = std::min(getParameters().distanceMeasures, MAX_DISTANCE_MEASURES);
+        for (int i = 0; i < measures; i++) {
+            float distance = getSingleDistance();
+            if (distance != -1)
+                distances[count++] = distance;
         }
+        float distance = filterDistances(distances, count);
+        LiveState *live = LiveState::get();
+        if (live != nullptr)
+            live->setDistance(distance);
+        return distance;
+    }
+
+    /**
+     * @brief Se toma una única medida de la distancia, sin filtrar, en la dirección en la que esté montado el sensor.
+     * Permite muestrear a la máxima frecuencia del sensor. Si hay un mapa asociado, la medida se integra en él. Antes y
+     * después de la medida se consultan los encoders, de forma que una serie de medidas no deja sin contar los tacos
+     * @return Distancia, en CM, al próximo obstáculo. -1 en caso de medida errónea
+     */
+    float RoboCar::getSingleDistance() {
+        integrateEncoders();
+        float distance = ultrasoundSensor->getDistance();
+        integrateEncoders();
+        integrateRange(distance, sensorMount);
+        return distance;
+    }
+
+    void RoboCar::integrateRange(float distance, float mount) {
+        if (distance == -1 || map == nullptr)
+            return;
+        Navigation::Pose sensor = getPose();
+        sensor.x += ULTRASOUND_OFFSET_CM * std::cos(sensor.heading);
+        sensor.y += ULTRASOUND_OFFSET_CM * std::sin(sensor.heading);
+        sensor.heading += mount;
+        map->integrate(sensor, distance, ULTRASOUND_BEAM_HALF_ANGLE * (float) M_PI / 180.0f, MAP_MAX_RANGE_CM);
+    }
+
+    /**
+     * @brief Añade al sensor principal los sensores laterales (girados ULTRASOUND_SIDE_MOUNT_DEG a cada lado),
+     * formando un array cuyos disparos se intercalan. El sensor principal se sigue pudiendo usar por separado
+     */
+    void RoboCar::enableUltrasoundArray() {
+        if (ultrasoundArray != nullptr)
+            return;
+        float side = ULTRASOUND_SIDE_MOUNT_DEG * (float) M_PI / 180.0f;
+        sideSensors.push_back(new UltrasoundSensor(pins.leftUltrasoundTrigger, pins.leftUltrasoundEcho));
+        sideSensors.push_back(new UltrasoundSensor(pins.rightUltrasoundTrigger, pins.rightUltrasoundEcho));
+        ultrasoundArray = new UltrasoundArray();
+        ultrasoundArray->addSensor(ultrasoundSensor, sensorMount);
+        ultrasoundArray->addSensor(sideSensors[0], sensorMount + side);
+        ultrasoundArray->addSensor(sideSensors[1], sensorMount - side);
+    }
+
+    UltrasoundArray *RoboCar::getUltrasoundArray() const {
+        return ultrasoundArray;
+    }
+
+    /**
+     * @brief Toma una medida de cada sensor del array (o del sensor principal, si no hay array) y las integra en el
+     * mapa. Las medidas no se filtran: cada sensor dispara una sola vez
+     * @return Distancia, en CM, medida por el sensor principal. -1 en caso de medida errónea
+     */
+    float RoboCar::scanRanges() {
+        if (ultrasoundArray == nullptr)
+            return getSingleDistance();
+        ultrasoundArray->scan();
+        for (int i = 0; i < ultrasoundArray->getSize(); i++)
+            integrateRange(ultrasoundArray->getReading(i).distance, ultrasoundArray->getReading(i).mount);
+        float distance = ultrasoundArray->getReading(0).distance;
+        LiveState *live = LiveState::get();
+        if (live != nullptr)
+            live->setDistance(distance);
+        return distance;
+    }
+
+    /**
+     * @brief Indica la orientación con la que está montado el sensor de ultrasonidos (p.e: girado hacia un lado para
+     * seguir paredes), para integrar las medidas en el mapa en la dirección correcta
+     * @param angle Ángulo respecto al eje del coche (radianes, positivo hacia la izquierda)
+     */
+    void RoboCar::setSensorMount(float angle) {
+        sensorMount = angle;
+    }
+
+    UltrasoundSensor *RoboCar::getUltrasoundSensor() const {
+        return ultrasoundSensor;
+    }
+
+    /**
+     * @brief Registra una medida del sensor principal tomada sin bloquear: se graba en la sesión, si se está grabando,
+     * y se integra en el mapa, si lo hay
+     * @param distance Distancia en CM, -1 si la medida es errónea
+     */
+    void RoboCar::registerRange(float distance) {
+        SessionRecorder *recorder = SessionRecorder::get();
+        if (recorder != nullptr)
+            recorder->recordRange(distance);
+        integrateRange(distance, sensorMount);
+    }
+
+    /**
+     * @brief Filtrado estadístico de un conjunto de medidas de distancia: se descartan las que se alejan de la mediana
+     * más de una desviación típica y se calcula la media del resto
+     * @param distances Medidas válidas (se reordenan)
+     * @param count Número de medidas
+     * @return Distancia filtrada, en CM. -1 si no hay medidas
+     */
+    float RoboCar::filterDistances(float *distances, int count) {
         // En caso de que hayan sido todas erróneas, devolvemos error
-        if (distances.empty())
+        if (count == 0)
             return -1;
 
         // Ordenamos las medidas tomadas para poder calcular la mediana
-        std::sort(distances.begin(), distances.end());
-        float median = distances[distances.size() / 2];
+        std::sort(distances, distances + count);
+        float median = distances[count / 2];
 
         // Calculamos la desviación típica de las medidas tomadas
-        float sum = std::accumulate(distances.begin(), distances.end(), 0.0f);
-        float mean = sum / distances.size();
-        float sqSum = std::inner_product(distances.begin(), distances.end(), distances.begin(), 0.0);
-        float stDev = std::sqrt(sqSum / distances.size() - mean * mean);
+        float sum = std::accumulate(distances, distances + count, 0.0f);
+        float mean = sum / count;
+        float sqSum = std::inner_product(distances, distances + count, distances, 0.0);
+        float stDev = std::sqrt(sqSum / count - mean * mean);
 
         // Calculamos la distancia como la media de los valores que entre en el rango [median - stDev >= X <= median + stDev]
         float total = 0.0f;
         int elementsForMean = 0;
-        for (float distance: distances) {
-            if (distance >= median - stDev && distance <= median + stDev) {
-                total += distance;
+        for (int i = 0; i < count; i++) {
+            if (distances[i] >= median - stDev && distances[i] <= median + stDev) {
+                total += distances[i];
                 elementsForMean++;
             }
         }
         return total / elementsForMean;
     }
 
+    /**
+     * @brief Posición estimada del coche por odometría, respecto a la posición en la que se creó. Consulta los
+     * encoders, por lo que cuanto más a menudo se llame más exacta es la cuenta de tacos
+     * @return Posición (CM) y orientación (radianes) actuales
+     */
+    Navigation::Pose RoboCar::getPose() {
+        heartbeat();
+        integrateEncoders();
+        return odometry.getPose();
+    }
+
+    /**
+     * @brief Distancia recorrida por el coche según la odometría, desde que se creó
+     * @return Distancia recorrida (CM), sumando los tramos hacia delante y hacia atrás
+     */
+    float RoboCar::getTravelled() {
+        integrateEncoders();
+        return (float) odometry.getTravelled();
+    }
+
+    /**
+     * @brief Tacos contados en el encoder de cada rueda desde que se creó el coche
+     * @param left, right Tacos de cada rueda, en valor absoluto
+     */
+    void RoboCar::getWheelTicks(float &left, float &right) {
+        heartbeat();
+        integrateEncoders();
+        left = leftTicks;
+        right = rightTicks;
+    }
+
+    /**
+     * @brief Velocidad estimada de cada rueda, sin consultar los encoders
+     * @param left, right Velocidades (tacos/s), negativas hacia atrás
+     */
+    void RoboCar::getWheelVelocities(int &left, int &right) const {
+        left = leftWheel->getVelocity();
+        right = rightWheel->getVelocity();
+    }
+
+    /**
+     * @brief Consulta los encoders de ambas ruedas y devuelve los tacos contados por sondeo, los mismos que integra la
+     * odometría. Refleja el movimiento real de las ruedas (incluida la inercia al arrancar y al detenerse); si no se
+     * consulta con frecuencia, los flancos perdidos se estiman con la última velocidad medida
+     * @param left, right Tacos contados en cada rueda, en valor absoluto
+     */
+    void RoboCar::pollEncoders(float &left, float &right) {
+        heartbeat();
+        left = leftWheel->countTicks();
+        right = rightWheel->countTicks();
+    }
+
+    /**
+     * @brief Asocia un mapa de ocupación, que se actualizará con cada medida de distancia
+     * @param map Mapa a actualizar (nullptr para dejar de mapear). Debe existir mientras esté asociado
+     */
+    void RoboCar::setMap(Navigation::OccupancyGrid *map) {
+        this->map = map;
+    }
+
+    Navigation::OccupancyGrid *RoboCar::getMap() const {
+        return map;
+    }
+
+    /**
+     * @brief Integra el movimiento hasta ahora: los tacos contados hasta la orden a los motores aún llevan el sentido
+     * anterior de las ruedas
+     */
+    void RoboCar::updateOdometry() {
+        integrateEncoders();
+        int left = leftWheel->getDirection() * leftSpeed, right = rightWheel->getDirection() * rightSpeed;
+        if (left != syncLeftSpeed || right != syncRightSpeed) {
+            syncLeftSpeed = left;
+            syncRightSpeed = right;
+            if (left != 0 && right != 0) {
+                syncLeftTicks = leftWheel->countTicks();
+                syncRightTicks = rightWheel->countTicks();
+            }
+        }
+        publishState();
+        heartbeat();
+    }
+
+    /**
+     * @brief Consulta los encoders e integra en la odometría los tacos recorridos por cada rueda desde la
+     * actualización anterior, con el sentido en que ha girado (ver WheelMotor::getPosition)
+     */
+    void RoboCar::integrateEncoders() {
+        leftTicks = leftWheel->countTicks();
+        rightTicks = rightWheel->countTicks();
+        float left = leftWheel->getPosition(), right = rightWheel->getPosition();
+        odometry.addTicks(left - leftPosition, right - rightPosition);
+        leftPosition = left;
+        rightPosition = right;
+    }
+
+    /**
+     * @brief Señal de vida del bucle principal para el watchdog, si lo hay. Se da en cada orden a los motores y en cada
+     * consulta de la posición, que son las operaciones que repiten todos los modos y maniobras
+     */
+    void RoboCar::heartbeat() {
+        Watchdog *watchdog = Watchdog::get();
+        if (watchdog != nullptr)
+            watchdog->beat(WATCHDOG_LOOP);
+    }
+
+    /**
+     * @brief Anuncia al watchdog una espera intencionada del bucle principal (p.e: un giro por tiempo)
+     * @param duration Duración de la espera en us
+     */
+    void RoboCar::allowWait(long long duration) {
+        Watchdog *watchdog = Watchdog::get();
+        if (watchdog != nullptr)
+            watchdog->allow(WATCHDOG_LOOP, duration);
+    }
+
+    /**
+     * @brief Ficheros que escriben las paradas de ambas ruedas (ver WheelMotor::getStopFiles)
+     * @param files Se añaden las rutas reales; queda vacío si el backend no trabaja sobre ficheros (simulación)
+     */
+    void RoboCar::getStopFiles(std::vector<string> &files) {
+        leftWheel->getStopFiles(files);
+        rightWheel->getStopFiles(files);
+    }
+
+    /**
+     * @brief Control cruzado de las ruedas: además de que cada rueda alcance su velocidad, los tacos contados en los
+     * encoders desde que empezó el tramo han de guardar la proporción de las velocidades de referencia (los mismos en
+     * línea recta). La diferencia acumulada es el error de orientación, que la regulación de cada rueda por separado
+     * no corrige: la corrección se resta de la referencia de la rueda adelantada y se suma a la de la retrasada, en
+     * proporción a sus velocidades. Si una de las ruedas está parada no se corrige nada. Los tacos son exactos si se
+     * consultan los encoders con frecuencia (p.e: las misiones cuentan cada flanco); si no, se estiman a partir de la
+     * última velocidad medida
+     * @param left, right Velocidades de referencia (tacos/s) a corregir
+     */
+    void RoboCar::synchronizeWheels(int &left, int &right) {
+        float gain = getParameters().syncGain;
+        if (gain <= 0 || syncLeftSpeed == 0 || syncRightSpeed == 0 || left <= 0 || right <= 0)
+            return;
+        float leftTicks = leftWheel->countTicks() - syncLeftTicks;
+        float rightTicks = rightWheel->countTicks() - syncRightTicks;
+        float mean = (left + right) / 2.0f;
+        float error = (leftTicks * right - rightTicks * left) / (2 * mean);
+        float correction = std::clamp(gain * error / mean, -WHEEL_SYNC_MAX_CORRECTION, WHEEL_SYNC_MAX_CORRECTION);
+        left = (int) std::lround(left * (1 - correction));
+        right = (int) std::lround(right * (1 + correction));
+    }
+
+    /**
+     * @brief Limita las velocidades de las ruedas a la máxima indicada desde el monitor (nunca por debajo de la
+     * mínima calibrada), escalando ambas por igual para no alterar la curvatura de la trayectoria
+     * @param left, right Velocidades a limitar (tacos/s)
+     */
+    void RoboCar::applySpeedLimit(int &left, int &right) const {
+        LiveState *live = LiveState::get();
+        if (live == nullptr)
+            return;
+        int limit = live->getSpeedLimit();
+        int fastest = std::max(left, right);
+        if (limit <= 0 || fastest <= limit)
+            return;
+        limit = std::max(limit, minSpeed);
+        if (left > 0)
+            left = std::max(minSpeed, left * limit / fastest);
+        if (right > 0)
+            right = std::max(minSpeed, right * limit / fastest);
+    }
+
+    /**
+     * @brief Publica el estado de las ruedas y la posición, si se está publicando el estado del coche. Solo escribe
+     * en memoria, sin llamadas al sistema
+     */
+    void RoboCar::publishState() {
+        LiveState *live = LiveState::get();
+        if (live == nullptr)
+            return;
+        Navigation::Pose pose = odometry.getPose();
+        LiveStateData &state = live->beginUpdate();
+        state.commandedLeft = leftSpeed;
+        state.commandedRight = rightSpeed;
+        state.measuredLeft = leftWheel->getVelocity();
+        state.measuredRight = rightWheel->getVelocity();
+        state.dutyLeft = leftWheel->getDutyCycle();
+        state.dutyRight = rightWheel->getDutyCycle();
+        state.x = pose.x;
+        state.y = pose.y;
+        state.heading = pose.heading;
+        live->endUpdate();
+    }
+
     /**
      * @brief Enciende el LED del color especificado
      * @param color Color del LED a encender
@@ -329,6 +780,9 @@ namespace RoboCar{
                 std::cerr << "Color de LED invalido" << std::endl;
                 break;
         }
+        LiveState *live = LiveState::get();
+        if (live != nullptr)
+            live->setLed(color == GREEN ? LIVE_GREEN_LED : LIVE_RED_LED, (color == GREEN ? greenLed : redLed)->isOn());
     }
 
     /**
@@ -347,6 +801,9 @@ namespace RoboCar{
                 std::cerr << "Color de LED invalido" << std::endl;
                 break;
         }
+        LiveState *live = LiveState::get();
+        if (live != nullptr)
+            live->setLed(color == GREEN ? LIVE_GREEN_LED : LIVE_RED_LED, (color == GREEN ? greenLed : redLed)->isOn());
     }
 
     /**
@@ -365,6 +822,9 @@ namespace RoboCar{
                 std::cerr << "Color de LED invalido" << std::endl;
                 break;
         }
+        LiveState *live = LiveState::get();
+        if (live != nullptr)
+            live->setLed(color == GREEN ? LIVE_GREEN_LED : LIVE_RED_LED, (color == GREEN ? greenLed : redLed)->isOn());
     }
 
     /**
@@ -385,8 +845,8 @@ namespace RoboCar{
      * @return true si se ha guardado correctamente, false si ha ocurrido algún error
      */
     bool RoboCar::saveCalibration() {
-        return leftWheel->saveCalibration(LEFT_WHEEL_CALIBRATION_NAME) &&
-               rightWheel->saveCalibration(RIGHT_WHEEL_CALIBRATION_NAME);
+        return leftWheel->saveCalibration(calibrationPath + LEFT_WHEEL_CALIBRATION_NAME) &&
+               rightWheel->saveCalibration(calibrationPath + RIGHT_WHEEL_CALIBRATION_NAME);
     }
 
     /**
@@ -394,8 +854,8 @@ namespace RoboCar{
      * @return pair<minimo, maximo> con las velocidades cargadas, <0, 0> en caso de error
      */
     pair<int, int> RoboCar::loadCalibration() {
-        pair<int, int> left = leftWheel->loadCalibration(LEFT_WHEEL_CALIBRATION_NAME);
-        pair<int, int> right = rightWheel->loadCalibration(RIGHT_WHEEL_CALIBRATION_NAME);
+        pair<int, int> left = leftWheel->loadCalibration(calibrationPath + LEFT_WHEEL_CALIBRATION_NAME);
+        pair<int, int> right = rightWheel->loadCalibration(calibrationPath + RIGHT_WHEEL_CALIBRATION_NAME);
         if (left.minimum != 0 && left.maximum != 0 && right.minimum != 0 && right.maximum != 0) {
             minSpeed = max(left.minimum, right.minimum);
             maxSpeed = min(left.maximum, right.maximum);
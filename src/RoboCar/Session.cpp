@@ -0,0 +1,133 @@
+#include "RoboCar/Session.h"
+#include "PinsLib/Clock.h"
+#include <iostream>
+
+// Identificación del formato de fichero
+#define SESSION_MAGIC           "RCSN"
+#define SESSION_VERSION         1
+#define SESSION_HEADER_SIZE     8
+#define SESSION_RECORD_SIZE     12
+
+namespace RoboCar {
+
+    static SessionRecorder *activeRecorder = nullptr;
+
+    SessionRecorder *SessionRecorder::get() {
+        return activeRecorder;
+    }
+
+    void SessionRecorder::set(SessionRecorder *recorder) {
+        activeRecorder = recorder;
+    }
+
+    SessionRecorder::SessionRecorder() {
+        startTime = 0;
+    }
+
+    SessionRecorder::~SessionRecorder() {
+        close();
+    }
+
+    /**
+     * @brief Abre el fichero de sesión y escribe su cabecera. Las marcas de tiempo de las muestras
+     * se toman a partir de este momento
+     * @param filename Nombre del fichero donde se guardará la sesión
+     * @return true si se pudo abrir el fichero, false en caso contrario
+     */
+    bool SessionRecorder::open(const std::string &filename) {
+        out.open(filename, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "No se pudo abrir el fichero de sesion " << filename << " para escritura" << std::endl;
+            return false;
+        }
+        char header[SESSION_HEADER_SIZE] = {SESSION_MAGIC[0], SESSION_MAGIC[1], SESSION_MAGIC[2], SESSION_MAGIC[3],
+                                            (char) (SESSION_VERSION & 0xFF), (char) (SESSION_VERSION >> 8), 0, 0};
+        out.write(header, SESSION_HEADER_SIZE);
+        startTime = PinsLib::Clock::get()->now();
+        return true;
+    }
+
+    /**
+     * @brief Termina la grabación, volcando a disco las muestras pendientes
+     */
+    void SessionRecorder::close() {
+        if (out.is_open())
+            out.close();
+    }
+
+    /**
+     * @brief Registra una medida del sensor de ultrasonidos
+     * @param distance Distancia medida en CM (-1 si la medida fue errónea)
+     */
+    void SessionRecorder::recordRange(float distance) {
+        record(RANGE_SAMPLE, (distance < 0) ? -1 : (int) (distance * 10.0f));
+    }
+
+    /**
+     * @brief Registra una medida de velocidad del encoder de una rueda
+     * @param wheel Rueda a la que pertenece la medida
+     * @param speed Velocidad medida en tacos/s
+     */
+    void SessionRecorder::recordSpeed(Wheel wheel, int speed) {
+        record(wheel == LEFT ? LEFT_SPEED_SAMPLE : RIGHT_SPEED_SAMPLE, speed);
+    }
+
+    void SessionRecorder::record(SessionRecordType type, int value) {
+        if (!out.is_open())
+            return;
+        if (value > INT16_MAX) value = INT16_MAX;
+        if (value < INT16_MIN) value = INT16_MIN;
+
+        uint64_t time = (uint64_t) (PinsLib::Clock::get()->now() - startTime);
+        uint16_t raw = (uint16_t) (int16_t) value;
+        char buffer[SESSION_RECORD_SIZE];
+        for (int i = 0; i < 8; i++)
+            buffer[i] = (char) ((time >> (8 * i)) & 0xFF);
+        buffer[8] = (char) type;
+        buffer[9] = 0;
+        buffer[10] = (char) (raw & 0xFF);
+        buffer[11] = (char) (raw >> 8);
+        out.write(buffer, SESSION_RECORD_SIZE);
+    }
+
+    /**
+     * @brief Carga todas las muestras de un fichero de sesión, ordenadas por tiempo
+     * @param filename Nombre del fichero de sesión
+     * @param records Vector donde se devolverán las muestras
+     * @return true si el fichero es válido, false en caso contrario
+     */
+    bool loadSession(const std::string &filename, std::vector<SessionRecord> &records) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "No se pudo abrir el fichero de sesion " << filename << " para lectura" << std::endl;
+            return false;
+        }
+
+        unsigned char header[SESSION_HEADER_SIZE];
+        if (!in.read((char *) header, SESSION_HEADER_SIZE) || std::string((char *) header, 4) != SESSION_MAGIC) {
+            std::cerr << "El fichero " << filename << " no es una sesion valida" << std::endl;
+            return false;
+        }
+        int version = header[4] | (header[5] << 8);
+        if (version != SESSION_VERSION) {
+            std::cerr << "Version de sesion no soportada: " << version << std::endl;
+            return false;
+        }
+
+        records.clear();
+        unsigned char buffer[SESSION_RECORD_SIZE];
+        while (in.read((char *) buffer, SESSION_RECORD_SIZE)) {
+            uint64_t time = 0;
+            for (int i = 0; i < 8; i++)
+                time |= (uint64_t) buffer[i] << (8 * i);
+            int16_t value = (int16_t) (buffer[10] | (buffer[11] << 8));
+            SessionRecordType type = (SessionRecordType) buffer[8];
+            if (type < RANGE_SAMPLE || type > RIGHT_SPEED_SAMPLE)
+                continue;
+            float decoded = (type == RANGE_SAMPLE && value >= 0) ? value / 10.0f : (float) value;
+            records.push_back({(long long) time, type, decoded});
+        }
+        return true;
+    }
+
+} /* namespace RoboCar */
@@ -0,0 +1,38 @@
+#include "RoboCar/TeleopProtocol.h"
+#include <cstring>
+
+namespace RoboCar {
+
+    /**
+     * @brief Escribe la cabecera y el contenido de una trama
+     * @param buffer Destino, de al menos TELEOP_MAX_FRAME bytes
+     * @param length Tamaño del contenido (como mucho TELEOP_MAX_PAYLOAD)
+     * @return Tamaño total de la trama
+     */
+    size_t encodeTeleopFrame(uint8_t *buffer, TeleopFrameType type, const void *payload, uint8_t length) {
+        buffer[0] = type;
+        buffer[1] = length;
+        if (length > 0)
+            memcpy(buffer + TELEOP_HEADER_SIZE, payload, length);
+        return TELEOP_HEADER_SIZE + length;
+    }
+
+    /**
+     * @brief Extrae la siguiente trama de los bytes recibidos. El contenido apunta a data, sin copiarlo
+     * @param data, size Bytes recibidos pendientes de procesar
+     * @param frame Trama extraída
+     * @return Bytes que ocupa la trama, 0 si todavía no se ha recibido completa
+     */
+    size_t decodeTeleopFrame(const uint8_t *data, size_t size, TeleopFrame &frame) {
+        if (size < TELEOP_HEADER_SIZE)
+            return 0;
+        size_t total = TELEOP_HEADER_SIZE + data[1];
+        if (size < total)
+            return 0;
+        frame.type = (TeleopFrameType) data[0];
+        frame.length = data[1];
+        frame.payload = data + TELEOP_HEADER_SIZE;
+        return total;
+    }
+
+} /* namespace RoboCar */
@@ -0,0 +1,495 @@
+#include "RoboCar/TeleopServer.h"
+#include "RoboCar/Watchdog.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Periodo (us) del temporizador del bucle de eventos: telemetría, sensado y parada de seguridad
+#define TELEOP_TICK_UMS             10000
+
+// Si se está conduciendo con órdenes de velocidad y no llega ninguna en este tiempo (us), el coche se detiene
+#define TELEOP_DEADMAN_UMS          500000
+
+// Periodo (us) de las medidas de distancia para la telemetría (solo si hay algún suscriptor) y periodo mínimo de esta
+#define TELEOP_SENSING_UMS          100000
+#define TELEOP_MIN_TELEMETRY_UMS    10000
+
+// Eventos atendidos por cada llamada a epoll_wait y latencias que se guardan para calcular los percentiles
+#define TELEOP_MAX_EVENTS           16
+#define TELEOP_LATENCY_SAMPLES      200000
+
+namespace RoboCar {
+
+    // Signo de una velocidad (-1, 0, 1)
+    static int sign(int value) {
+        return (value > 0) - (value < 0);
+    }
+
+    TeleopServer::TeleopServer(RoboCar *car, const std::string &path) {
+        this->car = car;
+        this->clock = PinsLib::Clock::get();
+        this->path = path;
+        this->listenFd = -1;
+        this->epollFd = -1;
+        this->timerFd = -1;
+        for (Client &client : clients)
+            client.fd = -1;
+        this->velocityActive = false;
+        this->lastVelocity = 0;
+        this->nextSensing = 0;
+        this->distance = -1;
+        this->motion = 0;
+        this->appliedLeft = -1;
+        this->appliedRight = -1;
+        this->commands = 0;
+        this->coalesced = 0;
+        this->batches = 0;
+        this->invalid = 0;
+        this->telemetrySent = 0;
+        this->telemetryDropped = 0;
+        this->totalLatency = 0;
+        this->maxLatency = 0;
+    }
+
+    TeleopServer::~TeleopServer() {
+        close();
+    }
+
+    /**
+     * @brief Crea el socket de escucha (no bloqueante), el temporizador y la instancia de epoll que los atiende
+     * @return true si se ha creado correctamente, false en caso contrario
+     */
+    bool TeleopServer::open() {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "La ruta del socket de teleoperacion es demasiado larga: " << path << std::endl;
+            return false;
+        }
+        strcpy(address.sun_path, path.c_str());
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd == -1) {
+            perror("TeleopServer: socket failed ");
+            return false;
+        }
+        unlink(path.c_str());
+        if (bind(listenFd, (sockaddr *) &address, sizeof(address)) == -1 || listen(listenFd, TELEOP_MAX_CLIENTS) == -1) {
+            perror("TeleopServer: bind failed ");
+            close();
+            return false;
+        }
+
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        itimerspec period = {{0, TELEOP_TICK_UMS * 1000}, {0, TELEOP_TICK_UMS * 1000}};
+        if (timerFd == -1 || timerfd_settime(timerFd, 0, &period, nullptr) == -1) {
+            perror("TeleopServer: timerfd failed ");
+            close();
+            return false;
+        }
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        bool registered = epollFd != -1 && epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+        event.data.fd = timerFd;
+        registered = registered && epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event) == 0;
+        if (!registered) {
+            perror("TeleopServer: epoll failed ");
+            close();
+            return false;
+        }
+        latencies.reserve(TELEOP_LATENCY_SAMPLES);
+        return true;
+    }
+
+    void TeleopServer::close() {
+        for (Client &client : clients) {
+            if (client.fd != -1)
+                closeClient(client);
+        }
+        if (epollFd != -1)
+            ::close(epollFd);
+        if (timerFd != -1)
+            ::close(timerFd);
+        if (listenFd != -1) {
+            ::close(listenFd);
+            unlink(path.c_str());
+        }
+        epollFd = timerFd = listenFd = -1;
+    }
+
+    /**
+     * @brief Bucle de eventos. Si el reloj del coche es virtual (simulación) se hace avanzar con el tiempo real,
+     * para que el coche simulado responda a las órdenes al mismo ritmo que el real
+     * @param duration Tiempo de funcionamiento en us
+     */
+    void TeleopServer::run(long long duration) {
+        PinsLib::VirtualClock *virtualClock = dynamic_cast<PinsLib::VirtualClock *>(clock);
+        long long realStart = realClock.now(), virtualStart = clock->now();
+        long long end = clock->now() + duration;
+        epoll_event events[TELEOP_MAX_EVENTS];
+        Watchdog *watchdog = Watchdog::get();
+
+        while (clock->now() < end) {
+            if (watchdog != nullptr && watchdog->hasTripped()) {
+                std::cerr << "Detenido por el watchdog" << std::endl;
+                break;
+            }
+            int count = epoll_wait(epollFd, events, TELEOP_MAX_EVENTS, -1);
+            if (count == -1) {
+                if (errno == EINTR)
+                    continue;
+                perror("TeleopServer: epoll_wait failed ");
+                break;
+            }
+            if (virtualClock != nullptr)
+                virtualClock->sleepUntil(virtualStart + realClock.now() - realStart);
+
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptClient();
+                } else if (fd == timerFd) {
+                    uint64_t expirations;
+                    if (read(timerFd, &expirations, sizeof(expirations)) > 0)
+                        tick();
+                } else {
+                    for (Client &client : clients) {
+                        if (client.fd == fd) {
+                            readClient(client);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        car->stop();
+    }
+
+    /**
+     * @brief Acepta las conexiones pendientes y envía a cada cliente la versión del protocolo y las velocidades
+     * calibradas. Si no quedan huecos, la conexión se cierra
+     */
+    void TeleopServer::acceptClient() {
+        int fd;
+        while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+            Client *client = nullptr;
+            for (Client &candidate : clients) {
+                if (candidate.fd == -1) {
+                    client = &candidate;
+                    break;
+                }
+            }
+            if (client == nullptr) {
+                std::cerr << "Teleoperacion: demasiados clientes, se rechaza la conexion" << std::endl;
+                ::close(fd);
+                continue;
+            }
+
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+                perror("TeleopServer: epoll_ctl failed ");
+                ::close(fd);
+                continue;
+            }
+            client->fd = fd;
+            client->used = 0;
+            client->telemetryPeriod = 0;
+            client->nextTelemetry = 0;
+            std::cout << "Teleoperacion: cliente conectado" << std::endl;
+
+            TeleopHello hello = {TELEOP_PROTOCOL_VERSION, (int16_t) car->getMinSpeed(), (int16_t) car->getMaxSpeed()};
+            send(*client, TELEOP_HELLO, &hello, sizeof(hello));
+        }
+    }
+
+    /**
+     * @brief Cierra la conexión con el cliente. Si se estaba conduciendo con órdenes de velocidad, el coche se detiene
+     */
+    void TeleopServer::closeClient(Client &client) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        ::close(client.fd);
+        client.fd = -1;
+        if (velocityActive)
+            applyVelocity(0, 0);
+        std::cout << "Teleoperacion: cliente desconectado" << std::endl;
+    }
+
+    /**
+     * @brief Lee todo lo que haya enviado el cliente y procesa las tramas completas como una ráfaga: de las órdenes de
+     * velocidad solo se aplica la última, ya que las anteriores quedarían sustituidas de inmediato. El resto de
+     * órdenes se ejecutan en el orden en que han llegado
+     */
+    void TeleopServer::readClient(Client &client) {
+        bool closed = false;
+        while (true) {
+            ssize_t bytes = read(client.fd, client.buffer + client.used, TELEOP_BUFFER_SIZE - client.used);
+            if (bytes > 0) {
+                client.used += bytes;
+                if (client.used < TELEOP_BUFFER_SIZE)
+                    continue;
+            } else if (bytes == 0 || (errno != EAGAIN && errno != EINTR)) {
+                closed = true;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        long long received = realClock.now();
+
+        // Última orden de velocidad completa de la ráfaga
+        size_t offset = 0, lastVelocityOffset = (size_t) -1, consumed;
+        TeleopFrame frame;
+        while ((consumed = decodeTeleopFrame(client.buffer + offset, client.used - offset, frame)) > 0) {
+            if (frame.type == TELEOP_VELOCITY)
+                lastVelocityOffset = offset;
+            offset += consumed;
+        }
+
+        size_t end = offset;
+        offset = 0;
+        if (end > 0)
+            batches++;
+        while (offset < end) {
+            consumed = decodeTeleopFrame(client.buffer + offset, end - offset, frame);
+            if (frame.type == TELEOP_VELOCITY && offset != lastVelocityOffset)
+                coalesced++;
+            else
+                execute(client, frame, received);
+            offset += consumed;
+        }
+
+        // Se conserva la trama incompleta, si la hay
+        memmove(client.buffer, client.buffer + end, client.used - end);
+        client.used -= end;
+        if (client.used == TELEOP_BUFFER_SIZE) {
+            std::cerr << "Teleoperacion: trama invalida, se cierra la conexion" << std::endl;
+            closed = true;
+        }
+        if (closed)
+            closeClient(client);
+    }
+
+    /**
+     * @brief Ejecuta una orden sobre el coche y registra la latencia desde que se recibió
+     */
+    void TeleopServer::execute(Client &client, const TeleopFrame &frame, long long received) {
+        switch (frame.type) {
+            case TELEOP_VELOCITY: {
+                if (frame.length != sizeof(TeleopVelocity))
+                    break;
+                TeleopVelocity velocity;
+                memcpy(&velocity, frame.payload, sizeof(velocity));
+                applyVelocity(velocity.left, velocity.right);
+                break;
+            }
+            case TELEOP_MANEUVER: {
+                if (frame.length != sizeof(TeleopManeuverCommand))
+                    break;
+                velocityActive = false;
+                motion = -1;
+                switch (frame.payload[0]) {
+                    case MANEUVER_STOP:
+                        car->stop();
+                        break;
+                    case MANEUVER_FORWARD:
+                        car->goForward();
+                        break;
+                    case MANEUVER_BACKWARD:
+                        car->goBackward();
+                        break;
+                    case MANEUVER_ROTATE_LEFT:
+                        car->rotateLeft();
+                        break;
+                    case MANEUVER_ROTATE_RIGHT:
+                        car->rotateRight();
+                        break;
+                    default:
+                        invalid++;
+                        return;
+                }
+                break;
+            }
+            case TELEOP_SET_SPEED: {
+                if (frame.length != sizeof(TeleopSetSpeed))
+                    break;
+                TeleopSetSpeed speed;
+                memcpy(&speed, frame.payload, sizeof(speed));
+                car->setSpeed(std::max(car->getMinSpeed(), std::min(car->getMaxSpeed(), (int) speed.speed)));
+                appliedLeft = appliedRight = -1;
+                break;
+            }
+            case TELEOP_LED: {
+                if (frame.length != sizeof(TeleopLedCommand) || frame.payload[0] > RED)
+                    break;
+                LEDS_COLOR color = (LEDS_COLOR) frame.payload[0];
+                if (frame.payload[1] == LED_ON)
+                    car->turnOnLed(color);
+                else if (frame.payload[1] == LED_OFF)
+                    car->turnOffLed(color);
+                else
+                    car->toggleLed(color);
+                break;
+            }
+            case TELEOP_SUBSCRIBE: {
+                if (frame.length != sizeof(TeleopSubscribe))
+                    break;
+                TeleopSubscribe subscribe;
+                memcpy(&subscribe, frame.payload, sizeof(subscribe));
+                client.telemetryPeriod = (subscribe.period == 0) ? 0 :
+                                         std::max((long long) subscribe.period * 1000, (long long) TELEOP_MIN_TELEMETRY_UMS);
+                client.nextTelemetry = clock->now();
+                return;
+            }
+            case TELEOP_PING:
+                if (frame.length != sizeof(TeleopPing))
+                    break;
+                send(client, TELEOP_PONG, frame.payload, frame.length);
+                return;
+            case TELEOP_STATS: {
+                TeleopStats stats = {(uint32_t) commands, (uint32_t) coalesced, (uint32_t) batches,
+                                     commands > 0 ? (float) totalLatency / commands : 0, (float) maxLatency};
+                send(client, TELEOP_STATS_REPLY, &stats, sizeof(stats));
+                return;
+            }
+            default:
+                invalid++;
+                return;
+        }
+
+        long long latency = realClock.now() - received;
+        commands++;
+        totalLatency += latency;
+        maxLatency = std::max(maxLatency, latency);
+        if (latencies.size() < TELEOP_LATENCY_SAMPLES)
+            latencies.push_back(latency);
+    }
+
+    /**
+     * @brief Aplica una velocidad a cada rueda. Las velocidades se limitan al rango calibrado y solo se escriben en
+     * los pines si cambian; el sentido de giro de las ruedas, igualmente, solo se cambia si es distinto del actual.
+     * Con una rueda a 0 el coche gira sobre ella
+     * @param left, right Velocidades (tacos/s, negativas hacia atrás)
+     */
+    void TeleopServer::applyVelocity(int left, int right) {
+        lastVelocity = clock->now();
+        if (left == 0 && right == 0) {
+            velocityActive = false;
+            if (motion != 0)
+                car->stop();
+            motion = 0;
+            return;
+        }
+        velocityActive = true;
+
+        auto clamp = [this](int speed) {
+            return std::max(car->getMinSpeed(), std::min(car->getMaxSpeed(), std::abs(speed)));
+        };
+        int leftSpeed = clamp(left), rightSpeed = clamp(right);
+        if (leftSpeed != appliedLeft || rightSpeed != appliedRight) {
+            car->setWheelSpeeds(leftSpeed, rightSpeed);
+            appliedLeft = leftSpeed;
+            appliedRight = rightSpeed;
+        }
+
+        // Sentido de cada rueda codificado en un único valor (3 * izquierda + derecha)
+        int next = 3 * sign(left) + sign(right);
+        if (next == motion)
+            return;
+        motion = next;
+        if (left > 0 && right > 0)
+            car->goForward();
+        else if (left < 0 && right < 0)
+            car->goBackward();
+        else if (left < 0 && right > 0)
+            car->rotateLeft();
+        else if (left > 0 && right < 0)
+            car->rotateRight();
+        else if (right == 0)
+            (left > 0) ? car->goRight() : car->goBackRight();
+        else
+            (right > 0) ? car->goLeft() : car->goBackLeft();
+    }
+
+    /**
+     * @brief Trabajo periódico: parada de seguridad, medida de la distancia y envío de la telemetría a los suscriptores
+     */
+    void TeleopServer::tick() {
+        Watchdog *watchdog = Watchdog::get();
+        if (watchdog != nullptr)
+            watchdog->beat(WATCHDOG_LOOP);
+        long long now = clock->now();
+        if (velocityActive && now - lastVelocity > TELEOP_DEADMAN_UMS) {
+            std::cout << "Teleoperacion: sin ordenes de velocidad, se detiene el coche" << std::endl;
+            applyVelocity(0, 0);
+        }
+
+        bool subscribers = false;
+        for (Client &client : clients)
+            subscribers = subscribers || (client.fd != -1 && client.telemetryPeriod > 0);
+        if (!subscribers)
+            return;
+        if (now >= nextSensing) {
+            distance = car->getSingleDistance();
+            nextSensing = now + TELEOP_SENSING_UMS;
+            if (watchdog != nullptr && watchdog->isDegraded())
+                nextSensing += (WATCHDOG_SHED_FACTOR - 1) * TELEOP_SENSING_UMS;
+        }
+
+        Navigation::Pose pose = car->getPose();
+        int left, right;
+        car->getWheelVelocities(left, right);
+        TeleopTelemetry telemetry = {now, pose.x, pose.y, pose.heading, distance, (int16_t) left, (int16_t) right};
+        for (Client &client : clients) {
+            if (client.fd == -1 || client.telemetryPeriod == 0 || now < client.nextTelemetry)
+                continue;
+            client.nextTelemetry += client.telemetryPeriod;
+            if (client.nextTelemetry < now)
+                client.nextTelemetry = now + client.telemetryPeriod;
+            if (send(client, TELEOP_TELEMETRY, &telemetry, sizeof(telemetry)))
+                telemetrySent++;
+            else
+                telemetryDropped++;
+        }
+    }
+
+    /**
+     * @brief Envía una trama al cliente sin bloquear. Si el cliente no lee y su socket está lleno, la trama se descarta
+     * @return true si se ha enviado, false en caso contrario
+     */
+    bool TeleopServer::send(Client &client, TeleopFrameType type, const void *payload, uint8_t length) {
+        uint8_t frame[TELEOP_MAX_FRAME];
+        size_t size = encodeTeleopFrame(frame, type, payload, length);
+        return ::send(client.fd, frame, size, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t) size;
+    }
+
+    /**
+     * @brief Muestra las órdenes atendidas, las descartadas por llegar otra velocidad en la misma ráfaga, la telemetría
+     * enviada y la latencia de actuación (us): desde que se leen los bytes de la orden hasta que se ha actuado
+     */
+    void TeleopServer::printReport(std::ostream &out) const {
+        std::vector<long long> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) {
+            return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+        };
+        out << "Teleoperacion: " << commands << " ordenes ejecutadas, " << coalesced << " velocidades agrupadas en "
+            << batches << " rafagas, " << invalid << " invalidas. Telemetria: " << telemetrySent << " enviadas, "
+            << telemetryDropped << " descartadas" << std::endl;
+        out << "Latencia de actuacion (us): media " << (commands > 0 ? totalLatency / (long long) commands : 0)
+            << ", p50 " << percentile(0.50) << ", p99 " << percentile(0.99) << ", max " << maxLatency << std::endl;
+    }
+
+} /* namespace RoboCar */
@@ -0,0 +1,208 @@
+#include "RoboCar/UltrasoundArray.h"
+#include "RoboCar/Watchdog.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RoboCar {
+
+    /**
+     * @param separation Separación angular mínima (grados) entre sensores que pueden tener pulsos en vuelo a la vez
+     * @param range Alcance de las medidas (CM), que fija la ventana de escucha de cada pulso
+     */
+    UltrasoundArray::UltrasoundArray(float separation, float range) {
+        this->clock = PinsLib::Clock::get();
+        this->separation = separation * (float) M_PI / 180.0f;
+        this->window = (long long) (2.0f * range / CM_PER_SECOND * 1000000.0f);
+        this->scanTime = 0;
+        this->topic = nullptr;
+    }
+
+    /**
+     * @brief Añade un sensor y anota con qué sensores ya añadidos no puede tener pulsos en vuelo a la vez (consigo
+     * mismo tampoco: su propio pulso debe extinguirse antes de volver a disparar)
+     * @param sensor Sensor, que sigue siendo propiedad de quien lo ha creado
+     * @param mount Orientación respecto al eje del coche (radianes, positivo hacia la izquierda)
+     * @return Índice del sensor, -1 si ya hay RANGE_ARRAY_CAPACITY sensores
+     */
+    int UltrasoundArray::addSensor(UltrasoundSensor *sensor, float mount) {
+        if (sensors.size() >= RANGE_ARRAY_CAPACITY)
+            return -1;
+        sensors.push_back({sensor, mount, -1, false, {-1, mount, -1}, 0, 0});
+        for (std::vector<bool> &row : conflicts)
+            row.push_back(false);
+        conflicts.emplace_back(sensors.size(), false);
+
+        int index = (int) sensors.size() - 1;
+        for (int other = 0; other <= index; other++) {
+            float difference = std::fabs(std::remainder(mount - sensors[other].mount, 2.0f * (float) M_PI));
+            bool conflict = (other == index) || difference < separation;
+            conflicts[index][other] = conflicts[other][index] = conflict;
+        }
+        return index;
+    }
+
+    int UltrasoundArray::getSize() const {
+        return (int) sensors.size();
+    }
+
+    void UltrasoundArray::setTopic(Bus::Topic<Bus::RangeArrayMessage> *topic) {
+        this->topic = topic;
+    }
+
+    /**
+     * @brief Un sensor puede dispararse si ha terminado su medida anterior y ni él ni ningún sensor próximo tiene un
+     * pulso en vuelo (disparado hace menos de la ventana de escucha)
+     */
+    bool UltrasoundArray::canFire(int index, long long now) const {
+        if (sensors[index].inFlight || !sensors[index].sensor->isIdle())
+            return false;
+        for (size_t other = 0; other < sensors.size(); other++) {
+            if (conflicts[index][other] && sensors[other].fired >= 0 && now - sensors[other].fired < window)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Consulta una vez el eco de cada medida en curso y, después, dispara los sensores que pueden hacerlo,
+     * empezando por el que lleva más tiempo sin dispararse. Si ha terminado alguna medida, publica todas las últimas
+     * @return Número de medidas terminadas en esta llamada
+     */
+    int UltrasoundArray::update() {
+        int finished = 0;
+        for (Sensor &sensor : sensors) {
+            if (sensor.sensor->isIdle() && !sensor.inFlight)
+                continue;
+            float distance;
+            if (sensor.sensor->poll(window, distance)) {
+                sensor.inFlight = false;
+                sensor.latest = {distance, sensor.mount, sensor.fired};
+                sensor.samples++;
+                if (distance == -1)
+                    sensor.invalid++;
+                finished++;
+            }
+        }
+        if (finished > 0 && topic != nullptr) {
+            Bus::RangeArrayMessage message;
+            getReadings(message);
+            topic->publish(message);
+        }
+
+        // Orden de disparo: primero los que llevan más tiempo sin dispararse (sin reservar memoria). Si uno de ellos
+        // está esperando a que se extingan los pulsos de sus vecinos, estos no se vuelven a disparar antes que él: de
+        // lo contrario, dos sensores que no se oyen entre sí podrían alternarse indefinidamente sin dejarle hueco
+        int order[RANGE_ARRAY_CAPACITY];
+        bool reserved[RANGE_ARRAY_CAPACITY] = {false};
+        int count = (int) sensors.size();
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+        std::sort(order, order + count, [this](int a, int b) { return sensors[a].fired < sensors[b].fired; });
+        for (int i = 0; i < count; i++) {
+            int index = order[i];
+            Sensor &sensor = sensors[index];
+            if (reserved[index])
+                continue;
+            if (!canFire(index, clock->now())) {
+                if (!sensor.inFlight && sensor.sensor->isIdle()) {
+                    for (int other = 0; other < count; other++)
+                        reserved[other] = reserved[other] || conflicts[index][other];
+                }
+                continue;
+            }
+            sensor.sensor->fire();
+            sensor.fired = clock->now();
+            sensor.inFlight = true;
+        }
+        return finished;
+    }
+
+    /**
+     * @brief Ejecuta el planificador hasta que todos los sensores han terminado una medida disparada después de la
+     * llamada. Mientras no hay ningún eco que consultar, espera hasta que se pueda disparar el siguiente sensor.
+     * Si hay watchdog, cada medida terminada renueva el plazo del sensado
+     */
+    void UltrasoundArray::scan() {
+        long long start = clock->now();
+        Watchdog *watchdog = Watchdog::get();
+        if (watchdog != nullptr)
+            watchdog->begin(WATCHDOG_SENSING);
+
+        auto pending = [&]() {
+            for (const Sensor &sensor : sensors) {
+                if (sensor.inFlight || sensor.latest.time < start)
+                    return true;
+            }
+            return false;
+        };
+        while (!sensors.empty() && pending()) {
+            if (update() > 0 && watchdog != nullptr)
+                watchdog->begin(WATCHDOG_SENSING);
+            if (watchdog != nullptr && watchdog->hasTripped())
+                break;
+            if (!anyInFlight())
+                clock->sleepUntil(nextFireTime());
+        }
+
+        if (watchdog != nullptr)
+            watchdog->end(WATCHDOG_SENSING);
+        scanTime += clock->now() - start;
+    }
+
+    bool UltrasoundArray::anyInFlight() const {
+        for (const Sensor &sensor : sensors) {
+            if (sensor.inFlight || !sensor.sensor->isIdle())
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * @return Próximo instante en que se extingue el pulso en vuelo de algún sensor (y puede haber uno nuevo)
+     */
+    long long UltrasoundArray::nextFireTime() const {
+        long long now = clock->now(), next = now;
+        for (const Sensor &sensor : sensors) {
+            long long expires = sensor.fired + window;
+            if (sensor.fired >= 0 && expires > now && (next == now || expires < next))
+                next = expires;
+        }
+        return next;
+    }
+
+    const Bus::RangeMessage &UltrasoundArray::getReading(int index) const {
+        return sensors[index].latest;
+    }
+
+    void UltrasoundArray::getReadings(Bus::RangeArrayMessage &message) const {
+        message.count = (int32_t) sensors.size();
+        for (size_t i = 0; i < sensors.size(); i++)
+            message.ranges[i] = sensors[i].latest;
+    }
+
+    UltrasoundArray::Stats UltrasoundArray::getStats() const {
+        Stats stats = {0, 0, scanTime};
+        for (const Sensor &sensor : sensors) {
+            stats.samples += sensor.samples;
+            stats.invalid += sensor.invalid;
+        }
+        return stats;
+    }
+
+    /**
+     * @brief Muestra las medidas de cada sensor y la frecuencia agregada de muestreo durante los barridos
+     */
+    void UltrasoundArray::printReport(std::ostream &out) const {
+        Stats stats = getStats();
+        out << "Array de ultrasonidos: " << sensors.size() << " sensores, " << stats.samples << " medidas ("
+            << stats.invalid << " erroneas)";
+        if (stats.scanTime > 0)
+            out << ", " << stats.samples * 1000000.0 / stats.scanTime << " medidas/s";
+        out << std::endl;
+        for (const Sensor &sensor : sensors) {
+            out << "  " << sensor.mount * 180.0f / (float) M_PI << " grados: " << sensor.samples << " medidas ("
+                << sensor.invalid << " erroneas)" << std::endl;
+        }
+    }
+
+} /* namespace RoboCar */
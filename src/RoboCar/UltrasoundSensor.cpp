@@ -1,15 +1,10 @@
 #include "RoboCar/UltrasoundSensor.h"
+#include "RoboCar/Pinout.h"
+#include "RoboCar/Session.h"
+#include "RoboCar/Watchdog.h"
+#include "PinsLib/Clock.h"
 #include <iostream>
-#include <unistd.h>
 #include <stdio.h>
-#include <time.h>
-
-// Pins GPIO preconfigurados para su uso
-#define ULTRASOUND_TRIGGER_PIN  234
-#define ULTRASOUND_ECHO_PIN     209
-
-// Velocidad del sonido
-#define CM_PER_SECOND           34300.0f
 
 // Parámetros de configuración para las mediciones
 #define UMS_INTERVAL_TIME       5
@@ -20,13 +15,19 @@ namespace RoboCar {
 
     /**
      * @brief Inicializa los pines y configura el sensor
-     * Nota: solo puede existir una instancia de sensor simultáneamente
+     * Nota: solo puede existir una instancia por cada par de pines de un mismo backend simultáneamente
+     * @param triggerPinNumber Pin GPIO del trigger (por defecto, el del sensor frontal)
+     * @param echoPinNumber Pin GPIO del eco
      */
-    UltrasoundSensor::UltrasoundSensor() {
-        triggerPin = new PinsLib::GPIO(ULTRASOUND_TRIGGER_PIN);
+    UltrasoundSensor::UltrasoundSensor(int triggerPinNumber, int echoPinNumber) {
+        triggerPin = new PinsLib::GPIO(triggerPinNumber);
         triggerPin->setDirection(PinsLib::OUTPUT);
-        echoPin = new PinsLib::GPIO(ULTRASOUND_ECHO_PIN);
+        triggerPin->setValue(PinsLib::LOW);
+        echoPin = new PinsLib::GPIO(echoPinNumber);
         echoPin->setDirection(PinsLib::INPUT);
+        state = ULTRASOUND_IDLE;
+        echoStart = 0;
+        attempts = 0;
     }
 
     /**
@@ -38,17 +39,37 @@ namespace RoboCar {
     }
 
     /**
-     * @brief Obtiene la distancia, en centímetros, que mide el sensor hasta el siguiente obstáculo
+     * @brief Obtiene la distancia, en centímetros, que mide el sensor hasta el siguiente obstáculo.
+     * Si se está grabando una sesión, la medida queda registrada en ella. Si hay watchdog, vigila el plazo de la medida
      * @return float Distancia en CM. -1 en caso de medida errónea
      */
     float UltrasoundSensor::getDistance() {
+        Watchdog *watchdog = Watchdog::get();
+        if (watchdog != nullptr)
+            watchdog->begin(WATCHDOG_SENSING);
+        float distance = measureDistance();
+        if (watchdog != nullptr)
+            watchdog->end(WATCHDOG_SENSING);
+        SessionRecorder *recorder = SessionRecorder::get();
+        if (recorder != nullptr)
+            recorder->recordRange(distance);
+        return distance;
+    }
+
+    /**
+     * @brief Realiza una medición de la distancia a partir del tiempo que tarda en volver el eco
+     * @return float Distancia en CM. -1 en caso de medida errónea
+     */
+    float UltrasoundSensor::measureDistance() {
+        PinsLib::Clock *clock = PinsLib::Clock::get();
+
         // Reiniciamos el pin de Trigger
         triggerPin->setValue(PinsLib::LOW);
-        usleep(UMS_INTERVAL_TIME);
+        clock->sleep(UMS_INTERVAL_TIME);
 
         // Emitimos una onda con el trigger
         triggerPin->setValue(PinsLib::HIGH);
-        usleep(UMS_INTERVAL_TIME);
+        clock->sleep(UMS_INTERVAL_TIME);
         triggerPin->setValue(PinsLib::LOW);
 
         // Esperar hasta obtener un 1 en el echo (o que el valor ya sea 0, en el cual será error)
@@ -60,18 +81,89 @@ namespace RoboCar {
             return -1;
 
         // Tomamos una marca de tiempo
-        clock_t startTime = clock();
+        long long startTime = clock->now();
 
-        // Esperar mientras el valor pase a ser 0 (flanco descendente)
-        while(echoPin->getValue() != 0);
+        // Esperar mientras el valor pase a ser 0 (flanco descendente). Si el eco no termina nunca, la espera solo acaba
+        // cuando el watchdog detiene el coche
+        Watchdog *watchdog = Watchdog::get();
+        while(echoPin->getValue() != 0) {
+            if (watchdog != nullptr && watchdog->hasTripped())
+                return -1;
+        }
 
         // Tomamos otra marca de tiempo final
-        clock_t stopTime = clock();
+        long long stopTime = clock->now();
 
         // Calculamos la distancia (en CM)
-        float distance = (((float) (stopTime - startTime) / (float) CLOCKS_PER_SEC) * (float) CM_PER_SECOND) / 2.0f;
+        float distance = (((float) (stopTime - startTime) / 1000000.0f) * (float) CM_PER_SECOND) / 2.0f;
         // Y comprobamos si no se ha superado el umbral de error antes de retornarlo
         return (distance < THRESHOLD_WRONG_VALUE) ? distance : -1;
     }
 
+    /**
+     * @brief Emite el pulso del trigger y deja el sensor esperando el eco, sin bloquearse
+     */
+    void UltrasoundSensor::fire() {
+        PinsLib::Clock *clock = PinsLib::Clock::get();
+        triggerPin->setValue(PinsLib::LOW);
+        clock->sleep(UMS_INTERVAL_TIME);
+        triggerPin->setValue(PinsLib::HIGH);
+        clock->sleep(UMS_INTERVAL_TIME);
+        triggerPin->setValue(PinsLib::LOW);
+        state = ULTRASOUND_WAITING;
+        attempts = 0;
+    }
+
+    /**
+     * @brief Consulta una vez el eco de la medida en curso. La resolución de la medida depende de la frecuencia con
+     * la que se consulte (al atender varios sensores, una lectura de cada uno por vuelta)
+     * @param window Tiempo máximo de eco (us) que se espera; un eco más largo se descarta sin esperar a que termine
+     * @param distance Distancia medida (CM) si la medida ha terminado, -1 si es errónea
+     * @return true si la medida ha terminado en esta consulta
+     */
+    bool UltrasoundSensor::poll(long long window, float &distance) {
+        long long now = PinsLib::Clock::get()->now();
+        int level = echoPin->getValue();
+        switch (state) {
+            case ULTRASOUND_WAITING:
+                if (level == 1) {
+                    state = ULTRASOUND_ECHO;
+                    echoStart = now;
+                } else if (++attempts >= MAX_ATTEMPTS) {
+                    state = ULTRASOUND_IDLE;
+                    distance = -1;
+                    return true;
+                }
+                return false;
+            case ULTRASOUND_ECHO:
+                if (level == 0) {
+                    state = ULTRASOUND_IDLE;
+                    distance = (((float) (now - echoStart) / 1000000.0f) * (float) CM_PER_SECOND) / 2.0f;
+                    if (distance >= THRESHOLD_WRONG_VALUE)
+                        distance = -1;
+                    return true;
+                }
+                if (now - echoStart > window) {
+                    state = ULTRASOUND_DRAINING;
+                    distance = -1;
+                    return true;
+                }
+                return false;
+            case ULTRASOUND_DRAINING:
+                if (level == 0)
+                    state = ULTRASOUND_IDLE;
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    bool UltrasoundSensor::isIdle() const {
+        return state == ULTRASOUND_IDLE;
+    }
+
+    PinsLib::GPIO *UltrasoundSensor::getEchoPin() const {
+        return echoPin;
+    }
+
 } /* namespace RoboCar */
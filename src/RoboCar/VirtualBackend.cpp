@@ -0,0 +1,177 @@
+#include "RoboCar/VirtualBackend.h"
+#include "RoboCar/UltrasoundSensor.h"
+#include "PinsLib/GPIO.h"
+#include "PinsLib/PWM.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace RoboCar {
+
+    // Rutas de los ficheros de control de cada tipo de pin
+    static string gpioPath(int number) {
+        return string(GPIO_PATH) + "gpio" + std::to_string(number) + "/";
+    }
+
+    static string pwmPath(int number) {
+        return string(PWM_PATH) + "pwm-2:" + std::to_string(number) + "/";
+    }
+
+    /**
+     * @brief Prepara un backend virtual sobre el reloj indicado
+     * @param clock Reloj virtual que se hará avanzar con cada operación
+     * @param ioCost Tiempo virtual, en us, que consume cada lectura o escritura de un pin
+     * @param pins Pines del coche cuyo hardware se sustituye
+     */
+    VirtualBackend::VirtualBackend(PinsLib::VirtualClock *clock, long long ioCost, const PinMap &pins) {
+        this->clock = clock;
+        this->ioCost = ioCost;
+        this->commands = nullptr;
+        this->commandCount = 0;
+        for (MotorCommand &motor : motors)
+            motor = {false, false, false, 0, 0};
+
+        addUltrasound(pins.ultrasoundTrigger, pins.ultrasoundEcho);
+        leftEncoderPath = gpioPath(pins.leftEncoder);
+        rightEncoderPath = gpioPath(pins.rightEncoder);
+        leftForwardPath = gpioPath(pins.leftForward);
+        leftBackwardPath = gpioPath(pins.leftBackward);
+        leftPwmPath = pwmPath(pins.leftPwm);
+        rightForwardPath = gpioPath(pins.rightForward);
+        rightBackwardPath = gpioPath(pins.rightBackward);
+        rightPwmPath = pwmPath(pins.rightPwm);
+
+        actuators[leftForwardPath] = "left.forward";
+        actuators[leftBackwardPath] = "left.backward";
+        actuators[leftPwmPath] = "left.pwm";
+        actuators[rightForwardPath] = "right.forward";
+        actuators[rightBackwardPath] = "right.backward";
+        actuators[rightPwmPath] = "right.pwm";
+        actuators[gpioPath(pins.greenLed)] = "led.green";
+        actuators[gpioPath(pins.redLed)] = "led.red";
+    }
+
+    int VirtualBackend::write(const string &path, const string &filename, const string &value) {
+        clock->advance(ioCost);
+        long long now = clock->now();
+        update(now);
+        files[path][filename] = value;
+
+        // Flanco de bajada del trigger: se inicia un pulso de eco con la distancia que corresponda en ese instante
+        for (size_t i = 0; i < echoes.size() && filename == "value"; i++) {
+            Echo &echo = echoes[i];
+            if (path != echo.triggerPath)
+                continue;
+            bool high = (value == "1");
+            if (echo.triggerHigh && !high) {
+                float distance = echoDistance((int) i, now);
+                if (distance < 0) {
+                    echo.start = echo.end = -1;
+                } else {
+                    echo.start = now;
+                    echo.end = now + (long long) (2.0f * distance / CM_PER_SECOND * 1000000.0f);
+                }
+            }
+            echo.triggerHigh = high;
+            return 0;
+        }
+
+        // Órdenes a los motores
+        MotorCommand *motor = (path == leftForwardPath || path == leftBackwardPath || path == leftPwmPath) ? &motors[LEFT] :
+                              (path == rightForwardPath || path == rightBackwardPath || path == rightPwmPath) ? &motors[RIGHT] :
+                              nullptr;
+        if (motor != nullptr) {
+            int number = atoi(value.c_str());
+            if (filename == "value" && (path == leftForwardPath || path == rightForwardPath))
+                motor->forward = (number != 0);
+            else if (filename == "value")
+                motor->backward = (number != 0);
+            else if (filename == "enable")
+                motor->enabled = (number != 0);
+            else if (filename == "duty_cycle")
+                motor->dutyCycle = number;
+            else if (filename == "period")
+                motor->period = number;
+        }
+
+        std::map<string, string>::const_iterator actuator = actuators.find(path);
+        if (actuator != actuators.end() && commands != nullptr) {
+            *commands << now << " " << actuator->second << " " << filename << " " << value << "\n";
+            commandCount++;
+        }
+        return 0;
+    }
+
+    string VirtualBackend::read(const string &path, const string &filename) {
+        clock->advance(ioCost);
+        long long now = clock->now();
+        update(now);
+
+        if (filename == "value") {
+            for (const Echo &echo : echoes) {
+                if (path == echo.echoPath)
+                    return (now >= echo.start && now < echo.end) ? "1" : "0";
+            }
+            if (path == leftEncoderPath)
+                return encoderLevel(LEFT, now) ? "1" : "0";
+            if (path == rightEncoderPath)
+                return encoderLevel(RIGHT, now) ? "1" : "0";
+        }
+
+        std::map<string, std::map<string, string>>::const_iterator directory = files.find(path);
+        if (directory == files.end())
+            return "0";
+        std::map<string, string>::const_iterator file = directory->second.find(filename);
+        return (file != directory->second.end()) ? file->second : "0";
+    }
+
+    /**
+     * @brief Siguiente flanco del eco en curso de un sensor: su inicio o su final. Si otro pulso lo termina antes de
+     * tiempo (diafonía), el final se conoce cuando ese otro sensor dispara. Para los encoders, el que prevea el modelo
+     * @return Instante del flanco, -1 si no es el pin de eco de un sensor o de un encoder o si no hay un eco pendiente
+     */
+    long long VirtualBackend::nextChange(const string &path, const string &filename) {
+        long long now = clock->now();
+        if (filename == "value" && path == leftEncoderPath)
+            return nextEncoderEdge(LEFT, now);
+        if (filename == "value" && path == rightEncoderPath)
+            return nextEncoderEdge(RIGHT, now);
+        for (const Echo &echo : echoes) {
+            if (filename != "value" || path != echo.echoPath)
+                continue;
+            if (now < echo.start)
+                return echo.start;
+            return (now < echo.end) ? echo.end : -1;
+        }
+        return -1;
+    }
+
+    long long VirtualBackend::nextEncoderEdge(Wheel /*wheel*/, long long /*now*/) {
+        return -1;
+    }
+
+    void VirtualBackend::setCommandLog(std::ostream *commands) {
+        this->commands = commands;
+    }
+
+    long long VirtualBackend::getCommandCount() const {
+        return commandCount;
+    }
+
+    const VirtualBackend::MotorCommand &VirtualBackend::getMotorCommand(Wheel wheel) const {
+        return motors[wheel];
+    }
+
+    int VirtualBackend::addUltrasound(int triggerPin, int echoPin) {
+        echoes.push_back({gpioPath(triggerPin), gpioPath(echoPin), false, -1, -1});
+        return (int) echoes.size() - 1;
+    }
+
+    bool VirtualBackend::isListening(int sensor, long long now) const {
+        return now >= echoes[sensor].start && now < echoes[sensor].end;
+    }
+
+    void VirtualBackend::endEcho(int sensor, long long end) {
+        echoes[sensor].end = std::min(echoes[sensor].end, end);
+    }
+
+} /* namespace RoboCar */
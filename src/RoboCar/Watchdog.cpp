@@ -0,0 +1,215 @@
+#include "RoboCar/Watchdog.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+namespace RoboCar {
+
+    static Watchdog *activeWatchdog = nullptr;
+
+    Watchdog *Watchdog::get() {
+        return activeWatchdog;
+    }
+
+    void Watchdog::set(Watchdog *watchdog) {
+        activeWatchdog = watchdog;
+    }
+
+    Watchdog::Watchdog() : channels{{"bucle", WATCHDOG_LOOP_SOFT_UMS, WATCHDOG_LOOP_HARD_UMS, {0}, false, {0, 0, 0}},
+                                    {"sensado", WATCHDOG_SENSING_SOFT_UMS, WATCHDOG_SENSING_HARD_UMS, {0}, false, {0, 0, 0}}} {
+        running = false;
+        degraded = false;
+        tripped = false;
+        lastLate = 0;
+        degradedSince = 0;
+        degradedTime = 0;
+        degradations = 0;
+        shedLaunches = 0;
+        trippedChannel = -1;
+        stopLatency = -1;
+    }
+
+    Watchdog::~Watchdog() {
+        close();
+        for (int fd : stopFiles)
+            ::close(fd);
+    }
+
+    /**
+     * @brief Abre un fichero de control de los motores para la parada de emergencia
+     * @param file Ruta real del fichero (p.e: el duty_cycle de un PWM)
+     * @return true si se ha abierto, false en caso contrario
+     */
+    bool Watchdog::addStopFile(const std::string &file) {
+        int fd = open(file.c_str(), O_WRONLY);
+        if (fd == -1) {
+            perror(("Watchdog: no se pudo abrir " + file).c_str());
+            return false;
+        }
+        stopFiles.push_back(fd);
+        return true;
+    }
+
+    bool Watchdog::hasFastStop() const {
+        return !stopFiles.empty();
+    }
+
+    /**
+     * @brief Arranca el hilo que comprueba los plazos
+     * @return true si se ha arrancado, false si ya estaba en marcha
+     */
+    bool Watchdog::start() {
+        if (running)
+            return false;
+        running = true;
+        thread = std::thread(&Watchdog::watch, this);
+        return true;
+    }
+
+    void Watchdog::close() {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+        if (degraded) {
+            degradedTime += clock.now() - degradedSince;
+            degraded = false;
+        }
+    }
+
+    void Watchdog::beat(WatchdogChannel channel) {
+        // Los canales se pueden actualizar desde varios hilos: basta con que alguno deje el plazo más lejano
+        long long deadline = clock.now() + channels[channel].soft;
+        if (channels[channel].deadline.load(std::memory_order_relaxed) < deadline)
+            channels[channel].deadline.store(deadline, std::memory_order_relaxed);
+    }
+
+    void Watchdog::allow(WatchdogChannel channel, long long duration) {
+        long long deadline = clock.now() + duration + channels[channel].soft;
+        if (channels[channel].deadline.load(std::memory_order_relaxed) < deadline)
+            channels[channel].deadline.store(deadline, std::memory_order_relaxed);
+    }
+
+    void Watchdog::begin(WatchdogChannel channel) {
+        channels[channel].deadline.store(clock.now() + channels[channel].soft, std::memory_order_relaxed);
+    }
+
+    void Watchdog::end(WatchdogChannel channel) {
+        channels[channel].deadline.store(0, std::memory_order_relaxed);
+    }
+
+    bool Watchdog::isDegraded() const {
+        return degraded.load(std::memory_order_relaxed);
+    }
+
+    bool Watchdog::hasTripped() const {
+        return tripped.load(std::memory_order_relaxed);
+    }
+
+    void Watchdog::countShed() {
+        shedLaunches.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const Watchdog::ChannelStats &Watchdog::getStats(WatchdogChannel channel) const {
+        return channels[channel].stats;
+    }
+
+    long long Watchdog::getDegradations() const {
+        return degradations;
+    }
+
+    long long Watchdog::getStopLatency() const {
+        return stopLatency;
+    }
+
+    /**
+     * @brief Hilo del watchdog: comprueba los plazos en instantes absolutos cada WATCHDOG_PERIOD_UMS, hasta que se
+     * detiene o hasta que se produce la parada de emergencia
+     */
+    void Watchdog::watch() {
+        long long next = clock.now();
+        while (running && !tripped) {
+            next += WATCHDOG_PERIOD_UMS;
+            clock.sleepUntil(next);
+            check(clock.now());
+        }
+    }
+
+    /**
+     * @brief Comprueba el plazo de cada canal. Cada retraso (hasta que el canal vuelve a cumplir) cuenta una vez como
+     * plazo incumplido y lleva al modo degradado; si alcanza el plazo duro, se detiene el coche
+     */
+    void Watchdog::check(long long now) {
+        bool anyLate = false;
+        for (int i = 0; i < WATCHDOG_CHANNELS; i++) {
+            Channel &channel = channels[i];
+            long long deadline = channel.deadline.load(std::memory_order_relaxed);
+            if (deadline == 0 || now <= deadline) {
+                channel.late = false;
+                continue;
+            }
+
+            long long delay = now - deadline;
+            anyLate = true;
+            channel.stats.maxDelay = std::max(channel.stats.maxDelay, delay);
+            if (!channel.late) {
+                channel.late = true;
+                channel.stats.softMisses++;
+                if (!degraded) {
+                    degraded = true;
+                    degradations++;
+                    degradedSince = now;
+                }
+            }
+            if (delay >= channel.hard - channel.soft) {
+                channel.stats.hardMisses++;
+                emergencyStop(i, deadline + channel.hard - channel.soft);
+                return;
+            }
+        }
+
+        if (anyLate) {
+            lastLate = now;
+        } else if (degraded && now - lastLate >= WATCHDOG_RECOVERY_UMS) {
+            degradedTime += now - degradedSince;
+            degraded = false;
+        }
+    }
+
+    /**
+     * @brief Detiene los motores escribiendo en los ficheros abiertos de antemano, sin reservar memoria ni pasar por
+     * el backend de los pines. Si no hay ficheros (simulación), el bucle principal detiene el coche en cuanto
+     * comprueba hasTripped()
+     * @param hardDeadline Instante en que venció el plazo duro, para medir la latencia de la parada
+     */
+    void Watchdog::emergencyStop(int channel, long long hardDeadline) {
+        tripped = true;
+        for (int fd : stopFiles) {
+            if (pwrite(fd, "0", 1, 0) != 1)
+                perror("Watchdog: fallo en la parada de emergencia ");
+        }
+        stopLatency = clock.now() - hardDeadline;
+        trippedChannel = channel;
+        std::cerr << "Watchdog: plazo de " << channels[channel].name << " superado, coche detenido "
+                  << (stopFiles.empty() ? "desde el bucle" : "directamente") << std::endl;
+    }
+
+    /**
+     * @brief Muestra, por canal, los plazos blandos y duros incumplidos y el mayor retraso, las veces que se ha
+     * reducido la carga (y durante cuánto tiempo) y, si se ha producido, la latencia de la parada de emergencia
+     */
+    void Watchdog::printReport(std::ostream &out) const {
+        out << "Watchdog:";
+        for (const Channel &channel : channels) {
+            out << " " << channel.name << " " << channel.stats.softMisses << " retrasos (" << channel.stats.hardMisses
+                << " graves, max " << channel.stats.maxDelay / 1000 << " ms),";
+        }
+        out << " " << degradations << " degradaciones (" << degradedTime / 1000 << " ms, "
+            << shedLaunches.load() << " lanzamientos descartados)" << std::endl;
+        if (tripped) {
+            out << "Parada de emergencia por " << channels[trippedChannel].name << ": latencia " << stopLatency
+                << " us desde el plazo" << (stopFiles.empty() ? " (sin acceso directo a los motores)" : "") << std::endl;
+        }
+    }
+
+} /* namespace RoboCar */
@@ -1,18 +1,15 @@
 #include "RoboCar/WheelMotor.h"
+#include "RoboCar/Parameters.h"
+#include "RoboCar/Session.h"
+#include "RoboCar/BatteryMonitor.h"
+#include "RoboCar/Logger.h"
+#include "PinsLib/Clock.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
-#include <time.h>
-#include <unistd.h>
-
-// Pins GPIO y PWM preconfigurados para su uso
-#define LEFT_WHEEL_FORWARD_PIN      178
-#define LEFT_WHEEL_BACKWARD_PIN     164
-#define LEFT_WHEEL_ENCODER_PIN      208
-#define LEFT_WHEEL_PWM_PIN          1
-
-#define RIGHT_WHEEL_FORWARD_PIN     166
-#define RIGHT_WHEEL_BACKWARD_PIN    165
-#define RIGHT_WHEEL_ENCODER_PIN     177
-#define RIGHT_WHEEL_PWM_PIN         0
+#include <map>
+#include <sstream>
 
 // Parámetros para la configuración del periodo y duty cycle
 #define PERIOD                      4000
@@ -23,30 +20,38 @@
 #define MAX_ATTEMPTS_TO_READ        250
 #define CALIBRATION_WAIT_DELAY      200000
 
-// Constante de PID proporcional (K) para la modificación del duty cycle
-#define DUTYCYCLE_CONSTANT          5
+// Paso de duty cycle de la calibración y número de tablas (tomadas a distintas tensiones) que se conservan en cada
+// fichero de calibración para combinarlas
+#define CALIBRATION_DUTY_STEP       100
+#define CALIBRATION_MAX_TABLES      3
+
+// Tiempo (us) sin flancos a partir del que se considera que la rueda está parada: invertir entonces el sentido de giro
+// no deja flancos de la inercia en el sentido anterior
+#define REVERSAL_STOPPED_UMS        100000
 
 namespace RoboCar {
 
     /**
      * @brief Constructor que incializa los distintos pines utilizados por cada una de las ruedas (LEFT, RIGHT)
-     * Nota: solo se puede crear una instancia de cada tipo
+     * Nota: solo puede existir una instancia por cada rueda de un mismo mapa de pines y backend
      * @param wheel Rueda que se quiere instanciar
+     * @param pins Mapa de pines del coche al que pertenece la rueda
      */
-    WheelMotor::WheelMotor(Wheel wheel){
+    WheelMotor::WheelMotor(Wheel wheel, const PinMap &pins){
+        this->wheel = wheel;
         int forwardPinNumber, backwardPinNumber, encoderPinNumber, speedPinNumber;
         switch (wheel) {
             case LEFT:
-                forwardPinNumber = LEFT_WHEEL_FORWARD_PIN;
-                backwardPinNumber = LEFT_WHEEL_BACKWARD_PIN;
-                encoderPinNumber = LEFT_WHEEL_ENCODER_PIN;
-                speedPinNumber = LEFT_WHEEL_PWM_PIN;
+                forwardPinNumber = pins.leftForward;
+                backwardPinNumber = pins.leftBackward;
+                encoderPinNumber = pins.leftEncoder;
+                speedPinNumber = pins.leftPwm;
                 break;
             case RIGHT:
-                forwardPinNumber = RIGHT_WHEEL_FORWARD_PIN;
-                backwardPinNumber = RIGHT_WHEEL_BACKWARD_PIN;
-                encoderPinNumber = RIGHT_WHEEL_ENCODER_PIN;
-                speedPinNumber = RIGHT_WHEEL_PWM_PIN;
+                forwardPinNumber = pins.rightForward;
+                backwardPinNumber = pins.rightBackward;
+                encoderPinNumber = pins.rightEncoder;
+                speedPinNumber = pins.rightPwm;
                 break;
             default: // Gestión de errores
                 std::cerr << "El numero de rueda no es valido" << std::endl;
@@ -70,7 +75,24 @@ namespace RoboCar {
         calibrated = false;
         minSpeed = 0;
         maxSpeed = 0;
+        speedsVoltage = -1;
         dutyCycle = DEFAULT_DUTYCYCLE;
+        tableDutyCycle = DEFAULT_DUTYCYCLE;
+        direction = 0;
+        estimatedSpeed = 0;
+        encoderLevel = -1;
+        encoderEdges = 0;
+        lastPoll = 0;
+        lastEdge = 0;
+        edgeGap = 0;
+        halfPeriod = 0;
+        positionEdges = 0;
+        travel = 1;
+        reversing = false;
+        edgeInterval = 0;
+        reversalEdges = 0;
+        companion = nullptr;
+        speedGain = DUTYCYCLE_CONSTANT;
 
         // Establecimiento de la velocidad por defecto
         setDutyCycle(dutyCycle);
@@ -91,6 +113,7 @@ namespace RoboCar {
      */
     void WheelMotor::goForward() {
         moving = true;
+        setDirection(1);
         // Activamos los pines correspondientes para ir hacia adelante
         backwardPin->setValue(PinsLib::LOW);
         forwardPin->setValue(PinsLib::HIGH);
@@ -103,6 +126,7 @@ namespace RoboCar {
      */
     void WheelMotor::goBackward() {
         moving = true;
+        setDirection(-1);
         // Activamos los pines correspondientes para ir marcha atrás
         forwardPin->setValue(PinsLib::LOW);
         backwardPin->setValue(PinsLib::HIGH);
@@ -115,6 +139,7 @@ namespace RoboCar {
      */
     void WheelMotor::stop() {
         moving = false;
+        setDirection(0);
         // Se deshabilita el PWM para impedir el movimiento
         speedPin->setEnable(PinsLib::LOW);
         // Y se desactivan los pines
@@ -123,45 +148,88 @@ namespace RoboCar {
 
     }
 
+    /**
+     * @brief Cambia el sentido de giro. Al arrancar, invertir o detener la rueda el semiperiodo medido en el encoder
+     * deja de ser válido, así que no se estiman flancos perdidos (ver countTicks) hasta volver a medirlo. Si se
+     * invierte con la rueda en marcha, los flancos siguientes son de la inercia hasta que se detenga (ver
+     * detectReversal)
+     */
+    void WheelMotor::setDirection(int direction) {
+        if (direction != this->direction) {
+            halfPeriod = 0;
+            reversing = false;
+            if (direction != 0 && direction != travel) {
+                long long now = PinsLib::Clock::get()->now();
+                if (lastEdge > 0 && now - lastEdge < REVERSAL_STOPPED_UMS) {
+                    reversing = true;
+                    edgeInterval = 0;
+                    reversalEdges = 0;
+                } else {
+                    travel = direction;
+                }
+            }
+        }
+        this->direction = direction;
+    }
+
     /**
      * @brief Función privada que altera el DutyCycle, alterando así también la velocidad
      * @param _dutyCycle Valor de Duty Cycle utilizado. Debe ceñirse al invervalo de valores posibles [0, PERIOD]
      */
     void WheelMotor::setDutyCycle(int _dutyCycle) {
         if (_dutyCycle < 0 || _dutyCycle > PERIOD) {
-            std::cerr << "Valor de Duty Cycle invalido: " << _dutyCycle << std::endl;
+            LOG_ERROR("Valor de Duty Cycle invalido: {}", _dutyCycle);
             return;
         }
         dutyCycle = _dutyCycle;
         speedPin->setDutyCycle(dutyCycle);
     }
 
+    /**
+     * @brief Escala el duty cycle de la tabla de calibración por la relación entre la tensión a la que se tomó la tabla
+     * y la tensión actual de la batería, para que la tensión media aplicada al motor sea la misma. Si no se está
+     * midiendo la batería no se modifica; si se desconoce la tensión de la tabla se supone la nominal
+     * @param dutyCycle Duty cycle de la tabla
+     * @return Duty cycle a aplicar, limitado al periodo
+     */
+    int WheelMotor::compensateDutyCycle(int dutyCycle) {
+        BatteryMonitor *battery = BatteryMonitor::get();
+        float voltage = (battery != nullptr) ? battery->getVoltage() : -1;
+        if (voltage <= 0)
+            return dutyCycle;
+        float reference = (speedsVoltage > 0) ? speedsVoltage : BATTERY_NOMINAL_VOLTAGE;
+        return std::min(PERIOD, (int) std::lround(dutyCycle * reference / voltage));
+    }
+
     /**
      * @brief Actualiza la velocidad de la rueda haciendo uso de la tabla de calibraciones.
-     * Para ello la rueda debe haber estado previamente calibrada
+     * Para ello la rueda debe haber estado previamente calibrada. Si se mide la tensión de la batería, el duty cycle
+     * de la tabla se compensa según la tensión actual
      * @param speed Velocidad a establecer. Debe entrar dentro del rango de valores máximo y mínimo
      * @return true si se ha podido establecer la velocidad, false en caso contrario
      */
     bool WheelMotor::setSpeed(int speed) {
         if (!calibrated) {
-            std::cerr << "La rueda no esta calibrada, no se pudo establecer la velocidad" << std::endl;
+            LOG_ERROR("La rueda no esta calibrada, no se pudo establecer la velocidad");
             return false;
         }
 
         if (!(speed >= minSpeed && speed <= maxSpeed)) {
-            std::cerr << "La velocidad " << speed << " no es valida. Min=" << minSpeed << " Max=" << maxSpeed << std::endl;
+            LOG_ERROR("La velocidad {} no es valida. Min={} Max={}", speed, minSpeed, maxSpeed);
             return false;
         }
 
         // Se recorre el array con los valores de calibración y se utiliza el más adecuado
         for (int i = 0; i < speeds.size() - 1; i++) {
             if (speeds[i].second <= speed && speeds[i + 1].second >= speed) {
-                setDutyCycle(speeds[i].first);
+                tableDutyCycle = speeds[i].first;
+                setDutyCycle(compensateDutyCycle(tableDutyCycle));
+                estimatedSpeed = speed;
                 return true;
             }
         }
 
-        std::cerr << "Error: ocurrio un error inesperado al establecer una velocidad de " << speed << std::endl;
+        LOG_ERROR("Error: ocurrio un error inesperado al establecer una velocidad de {}", speed);
         return false;
     }
 
@@ -169,7 +237,7 @@ namespace RoboCar {
      * @brief Obtiene cuál es la velocidad de movimiento actual de la rueda.
      * Esta es muy probable que difiera con la que se ha establecido previamente con setSpeed(),
      * por lo que es recomendable actualizar la velocidad con updateSpeed() si se detecta que
-     * ha variado
+     * ha variado. Si se está grabando una sesión, la medida queda registrada en ella
      * @return Valor de la velocidad actual (tacos/s), 0 en caso de que se encuentre quieta o
      * haya sucedido algún error
      */
@@ -177,26 +245,185 @@ namespace RoboCar {
         if (!moving)
             return 0;
 
-        // Se inicia el temporizador para la medición
-        clock_t startTime = clock();
+        int speed = measureSpeed();
+        registerSpeed(speed);
+        return speed;
+    }
+
+    void WheelMotor::registerSpeed(int speed) {
+        // Una medida nula puede deberse a que se ha agotado el número de lecturas a baja velocidad, por lo que
+        // no se utiliza para la estimación
+        if (speed > 0) {
+            estimatedSpeed = speed;
+            // Un taco es un ciclo completo del encoder: dos flancos
+            halfPeriod = 500000 / speed;
+        }
+        SessionRecorder *recorder = SessionRecorder::get();
+        if (recorder != nullptr)
+            recorder->recordSpeed(wheel, speed);
+    }
+
+    /**
+     * @brief Velocidad estimada de la rueda con signo, a partir de la última velocidad establecida o medida
+     * @return Velocidad (tacos/s), positiva hacia adelante y 0 si la rueda está parada
+     */
+    int WheelMotor::getVelocity() const {
+        return direction * estimatedSpeed;
+    }
+
+    int WheelMotor::getDirection() const {
+        return direction;
+    }
+
+    int WheelMotor::getDutyCycle() const {
+        return dutyCycle;
+    }
+
+    /**
+     * @brief Ficheros que escribe stop(): habilitación del PWM y pines de sentido de giro. Permiten detener la rueda
+     * desde otro hilo sin pasar por esta clase (parada de emergencia del watchdog)
+     * @param files Se añaden las rutas reales de los ficheros, salvo que el backend no trabaje sobre ficheros
+     */
+    void WheelMotor::getStopFiles(std::vector<string> &files) {
+        string enable = speedPin->locate("enable");
+        string forward = forwardPin->locate("value");
+        string backward = backwardPin->locate("value");
+        if (enable.empty() || forward.empty() || backward.empty())
+            return;
+        files.push_back(enable);
+        files.push_back(forward);
+        files.push_back(backward);
+    }
+
+    /**
+     * @brief Cuenta los tacos del encoder por sondeo: cada cambio de nivel es medio taco. Si desde la consulta anterior
+     * ha pasado más de un semiperiodo (p.e: se ha tomado entretanto una medida del sensor de ultrasonidos), los flancos
+     * perdidos se estiman con el semiperiodo de la última velocidad medida (ver registerSpeed) o del último par de
+     * flancos observados, respetando la paridad que indica el nivel actual. Con la rueda detenida no se estima, porque
+     * tras la inercia deja de girar
+     * @return Tacos contados desde que se creó la rueda (en valor absoluto)
+     */
+    float WheelMotor::countTicks() {
+        long long now = PinsLib::Clock::get()->now();
+        int level = encoderPin->getValue();
+        if (encoderLevel != -1) {
+            long long gap = now - lastPoll;
+            long long edges = (level != encoderLevel) ? 1 : 0;
+            if (moving && halfPeriod > 0 && gap > halfPeriod) {
+                double expected = (double) gap / halfPeriod;
+                edges = 2 * std::llround((expected - edges) / 2.0) + edges;
+            } else if (edges == 0 && halfPeriod > 0 && lastPoll - lastEdge <= halfPeriod &&
+                       now - lastEdge > halfPeriod) {
+                // La rueda se está frenando: el semiperiodo es al menos el tiempo sin flancos (si no se ha podido
+                // perder ninguno desde el último)
+                halfPeriod = now - lastEdge;
+            }
+            if (edges > 0) {
+                if (reversing)
+                    detectReversal(now, edges);
+                // Si ambos se han visto con consultas frecuentes, el intervalo entre dos flancos consecutivos mide el
+                // semiperiodo actual
+                if (moving && edges == 1 && lastEdge > 0 && 2 * (gap + edgeGap) <= now - lastEdge)
+                    halfPeriod = now - lastEdge;
+                lastEdge = now;
+                edgeGap = gap;
+            }
+            encoderEdges += edges;
+            positionEdges += travel * edges;
+        }
+        encoderLevel = level;
+        lastPoll = now;
+        return encoderEdges / 2.0f;
+    }
+
+    /**
+     * @brief Tras invertir el sentido con la rueda en marcha, el intervalo entre flancos crece mientras se frena y
+     * decrece al acelerar en el nuevo sentido: los flancos desde el que cierra el intervalo más largo ya son del nuevo
+     * sentido. Para no confundir con ello las variaciones del sondeo, se espera a un intervalo de menos de la mitad
+     * del más largo. Si pasa demasiado tiempo sin flancos, la rueda se había detenido
+     * @param now Instante del flanco
+     * @param edges Flancos contados desde el anterior
+     */
+    void WheelMotor::detectReversal(long long now, long long edges) {
+        long long interval = (now - lastEdge) / edges;
+        if (now - lastEdge >= REVERSAL_STOPPED_UMS) {
+            travel = direction;
+            reversing = false;
+        } else if (interval >= edgeInterval) {
+            edgeInterval = interval;
+            reversalEdges = edges;
+        } else if (2 * interval < edgeInterval) {
+            // Los flancos desde el intervalo más largo se contaron en el sentido contrario
+            travel = direction;
+            reversing = false;
+            positionEdges += 2 * travel * reversalEdges;
+        } else {
+            reversalEdges += edges;
+        }
+    }
+
+    /**
+     * @brief Tacos recorridos con signo según los flancos contados hasta la última consulta del encoder
+     * @return Tacos desde que se creó la rueda, positivos hacia adelante
+     */
+    float WheelMotor::getPosition() const {
+        return positionEdges / 2.0f;
+    }
+
+    /**
+     * @brief Lee el nivel del encoder, contando los tacos como countTicks(). También se cuentan los de la rueda
+     * acompañante, si la hay: una medida de la velocidad bloquea durante varios tacos
+     * @return Nivel leído (0 o 1)
+     */
+    int WheelMotor::readEncoder() {
+        countTicks();
+        if (companion != nullptr)
+            companion->countTicks();
+        return encoderLevel;
+    }
+
+    void WheelMotor::setCompanion(WheelMotor *companion) {
+        this->companion = companion;
+    }
+
+    /**
+     * @brief Mide la velocidad de la rueda a partir del tiempo que se tarda en recorrer varios tacos del encoder
+     * @return Valor de la velocidad actual (tacos/s), 0 en caso de que se encuentre quieta
+     */
+    int WheelMotor::measureSpeed() {
+        PinsLib::Clock *clock = PinsLib::Clock::get();
         int cont = 0;
+
+        // El temporizador se inicia en un flanco de bajada: si se iniciase con el encoder a mitad de un taco, el
+        // primero sería parcial y la velocidad se sobreestimaría hasta en un taco de cada MEASURES_FOR_SPEED. Las
+        // lecturas pasan por el recuento de tacos, de forma que los de la medida también se cuentan
+        while(readEncoder() != 1 && cont++ < MAX_ATTEMPTS_TO_READ);
+        if (cont >= MAX_ATTEMPTS_TO_READ) return 0;
+        else cont = 0;
+        while(readEncoder() != 0 && cont++ < MAX_ATTEMPTS_TO_READ);
+        if (cont >= MAX_ATTEMPTS_TO_READ) return 0;
+        else cont = 0;
+        long long startTime = clock->now();
+
         // Se toma la medida del tiempo en recorrer MEASURES_FOR_SPEED tacos
         // Recorrer un taco se considera como una alteración en el encoder (tacómetro) entre 0 y 1
         for (int i = 0; i < MEASURES_FOR_SPEED; i++) {
             // Se realizan un máximo de lectura de cada pin y en caso de exceder un máximo de lecturas se considera que
             // la rueda está parada (aunque se le haya indicado moverse, no tiene potencia suficiente como para hacerlo)
-            while(encoderPin->getValue() != 1 && cont++ < MAX_ATTEMPTS_TO_READ);
+            while(readEncoder() != 1 && cont++ < MAX_ATTEMPTS_TO_READ);
             if (cont >= MAX_ATTEMPTS_TO_READ) return 0;
             else cont = 0;
 
-            while(encoderPin->getValue() != 0 && cont++ < MAX_ATTEMPTS_TO_READ);
+            while(readEncoder() != 0 && cont++ < MAX_ATTEMPTS_TO_READ);
             if (cont >= MAX_ATTEMPTS_TO_READ) return 0;
             else cont = 0;
         }
-        clock_t stopTime = clock();
+        long long stopTime = clock->now();
+        if (stopTime <= startTime)
+            return 0;
 
         // Con la diferencia de tiempo de las medidas, se calcula la velocidad actual de la rueda
-        return CLOCKS_PER_SEC * MEASURES_FOR_SPEED / (float) (stopTime - startTime);
+        return 1000000.0f * MEASURES_FOR_SPEED / (float) (stopTime - startTime);
     }
 
     /**
@@ -209,13 +436,46 @@ namespace RoboCar {
         if (!moving)
             return;
 
+        correctDutyCycle(referenceSpeed, getCurrentSpeed());
+    }
+
+    /**
+     * @brief Actualiza la velocidad de la rueda como updateSpeed(), con una velocidad ya medida
+     * @param referenceSpeed Velocidad de referencia sobre la que regular la velocidad
+     * @param currentSpeed Velocidad medida (tacos/s), 0 si la rueda está parada
+     */
+    void WheelMotor::updateSpeed(int referenceSpeed, int currentSpeed) {
+        if (!moving)
+            return;
+
+        registerSpeed(currentSpeed);
+        correctDutyCycle(referenceSpeed, currentSpeed);
+    }
+
+    PinsLib::GPIO *WheelMotor::getEncoderPin() const {
+        return encoderPin;
+    }
+
+    bool WheelMotor::isMoving() const {
+        return moving;
+    }
+
+    /**
+     * @brief La corrección se acumula sobre el duty cycle de la tabla y se compensa después, como en setSpeed(): si se
+     * corrigiera el ya compensado, la compensación dejaría de seguir a la batería y el regulador la iría deshaciendo
+     */
+    void WheelMotor::correctDutyCycle(int referenceSpeed, int currentSpeed) {
         // PID proporcional para la regulación de la velocidad, regulando para ello el duty cycle
-        int currentSpeed = getCurrentSpeed();
-        int dutyCycle_change = (referenceSpeed - currentSpeed) * DUTYCYCLE_CONSTANT;
-        dutyCycle += dutyCycle_change;
-        if (dutyCycle > PERIOD)
-            dutyCycle = PERIOD;
-        setDutyCycle(dutyCycle);
+        int dutyCycle_change = (int) lroundf((referenceSpeed - currentSpeed) * speedGain);
+        tableDutyCycle = std::max(0, std::min(PERIOD, tableDutyCycle + dutyCycle_change));
+        setDutyCycle(compensateDutyCycle(tableDutyCycle));
+    }
+
+    /**
+     * @brief Establece la constante (K) del PID proporcional de updateSpeed()
+     */
+    void WheelMotor::setSpeedGain(float speedGain) {
+        this->speedGain = speedGain;
     }
 
     /**
@@ -232,15 +492,15 @@ namespace RoboCar {
 
         // Se detiene el coche y se espera a que esté quieto
         stop();
-        usleep(CALIBRATION_WAIT_DELAY);
+        PinsLib::Clock::get()->sleep(CALIBRATION_WAIT_DELAY);
 
         // Realizamos el calibrado para 40 Duty Cycles distintos
         goForward();
-        for (int dutyCycle = 0; dutyCycle <= PERIOD; dutyCycle += 100) {
+        for (int dutyCycle = 0; dutyCycle <= PERIOD; dutyCycle += CALIBRATION_DUTY_STEP) {
             // Establecemos la nueva velocidad
             setDutyCycle(dutyCycle);
             // Dejamos un margen de espera hasta que se ponga la nueva velocidad
-            usleep(CALIBRATION_WAIT_DELAY);
+            PinsLib::Clock::get()->sleep(CALIBRATION_WAIT_DELAY);
 
             // Tomamos varias medidas de velocidad y realizamos la media
             int speed = 0;
@@ -257,60 +517,156 @@ namespace RoboCar {
             }
         }
 
-        // Terminamos y retornamos los resultados de la calibración
+        // Terminamos y retornamos los resultados de la calibración, anotando la tensión de la batería si se mide
         stop();
+        BatteryMonitor *battery = BatteryMonitor::get();
+        speedsVoltage = (battery != nullptr) ? battery->getVoltage() : -1;
         calibrated = true;
         return {minSpeed, maxSpeed};
     }
 
     /**
-     * @brief Guarda la calibración realizada en un fichero
+     * @brief Guarda la calibración realizada en un fichero. Si se conoce la tensión de la batería durante la
+     * calibración, la tabla se añade (precedida de "voltage <V>") a las tablas con tensión que ya hubiera en el fichero,
+     * conservando las CALIBRATION_MAX_TABLES más recientes. Si no, el fichero contiene solo la tabla actual
      * @param filename Nombre del fichero donde se quiere guardar (ruta relativa)
      * @return true si se pudo guardar la configuración, false en caso contrario
      */
     bool WheelMotor::saveCalibration(std::string filename) {
+        std::vector<CalibrationTable> tables;
+        if (speedsVoltage > 0) {
+            readCalibrationTables(filename, tables);
+            tables.erase(std::remove_if(tables.begin(), tables.end(),
+                                        [](const CalibrationTable &table) { return table.voltage <= 0; }), tables.end());
+            if (tables.size() >= CALIBRATION_MAX_TABLES)
+                tables.erase(tables.begin(), tables.end() - (CALIBRATION_MAX_TABLES - 1));
+        }
+        tables.push_back({speedsVoltage, speeds});
+
         // Apertura de fichero
         std::ofstream out(filename);
-        if (out.bad()) {
+        if (!out.is_open()) {
             std::cerr << "No se pudo abrir el fichero " << filename << " para escritura" << std::endl;
             return false;
         }
 
         // Escritura en fichero
-        for (std::pair<int, int> s : speeds)
-            out << s.first << " " << s.second << std::endl;
+        for (const CalibrationTable &table : tables) {
+            if (table.voltage > 0)
+                out << "voltage " << table.voltage << std::endl;
+            for (std::pair<int, int> s : table.speeds)
+                out << s.first << " " << s.second << std::endl;
+        }
         out.close();
 
         return true;
     }
 
     /**
-     * @brief Carga la calibración almacenada en un fichero
+     * @brief Carga la calibración almacenada en un fichero. Si contiene varias tablas tomadas a distintas tensiones,
+     * se combinan en una sola referida a la tensión nominal
      * @param filename Nombre del fichero que se quiere cargar (ruta relativa)
      * @return pair<minimo, maximo> con las velocidades cargadas, <0, 0> en caso de error
      */
     pair<int, int> WheelMotor::loadCalibration(std::string filename) {
-        // Apertura de fichero
-        std::ifstream in(filename);
-        if (in.bad()) {
+        std::vector<CalibrationTable> tables;
+        if (!readCalibrationTables(filename, tables)) {
             std::cerr << "No se pudo abrir el fichero " << filename << " para lectura" << std::endl;
             return {0, 0};
         }
 
-        // Carga de valores desde fichero
-        int duty_cycle, speed;
-        speeds.clear();
+        if (tables.size() == 1) {
+            speeds = tables[0].speeds;
+            speedsVoltage = tables[0].voltage;
+        } else {
+            speeds = combineCalibrationTables(tables);
+            speedsVoltage = BATTERY_NOMINAL_VOLTAGE;
+        }
+
         minSpeed = INT32_MAX;
         maxSpeed = 0;
-        while (in >> duty_cycle >> speed) {
-            speeds.push_back({duty_cycle, speed});
-            minSpeed = std::min(minSpeed, speed);
-            maxSpeed = std::max(maxSpeed, speed);
+        for (std::pair<int, int> s : speeds) {
+            minSpeed = std::min(minSpeed, s.second);
+            maxSpeed = std::max(maxSpeed, s.second);
         }
-        in.close();
+        if (speeds.empty())
+            return {0, 0};
 
         calibrated = true;
         return {minSpeed, maxSpeed};
     }
 
+    /**
+     * @brief Lee las tablas de un fichero de calibración. Cada tabla empieza con "voltage <V>", salvo en los ficheros
+     * anteriores a la medida de la batería, que contienen una sola tabla sin tensión
+     * @param tables Tablas leídas, en el orden del fichero
+     * @return false si no se ha podido abrir el fichero
+     */
+    bool WheelMotor::readCalibrationTables(const string &filename, std::vector<CalibrationTable> &tables) {
+        std::ifstream in(filename);
+        if (!in.is_open())
+            return false;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string first;
+            if (!(fields >> first))
+                continue;
+            if (first == "voltage") {
+                float voltage = -1;
+                fields >> voltage;
+                tables.push_back({voltage, {}});
+                continue;
+            }
+            int duty_cycle = std::atoi(first.c_str()), speed;
+            if (!(fields >> speed))
+                continue;
+            if (tables.empty())
+                tables.push_back({-1, {}});
+            tables.back().speeds.push_back({duty_cycle, speed});
+        }
+        in.close();
+        return true;
+    }
+
+    /**
+     * @brief Combina varias tablas de calibración en una referida a la tensión nominal. El duty cycle de cada punto
+     * se escala a la tensión nominal (misma tensión media en el motor), los puntos se agrupan por intervalos de
+     * CALIBRATION_DUTY_STEP promediando las velocidades y se fuerza que la velocidad no decrezca con el duty cycle.
+     * El tramo bajo solo se conserva desde donde lo cubren todas las tablas: el primer punto de cada una está en el
+     * límite de la zona muerta del motor y, a otra tensión, no garantiza que la rueda llegue a girar.
+     * Las tablas sin tensión se suponen tomadas a la tensión nominal
+     * @return Tabla combinada, ordenada por duty cycle
+     */
+    std::vector<std::pair<int, int>> WheelMotor::combineCalibrationTables(const std::vector<CalibrationTable> &tables) {
+        std::map<int, std::pair<long long, int>> bins;     // Intervalo -> (suma de velocidades, puntos)
+        int firstBin = 0;
+        for (const CalibrationTable &table : tables) {
+            float voltage = (table.voltage > 0) ? table.voltage : BATTERY_NOMINAL_VOLTAGE;
+            for (size_t i = 0; i < table.speeds.size(); i++) {
+                const std::pair<int, int> &s = table.speeds[i];
+                int bin = (int) std::lround(s.first * voltage / BATTERY_NOMINAL_VOLTAGE / CALIBRATION_DUTY_STEP);
+                if (i == 0)
+                    firstBin = std::max(firstBin, bin);
+                bins[bin].first += s.second;
+                bins[bin].second++;
+            }
+        }
+
+        std::vector<std::pair<int, int>> combined;
+        int fastest = 0;
+        for (const std::pair<const int, std::pair<long long, int>> &bin : bins) {
+            if (bin.first < firstBin)
+                continue;
+            int duty_cycle = std::min(PERIOD, bin.first * CALIBRATION_DUTY_STEP);
+            fastest = std::max(fastest, (int) (bin.second.first / bin.second.second));
+            if (!combined.empty() && combined.back().first == duty_cycle)
+                combined.back().second = fastest;
+            else
+                combined.push_back({duty_cycle, fastest});
+        }
+        return combined;
+    }
+
 } /* namespace RoboCar */
\ No newline at end of file
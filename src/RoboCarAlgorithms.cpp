@@ -1,20 +1,292 @@
 #include "RoboCarAlgorithms.h"
+#include "RoboCar/LoopExecutor.h"
+#include "RoboCar/MissionCar.h"
+#include "RoboCar/Behaviours.h"
+#include "RoboCar/BatteryMonitor.h"
+#include "RoboCar/LiveState.h"
+#include "RoboCar/MissionReport.h"
+#include "RoboCar/Logger.h"
+#include "RoboCar/TeleopServer.h"
+#include "PinsLib/Clock.h"
+#include "RoboCar/Geometry.h"
+#include "Navigation/OccupancyGrid.h"
+#include "Navigation/CostMap.h"
+#include "Navigation/DStarLite.h"
+#include "Navigation/CircuitPlan.h"
+#include "Bus/Topics.h"
+#include <cmath>
 #include <iostream>
-#include <unistd.h>
+#include <thread>
 
 // Parámetros de configuración de espera para los algoritmos
 #define DEFAULT_DELAY_TIMEUMS       500000
-#define DELAY_BETWEEN_ITERATIONS    100000
+
+// Periodos y fases (us) de las etapas del bucle principal. El sensado y la decisión se ejecutan con el periodo de los
+// parámetros del coche (loopPeriod); el control de velocidad mide ambos encoders, por lo que se lanza con menos
+// frecuencia
+#define CONTROL_PERIOD_UMS          400000
+#define CONTROL_PHASE_UMS           50000
+#define LEDS_PERIOD_UMS             200000
+
+// Periodo (us) con el que los bucles periódicos consultan los encoders para que la odometría cuente cada flanco: menor
+// que el semiperiodo de la señal a la velocidad máxima (unos 110 tacos/s)
+#define ENCODER_PERIOD_UMS          4000
+
+// Periodo (us) con el que se comprueba si se ha completado la primitiva actual del circuito
+#define PRIMITIVE_PERIOD_UMS        10000
+
+// Parámetros de la navegación hacia un destino: rejilla de planificación de 500 x 500 celdas de 2 CM (10 x 10 metros
+// centrados en la posición de salida). Los obstáculos son infranqueables hasta la mitad del radio del coche (el
+// mapa de ocupación ensancha los obstáculos con la apertura del haz) y penalizan el paso hasta el radio y un margen
+#define PLAN_GRID_CELLS             500
+#define PLAN_CELL_CM                2.0f
+#define PLAN_LETHAL_CM              (BODY_RADIUS_CM / 2.0f)
+#define PLAN_INFLATION_CM           (BODY_RADIUS_CM + 4.0f)
+#define PLAN_UPDATE_RANGE_CM        220.0f
+#define PLAN_LOOKAHEAD_CELLS        10
+#define GOAL_TOLERANCE_CM           10.0f
+#define HEADING_TOLERANCE_DEG       20.0f
+#define MAX_BLOCKED_ITERATIONS      10
+#define GOAL_SEARCH_CELLS           25
+#define ROTATION_STEP_UMS           2000
+#define ROTATION_TIMEOUT_UMS        4000000
+
+// Periodo (us) del árbitro de comportamientos: cada ciclo consulta a todos los comportamientos con el estado actual
+// del coche (las medidas del sensor llegan de forma independiente, cada MISSION_PING_UMS)
+#define BEHAVIOUR_PERIOD_UMS        5000
+
+// Parámetros del circuito con aprendizaje: distancia a la que se considera que se ve la pared del final de cada
+// recta, deceleración (CM/s^2) a utilizar si no se ha podido medir, margen de seguridad de la frenada y tacos (entre
+// ambas ruedas) que recorre el coche por inercia al detener un giro, hasta medirlos en el primero. Los tiempos de las
+// vueltas se guardan en un vector con capacidad para RACE_MAX_LAPS, para no reservar memoria durante la carrera
+#define WALL_VISIBLE_CM             150.0f
+#define DEFAULT_DECELERATION        200.0f
+#define BRAKING_MARGIN_CM           3.0f
+#define DEFAULT_SPIN_COAST_TICKS    5.0f
+#define RACE_MAX_LAPS               256
+
+// Parámetros del seguimiento de paredes: periodo de muestreo del sensor (el HC-SR04 necesita unos 25 ms para que se
+// extinga el eco anterior), ganancias del controlador PD (tacos/s de diferencia entre ruedas por CM y por CM/s de
+// error), filtro de la derivada, distancia lateral a partir de la que se considera perdida la pared y giro con el que
+// se busca de nuevo
+#define WALL_FOLLOW_PERIOD_UMS      30000
+#define WALL_FOLLOW_KP              1.5f
+#define WALL_FOLLOW_KD              0.8f
+#define WALL_FOLLOW_DERIVATIVE_FILTER 0.5f
+#define WALL_FOLLOW_MAX_STEERING    60.0f
+#define WALL_LOST_CM                120.0f
+#define WALL_SEARCH_STEERING        25.0f
+
+// Reparto del seguimiento de paredes entre hilos: el control comprueba cada WALL_FOLLOW_CONTROL_PERIOD_UMS si hay una
+// medida nueva en el bus, de forma que reacciona en cuanto llega aunque el sensado vaya en otro núcleo
+#define WALL_FOLLOW_CONTROL_PERIOD_UMS 5000
+#define SENSING_CORE                0
+#define CONTROL_CORE                1
 
 namespace RoboCarAlgorithms {
 
+    /**
+     * @brief Muestra en los LEDs el estado del coche (verde: en marcha, rojo: obstáculo). Solo escribe
+     * en los pines si el estado ha cambiado
+     */
+    static void showState(RoboCar::RoboCar *car, bool warning, int &shownState) {
+        if (shownState == (int) warning)
+            return;
+        shownState = (int) warning;
+        if (warning) {
+            car->turnOffLed(RoboCar::GREEN);
+            car->turnOnLed(RoboCar::RED);
+        } else {
+            car->turnOffLed(RoboCar::RED);
+            car->turnOnLed(RoboCar::GREEN);
+        }
+    }
+
+    /**
+     * @brief Publica el tramo del circuito en curso, si se está publicando el estado del coche
+     */
+    static void showSegment(int segment) {
+        RoboCar::LiveState *live = RoboCar::LiveState::get();
+        if (live != nullptr)
+            live->setSegment(segment);
+    }
+
+    /**
+     * @brief Espera el tiempo indicado consultando los encoders cada ENCODER_PERIOD_UMS, de forma que la odometría
+     * cuenta también los tacos de las maniobras de duración fija (p.e: la inercia al frenar)
+     */
+    static void waitCounting(RoboCar::RoboCar *car, PinsLib::Clock *clock, long long ums) {
+        float left, right;
+        for (long long waited = 0; waited < ums; waited += ENCODER_PERIOD_UMS) {
+            clock->sleep(std::min((long long) ENCODER_PERIOD_UMS, ums - waited));
+            car->pollEncoders(left, right);
+        }
+    }
+
+    /**
+     * @brief Gira el coche sobre sí mismo el ángulo indicado, deteniéndose cuando los tacos contados en los encoders de
+     * ambas ruedas cubren el arco del giro (a diferencia de rotateLeft(angle) y rotateRight(angle), que giran durante un
+     * tiempo fijo). La inercia posterior no cuenta para el giro, pero sí para la odometría
+     * @param angle Ángulo de giro (radianes, positivo hacia la izquierda)
+     */
+    static void rotateByEncoders(RoboCar::RoboCar *car, PinsLib::Clock *clock, float angle) {
+        float startLeft, startRight, left, right;
+        car->pollEncoders(startLeft, startRight);
+        // En un giro sobre sí mismo cada rueda recorre el arco del ángulo con radio la mitad de la vía
+        float target = std::fabs(angle) * WHEEL_TRACK_CM / CM_PER_TICK;
+        if (angle > 0)
+            car->rotateLeft();
+        else
+            car->rotateRight();
+        for (long long waited = 0; waited < ROTATION_TIMEOUT_UMS; waited += ROTATION_STEP_UMS) {
+            clock->sleep(ROTATION_STEP_UMS);
+            car->pollEncoders(left, right);
+            if ((left - startLeft) + (right - startRight) >= target)
+                break;
+        }
+        car->stop();
+    }
+
+    /**
+     * @brief Estado del coche para los comportamientos: instante, posición y tacos según la odometría y tensión de la
+     * batería. Las medidas del sensor las añade la tarea de medida
+     */
+    static void readInputs(RoboCar::MissionCar &car, RoboCar::BehaviourInputs &inputs) {
+        RoboCar::RoboCar *robocar = car.get();
+        inputs.time = car.getExecutor().getClock()->now();
+        inputs.pose = robocar->getPose();
+        robocar->getWheelTicks(inputs.leftTicks, inputs.rightTicks);
+        RoboCar::BatteryMonitor *battery = RoboCar::BatteryMonitor::get();
+        inputs.battery = (battery != nullptr) ? battery->getVoltage() : -1;
+    }
+
+    /**
+     * @brief Medida continua del sensor principal para los comportamientos, etiquetando cada medida con los encoders a
+     * mitad de ella. Con el array se toma una medida de cada sensor en cada periodo del bucle; está pendiente de portar
+     * a esperas del ejecutor: scanRanges() bloquea el hilo hasta el último eco (los disparos se intercalan)
+     */
+    static RoboCar::Task<> rangeTask(RoboCar::MissionCar &car, RoboCar::BehaviourInputs &inputs) {
+        RoboCar::RoboCar *robocar = car.get();
+        RoboCar::UltrasoundArray *array = robocar->getUltrasoundArray();
+        for (;;) {
+            float before = inputs.leftEncoder + inputs.rightEncoder;
+            float distance;
+            if (array != nullptr) {
+                co_await car.sleep(robocar->getParameters().loopPeriod);
+                distance = robocar->scanRanges();
+            } else {
+                distance = co_await car.ping();
+            }
+            inputs.range = distance;
+            inputs.rangeEncoders = (before + inputs.leftEncoder + inputs.rightEncoder) / 2.0f;
+            inputs.rangeSequence++;
+        }
+    }
+
+    /**
+     * @brief Control de velocidad de las misiones: cada CONTROL_PERIOD_UMS (tras CONTROL_PHASE_UMS) se actualiza la
+     * velocidad de las ruedas para mantener la especificada, salvo mientras el coche maniobra
+     */
+    static RoboCar::Task<> speedControl(RoboCar::MissionCar &car, const bool &maneuvering) {
+        co_await car.sleep(CONTROL_PHASE_UMS);
+        for (;;) {
+            if (!maneuvering) {
+                int left = co_await car.measureSpeed(RoboCar::LEFT);
+                int right = co_await car.measureSpeed(RoboCar::RIGHT);
+                // Si ha empezado una maniobra mientras se medía, las medidas ya no corresponden a la marcha
+                if (!maneuvering)
+                    car.get()->updateSpeed(left, right);
+            }
+            co_await car.sleep(CONTROL_PERIOD_UMS);
+        }
+    }
+
+    /**
+     * @brief Ciclo del árbitro: cada BEHAVIOUR_PERIOD_UMS combina las propuestas de los comportamientos y aplica la
+     * orden resultante a las ruedas. Tras cada ciclo se llama a onTick, que devuelve false para terminar
+     */
+    template<typename Tick>
+    static RoboCar::Task<> arbiterTask(RoboCar::MissionCar &car, RoboCar::Arbiter &arbiter,
+                                       RoboCar::BehaviourInputs &inputs, bool &maneuvering, Tick onTick) {
+        RoboCar::MotionOutput output(car.get());
+        RoboCar::MotionCommand command;
+        for (;;) {
+            readInputs(car, inputs);
+            arbiter.arbitrate(inputs, command);
+            output.apply(command);
+            maneuvering = !output.isForward();
+            if (!onTick())
+                co_return;
+            co_await car.sleep(BEHAVIOUR_PERIOD_UMS);
+        }
+    }
+
+    /**
+     * @brief Misión compuesta por comportamientos: el árbitro, la medida del sensor, la cuenta de los encoders
+     * (siempre: las maniobras la usan para medir los giros y el control de velocidad para sincronizar las ruedas) y el
+     * control de velocidad (mientras ambas ruedas van hacia delante) como tareas del ejecutor. Termina cuando onTick
+     * devuelve false
+     */
+    template<typename Tick>
+    static RoboCar::Task<> behaviourMission(RoboCar::MissionCar &car, RoboCar::Arbiter &arbiter,
+                                            RoboCar::BehaviourInputs &inputs, Tick onTick) {
+        bool maneuvering = true;
+        const bool counting = true;
+        co_await RoboCar::whenAny(arbiterTask(car, arbiter, inputs, maneuvering, onTick), rangeTask(car, inputs),
+                                  car.countTicks(RoboCar::LEFT, inputs.leftEncoder, counting),
+                                  car.countTicks(RoboCar::RIGHT, inputs.rightEncoder, counting),
+                                  speedControl(car, maneuvering));
+    }
+
+    /**
+     * @brief Busca una salida cuando hay un obstáculo delante, con la maniobra de tanteo original (scanArc = 0) o
+     * mediante un barrido del arco indicado. Con el array de sensores, primero se intenta girar directamente hacia un
+     * lateral despejado. Es el comportamiento de evasión de los modos, ejecutado solo si una primera medida confirma
+     * el obstáculo. El coche queda detenido y orientado hacia la salida
+     * @param car RoboCar
+     * @param limitDistance Distancia mínima libre delante del coche para considerar que hay salida
+     * @param scanArc Arco de barrido en grados (0 para la maniobra de tanteo)
+     * @return true si se ha encontrado una salida, false si se ha agotado el tiempo
+     */
+    bool escapeObstacle(RoboCar::RoboCar *car, int limitDistance, int scanArc) {
+        int speed = car->getSpeed();
+        RoboCar::MissionExecutor executor;
+        RoboCar::MissionCar missionCar(car, executor);
+        RoboCar::ObstacleAvoidBehaviour avoid(car, limitDistance, scanArc);
+        RoboCar::Arbiter arbiter;
+        arbiter.add(&avoid);
+
+        // Se detiene el coche y se confirma el obstáculo con una medida antes de maniobrar
+        car->stop();
+        float distance = (car->getUltrasoundArray() != nullptr) ? car->scanRanges() : car->getDistance();
+        if (distance >= limitDistance) {
+            car->setSpeed(speed);
+            return true;
+        }
+        RoboCar::BehaviourInputs inputs = {};
+        inputs.range = -1;
+        readInputs(missionCar, inputs);
+        avoid.trigger(inputs);
+        RoboCar::Task<> mission = behaviourMission(missionCar, arbiter, inputs, [&]() { return avoid.isActive(); });
+        executor.run(mission, AVOID_TIMEOUT_UMS + BEHAVIOUR_PERIOD_UMS);
+
+        car->stop();
+        car->setSpeed(speed);
+        return avoid.getEscapes() > 0;
+    }
+
     /**
      * @brief El coche comienza a moverse en linea recta detectando obstáculos. En caso de que vaya a chocar,
-     * se detiene y girar hacia los lados. En caso de que no pueda girar, retrocederá marcha atrás.
-     * @param car RoboCar 
+     * se detiene y barre a su alrededor para girar directamente hacia la dirección más despejada (o, con scanArc = 0,
+     * gira hacia los lados tanteando). En caso de que no pueda girar, retrocederá marcha atrás.
+     * Las medidas se integran en un mapa de ocupación, de forma que no se gira hacia los lados que ya se sabe
+     * que están bloqueados. El modo es una composición de comportamientos (evasión, vuelta a casa con la batería baja y
+     * avance) combinados por un árbitro
+     * @param car RoboCar
      * @param time Tiempo total de funcionamiento en segundos
+     * @param scanArc Arco de barrido en grados (0 para la maniobra de tanteo)
      */
-    void simpleMode(RoboCar::RoboCar *car, int time, int limitDistance, bool maxSpeed) {
+    void simpleMode(RoboCar::RoboCar *car, int time, int limitDistance, bool maxSpeed, int scanArc) {
         std::cout << "Iniciando modo de movimiento \"simple\"" << std::endl;
 
         // Se establece la velocidad y el coche empieza a moverse
@@ -23,74 +295,77 @@ namespace RoboCarAlgorithms {
         else
             car->setMinSpeed();
         std::cout << "RoboCar se movera a una velocidad de " << car->getSpeed() << std::endl;
-        car->goForward();
-        car->turnOnLed(RoboCar::GREEN);
-
-        // Inicialización de variables y temporizadores
-        long long totalTime = CLOCKS_PER_SEC * time;
-        clock_t start = clock();
-        clock_t actual = start;
-
-        // Bucle principal de funcionamiento
-        while ((actual - start) < totalTime) {
-            // Se toma una medida de la distancia y se actúa en funcioón de ella
-            float distance = car->getDistance();
-
-            if (distance < limitDistance || distance == -1) {
-                car->turnOffLed(RoboCar::GREEN);
-                car->turnOnLed(RoboCar::RED);
-
-                // El coche ha detectado un obstáculo y debe evitarlo
-                int attempts = 0;
-                while (distance < limitDistance || distance == -1) {
-                    std::cout << "Obstaculo detectado a " << distance << " CM" << std::endl;
-                    switch (attempts) {
-                        case 0: // Comprobar si se puede avanzar a la derecha
-                            std::cout << "Girando a la derecha..." << std::endl;
-                            car->rotateRight(90);
-                            break;
-                        case 1:
-                            std::cout << "Girando a la izquierda..." << std::endl;
-                            car->rotateLeft(180);
-                            break;
-                        default: // Si no se puede girar a ningún lado, se vuelve a la posición inicial y se retrocede
-                            std::cout << "Camino no encontrado. Retrocediendo..." << std::endl;
-                            car->rotateRight(90),
-                            car->goBackward();
-                            usleep(DEFAULT_DELAY_TIMEUMS);
-                            car->rotateRight(90);
-                            attempts = 0;
-                            break;
-                    }
-
-                    // Se toma una nueva medida para comprobar si
-                    distance = car->getDistance();
-                    attempts++;
-                }
+        Navigation::OccupancyGrid map;
+        car->setMap(&map);
 
-                std::cout << "Obstaculo evitado. Continuando..." << std::endl;
-                car->stop();
-                usleep(DEFAULT_DELAY_TIMEUMS);
-                car->goForward();
-                car->turnOffLed(RoboCar::RED);
-                car->turnOnLed(RoboCar::GREEN);
+        RoboCar::ObstacleAvoidBehaviour avoid(car, limitDistance, scanArc);
+        RoboCar::LowBatteryReturnBehaviour goHome(car->getPose(), car->getMinSpeed());
+        RoboCar::CruiseBehaviour cruise(car->getSpeed());
+        RoboCar::Arbiter arbiter;
+        arbiter.add(&avoid);
+        arbiter.add(&goHome);
+        arbiter.add(&cruise);
 
-            } else {
-                // Si el coche no va a chocarse entonces actualizamos su velocidad para mantenerla a la especificada
-                car->updateSpeed();
+        RoboCar::MissionExecutor executor;
+        RoboCar::MissionCar missionCar(car, executor);
+        RoboCar::BehaviourInputs inputs = {};
+        inputs.range = -1;
+        int shownState = -1;
+        RoboCar::MissionReport *report = RoboCar::MissionReport::get();
+        if (report != nullptr)
+            report->begin("simple");
+        RoboCar::Task<> mission = behaviourMission(missionCar, arbiter, inputs, [&]() {
+            // Parámetros recargados en marcha: distancia de detección y velocidad de avance
+            if (car->refreshParameters()) {
+                const RoboCar::Parameters &parameters = car->getParameters();
+                avoid.setLimitDistance(parameters.limitDistance);
+                if (parameters.maxSpeed)
+                    car->setMaxSpeed();
+                else
+                    car->setMinSpeed();
+                cruise.setSpeed(car->getSpeed());
+                LOG_INFO("Nuevos parametros: distancia {} CM, velocidad {}", parameters.limitDistance, car->getSpeed());
             }
-
-            // Control de tiempo entre iteraciones
-            usleep(DELAY_BETWEEN_ITERATIONS);
-            actual = clock();
-        }
+            showState(car, arbiter.getWinner() != &cruise, shownState);
+            if (report != nullptr)
+                report->sample(car, inputs);
+            return true;
+        });
+        executor.run(mission, 1000000LL * time);
+        if (report != nullptr)
+            report->setObstacles(avoid.getDetections(), avoid.getEscapes(), avoid.getFailures());
+        executor.printReport(std::cout);
+        arbiter.printReport(std::cout);
+        std::cout << "Evasiones: " << avoid.getEscapes() << " con salida, " << avoid.getFailures() << " sin salida" << std::endl;
+        std::cout << "Mapa: " << map.getAllocatedTiles() << " teselas (" << map.getMemoryUsage() / 1024 << " KB)" << std::endl;
+        RoboCar::UltrasoundArray *array = car->getUltrasoundArray();
+        if (array != nullptr)
+            array->printReport(std::cout);
 
         // Se termina la ejecución y se detiene el vehículo
         car->stop();
+        car->setMap(nullptr);
         car->turnOffLed(RoboCar::GREEN);
         car->turnOffLed(RoboCar::RED);
     }
 
+    /**
+     * @brief Misión del modo tornado: giro a la derecha (LED verde), parada de 1 segundo y giro a la izquierda (LED rojo)
+     */
+    static RoboCar::Task<> twisterMission(RoboCar::MissionCar &car, long long turnTime) {
+        RoboCar::RoboCar *robocar = car.get();
+        robocar->rotateRight();
+        robocar->turnOnLed(RoboCar::GREEN);
+        co_await car.sleep(turnTime);
+        robocar->stop();
+        co_await car.sleep(1000000);
+        robocar->rotateLeft();
+        robocar->turnOffLed(RoboCar::GREEN);
+        robocar->turnOnLed(RoboCar::RED);
+        co_await car.sleep(turnTime);
+        robocar->stop();
+    }
+
     /**
      * @brief Modo de funcionamiento de RoboCar en el que este gira haciendo uso de sus dos ruedas
      * a máxima velocidad durante el tiempo estipulado. Alterna el giro entre la izquierda y la derecha.
@@ -99,116 +374,551 @@ namespace RoboCarAlgorithms {
      */
     void twisterMode(RoboCar::RoboCar *car, int time) {
         std::cout << "Iniciando modo de movimiento \"tornado\"" << std::endl;
-        int turnTime = (time - 1) / 2;
 
         // Se establece la máxima velocidad
         car->setMaxSpeed();
 
-        // Se comienza la primera fase de giro a la derecha
-        car->turnOnLed(RoboCar::GREEN);
-        car->rotateRight();
-        sleep(turnTime);
-        car->stop();
-        sleep(1);
-
-        // Se realiza la segunda fase de giro a la izquierda
-        car->turnOffLed(RoboCar::GREEN);
-        car->turnOnLed(RoboCar::RED);
-        car->rotateLeft();
-        sleep(turnTime);
+        RoboCar::MissionExecutor executor;
+        RoboCar::MissionCar missionCar(car, executor);
+        RoboCar::Task<> mission = twisterMission(missionCar, 1000000LL * ((time - 1) / 2));
+        executor.run(mission, 1000000LL * time);
+        executor.printReport(std::cout);
 
         // Y finalmente se detiene el vehiculo
         car->stop();
+        car->turnOffLed(RoboCar::GREEN);
         car->turnOffLed(RoboCar::RED);
     }
 
     /**
-     * @brief El coche comienza a seguir un circuito especificado en un fichero. En este se especifican en qué sentido y ángulo
-     * son las curvas. El coche siempre va en línea recta y, al detectar un obstáculo, tomará la siguiente decisión en la lista.
-     * También realiza pequeños ajustes para corregir posibles errores y mantenerse en la trazada.
-     * @param car RoboCar
+     * @brief Carga y compila el fichero del circuito, limitando las velocidades a las calibradas para el coche
      * @param circuitFilename Nombre del fichero que contiene la especificación del circuito
+     * @param plan Plan de movimiento compilado
+     * @return true si el fichero es válido, false en caso contrario
      */
-    void circuitMode(RoboCar::RoboCar *car, int time, int limitDistance, const string &circuitFilename) {
-        // Comprobación de parámetros
+    static bool loadCircuit(RoboCar::RoboCar *car, const string &circuitFilename, Navigation::CircuitPlan &plan) {
         if (circuitFilename.empty()) {
             std::cerr << "Se tiene que establecer un fichero con la configuracion del circuito" << std::endl;
+            return false;
+        }
+        return plan.load(circuitFilename, car->getMinSpeed(), car->getMaxSpeed());
+    }
+
+    /**
+     * @brief Gira el coche sobre sí mismo hasta que ambas ruedas han recorrido los tacos de la primitiva, contados por
+     * sondeo de los encoders. Se detiene antes de girar, para que el giro no dependa de la velocidad que se llevaba, y
+     * corta la potencia antes de llegar a los tacos que la inercia recorrió tras el giro anterior
+     * @param coast Tacos recorridos por inercia tras detener el giro anterior (se actualiza con los de este)
+     */
+    static void runSpin(RoboCar::RoboCar *car, PinsLib::Clock *clock, const Navigation::MotionPrimitive &primitive,
+                        float &coast) {
+        car->stop();
+        waitCounting(car, clock, SPIN_SETTLE_UMS);
+        car->setWheelSpeeds(std::abs(primitive.leftSpeed), std::abs(primitive.rightSpeed));
+        if (primitive.rightSpeed > 0)
+            car->rotateLeft();
+        else
+            car->rotateRight();
+
+        float startLeft, startRight, left, right;
+        car->pollEncoders(startLeft, startRight);
+        float target = std::max(0.0f, primitive.leftTicks + primitive.rightTicks - coast);
+        for (long long waited = 0; waited < ROTATION_TIMEOUT_UMS; waited += ROTATION_STEP_UMS) {
+            clock->sleep(ROTATION_STEP_UMS);
+            car->pollEncoders(left, right);
+            if ((left - startLeft) + (right - startRight) >= target)
+                break;
+        }
+        car->stop();
+
+        float stopLeft = left, stopRight = right;
+        waitCounting(car, clock, SPIN_SETTLE_UMS);
+        car->pollEncoders(left, right);
+        coast = (left - stopLeft) + (right - stopRight);
+    }
+
+    /**
+     * @brief El coche recorre en bucle el circuito especificado en un fichero, compilado antes de empezar a una lista de
+     * primitivas de movimiento (rectas, giros sobre sí mismo y curvas). Cada primitiva termina al recorrer los tacos
+     * precalculados o, si así se indica, al detectar la pared. Con el formato original (solo giros) el coche va en
+     * línea recta y, al detectar un obstáculo, toma la siguiente decisión de la lista.
+     * También realiza pequeños ajustes para corregir posibles errores y mantenerse en la trazada. El modo es una
+     * composición de comportamientos (vuelta a casa con la batería baja y seguimiento del circuito)
+     * @param car RoboCar
+     * @param limitDistance Distancia a la que se detecta la pared en las rectas que no indican otra
+     * @param circuitFilename Nombre del fichero que contiene la especificación del circuito
+     */
+    void circuitMode(RoboCar::RoboCar *car, int time, int limitDistance, const string &circuitFilename) {
+        Navigation::CircuitPlan plan;
+        if (!loadCircuit(car, circuitFilename, plan))
             return;
+
+        // Algoritmo
+        std::cout << "Iniciando modo de movimiento \"circuito\"" << std::endl;
+        RoboCar::LowBatteryReturnBehaviour goHome(car->getPose(), car->getMinSpeed());
+        RoboCar::FollowCircuitBehaviour follow(plan.getPrimitives(), limitDistance);
+        RoboCar::Arbiter arbiter;
+        arbiter.add(&goHome);
+        arbiter.add(&follow);
+
+        RoboCar::MissionExecutor executor;
+        RoboCar::MissionCar missionCar(car, executor);
+        RoboCar::BehaviourInputs inputs = {};
+        inputs.range = -1;
+        int shownState = -1, shownSegment = -1;
+        RoboCar::MissionReport *report = RoboCar::MissionReport::get();
+        if (report != nullptr)
+            report->begin("circuit");
+        RoboCar::Task<> mission = behaviourMission(missionCar, arbiter, inputs, [&]() {
+            if (car->refreshParameters()) {
+                follow.setLimitDistance(car->getParameters().limitDistance);
+                LOG_INFO("Nuevos parametros: distancia {} CM", car->getParameters().limitDistance);
+            }
+            if (follow.getSegment() != shownSegment) {
+                shownSegment = follow.getSegment();
+                showSegment(shownSegment);
+            }
+            showState(car, arbiter.getWinner() != &follow || follow.isTurning(), shownState);
+            if (report != nullptr)
+                report->sample(car, inputs);
+            return true;
+        });
+        executor.run(mission, 1000000LL * time);
+        if (report != nullptr)
+            report->setCircuit(follow.getCurves(), follow.getLaps());
+        executor.printReport(std::cout);
+        arbiter.printReport(std::cout);
+
+        // Y finalmente se detiene el vehiculo
+        car->stop();
+        car->turnOffLed(RoboCar::GREEN);
+        car->turnOffLed(RoboCar::RED);
+    }
+
+    /**
+     * @brief Compila el circuito y muestra el plan resultante y el tiempo estimado de vuelta, sin mover el coche
+     * @param car RoboCar (calibrado, para limitar las velocidades)
+     * @param circuitFilename Nombre del fichero que contiene la especificación del circuito
+     * @return true si el circuito es válido, false en caso contrario
+     */
+    bool circuitDryRun(RoboCar::RoboCar *car, const string &circuitFilename) {
+        Navigation::CircuitPlan plan;
+        if (!loadCircuit(car, circuitFilename, plan))
+            return false;
+        plan.print(std::cout);
+        return true;
+    }
+
+    /**
+     * @brief Celda libre más cercana al destino, buscando en anillos cuadrados de radio creciente alrededor de él
+     * (hasta GOAL_SEARCH_CELLS celdas)
+     * @param goalX, goalY Celda de destino
+     * @param cellX, cellY Celda libre encontrada
+     * @return true si se ha encontrado alguna
+     */
+    static bool nearestFreeCell(const Navigation::CostMap &costMap, int goalX, int goalY, int &cellX, int &cellY) {
+        for (int radius = 0; radius <= GOAL_SEARCH_CELLS; radius++) {
+            int bestDistance = -1;
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++) {
+                    int x = goalX + dx, y = goalY + dy;
+                    if (std::max(std::abs(dx), std::abs(dy)) != radius || x < 0 || y < 0 ||
+                        x >= costMap.getWidth() || y >= costMap.getHeight() ||
+                        costMap.getCost(x, y) == IMPASSABLE_CELL)
+                        continue;
+                    if (bestDistance == -1 || dx * dx + dy * dy < bestDistance) {
+                        bestDistance = dx * dx + dy * dy;
+                        cellX = x;
+                        cellY = y;
+                    }
+                }
+            }
+            if (bestDistance != -1)
+                return true;
         }
-        std::ifstream circuitFile(circuitFilename);
-        if (circuitFile.bad()) {
-            std::cerr << "El fichero de configuracion del circuito < " << circuitFilename << " > no es valido" << std::endl;
+        return false;
+    }
+
+    /**
+     * @brief El coche navega hasta un destino planificando el camino con D* Lite sobre la rejilla de obstáculos que
+     * construye a partir de las medidas del sensor de ultrasonidos y la odometría. Lo desconocido se considera libre;
+     * cuando aparece un obstáculo nuevo el camino se repara de forma incremental. El coche gira sobre sí mismo hacia
+     * el siguiente tramo del camino y avanza en línea recta.
+     * Un eco del haz ancho del sensor puede marcar como ocupado el propio destino o cerrar el paso: en ese caso no se
+     * abandona, sino que se planifica hacia la celda libre más cercana al destino o se espera (girando de vez en
+     * cuando) a que las medidas siguientes liberen las celdas, hasta agotar el tiempo
+     * @param car RoboCar
+     * @param time Tiempo máximo de funcionamiento en segundos
+     * @param limitDistance Distancia a la que se detiene si el sensor detecta un obstáculo que todavía no está en el mapa
+     * @param goalX, goalY Destino (CM) respecto a la posición de salida (X hacia delante, Y hacia la izquierda)
+     */
+    void gotoMode(RoboCar::RoboCar *car, int time, int limitDistance, float goalX, float goalY) {
+        Navigation::CostMap costMap(PLAN_GRID_CELLS, PLAN_GRID_CELLS, PLAN_CELL_CM, PLAN_LETHAL_CM, PLAN_INFLATION_CM);
+        Navigation::DStarLite planner(PLAN_GRID_CELLS, PLAN_GRID_CELLS);
+        int goalCellX, goalCellY, cellX, cellY;
+        if (!costMap.toCell(goalX, goalY, goalCellX, goalCellY)) {
+            std::cerr << "El destino (" << goalX << ", " << goalY << ") queda fuera del mapa" << std::endl;
             return;
         }
+        std::cout << "Iniciando modo de movimiento \"destino\" hacia (" << goalX << ", " << goalY << ")" << std::endl;
+
+        // Mapa de ocupación y planificación inicial (sin obstáculos conocidos)
+        Navigation::OccupancyGrid map;
+        car->setMap(&map);
+        car->setMinSpeed();
+        Navigation::Pose pose = car->getPose();
+        costMap.toCell(pose.x, pose.y, cellX, cellY);
+        planner.setStart(cellX, cellY);
+        planner.setGoal(goalCellX, goalCellY);
+        int plannedGoalX = goalCellX, plannedGoalY = goalCellY;
+        long long expansions = 0;
+
+        // Estado compartido entre las etapas
+        PinsLib::Clock *clock = PinsLib::Clock::get();
+        RoboCar::LoopExecutor executor(clock);
+        float distance = -1;
+        bool found = false, moving = false, warning = false, reached = false;
+        int shownState = -1, blockedIterations = 0, repairs = 0;
+        // Las listas de celdas se reservan de una vez (toda la rejilla y el tramo del camino que se sigue), para que las
+        // etapas no reserven memoria
+        std::vector<int> changed, path;
+        changed.reserve(PLAN_GRID_CELLS * PLAN_GRID_CELLS);
+        path.reserve(PLAN_LOOKAHEAD_CELLS + 1);
+        showState(car, warning, shownState);
+
+        // Sensado: la medida se integra en el mapa de ocupación y los obstáculos del entorno se vuelcan a la
+        // rejilla de planificación. Solo se notifican al planificador las celdas que cambian
+        executor.addStage("sensado", car->getParameters().loopPeriod, 0, [&]() {
+            distance = car->getDistance();
+            Navigation::Pose pose = car->getPose();
+            changed.clear();
+            costMap.update(map, pose.x - PLAN_UPDATE_RANGE_CM, pose.y - PLAN_UPDATE_RANGE_CM,
+                           pose.x + PLAN_UPDATE_RANGE_CM, pose.y + PLAN_UPDATE_RANGE_CM, changed);
+            for (int cell : changed) {
+                int x = cell % PLAN_GRID_CELLS, y = cell / PLAN_GRID_CELLS;
+                planner.setCost(x, y, costMap.getCost(x, y));
+            }
+        }, RoboCar::STAGE_SHEDDABLE);
 
-        // Lectura y parseo del fichero de configuración
-        std::vector<std::pair<char, int>> curves;
-        char direction;
-        int angle;
-        while (circuitFile >> direction >> angle){
-            if (direction != 'l' && direction != 'L' && direction != 'r' && direction != 'R') {
-                std::cerr << "Error: la direcction " << direction << " es invalida" << std::endl;
+        // Planificación: reparación del camino desde la posición actual
+        executor.addStage("planificacion", car->getParameters().loopPeriod, 0, [&]() {
+            Navigation::Pose pose = car->getPose();
+            int x, y;
+            if (!costMap.toCell(pose.x, pose.y, x, y)) {
+                LOG_ERROR("RoboCar ha salido del mapa");
+                found = false;
                 return;
             }
-            if (angle < 0 || angle > 360) {
-                std::cerr << "Error: el angulo " << angle << " es invalido" << std::endl;
+            if (!changed.empty())
+                repairs++;
+
+            // Con el destino ocupado se planifica hacia la celda libre más cercana, y se vuelve a él en cuanto las
+            // medidas lo liberen. Cambiar de destino reinicia la búsqueda
+            int targetX = goalCellX, targetY = goalCellY;
+            if (costMap.getCost(goalCellX, goalCellY) == IMPASSABLE_CELL)
+                nearestFreeCell(costMap, goalCellX, goalCellY, targetX, targetY);
+            if (targetX != plannedGoalX || targetY != plannedGoalY) {
+                bool substitute = targetX != goalCellX || targetY != goalCellY;
+                if (substitute != (plannedGoalX != goalCellX || plannedGoalY != goalCellY))
+                    LOG_INFO(substitute ? "El destino esta ocupado por un obstaculo, se planifica hacia la celda libre "
+                                          "mas cercana" : "El destino vuelve a estar libre");
+                expansions += planner.getExpansions();
+                planner.setGoal(targetX, targetY);
+                plannedGoalX = targetX;
+                plannedGoalY = targetY;
+            }
+            planner.setStart(x, y);
+            found = planner.plan();
+            planner.getPath(path, PLAN_LOOKAHEAD_CELLS + 1);
+        });
+
+        // Decisión: giro hacia el siguiente tramo del camino o avance en línea recta
+        executor.addStage("decision", car->getParameters().loopPeriod, 0, [&]() {
+            if (car->refreshParameters())
+                limitDistance = car->getParameters().limitDistance;
+            Navigation::Pose pose = car->getPose();
+            if (std::hypot(goalX - pose.x, goalY - pose.y) < GOAL_TOLERANCE_CM) {
+                LOG_INFO("Destino alcanzado");
+                reached = true;
+                executor.stop();
                 return;
             }
-            curves.push_back({direction, angle});
-        }
-        if (curves.empty()) {
-            std::cerr << "El fichero de configuracion del circuito < " << circuitFilename << " > esta vacio" << std::endl;
+            // Sin camino se espera a que las medidas siguientes liberen el paso, girando de vez en cuando para
+            // observar otra zona
+            if (!found) {
+                car->stop();
+                moving = false;
+                warning = true;
+                if (++blockedIterations >= MAX_BLOCKED_ITERATIONS) {
+                    LOG_INFO("No existe camino hasta el destino. Girando para buscar otro...");
+                    car->setMinSpeed();
+                    rotateByEncoders(car, clock, (float) M_PI / 2.0f);
+                    blockedIterations = 0;
+                    executor.resync();
+                }
+                return;
+            }
+
+            float targetX = goalX, targetY = goalY;
+            if (path.size() > 1)
+                costMap.toWorld(path.back() % PLAN_GRID_CELLS, path.back() / PLAN_GRID_CELLS, targetX, targetY);
+            float error = std::remainder(std::atan2(targetY - pose.y, targetX - pose.x) - pose.heading,
+                                         2.0f * (float) M_PI) * 180.0f / (float) M_PI;
+            bool waiting = path.size() <= 1 && (plannedGoalX != goalCellX || plannedGoalY != goalCellY);
+            if (std::fabs(error) > HEADING_TOLERANCE_DEG) {
+                LOG_INFO("Girando {} grados hacia {}...", (int) std::round(std::fabs(error)),
+                         error > 0 ? "la izquierda" : "la derecha");
+                car->stop();
+                car->setMinSpeed();
+                rotateByEncoders(car, clock, error * (float) M_PI / 180.0f);
+                moving = false;
+                executor.resync();
+                return;
+            }
+
+            // En la celda libre más cercana al destino ocupado se espera, de cara a él, a nuevas medidas
+            if (waiting) {
+                car->stop();
+                moving = false;
+                warning = true;
+                return;
+            }
+
+            // Si el sensor ve un obstáculo que el mapa todavía no bloquea, se espera a nuevas medidas y, si no
+            // desaparece, se retrocede. Los que quedan más allá del destino no impiden llegar a él
+            float goalDistance = std::hypot(goalX - pose.x, goalY - pose.y);
+            if (distance != -1 && distance < limitDistance && distance < goalDistance) {
+                car->stop();
+                moving = false;
+                warning = true;
+                if (++blockedIterations >= MAX_BLOCKED_ITERATIONS) {
+                    LOG_INFO("Obstaculo detectado a {} CM. Retrocediendo...", distance);
+                    car->goBackward();
+                    waitCounting(car, clock, DEFAULT_DELAY_TIMEUMS);
+                    car->stop();
+                    blockedIterations = 0;
+                    executor.resync();
+                }
+                return;
+            }
+            blockedIterations = 0;
+            warning = false;
+            if (!moving) {
+                car->setMinSpeed();
+                car->goForward();
+                moving = true;
+            }
+        });
+
+        executor.addStage("control", CONTROL_PERIOD_UMS, CONTROL_PHASE_UMS, [&]() {
+            if (moving)
+                car->updateSpeed();
+        });
+
+        // Cuenta de los tacos de los encoders entre las demás etapas, para la odometría
+        executor.addStage("encoders", ENCODER_PERIOD_UMS, 0, [&]() {
+            float left, right;
+            car->pollEncoders(left, right);
+        });
+
+        executor.addStage("leds", LEDS_PERIOD_UMS, 0, [&]() {
+            showState(car, warning, shownState);
+        }, RoboCar::STAGE_OPTIONAL);
+
+        executor.run(1000000LL * time);
+        executor.printReport(std::cout);
+        if (!reached)
+            std::cout << "No se ha alcanzado el destino" << std::endl;
+        std::cout << "Planificacion: " << repairs << " reparaciones del camino, " << expansions + planner.getExpansions()
+                  << " celdas expandidas" << std::endl;
+
+        // Se termina la ejecución y se detiene el vehículo
+        car->stop();
+        car->setMap(nullptr);
+        car->turnOffLed(RoboCar::GREEN);
+        car->turnOffLed(RoboCar::RED);
+    }
+
+    /**
+     * @brief Variante con aprendizaje del modo circuito. La primera vuelta es de reconocimiento: se recorre como en
+     * circuitMode (velocidad media, girando al detectar la pared) y se registra, para cada recta, su longitud según
+     * la odometría, dónde apareció la pared y a qué distancia de ella quedó parado el coche, junto con la deceleración
+     * medida en cada frenada. En las vueltas siguientes las rectas se recorren a la máxima velocidad calibrada y se
+     * frena justo a la distancia que requiere la deceleración medida para quedar parado en el mismo punto.
+     * Se muestra el tiempo de cada vuelta
+     * @param car RoboCar
+     * @param time Tiempo total de funcionamiento en segundos
+     * @param circuitFilename Nombre del fichero que contiene la especificación del circuito
+     */
+    void raceMode(RoboCar::RoboCar *car, int time, int limitDistance, const string &circuitFilename) {
+        Navigation::CircuitPlan plan;
+        if (!loadCircuit(car, circuitFilename, plan))
             return;
+
+        // Solo se admiten rectas hasta la pared seguidas de giros sobre sí mismo (el formato original)
+        const std::vector<Navigation::MotionPrimitive> &primitives = plan.getPrimitives();
+        std::vector<Navigation::MotionPrimitive> curves;
+        for (size_t i = 0; i < primitives.size(); i++) {
+            bool valid = (i % 2 == 0) ? primitives[i].type == Navigation::STRAIGHT_PRIMITIVE && primitives[i].untilWall
+                                      : primitives[i].type == Navigation::SPIN_PRIMITIVE;
+            if (!valid || primitives.size() % 2 != 0) {
+                std::cerr << "El circuito con aprendizaje solo admite rectas hasta la pared seguidas de giros sobre si mismo" << std::endl;
+                return;
+            }
+            if (i % 2 != 0)
+                curves.push_back(primitives[i]);
         }
 
-        long long totalTime = CLOCKS_PER_SEC * time;
+        // Lo aprendido de cada recta en la vuelta de reconocimiento (CM)
+        struct Segment {
+            float length;           // Desde la salida de la curva anterior hasta quedar parado antes de la siguiente
+            float wallSeen;         // Posición en la recta a partir de la que el sensor ve la pared del final
+            float wallDistance;     // Distancia a la pared una vez parado
+        };
+        std::vector<Segment> segments(curves.size());
 
-        // Algoritmo
-        std::cout << "Iniciando modo de movimiento \"circuito\"" << std::endl;
-        car->goForward();
+        std::cout << "Iniciando modo de movimiento \"circuito con aprendizaje\"" << std::endl;
+        std::cout << "Vuelta de reconocimiento..." << std::endl;
         car->setMeanSpeed();
-        car->turnOnLed(RoboCar::GREEN);
+        car->goForward();
 
-        int decision = 0;
-        char nextDirection = curves[decision].first;
-        int nextAngle = curves[decision].second;
-
-        clock_t start = clock();
-        clock_t actual = start;
-        while ((actual - start) < totalTime) {
-            float distance = car->getDistance();
-
-            if (distance < limitDistance || distance == -1) {
-                car->turnOffLed(RoboCar::GREEN);
-                car->turnOnLed(RoboCar::RED);
-
-                // Si se detecta un obstáculo entonces se toma la siguiente decisión
-                if (nextDirection == 'l' || nextDirection == 'L') {
-                    std::cout << "Girando a la izquierda " << nextAngle << " grados..." << std::endl;
-                    car->rotateLeft(nextAngle);
-                } else { // (nextDirection == 'r' || nextDirection == 'R')
-                    std::cout << "Girando a la derecha " << nextAngle << " grados..." << std::endl;
-                    car->rotateRight(nextAngle);
-                }
-                usleep(DEFAULT_DELAY_TIMEUMS);
+        PinsLib::Clock *clock = PinsLib::Clock::get();
+        RoboCar::LoopExecutor executor(clock);
+        int lap = 0, decision = 0;
+        std::vector<long long> lapTimes;
+        lapTimes.reserve(RACE_MAX_LAPS);
+        long long lapStart = clock->now();
+        showSegment(decision);
+        // La posición en la recta se mide con los tacos contados en los encoders desde su inicio
+        float segmentLeft, segmentRight, position = 0, wallSeen = -1;
+        car->pollEncoders(segmentLeft, segmentRight);
+        float deceleration = 0, spinCoast = DEFAULT_SPIN_COAST_TICKS;
+        int decelerationSamples = 0;
+        float distance = car->getDistance();
+        bool turning = false;
+        int shownState = -1;
+        showState(car, turning, shownState);
 
-                // Actualizamos la siguiente decisión
-                decision = (decision + 1) % curves.size();
-                nextDirection = curves[decision].first;
-                nextAngle = curves[decision].second;
+        // Sensado: distancia a la pared y posición en la recta actual
+        executor.addStage("sensado", car->getParameters().loopPeriod, 0, [&]() {
+            distance = car->getDistance();
+            float left, right;
+            car->pollEncoders(left, right);
+            position = ((left - segmentLeft) + (right - segmentRight)) / 2.0f * CM_PER_TICK;
+            if (wallSeen < 0 && distance != -1 && distance < WALL_VISIBLE_CM)
+                wallSeen = position;
+        }, RoboCar::STAGE_SHEDDABLE);
 
-                car->turnOnLed(RoboCar::GREEN);
-                car->turnOffLed(RoboCar::RED);
+        executor.addStage("decision", car->getParameters().loopPeriod, 0, [&]() {
+            if (car->refreshParameters())
+                limitDistance = car->getParameters().limitDistance;
+            bool brake;
+            if (lap == 0) {
+                brake = distance < limitDistance || distance == -1;
             } else {
-                // Si el coche no va a chocarse entonces actualizamos su velocidad para mantenerla a la especificada
-                car->updateSpeed();
+                // Distancia de frenada a la velocidad actual, más lo que se recorre hasta la siguiente decisión
+                const Segment &segment = segments[decision];
+                float speed = car->getSpeed() * CM_PER_TICK;
+                float braking = speed * speed / (2.0f * deceleration) + speed * car->getParameters().loopPeriod / 1000000.0f
+                                + BRAKING_MARGIN_CM;
+                float remaining = segment.length - position;
+                if (distance != -1)
+                    remaining = std::min(remaining, distance - segment.wallDistance);
+                brake = remaining <= braking;
+            }
+            if (!brake)
+                return;
+            turning = true;
+            showState(car, turning, shownState);
+
+            // Frenada: se deja de dar potencia y se espera a que el coche se detenga
+            float brakeDistance = distance, brakeSpeed = car->getSpeed() * CM_PER_TICK, brakePosition = position;
+            car->stop();
+            waitCounting(car, clock, DEFAULT_DELAY_TIMEUMS);
+            float restDistance = car->getDistance();
+
+            // En la vuelta de reconocimiento se registra la recta y la deceleración de la frenada
+            if (lap == 0) {
+                float stopping = (brakeDistance != -1 && restDistance != -1) ? std::max(0.0f, brakeDistance - restDistance) : 0;
+                segments[decision] = {brakePosition + stopping, (wallSeen >= 0) ? wallSeen : brakePosition,
+                                      (restDistance != -1) ? restDistance : (float) limitDistance};
+                if (stopping > 1.0f) {
+                    deceleration += brakeSpeed * brakeSpeed / (2.0f * stopping);
+                    decelerationSamples++;
+                }
+            }
+
+            // Giro controlado por los encoders, para que sea el mismo en todas las vueltas
+            LOG_INFO("Girando a la {}...", curves[decision].rightSpeed > 0 ? "izquierda" : "derecha");
+            runSpin(car, clock, curves[decision], spinCoast);
+
+            // Fin de vuelta
+            decision = (decision + 1) % curves.size();
+            showSegment(decision);
+            if (decision == 0) {
+                long long now = clock->now();
+                lapTimes.push_back(now - lapStart);
+                lapStart = now;
+                LOG_INFO("Vuelta {}: {} s", lapTimes.size(), lapTimes.back() / 1000000.0);
+                if (lap == 0) {
+                    deceleration = (decelerationSamples > 0) ? deceleration / decelerationSamples : DEFAULT_DECELERATION;
+                    LOG_INFO("Circuito aprendido. Deceleracion: {} CM/s^2", deceleration);
+                    for (size_t i = 0; i < segments.size(); i++)
+                        LOG_INFO("  Recta {}: {} CM, pared visible a partir de {} CM, parada a {} CM", i + 1,
+                                 segments[i].length, segments[i].wallSeen, segments[i].wallDistance);
+                }
+                lap++;
             }
 
-            // Control de tiempo entre iteraciones
-            usleep(DELAY_BETWEEN_ITERATIONS);
-            car->setMeanSpeed();
+            // Siguiente recta
+            if (lap == 0)
+                car->setMeanSpeed();
+            else
+                car->setMaxSpeed();
             car->goForward();
-            actual = clock();
+            car->pollEncoders(segmentLeft, segmentRight);
+            position = 0;
+            wallSeen = -1;
+            distance = car->getDistance();
+            turning = false;
+            showState(car, turning, shownState);
+            executor.resync();
+        });
+
+        // Cuenta de los tacos de los encoders entre las demás etapas, para la odometría
+        executor.addStage("encoders", ENCODER_PERIOD_UMS, 0, [&]() {
+            float left, right;
+            car->pollEncoders(left, right);
+        });
+
+        // Control de velocidad: se mantiene la velocidad de la vuelta actual
+        executor.addStage("control", CONTROL_PERIOD_UMS, CONTROL_PHASE_UMS, [&]() {
+            if (turning)
+                return;
+            car->updateSpeed();
+            if (lap == 0)
+                car->setMeanSpeed();
+            else
+                car->setMaxSpeed();
+            car->goForward();
+        });
+
+        executor.addStage("leds", LEDS_PERIOD_UMS, 0, [&]() {
+            showState(car, turning, shownState);
+        }, RoboCar::STAGE_OPTIONAL);
+
+        executor.run(1000000LL * time);
+        executor.printReport(std::cout);
+
+        // Resumen de las vueltas completadas
+        if (!lapTimes.empty()) {
+            std::cout << "Tiempos por vuelta:" << std::endl;
+            for (size_t i = 0; i < lapTimes.size(); i++) {
+                std::cout << "  Vuelta " << i + 1 << ": " << lapTimes[i] / 1000000.0 << " s";
+                if (i > 0)
+                    std::cout << " (" << 100.0 * (lapTimes[i] - lapTimes[0]) / lapTimes[0] << "% respecto al reconocimiento)";
+                std::cout << std::endl;
+            }
         }
 
         // Y finalmente se detiene el vehiculo
@@ -217,4 +927,180 @@ namespace RoboCarAlgorithms {
         car->turnOffLed(RoboCar::RED);
     }
 
-}
\ No newline at end of file
+    /**
+     * @brief Fija la velocidad de cada rueda manteniendo su diferencia (la curvatura) dentro del rango calibrado: si una
+     * rueda supera la velocidad máxima se reducen ambas, y después se limitan a la mínima
+     * @param difference Diferencia de velocidad (tacos/s) entre la rueda derecha y la izquierda (positiva hacia la izquierda)
+     */
+    static void steer(RoboCar::RoboCar *car, int baseSpeed, int difference, int &leftSpeed, int &rightSpeed) {
+        int left = baseSpeed - difference / 2, right = baseSpeed + (difference - difference / 2);
+        int excess = std::max(left, right) - car->getMaxSpeed();
+        if (excess > 0) {
+            left -= excess;
+            right -= excess;
+        }
+        left = std::max(left, car->getMinSpeed());
+        right = std::max(right, car->getMinSpeed());
+        if (left == leftSpeed && right == rightSpeed)
+            return;
+        leftSpeed = left;
+        rightSpeed = right;
+        car->setWheelSpeeds(left, right);
+    }
+
+    /**
+     * @brief El coche avanza sin detenerse siguiendo la pared que ve el sensor (montado de lado, con el ángulo
+     * WALL_FOLLOW_MOUNT_DEG) a la distancia indicada. La dirección se corrige con un controlador PD sobre la distancia
+     * lateral a la pared, tomando una medida en cada periodo del sensor, y se aplica como diferencia de velocidad entre
+     * las ruedas: las esquinas se toman en curva. Si se pierde la pared (esquina exterior) se gira hacia ella hasta
+     * volver a encontrarla. Al terminar se muestra la velocidad media.
+     * Las etapas se comunican a través del bus: el sensado publica cada medida y el control la recoge, publica las
+     * velocidades, los tacos y la posición contados en los encoders y los eventos de pérdida de la pared, que consumen
+     * los LEDs. Con threads el sensado (que espera al eco) se ejecuta en su propio hilo y núcleo, sin retrasar el
+     * control (sin verificar: no se puede simular)
+     * @param car RoboCar
+     * @param time Tiempo total de funcionamiento en segundos
+     * @param limitDistance Distancia (CM) a mantener con la pared
+     * @param maxSpeed Si se habilita, la velocidad de referencia es la máxima en lugar de la media
+     * @param threads Si se habilita, el sensado y el control se ejecutan en hilos fijados a distintos núcleos
+     */
+    void wallFollowMode(RoboCar::RoboCar *car, int time, int limitDistance, bool maxSpeed, bool threads) {
+        float mount = WALL_FOLLOW_MOUNT_DEG * (float) M_PI / 180.0f;
+        float side = (mount < 0) ? -1.0f : 1.0f;
+        car->setSensorMount(mount);
+        std::cout << "Iniciando modo de movimiento \"seguimiento de pared\" a " << limitDistance << " CM de la pared "
+                  << (side < 0 ? "derecha" : "izquierda") << (threads ? " (sensado y control en hilos separados)" : "")
+                  << std::endl;
+
+        int baseSpeed = maxSpeed ? car->getMaxSpeed() : (car->getMinSpeed() + car->getMaxSpeed()) / 2;
+        int leftSpeed = -1, rightSpeed = -1;
+        steer(car, baseSpeed, 0, leftSpeed, rightSpeed);
+        car->goForward();
+
+        PinsLib::Clock *clock = PinsLib::Clock::get();
+        Bus::RoboCarTopics topics(clock);
+        Bus::Topic<Bus::RangeMessage>::Subscriber ranges = topics.range.subscribe(Bus::LATEST);
+        Bus::Topic<Bus::ModeEventMessage, MODE_EVENTS_CAPACITY>::Subscriber events = topics.modeEvents.subscribe(Bus::QUEUED);
+        RoboCar::LoopExecutor sensing(clock), control(clock);
+        RoboCar::LoopExecutor &controlExecutor = threads ? control : sensing;
+
+        long long start = clock->now(), lastSample = start, samples = 0, lostSamples = 0;
+        float travelledStart = car->getTravelled();
+        float error = 0, derivative = 0;
+        bool tracking = false, warning = true;
+        int shownState = -1;
+        showState(car, warning, shownState);
+        topics.modeEvents.publish({Bus::MODE_STARTED, limitDistance});
+
+        // Sensado: una medida por periodo, en la orientación del sensor. En su propio hilo solo accede al sensor: los
+        // encoders (que getSingleDistance() consulta tras medir) y la odometría son del hilo de control
+        RoboCar::UltrasoundSensor *sensor = car->getUltrasoundSensor();
+        sensing.addStage("sensado", WALL_FOLLOW_PERIOD_UMS, 0, [&]() {
+            Bus::RangeMessage &range = topics.range.claim();
+            range.distance = threads ? sensor->getDistance() : car->getSingleDistance();
+            range.mount = mount;
+            range.time = clock->now();
+            topics.range.publish();
+        }, RoboCar::STAGE_SHEDDABLE);
+
+        // Control PD con cada medida nueva: el error es positivo si el coche está más lejos de la pared de lo indicado
+        controlExecutor.addStage("control", WALL_FOLLOW_CONTROL_PERIOD_UMS, 0, [&]() {
+            Bus::RangeMessage range;
+            if (ranges.receive(range)) {
+                float lateral = range.distance * std::fabs(std::sin(range.mount));
+                float steering;
+                bool wasTracking = tracking;
+                samples++;
+                if (range.distance == -1 || lateral > WALL_LOST_CM) {
+                    steering = WALL_SEARCH_STEERING;
+                    tracking = false;
+                    lostSamples++;
+                } else {
+                    float current = lateral - limitDistance;
+                    float dt = (range.time - lastSample) / 1000000.0f;
+                    if (tracking && dt > 0)
+                        derivative += WALL_FOLLOW_DERIVATIVE_FILTER * ((current - error) / dt - derivative);
+                    else
+                        derivative = 0;
+                    error = current;
+                    lastSample = range.time;
+                    tracking = true;
+                    steering = WALL_FOLLOW_KP * error + WALL_FOLLOW_KD * derivative;
+                }
+                steering = std::max(-WALL_FOLLOW_MAX_STEERING, std::min(WALL_FOLLOW_MAX_STEERING, steering));
+                steer(car, baseSpeed, (int) std::lround(side * steering), leftSpeed, rightSpeed);
+                topics.speedSetpoints.publish({(int16_t) leftSpeed, (int16_t) rightSpeed});
+                if (tracking != wasTracking)
+                    topics.modeEvents.publish({tracking ? Bus::WALL_FOUND : Bus::WALL_LOST, (int32_t) std::lround(lateral)});
+            }
+
+            Bus::WheelTicksMessage &ticks = topics.wheelTicks.claim();
+            car->getWheelTicks(ticks.left, ticks.right);
+            topics.wheelTicks.publish();
+            topics.pose.publish(car->getPose());
+        });
+
+        controlExecutor.addStage("leds", LEDS_PERIOD_UMS, 0, [&]() {
+            Bus::ModeEventMessage event;
+            while (events.receive(event)) {
+                if (event.type == Bus::WALL_FOUND || event.type == Bus::WALL_LOST)
+                    warning = event.type == Bus::WALL_LOST;
+            }
+            showState(car, warning, shownState);
+        }, RoboCar::STAGE_OPTIONAL);
+
+        if (threads) {
+            std::thread sensingThread([&]() {
+                RoboCar::LoopExecutor::pinToCore(SENSING_CORE);
+                sensing.run(1000000LL * time);
+            });
+            RoboCar::LoopExecutor::pinToCore(CONTROL_CORE);
+            control.run(1000000LL * time);
+            sensingThread.join();
+            std::cout << "Hilo de sensado (nucleo " << SENSING_CORE << "):" << std::endl;
+            sensing.printReport(std::cout);
+            std::cout << "Hilo de control (nucleo " << CONTROL_CORE << "):" << std::endl;
+            control.printReport(std::cout);
+        } else {
+            sensing.run(1000000LL * time);
+            sensing.printReport(std::cout);
+        }
+        topics.modeEvents.publish({Bus::MODE_FINISHED, 0});
+        topics.printReport(std::cout);
+
+        // Velocidad media según la odometría
+        car->stop();
+        float travelled = car->getTravelled() - travelledStart;
+        float seconds = (clock->now() - start) / 1000000.0f;
+        std::cout << "Recorrido: " << travelled << " CM en " << seconds << " s. Velocidad media: "
+                  << ((seconds > 0) ? travelled / seconds : 0) << " CM/s" << std::endl;
+        std::cout << "Medidas: " << samples << " (" << lostSamples << " sin pared)" << std::endl;
+
+        car->turnOffLed(RoboCar::GREEN);
+        car->turnOffLed(RoboCar::RED);
+    }
+
+    /**
+     * @brief El coche se conduce desde otro proceso a través de un socket UNIX (ver TeleopProtocol.h): órdenes de
+     * velocidad, maniobras, LEDs y suscripción a la telemetría. Las velocidades se aplican en lazo abierto, con la
+     * tabla de calibración: la regulación con los encoders bloquearía el bucle de eventos durante la medida. Al
+     * terminar se muestran las órdenes atendidas y la latencia de actuación
+     * @param car RoboCar
+     * @param time Tiempo total de funcionamiento en segundos
+     * @param socketPath Ruta del socket en el que se esperan las conexiones
+     */
+    void teleopMode(RoboCar::RoboCar *car, int time, const string &socketPath) {
+        RoboCar::TeleopServer server(car, socketPath);
+        if (!server.open())
+            return;
+        std::cout << "Iniciando modo de movimiento \"teleoperacion\" en " << socketPath << std::endl;
+        car->setMinSpeed();
+        car->turnOnLed(RoboCar::GREEN);
+        server.run(1000000LL * time);
+        server.close();
+        server.printReport(std::cout);
+        car->turnOffLed(RoboCar::GREEN);
+        car->turnOffLed(RoboCar::RED);
+    }
+
+}
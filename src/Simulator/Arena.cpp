@@ -0,0 +1,149 @@
+#include "Simulator/Arena.h"
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace Simulator {
+
+    Arena::Arena() {
+        start = {0, 0};
+        startHeading = 0;
+    }
+
+    /**
+     * @brief Carga el escenario desde un fichero de texto
+     * @param filename Nombre del fichero con la descripción del escenario
+     * @return true si se ha cargado correctamente, false en caso contrario
+     */
+    bool Arena::load(const std::string &filename) {
+        std::ifstream in(filename);
+        if (!in.is_open()) {
+            std::cerr << "No se pudo abrir el escenario " << filename << std::endl;
+            return false;
+        }
+
+        walls.clear();
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            std::string::size_type comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+
+            std::istringstream tokens(line);
+            std::string keyword;
+            if (!(tokens >> keyword))
+                continue;
+
+            if (keyword == "start") {
+                float x, y, heading;
+                if (!(tokens >> x >> y >> heading)) {
+                    std::cerr << "Escenario " << filename << ":" << lineNumber << ": start <x> <y> <angulo>" << std::endl;
+                    return false;
+                }
+                setStart({x, y}, heading * (float) M_PI / 180.0f);
+            } else if (keyword == "polygon") {
+                std::vector<Point> vertices;
+                float x, y;
+                while (tokens >> x >> y)
+                    vertices.push_back({x, y});
+                if (vertices.size() < 2) {
+                    std::cerr << "Escenario " << filename << ":" << lineNumber << ": el poligono necesita al menos 2 vertices" << std::endl;
+                    return false;
+                }
+                addPolygon(vertices);
+            } else {
+                std::cerr << "Escenario " << filename << ":" << lineNumber << ": elemento desconocido " << keyword << std::endl;
+                return false;
+            }
+        }
+
+        if (walls.empty()) {
+            std::cerr << "El escenario " << filename << " no contiene paredes" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Añade un polígono cerrado al escenario
+     * @param vertices Vértices del polígono, en orden
+     */
+    void Arena::addPolygon(const std::vector<Point> &vertices) {
+        for (size_t i = 0; i < vertices.size(); i++)
+            walls.push_back({vertices[i], vertices[(i + 1) % vertices.size()]});
+    }
+
+    void Arena::setStart(Point position, float heading) {
+        start = position;
+        startHeading = heading;
+    }
+
+    Point Arena::getStart() const {
+        return start;
+    }
+
+    float Arena::getStartHeading() const {
+        return startHeading;
+    }
+
+    const std::vector<Segment> &Arena::getWalls() const {
+        return walls;
+    }
+
+    /**
+     * @brief Intersección de un rayo con todas las paredes del escenario
+     */
+    float Arena::castRay(Point origin, float angle, float maxRange) const {
+        float dx = std::cos(angle), dy = std::sin(angle);
+        float nearest = maxRange;
+        for (const Segment &wall : walls) {
+            float ex = wall.b.x - wall.a.x, ey = wall.b.y - wall.a.y;
+            float denominator = dx * ey - dy * ex;
+            if (std::fabs(denominator) < 1e-9f)
+                continue;
+            float ox = wall.a.x - origin.x, oy = wall.a.y - origin.y;
+            float t = (ox * ey - oy * ex) / denominator;   // Distancia a lo largo del rayo
+            float u = (ox * dy - oy * dx) / denominator;   // Posición a lo largo de la pared [0, 1]
+            if (t >= 0 && u >= 0 && u <= 1 && t < nearest)
+                nearest = t;
+        }
+        return nearest;
+    }
+
+    /**
+     * @brief Distancia mínima entre un punto y cualquiera de las paredes
+     */
+    float Arena::clearance(Point position) const {
+        float nearest = std::numeric_limits<float>::max();
+        for (const Segment &wall : walls) {
+            float ex = wall.b.x - wall.a.x, ey = wall.b.y - wall.a.y;
+            float length = ex * ex + ey * ey;
+            float t = (length > 0) ? ((position.x - wall.a.x) * ex + (position.y - wall.a.y) * ey) / length : 0;
+            t = std::fmax(0.0f, std::fmin(1.0f, t));
+            float px = wall.a.x + t * ex - position.x, py = wall.a.y + t * ey - position.y;
+            nearest = std::fmin(nearest, std::sqrt(px * px + py * py));
+        }
+        return nearest;
+    }
+
+    /**
+     * @brief Cuenta las paredes que cruza una semirrecta horizontal desde el punto: el número es impar dentro del
+     * recinto y fuera de los obstáculos (cada obstáculo que no contiene al punto se cruza un número par de veces)
+     */
+    bool Arena::contains(Point position) const {
+        int crossings = 0;
+        for (const Segment &wall : walls) {
+            if ((wall.a.y > position.y) == (wall.b.y > position.y))
+                continue;
+            float x = wall.a.x + (position.y - wall.a.y) * (wall.b.x - wall.a.x) / (wall.b.y - wall.a.y);
+            if (x > position.x)
+                crossings++;
+        }
+        return crossings % 2 == 1;
+    }
+
+} /* namespace Simulator */
@@ -0,0 +1,265 @@
+#include "Simulator/Fleet.h"
+#include "Simulator/TaskPool.h"
+#include "RoboCar/AllocationCheck.h"
+#include "RoboCar/Geometry.h"
+#include "RoboCar/Logger.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+
+namespace Simulator {
+
+    /**
+     * @brief Prepara la pila y el contexto en el que se ejecutará el coche, que no empieza hasta el primer resume()
+     * @param body Ejecución completa del coche
+     */
+    FleetClock::FleetClock(std::function<void()> body) : PinsLib::VirtualClock(0) {
+        this->body = body;
+        this->boundary = 0;
+        this->finished = false;
+        this->stack = new char[FLEET_STACK_SIZE];
+
+        // makecontext solo admite argumentos int: la dirección del reloj se pasa en dos mitades
+        uintptr_t address = (uintptr_t) this;
+        getcontext(&context);
+        context.uc_stack.ss_sp = stack;
+        context.uc_stack.ss_size = FLEET_STACK_SIZE;
+        context.uc_link = &caller;
+        makecontext(&context, (void (*)()) &FleetClock::start, 2,
+                    (unsigned int) (address >> 32), (unsigned int) (address & 0xFFFFFFFFu));
+    }
+
+    FleetClock::~FleetClock() {
+        delete[] stack;
+    }
+
+    void FleetClock::start(unsigned int high, unsigned int low) {
+        FleetClock *clock = (FleetClock *) (((uintptr_t) high << 32) | (uintptr_t) low);
+        clock->body();
+        clock->finished = true;
+    }
+
+    /**
+     * @brief El coche puede continuar en un hilo en el que no ha estado: se prepara antes su registro de mensajes,
+     * para que el bucle del coche no reserve memoria
+     */
+    bool FleetClock::resume(long long boundary) {
+        if (finished)
+            return false;
+        this->boundary = boundary;
+        RoboCar::Logger::prepareThread();
+        swapcontext(&caller, &context);
+        return !finished;
+    }
+
+    bool FleetClock::isFinished() const {
+        return finished;
+    }
+
+    /**
+     * @brief La región sin reservas en la que esté el coche es suya: no se aplica a lo que ejecute el hilo mientras
+     * tanto, y se recupera al continuar (quizás en otro hilo)
+     */
+    void FleetClock::yield() {
+        const char *region = RoboCar::AllocationFreeRegion::getCurrent();
+        RoboCar::AllocationFreeRegion::setCurrent(nullptr);
+        swapcontext(&context, &caller);
+        RoboCar::AllocationFreeRegion::setCurrent(region);
+    }
+
+    void FleetClock::sleep(long long ums) {
+        if (ums > 0)
+            sleepUntil(time + ums);
+    }
+
+    /**
+     * @brief Una espera que termina después del intervalo en curso se reparte entre los intervalos necesarios
+     */
+    void FleetClock::sleepUntil(long long time) {
+        while (time > boundary) {
+            if (boundary > this->time)
+                this->time = boundary;
+            yield();
+        }
+        if (time > this->time)
+            this->time = time;
+    }
+
+    void FleetClock::advance(long long ums) {
+        if (ums <= 0)
+            return;
+        time += ums;
+        while (time >= boundary)
+            yield();
+    }
+
+    Fleet::Fleet(const Arena &arena, long long ioCost) : arena(arena) {
+        this->ioCost = ioCost;
+        this->threads = 0;
+        this->syncs = 0;
+        this->realTime = 0;
+    }
+
+    Fleet::~Fleet() {
+        for (Member &member : members) {
+            delete member.backend;
+            delete member.clock;
+        }
+    }
+
+    /**
+     * @brief Cada coche queda al menos a FLEET_START_CLEARANCE_CM de las paredes y a FLEET_START_SEPARATION_CM del
+     * resto, con una orientación al azar
+     * @return false si no se ha encontrado sitio para todos los coches
+     */
+    bool Fleet::populate(int size, unsigned int seed) {
+        float minX = 0, minY = 0, maxX = 0, maxY = 0;
+        for (const Segment &wall : arena.getWalls()) {
+            for (const Point &point : {wall.a, wall.b}) {
+                minX = std::fmin(minX, point.x);
+                minY = std::fmin(minY, point.y);
+                maxX = std::fmax(maxX, point.x);
+                maxY = std::fmax(maxY, point.y);
+            }
+        }
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> x(minX, maxX), y(minY, maxY), heading(-(float) M_PI, (float) M_PI);
+
+        std::vector<Pose> poses = {{arena.getStart().x, arena.getStart().y, arena.getStartHeading()}};
+        while ((int) poses.size() < size) {
+            int attempt = 0;
+            for (; attempt < FLEET_START_ATTEMPTS; attempt++) {
+                Pose pose = {x(random), y(random), heading(random)};
+                bool free = arena.contains({pose.x, pose.y}) && arena.clearance({pose.x, pose.y}) >= FLEET_START_CLEARANCE_CM;
+                for (size_t i = 0; i < poses.size() && free; i++)
+                    free = std::hypot(pose.x - poses[i].x, pose.y - poses[i].y) >= FLEET_START_SEPARATION_CM;
+                if (free) {
+                    poses.push_back(pose);
+                    break;
+                }
+            }
+            if (attempt == FLEET_START_ATTEMPTS) {
+                std::cerr << "No hay sitio en el escenario para " << size << " coches (solo para " << poses.size()
+                          << ")" << std::endl;
+                return false;
+            }
+        }
+
+        // Los relojes guardan la dirección de su coche: no se puede realojar el vector
+        members.reserve(size);
+        traffic.poses.clear();
+        traffic.pings.assign(size, {});
+        for (int i = 0; i < size; i++) {
+            FleetClock *clock = new FleetClock([this, i]() {
+                auto *car = new RoboCar::RoboCar(pins, calibrationPath);
+                members[i].completed = behaviour(car);
+                delete car;
+            });
+            SimBackend *backend = new SimBackend(arena, clock, ioCost, seed + i, pins);
+            backend->setPose(poses[i]);
+            backend->joinTraffic(&traffic, i);
+            members.push_back({clock, backend, false});
+            traffic.poses.push_back(poses[i]);
+        }
+        return true;
+    }
+
+    int Fleet::getSize() const {
+        return (int) members.size();
+    }
+
+    SimBackend *Fleet::getBackend(int car) const {
+        return members[car].backend;
+    }
+
+    void Fleet::setCar(const RoboCar::PinMap &pins, const std::string &calibrationPath) {
+        this->pins = pins;
+        this->calibrationPath = calibrationPath;
+    }
+
+    /**
+     * @brief En cada intervalo, cada coche que no ha terminado es una tarea que lo ejecuta con su reloj y su backend
+     * como los del hilo que la toma. Al terminar el intervalo se actualiza el tráfico: posición de cada coche y
+     * pulsos que no se han extinguido
+     */
+    void Fleet::run(int threads, std::function<bool(RoboCar::RoboCar *)> behaviour) {
+        this->behaviour = behaviour;
+        this->threads = threads;
+        auto realStart = std::chrono::steady_clock::now();
+        std::streambuf *output = std::cout.rdbuf(&nullBuffer);
+        {
+            TaskPool pool(threads);
+            int running = (int) members.size();
+            for (long long boundary = FLEET_SYNC_INTERVAL_UMS; running > 0; boundary += FLEET_SYNC_INTERVAL_UMS) {
+                for (Member &member : members) {
+                    if (member.clock->isFinished())
+                        continue;
+                    pool.submit([&member, boundary]() {
+                        PinsLib::Clock::setForThread(member.clock);
+                        PinsLib::Backend::setForThread(member.backend);
+                        member.clock->resume(boundary);
+                        member.backend->synchronize(member.clock->now());
+                        PinsLib::Backend::setForThread(nullptr);
+                        PinsLib::Clock::setForThread(nullptr);
+                    });
+                }
+                pool.wait();
+                syncs++;
+
+                running = 0;
+                for (size_t i = 0; i < members.size(); i++) {
+                    traffic.poses[i] = members[i].backend->getPose();
+                    std::vector<Ping> &pings = traffic.pings[i];
+                    size_t kept = 0;
+                    for (const Ping &ping : pings) {
+                        if (ping.expires >= boundary)
+                            pings[kept++] = ping;
+                    }
+                    pings.resize(kept);
+                    members[i].backend->collectPings(pings);
+                    if (!members[i].clock->isFinished())
+                        running++;
+                }
+            }
+        }
+        std::cout.rdbuf(output);
+        realTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - realStart).count();
+    }
+
+    Fleet::CarStats Fleet::getStats(int car) const {
+        const Member &member = members[car];
+        return {member.completed, member.clock->now(), member.backend->getPose(), member.backend->getTravelled(),
+                member.backend->getCollisions(), member.backend->getCrosstalkEchoes(),
+                member.backend->getInterferenceEchoes()};
+    }
+
+    long long Fleet::getRealTime() const {
+        return realTime;
+    }
+
+    void Fleet::printReport(std::ostream &out) const {
+        long long virtualTime = 0, collisions = 0, interference = 0;
+        double travelled = 0;
+        for (int i = 0; i < getSize(); i++) {
+            CarStats stats = getStats(i);
+            out << "  Coche " << i << (stats.completed ? "" : " (fallido)") << ": (" << stats.pose.x << ", "
+                << stats.pose.y << ") CM, " << stats.pose.heading * 180.0f / M_PI << " grados. Recorrido: "
+                << stats.travelled << " CM. Colisiones: " << stats.collisions << ". Ecos con interferencias: "
+                << stats.interferenceEchoes << std::endl;
+            virtualTime += stats.virtualTime;
+            collisions += stats.collisions;
+            interference += stats.interferenceEchoes;
+            travelled += stats.travelled;
+        }
+        out << "Flota: " << getSize() << " coches, " << virtualTime / 1000000.0 << " s de coche simulados en "
+            << realTime / 1000 << " ms reales con " << threads << " hilos ("
+            << (realTime > 0 ? virtualTime / (double) realTime : 0) << " s de coche por segundo real), "
+            << syncs << " sincronizaciones" << std::endl;
+        out << "Total: " << travelled << " CM recorridos, " << collisions << " colisiones, " << interference
+            << " ecos con interferencias de otros coches" << std::endl;
+    }
+
+} /* namespace Simulator */
@@ -0,0 +1,54 @@
+#include "Simulator/MotorModel.h"
+#include <cmath>
+
+namespace Simulator {
+
+    MotorModel::MotorModel() : MotorModel(DEFAULT_DEAD_ZONE, DEFAULT_MAX_SPEED, DEFAULT_CURVE_EXPONENT,
+                                          DEFAULT_TIME_CONSTANT) {
+    }
+
+    MotorModel::MotorModel(float deadZone, float maxSpeed, float curveExponent, float timeConstant) {
+        this->deadZone = deadZone;
+        this->maxSpeed = maxSpeed;
+        this->curveExponent = curveExponent;
+        this->timeConstant = timeConstant;
+        this->speed = 0;
+        this->ticks = 0;
+    }
+
+    /**
+     * @brief Curva duty cycle -> velocidad: nula dentro de la zona muerta y creciente hasta maxSpeed
+     * @return Velocidad en régimen permanente (tacos/s)
+     */
+    float MotorModel::steadySpeed(int dutyCycle, int period) const {
+        if (period <= 0)
+            return 0;
+        float duty = std::fmin(1.0f, std::fmax(0.0f, (float) dutyCycle / (float) period));
+        if (duty <= deadZone)
+            return 0;
+        return maxSpeed * std::pow((duty - deadZone) / (1.0f - deadZone), curveExponent);
+    }
+
+    /**
+     * @brief Integra la respuesta de primer orden del motor y acumula los tacos recorridos. Con menos tensión de
+     * alimentación, el mismo duty cycle equivale a uno proporcionalmente menor
+     */
+    void MotorModel::step(int direction, int dutyCycle, int period, float dt, float supply) {
+        float target = (float) direction * steadySpeed((int) std::lround(dutyCycle * supply), period);
+        speed += (target - speed) * (1.0f - std::exp(-dt / timeConstant));
+        ticks += std::fabs(speed) * dt;
+    }
+
+    float MotorModel::getSpeed() const {
+        return speed;
+    }
+
+    double MotorModel::getTicks() const {
+        return ticks;
+    }
+
+    bool MotorModel::encoderLevel() const {
+        return ((long long) (ticks * 2.0)) % 2 == 0;
+    }
+
+} /* namespace Simulator */
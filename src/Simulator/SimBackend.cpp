@@ -0,0 +1,335 @@
+#include "Simulator/SimBackend.h"
+#include "RoboCar/Geometry.h"
+#include "RoboCar/BatteryMonitor.h"
+#include "RoboCar/UltrasoundSensor.h"
+#include <algorithm>
+#include <cmath>
+
+// Paso de integración de la física
+#define SIMULATION_STEP_UMS         1000
+
+// Modelo del sensor de ultrasonidos
+#define ULTRASOUND_RAYS             9
+#define ULTRASOUND_MAX_RANGE_CM     400.0f
+#define ULTRASOUND_MIN_RANGE_CM     2.0f
+#define ULTRASOUND_NOISE_CM         0.5f
+#define ULTRASOUND_NOISE_RATIO      0.01f
+
+// Semiapertura (grados) del cono en el que el receptor capta ecos, más ancho que el haz emitido
+#define ULTRASOUND_RECEIVE_HALF_ANGLE 50.0f
+
+// Modelo de la batería: tensión mínima (descargada) y ruido de las lecturas del ADC (V)
+#define BATTERY_MIN_VOLTAGE         6.0f
+#define BATTERY_ADC_NOISE_V         0.05f
+
+namespace Simulator {
+
+    /**
+     * @brief Prepara la simulación del coche en la posición de salida del escenario
+     * @param arena Escenario sobre el que se mueve el coche
+     * @param clock Reloj virtual que se hará avanzar con cada operación
+     * @param ioCost Tiempo virtual, en us, que consume cada lectura o escritura de un pin
+     * @param seed Semilla para el ruido de las medidas
+     * @param pins Pines del coche simulado
+     */
+    SimBackend::SimBackend(const Arena &arena, PinsLib::VirtualClock *clock, long long ioCost, unsigned int seed,
+                           const RoboCar::PinMap &pins)
+            : RoboCar::VirtualBackend(clock, ioCost, pins), arena(arena), random(seed) {
+        Point start = arena.getStart();
+        pose = {start.x, start.y, arena.getStartHeading()};
+        lastUpdate = clock->now();
+        sensorMounts.push_back(0);
+        pings.push_back({-1, -1, {0, 0}, {0, 0}});
+        contaminated.push_back(false);
+        crosstalkEchoes = 0;
+        traffic = nullptr;
+        trafficIndex = -1;
+        interferenceEchoes = 0;
+        collisions = 0;
+        inContact = false;
+        travelled = 0;
+        batteryStart = 0;
+        batteryDrain = 0;
+        batteryStartTime = clock->now();
+        adcRandom.seed(seed);
+    }
+
+    Pose SimBackend::getPose() const {
+        return pose;
+    }
+
+    void SimBackend::setPose(Pose pose) {
+        this->pose = pose;
+    }
+
+    void SimBackend::setSensorMount(float angle) {
+        sensorMounts[0] = angle;
+    }
+
+    int SimBackend::addSensor(int triggerPin, int echoPin, float mount) {
+        sensorMounts.push_back(mount);
+        pings.push_back({-1, -1, {0, 0}, {0, 0}});
+        contaminated.push_back(false);
+        return addUltrasound(triggerPin, echoPin);
+    }
+
+    long long SimBackend::getCrosstalkEchoes() const {
+        return crosstalkEchoes;
+    }
+
+    void SimBackend::joinTraffic(const Traffic *traffic, int index) {
+        this->traffic = traffic;
+        this->trafficIndex = index;
+    }
+
+    void SimBackend::collectPings(std::vector<Ping> &out) {
+        out.insert(out.end(), emitted.begin(), emitted.end());
+        emitted.clear();
+    }
+
+    void SimBackend::synchronize(long long now) {
+        update(now);
+    }
+
+    long long SimBackend::getInterferenceEchoes() const {
+        return interferenceEchoes;
+    }
+
+    long long SimBackend::getCollisions() const {
+        return collisions;
+    }
+
+    double SimBackend::getTravelled() const {
+        return travelled;
+    }
+
+    const MotorModel &SimBackend::getMotor(RoboCar::Wheel wheel) const {
+        return motors[wheel];
+    }
+
+    void SimBackend::setMotor(RoboCar::Wheel wheel, const MotorModel &motor) {
+        motors[wheel] = motor;
+    }
+
+    /**
+     * @param voltage Tensión inicial (V). Los motores del modelo se ajustaron a BATTERY_NOMINAL_VOLTAGE
+     * @param drainPerMinute Descarga lineal (V/min), hasta BATTERY_MIN_VOLTAGE
+     */
+    void SimBackend::setBattery(float voltage, float drainPerMinute) {
+        batteryStart = voltage;
+        batteryDrain = drainPerMinute / 60.0f;
+        batteryStartTime = lastUpdate;
+    }
+
+    float SimBackend::getBatteryVoltage(long long now) const {
+        if (batteryStart <= 0)
+            return BATTERY_NOMINAL_VOLTAGE;
+        return std::fmax(BATTERY_MIN_VOLTAGE, batteryStart - batteryDrain * (now - batteryStartTime) / 1000000.0f);
+    }
+
+    /**
+     * @brief Además de los pines, responde a las lecturas del ADC de la batería con la tensión simulada más ruido
+     */
+    string SimBackend::read(const string &path, const string &filename) {
+        if (filename != BATTERY_IIO_RAW)
+            return VirtualBackend::read(path, filename);
+        // La lectura consume el mismo tiempo virtual que la de un pin
+        VirtualBackend::read(path, filename);
+        std::normal_distribution<float> noise(0.0f, BATTERY_ADC_NOISE_V);
+        float voltage = getBatteryVoltage(lastUpdate) + noise(adcRandom);
+        return std::to_string(std::lround(voltage / BATTERY_DIVIDER * 1000.0f / BATTERY_ADC_MV_PER_LSB));
+    }
+
+    /**
+     * @brief Avanza la física en pasos fijos hasta alcanzar el instante indicado
+     */
+    void SimBackend::update(long long now) {
+        while (lastUpdate + SIMULATION_STEP_UMS <= now) {
+            step(SIMULATION_STEP_UMS / 1000000.0f);
+            lastUpdate += SIMULATION_STEP_UMS;
+        }
+    }
+
+    void SimBackend::step(float dt) {
+        // Respuesta de cada motor a las órdenes que tiene aplicadas
+        float wheelSpeed[2];
+        for (RoboCar::Wheel wheel : {RoboCar::LEFT, RoboCar::RIGHT}) {
+            const MotorCommand &command = getMotorCommand(wheel);
+            int direction = 0;
+            if (command.enabled && command.forward != command.backward)
+                direction = command.forward ? 1 : -1;
+            motors[wheel].step(direction, command.dutyCycle, command.period, dt,
+                               getBatteryVoltage(lastUpdate) / BATTERY_NOMINAL_VOLTAGE);
+            wheelSpeed[wheel] = motors[wheel].getSpeed() * CM_PER_TICK;
+        }
+
+        // Cinemática diferencial
+        float linear = (wheelSpeed[RoboCar::LEFT] + wheelSpeed[RoboCar::RIGHT]) / 2.0f;
+        float angular = (wheelSpeed[RoboCar::RIGHT] - wheelSpeed[RoboCar::LEFT]) / WHEEL_TRACK_CM;
+        pose.heading = std::remainder(pose.heading + angular * dt, 2.0f * (float) M_PI);
+
+        // El desplazamiento solo se aplica si no se atraviesa ninguna pared ni se choca con otro coche
+        Point next = {pose.x + linear * std::cos(pose.heading) * dt, pose.y + linear * std::sin(pose.heading) * dt};
+        if (arena.clearance(next) < BODY_RADIUS_CM || blockedByTraffic(next)) {
+            if (!inContact && linear != 0)
+                collisions++;
+            inContact = true;
+        } else {
+            inContact = false;
+            travelled += std::fabs(linear * dt);
+            pose.x = next.x;
+            pose.y = next.y;
+        }
+    }
+
+    /**
+     * @brief Traza varios rayos dentro del haz del sensor y devuelve la distancia al obstáculo más cercano con ruido.
+     * Si antes que el propio eco le llega el pulso de otro sensor, el eco termina con él (medida corta errónea); del
+     * mismo modo, este disparo puede acortar el eco de los sensores que estén escuchando. Si hay más coches en el
+     * escenario, también los pulsos que emitieron antes de la última sincronización pueden acortar el eco
+     */
+    float SimBackend::echoDistance(int sensor, long long now) {
+        float halfAngle = ULTRASOUND_BEAM_HALF_ANGLE * (float) M_PI / 180.0f;
+        Point origin = sensorPosition();
+
+        float nearest = ULTRASOUND_MAX_RANGE_CM, direction = pose.heading + sensorMounts[sensor];
+        for (int i = 0; i < ULTRASOUND_RAYS; i++) {
+            float angle = pose.heading + sensorMounts[sensor] - halfAngle + 2.0f * halfAngle * i / (ULTRASOUND_RAYS - 1);
+            float range = castRay(origin, angle, ULTRASOUND_MAX_RANGE_CM);
+            if (range < nearest) {
+                nearest = range;
+                direction = angle;
+            }
+        }
+
+        std::normal_distribution<float> noise(0.0f, ULTRASOUND_NOISE_CM + ULTRASOUND_NOISE_RATIO * nearest);
+        float distance = std::fmax(ULTRASOUND_MIN_RANGE_CM, nearest + noise(random));
+
+        // Pulso emitido, que se extingue al recorrer el doble del alcance máximo
+        Ping &ping = pings[sensor];
+        ping.fired = now;
+        ping.expires = now + (long long) (2.0f * ULTRASOUND_MAX_RANGE_CM / CM_PER_SECOND * 1000000.0f);
+        ping.origin = origin;
+        ping.hit = {origin.x + nearest * std::cos(direction), origin.y + nearest * std::sin(direction)};
+        contaminated[sensor] = false;
+        if (nearest >= ULTRASOUND_MAX_RANGE_CM)
+            ping.expires = -1;
+        else if (traffic != nullptr)
+            emitted.push_back(ping);
+
+        for (int other = 0; other < (int) pings.size(); other++) {
+            if (other == sensor || pings[other].expires < now)
+                continue;
+            // Pulso anterior de otro sensor que llega mientras este escucha
+            long long arrival = crosstalkArrival(pings[other], sensor);
+            if (arrival > now && arrival < now + (long long) (2.0f * distance / CM_PER_SECOND * 1000000.0f)) {
+                distance = (float) (arrival - now) / 1000000.0f * CM_PER_SECOND / 2.0f;
+                contaminated[sensor] = true;
+                crosstalkEchoes++;
+            }
+        }
+        for (int other = 0; other < (int) pings.size(); other++) {
+            // Este pulso llega a otro sensor que está escuchando
+            if (other == sensor || !isListening(other, now) || ping.expires < 0)
+                continue;
+            long long arrival = crosstalkArrival(ping, other);
+            if (arrival > now && isListening(other, arrival)) {
+                endEcho(other, arrival);
+                if (!contaminated[other]) {
+                    contaminated[other] = true;
+                    crosstalkEchoes++;
+                }
+            }
+        }
+        for (int car = 0; traffic != nullptr && car < (int) traffic->pings.size(); car++) {
+            // Pulsos de otros coches que llegan mientras este escucha
+            for (const Ping &foreign : traffic->pings[car]) {
+                if (car == trafficIndex || foreign.expires < now)
+                    continue;
+                long long arrival = crosstalkArrival(foreign, sensor);
+                if (arrival > now && arrival < now + (long long) (2.0f * distance / CM_PER_SECOND * 1000000.0f)) {
+                    distance = (float) (arrival - now) / 1000000.0f * CM_PER_SECOND / 2.0f;
+                    if (!contaminated[sensor])
+                        interferenceEchoes++;
+                    contaminated[sensor] = true;
+                }
+            }
+        }
+        return distance;
+    }
+
+    Point SimBackend::sensorPosition() const {
+        return {pose.x + ULTRASOUND_OFFSET_CM * std::cos(pose.heading),
+                pose.y + ULTRASOUND_OFFSET_CM * std::sin(pose.heading)};
+    }
+
+    /**
+     * @brief El pulso llega al sensor si el punto en que se reflejó está dentro de su cono de recepción
+     * @return Instante de llegada (us), -1 si el sensor no lo capta
+     */
+    long long SimBackend::crosstalkArrival(const Ping &ping, int sensor) const {
+        Point position = sensorPosition();
+        float dx = ping.hit.x - position.x, dy = ping.hit.y - position.y;
+        float offAxis = std::remainder(std::atan2(dy, dx) - pose.heading - sensorMounts[sensor], 2.0f * (float) M_PI);
+        if (std::fabs(offAxis) > ULTRASOUND_RECEIVE_HALF_ANGLE * (float) M_PI / 180.0f)
+            return -1;
+        float path = std::hypot(ping.hit.x - ping.origin.x, ping.hit.y - ping.origin.y) + std::hypot(dx, dy);
+        return ping.fired + (long long) (path / CM_PER_SECOND * 1000000.0f);
+    }
+
+    /**
+     * @brief Los demás coches se modelan como círculos de radio BODY_RADIUS_CM en su última posición sincronizada
+     */
+    float SimBackend::castRay(Point origin, float angle, float maxRange) const {
+        float nearest = arena.castRay(origin, angle, maxRange);
+        float dx = std::cos(angle), dy = std::sin(angle);
+        for (int car = 0; traffic != nullptr && car < (int) traffic->poses.size(); car++) {
+            if (car == trafficIndex)
+                continue;
+            float cx = traffic->poses[car].x - origin.x, cy = traffic->poses[car].y - origin.y;
+            float along = cx * dx + cy * dy;
+            float across = cx * dy - cy * dx;
+            if (along <= 0 || std::fabs(across) > BODY_RADIUS_CM)
+                continue;
+            float range = along - std::sqrt(BODY_RADIUS_CM * BODY_RADIUS_CM - across * across);
+            if (range >= 0 && range < nearest)
+                nearest = range;
+        }
+        return nearest;
+    }
+
+    /**
+     * @brief El coche no puede acercarse a otro más de lo que permiten sus cuerpos, aunque sí alejarse de él
+     */
+    bool SimBackend::blockedByTraffic(Point next) const {
+        for (int car = 0; traffic != nullptr && car < (int) traffic->poses.size(); car++) {
+            if (car == trafficIndex)
+                continue;
+            const Pose &other = traffic->poses[car];
+            float distance = std::hypot(next.x - other.x, next.y - other.y);
+            if (distance < 2.0f * BODY_RADIUS_CM && distance < std::hypot(pose.x - other.x, pose.y - other.y))
+                return true;
+        }
+        return false;
+    }
+
+    bool SimBackend::encoderLevel(RoboCar::Wheel wheel, long long /*now*/) {
+        return motors[wheel].encoderLevel();
+    }
+
+    /**
+     * @brief Con la velocidad actual del motor, tiempo hasta completar el medio taco en curso, redondeado al paso de la
+     * física (el nivel solo cambia al integrar un paso). Si el motor acelera o frena, quien espera vuelve a preguntar
+     */
+    long long SimBackend::nextEncoderEdge(RoboCar::Wheel wheel, long long now) {
+        update(now);
+        float speed = std::fabs(motors[wheel].getSpeed());
+        if (speed <= 0)
+            return -1;
+        double halfTicks = motors[wheel].getTicks() * 2.0;
+        double remaining = (std::floor(halfTicks) + 1.0 - halfTicks) / 2.0;
+        long long steps = (long long) std::ceil(remaining / speed * 1000000.0 / SIMULATION_STEP_UMS);
+        return lastUpdate + std::max(steps, 1LL) * SIMULATION_STEP_UMS;
+    }
+
+} /* namespace Simulator */
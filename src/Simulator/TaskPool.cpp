@@ -0,0 +1,119 @@
+#include "Simulator/TaskPool.h"
+
+namespace Simulator {
+
+    // Conjunto y cola del hilo actual, si es uno de los hilos de un TaskPool
+    static thread_local TaskPool *currentPool = nullptr;
+    static thread_local int currentQueue = -1;
+
+    TaskPool::TaskPool(int threads) : queued(0), pending(0) {
+        stopping = false;
+        nextQueue = 0;
+        if (threads < 1)
+            threads = 1;
+        for (int i = 0; i < threads; i++)
+            queues.push_back(new Queue{{}, {}, 0, 0});
+        for (int i = 0; i < threads; i++)
+            this->threads.emplace_back(&TaskPool::work, this, i);
+    }
+
+    TaskPool::~TaskPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+        for (Queue *queue : queues)
+            delete queue;
+    }
+
+    /**
+     * @brief Una tarea añadida desde uno de los hilos va a su propia cola, para que la ejecute él mismo salvo que
+     * otro hilo se quede sin trabajo y se la robe
+     */
+    void TaskPool::submit(std::function<void()> task) {
+        int index;
+        if (currentPool == this) {
+            index = currentQueue;
+        } else {
+            index = nextQueue;
+            nextQueue = (nextQueue + 1) % (int) queues.size();
+        }
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued++;
+        }
+        available.notify_one();
+    }
+
+    void TaskPool::wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return pending == 0; });
+    }
+
+    int TaskPool::getThreads() const {
+        return (int) threads.size();
+    }
+
+    void TaskPool::printReport(std::ostream &out) const {
+        out << "Hilos: " << threads.size() << std::endl;
+        for (size_t i = 0; i < queues.size(); i++) {
+            out << "  Hilo " << i << ": " << queues[i]->executed << " tareas (" << queues[i]->stolen << " robadas)"
+                << std::endl;
+        }
+    }
+
+    void TaskPool::work(int index) {
+        currentPool = this;
+        currentQueue = index;
+        std::function<void()> task;
+        while (true) {
+            if (take(index, task)) {
+                task();
+                task = nullptr;
+                if (--pending == 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this]() { return stopping || queued > 0; });
+            if (stopping && queued == 0)
+                return;
+        }
+    }
+
+    /**
+     * @brief Toma la última tarea de la cola propia o, si está vacía, la primera de la siguiente cola que tenga alguna
+     */
+    bool TaskPool::take(int index, std::function<void()> &task) {
+        for (size_t offset = 0; offset < queues.size(); offset++) {
+            Queue *queue = queues[(index + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (queue->tasks.empty())
+                continue;
+            if (offset == 0) {
+                task = std::move(queue->tasks.back());
+                queue->tasks.pop_back();
+            } else {
+                task = std::move(queue->tasks.front());
+                queue->tasks.pop_front();
+                queues[index]->stolen++;
+            }
+            queues[index]->executed++;
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+} /* namespace Simulator */
@@ -1,11 +1,33 @@
 #include <iostream>
+#include <chrono>
+#include <cstdio>
 #include <getopt.h>
 #include "RoboCarAlgorithms.h"
+#include "RoboCar/ReplayBackend.h"
+#include "RoboCar/Session.h"
+#include "RoboCar/Geometry.h"
+#include "RoboCar/Pinout.h"
+#include "RoboCar/LiveState.h"
+#include "RoboCar/Watchdog.h"
+#include "RoboCar/BatteryMonitor.h"
+#include "RoboCar/TeleopProtocol.h"
+#include "RoboCar/Logger.h"
+#include "RoboCar/MissionReport.h"
+#include "Simulator/SimBackend.h"
+#include "Simulator/Fleet.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 // Valores por defecto para los parámetros
 #define DEFAULT_TIME                30
-#define DEFAULT_LIMIT_DISTANCE      35
 #define DEFAULT_MAXSPEED_ENABLED    false
+#define DEFAULT_SCAN_ARC            360
+#define DEFAULT_REPLAY_OUTPUT       "replay.commands"
+#define DEFAULT_SOCKET_PATH         TELEOP_SOCKET_PATH
+
+// Coste, en tiempo virtual, de cada operación sobre los pines durante una reproducción o simulación
+#define VIRTUAL_IO_COST_UMS         60
 
 void printHelp(char **argv) {
     std::cout << "USO: " << argv[0] << " [OPCIONES]" << std::endl;
@@ -20,21 +42,91 @@ void printHelp(char **argv) {
     std::cout << "    - simple : movimiento aleatorio evitando obstaculos" << std::endl;
     std::cout << "    - twister , tornado : movimiento rotatorio" << std::endl;
     std::cout << "    - circuit : movimiento siguiendo el circuito que se indique en un fichero" << std::endl;
+    std::cout << "    - race : circuito con aprendizaje (vuelta de reconocimiento y siguientes a maxima velocidad)" << std::endl;
+    std::cout << "    - wallfollow : seguimiento continuo de la pared derecha (sensor girado " << WALL_FOLLOW_MOUNT_DEG << " grados)" << std::endl;
+    std::cout << "    - goto X,Y : navegacion hasta el punto indicado (CM, X hacia delante e Y hacia la izquierda)" << std::endl;
+    std::cout << "    - teleop : conduccion desde otro proceso a traves de un socket UNIX (ver RoboCarTeleop.out)" << std::endl;
     std::cout << std::endl;
     std::cout << "  -t, --time <SEGUNDOS>" << std::endl;
     std::cout << "    (opcional, por defecto = 30)" << std::endl;
     std::cout << "    Tiempo de funcionamiento del vehiculo" << std::endl;
     std::cout << std::endl;
     std::cout << "  -d, --distance <CENTIMETROS>" << std::endl;
-    std::cout << "    (opcional, por defecto = 35)" << std::endl;
+    std::cout << "    (opcional, por defecto = la de los parametros, " << DEFAULT_LIMIT_DISTANCE << " sin fichero)" << std::endl;
     std::cout << "    Distancia a la que se detectan obstaculos" << std::endl;
     std::cout << std::endl;
     std::cout << "  -s, --maxSpeed" << std::endl;
     std::cout << "    Si se habilita, el vehiculo se movera a maxima velocidad" << std::endl;
     std::cout << std::endl;
+    std::cout << "  -a, --scanArc <GRADOS>" << std::endl;
+    std::cout << "    (opcional, por defecto = " << DEFAULT_SCAN_ARC << ")" << std::endl;
+    std::cout << "    Arco que barre el modo simple al encontrar un obstaculo. Con 0 gira hacia los lados tanteando" << std::endl;
+    std::cout << std::endl;
     std::cout << "  -k, --circuit <NOMBRE_FICHERO>" << std::endl;
-    std::cout << "    (obligatorio si --mode circuit)" << std::endl;
-    std::cout << "    Especifica las curvas que tiene el circuito" << std::endl;
+    std::cout << "    (obligatorio si --mode circuit o race)" << std::endl;
+    std::cout << "    Especifica los tramos que tiene el circuito" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -n, --dryRun" << std::endl;
+    std::cout << "    (opcional, con --mode circuit)" << std::endl;
+    std::cout << "    Compila el circuito y muestra el plan y el tiempo estimado de vuelta, sin mover el vehiculo" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -A, --array" << std::endl;
+    std::cout << "    (opcional, con --mode simple)" << std::endl;
+    std::cout << "    Usa tambien los sensores de ultrasonidos laterales, con disparos intercalados" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -u, --socket <RUTA>" << std::endl;
+    std::cout << "    (opcional, con --mode teleop, por defecto = " << DEFAULT_SOCKET_PATH << ")" << std::endl;
+    std::cout << "    Socket UNIX en el que se esperan las ordenes de teleoperacion" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -b, --battery <DIRECTORIO>" << std::endl;
+    std::cout << "    (opcional, p.e: " << BATTERY_IIO_DEVICE << ")" << std::endl;
+    std::cout << "    Mide la bateria en el ADC del dispositivo IIO indicado y compensa con ella el duty cycle de las ruedas" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -v, --supply <VOLTIOS>[,<VOLTIOS/MIN>]" << std::endl;
+    std::cout << "    (opcional, con --simulate)" << std::endl;
+    std::cout << "    Simula la bateria con la tension inicial y la descarga indicadas" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -T, --threads" << std::endl;
+    std::cout << "    (opcional, con --mode wallfollow y en el coche real)" << std::endl;
+    std::cout << "    Ejecuta el sensado y el control en hilos fijados a distintos nucleos, comunicados por el bus" << std::endl;
+    std::cout << "    Sin verificar: no se puede simular ni reproducir, solo se mide el bus entre hilos (make bench)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -L, --live" << std::endl;
+    std::cout << "    (opcional)" << std::endl;
+    std::cout << "    Publica el estado del coche en memoria compartida (" << LIVE_STATE_NAME << ") para RoboCarMonitor.out" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -W, --watchdog" << std::endl;
+    std::cout << "    (opcional)" << std::endl;
+    std::cout << "    Vigila los plazos del bucle y del sensado: reduce la carga ante retrasos y detiene el coche si se bloquea" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -r, --record <NOMBRE_FICHERO>" << std::endl;
+    std::cout << "    (opcional)" << std::endl;
+    std::cout << "    Graba en un fichero de sesion las medidas de los sensores tomadas durante la ejecucion" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -p, --replay <NOMBRE_FICHERO>" << std::endl;
+    std::cout << "    (opcional)" << std::endl;
+    std::cout << "    Ejecuta el modo indicado sobre una sesion grabada, con un reloj virtual y sin usar los pines" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -S, --simulate <NOMBRE_FICHERO>" << std::endl;
+    std::cout << "    (opcional)" << std::endl;
+    std::cout << "    Ejecuta el modo indicado (o la calibracion) sobre un coche simulado en el escenario indicado" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -F, --fleet <COCHES>[,<HILOS>]" << std::endl;
+    std::cout << "    (opcional, con --simulate, por defecto tantos hilos como nucleos)" << std::endl;
+    std::cout << "    Simula a la vez varios coches en el mismo escenario, cada uno ejecutando el modo indicado" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -P, --params <NOMBRE_FICHERO>" << std::endl;
+    std::cout << "    (opcional, por defecto = " << DEFAULT_PARAMETERS_FILE << " si existe)" << std::endl;
+    std::cout << "    Parametros de comportamiento del coche (giros, control de velocidad...), p.e: de RoboCarTune.out" << std::endl;
+    std::cout << "    El fichero se vigila: al guardarlo se aplican los nuevos parametros sin reiniciar" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -R, --report <NOMBRE_FICHERO>" << std::endl;
+    std::cout << "    (opcional, con --mode simple o circuit)" << std::endl;
+    std::cout << "    Escribe al terminar un resumen de la mision en JSON (distancias, velocidades, tiempos, eventos...)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  -o, --output <NOMBRE_FICHERO>" << std::endl;
+    std::cout << "    (opcional, por defecto = " << DEFAULT_REPLAY_OUTPUT << " al reproducir)" << std::endl;
+    std::cout << "    Fichero donde se escriben los comandos generados durante una reproduccion o simulacion" << std::endl;
     std::cout << std::endl;
     std::cout << "  -h, --help" << std::endl;
     std::cout << "    Muestra este menu de ayuda" << std::endl;
@@ -47,9 +139,25 @@ int main(int argc, char **argv) {
     bool calibrate = false;
     std::string mode;
     int time = DEFAULT_TIME;
-    int limitDistance = DEFAULT_LIMIT_DISTANCE;
+    int limitDistance = -1;
     bool maxSpeed = DEFAULT_MAXSPEED_ENABLED;
+    bool dryRun = false;
+    bool threads = false;
+    bool live = false;
+    bool watchdog = false;
+    bool sensorArray = false;
+    std::string batteryDevice;
+    float supplyVoltage = 0, supplyDrain = 0;
+    int scanArc = DEFAULT_SCAN_ARC;
     std::string circuit;
+    std::string socketPath = DEFAULT_SOCKET_PATH;
+    std::string recordFile;
+    std::string replayFile;
+    std::string simulationArena;
+    std::string commandsOutput;
+    std::string parametersFile;
+    std::string reportFile;
+    int fleetSize = 0, fleetThreads = (int) std::thread::hardware_concurrency();
 
     struct option long_options[] = {
             {"calibrate", no_argument,       nullptr, 'c'},
@@ -57,7 +165,23 @@ int main(int argc, char **argv) {
             {"time",      required_argument, nullptr, 't'},
             {"distance",  required_argument, nullptr, 'd'},
             {"maxSpeed",  no_argument,       nullptr, 's'},
+            {"scanArc",   required_argument, nullptr, 'a'},
             {"circuit",   required_argument, nullptr, 'k'},
+            {"dryRun",    no_argument,       nullptr, 'n'},
+            {"socket",    required_argument, nullptr, 'u'},
+            {"array",     no_argument,       nullptr, 'A'},
+            {"threads",   no_argument,       nullptr, 'T'},
+            {"live",      no_argument,       nullptr, 'L'},
+            {"watchdog",  no_argument,       nullptr, 'W'},
+            {"battery",   required_argument, nullptr, 'b'},
+            {"supply",    required_argument, nullptr, 'v'},
+            {"record",    required_argument, nullptr, 'r'},
+            {"replay",    required_argument, nullptr, 'p'},
+            {"simulate",  required_argument, nullptr, 'S'},
+            {"fleet",     required_argument, nullptr, 'F'},
+            {"params",    required_argument, nullptr, 'P'},
+            {"output",    required_argument, nullptr, 'o'},
+            {"report",    required_argument, nullptr, 'R'},
             {"help",      no_argument,       nullptr, 'h'},
             {nullptr,     0,                 nullptr, 0}
     };
@@ -80,9 +204,65 @@ int main(int argc, char **argv) {
             case 's':
                 maxSpeed = true;
                 break;
+            case 'a':
+                scanArc = stoi(optarg);
+                break;
             case 'k':
                 circuit = optarg;
                 break;
+            case 'n':
+                dryRun = true;
+                break;
+            case 'u':
+                socketPath = optarg;
+                break;
+            case 'A':
+                sensorArray = true;
+                break;
+            case 'T':
+                threads = true;
+                break;
+            case 'L':
+                live = true;
+                break;
+            case 'W':
+                watchdog = true;
+                break;
+            case 'b':
+                batteryDevice = optarg;
+                if (batteryDevice.back() != '/')
+                    batteryDevice += "/";
+                break;
+            case 'v':
+                if (sscanf(optarg, "%f,%f", &supplyVoltage, &supplyDrain) < 1 || supplyVoltage <= 0) {
+                    std::cerr << "La bateria simulada se indica como VOLTIOS[,VOLTIOS/MIN]" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'r':
+                recordFile = optarg;
+                break;
+            case 'p':
+                replayFile = optarg;
+                break;
+            case 'S':
+                simulationArena = optarg;
+                break;
+            case 'F':
+                if (sscanf(optarg, "%d,%d", &fleetSize, &fleetThreads) < 1 || fleetSize < 1 || fleetThreads < 1) {
+                    std::cerr << "La flota se indica como COCHES[,HILOS]" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'P':
+                parametersFile = optarg;
+                break;
+            case 'o':
+                commandsOutput = optarg;
+                break;
+            case 'R':
+                reportFile = optarg;
+                break;
             case 'h':
             default:
                 printHelp(argv);
@@ -90,8 +270,193 @@ int main(int argc, char **argv) {
         }
     }
 
+    // El modo goto recibe el destino a continuación: --mode goto X,Y
+    float goalX = 0, goalY = 0;
+    if (mode == "goto") {
+        if (optind >= argc || sscanf(argv[optind], "%f,%f", &goalX, &goalY) != 2) {
+            std::cerr << "Se tiene que indicar el destino con el formato X,Y" << std::endl;
+            printHelp(argv);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /*** Parámetros de comportamiento del coche ***/
+    // Sin --params se cargan los de DEFAULT_PARAMETERS_FILE si existe. La distancia indicada con --distance y la
+    // velocidad máxima prevalecen sobre el fichero, también al recargarlo
+    RoboCar::Parameters parameters;
+    bool missingParameters = parametersFile.empty() && !std::ifstream(DEFAULT_PARAMETERS_FILE).good();
+    if (parametersFile.empty())
+        parametersFile = DEFAULT_PARAMETERS_FILE;
+    if (!missingParameters) {
+        if (!parameters.load(parametersFile))
+            exit(EXIT_FAILURE);
+        std::cout << "Parametros cargados de " << parametersFile << std::endl;
+    }
+    std::string overrides;
+    if (limitDistance >= 0)
+        overrides += "limitDistance " + std::to_string(limitDistance) + "\n";
+    if (maxSpeed)
+        overrides += "maxSpeed 1\n";
+    std::istringstream commandLine(overrides);
+    if (!parameters.parse(commandLine, "de la linea de comandos"))
+        exit(EXIT_FAILURE);
+    limitDistance = parameters.limitDistance;
+    maxSpeed = parameters.maxSpeed;
+
+    // El fichero se vigila (aunque todavía no exista) para aplicar los cambios sin reiniciar
+    RoboCar::ParameterStore parameterStore(parameters);
+    parameterStore.setOverrides(overrides);
+    if (!calibrate && !dryRun && parameterStore.watch(parametersFile))
+        std::cout << "Vigilando los cambios en " << parametersFile << std::endl;
+
+    /*** Ejecución del modo indicado sobre un coche ***/
+    // Se comprueba el modo antes de preparar nada, ya que se ejecuta sobre el único coche o sobre cada coche de la flota
+    if (!calibrate && mode.empty()) {
+        printHelp(argv);
+        exit(EXIT_FAILURE);
+    } else if (!calibrate && mode != "simple" && mode != "twister" && mode != "tornado" && mode != "circuit" && mode != "race" &&
+               mode != "wallfollow" && mode != "goto" && mode != "teleop") {
+        std::cerr << "No se reconoce el modo << " << mode << std::endl;
+        printHelp(argv);
+        exit(EXIT_FAILURE);
+    }
+    auto runMode = [&](RoboCar::RoboCar *car) -> bool {
+        if (mode == "simple") {
+            RoboCarAlgorithms::simpleMode(car, time, limitDistance, maxSpeed, scanArc);
+        } else if (mode == "twister" || mode == "tornado") {
+            RoboCarAlgorithms::twisterMode(car, time);
+        } else if (mode == "circuit" && dryRun) {
+            return RoboCarAlgorithms::circuitDryRun(car, circuit);
+        } else if (mode == "circuit") {
+            RoboCarAlgorithms::circuitMode(car, time, limitDistance, circuit);
+        } else if (mode == "race") {
+            RoboCarAlgorithms::raceMode(car, time, limitDistance, circuit);
+        } else if (mode == "wallfollow") {
+            RoboCarAlgorithms::wallFollowMode(car, time, limitDistance, maxSpeed, threads);
+        } else if (mode == "goto") {
+            RoboCarAlgorithms::gotoMode(car, time, limitDistance, goalX, goalY);
+        } else if (mode == "teleop") {
+            RoboCarAlgorithms::teleopMode(car, time, socketPath);
+        }
+        return true;
+    };
+
+    // Sensores y batería de un coche simulado
+    auto configureSimulation = [&](Simulator::SimBackend *backend) {
+        if (mode == "wallfollow")
+            backend->setSensorMount(WALL_FOLLOW_MOUNT_DEG * (float) M_PI / 180.0f);
+        if (supplyVoltage > 0)
+            backend->setBattery(supplyVoltage, supplyDrain);
+        if (sensorArray) {
+            RoboCar::PinMap pins;
+            float side = ULTRASOUND_SIDE_MOUNT_DEG * (float) M_PI / 180.0f;
+            backend->addSensor(pins.leftUltrasoundTrigger, pins.leftUltrasoundEcho, side);
+            backend->addSensor(pins.rightUltrasoundTrigger, pins.rightUltrasoundEcho, -side);
+        }
+    };
+
+    Simulator::Arena arena;
+
+    /*** Simulación de una flota ***/
+    // Cada coche se crea, carga la calibración y ejecuta el modo en su propio contexto. No se admite nada que dependa
+    // de recursos únicos del proceso (grabación, memoria compartida, watchdog, socket, batería real...)
+    if (fleetSize > 0) {
+        if (simulationArena.empty() || calibrate || dryRun || threads || live || watchdog || mode == "teleop" ||
+            !recordFile.empty() || !replayFile.empty() || !batteryDevice.empty() || !commandsOutput.empty() ||
+            !reportFile.empty()) {
+            std::cerr << "La flota solo se puede simular (--simulate), sin calibrar, grabar, vigilar, publicar el estado "
+                      << "ni escribir el resumen" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!arena.load(simulationArena))
+            exit(EXIT_FAILURE);
+        Simulator::Fleet fleet(arena, VIRTUAL_IO_COST_UMS);
+        if (!fleet.populate(fleetSize, 1))
+            exit(EXIT_FAILURE);
+        for (int i = 0; i < fleet.getSize(); i++)
+            configureSimulation(fleet.getBackend(i));
+        fleet.run(fleetThreads, [&](RoboCar::RoboCar *car) {
+            car->setParameters(parameters);
+            car->setParameterStore(&parameterStore);
+            std::pair<int, int> results = car->loadCalibration();
+            if (results.minimum == 0 && results.maximum == 0)
+                return false;
+            if (sensorArray)
+                car->enableUltrasoundArray();
+            return runMode(car);
+        });
+        fleet.printReport(std::cerr);
+        parameterStore.stop();
+        exit(EXIT_SUCCESS);
+    }
+
+    /*** Preparación de la reproducción de una sesión grabada o de la simulación ***/
+    // Se sustituyen el reloj y los pines antes de crear el coche, de forma que este no acceda al hardware
+    PinsLib::VirtualClock *virtualClock = nullptr;
+    RoboCar::VirtualBackend *virtualBackend = nullptr;
+    RoboCar::ReplayBackend *replayBackend = nullptr;
+    Simulator::SimBackend *simBackend = nullptr;
+    std::ofstream commands;
+    if (!replayFile.empty() && !simulationArena.empty()) {
+        std::cerr << "No se puede reproducir una sesion y simular a la vez" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    // El reloj virtual, los backends de reproducción y simulación y la grabación no admiten varios hilos
+    if (threads && (!replayFile.empty() || !simulationArena.empty() || !recordFile.empty())) {
+        std::cerr << "La ejecucion en varios hilos solo es posible en el coche real y sin grabar" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!replayFile.empty()) {
+        if (calibrate || !recordFile.empty()) {
+            std::cerr << "No se puede calibrar ni grabar durante una reproduccion" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::vector<RoboCar::SessionRecord> records;
+        if (!RoboCar::loadSession(replayFile, records))
+            exit(EXIT_FAILURE);
+        if (commandsOutput.empty())
+            commandsOutput = DEFAULT_REPLAY_OUTPUT;
+        virtualClock = new PinsLib::VirtualClock();
+        replayBackend = new RoboCar::ReplayBackend(records, virtualClock, VIRTUAL_IO_COST_UMS);
+        virtualBackend = replayBackend;
+    } else if (!simulationArena.empty()) {
+        if (!arena.load(simulationArena))
+            exit(EXIT_FAILURE);
+        virtualClock = new PinsLib::VirtualClock();
+        simBackend = new Simulator::SimBackend(arena, virtualClock, VIRTUAL_IO_COST_UMS);
+        configureSimulation(simBackend);
+        virtualBackend = simBackend;
+    } else if (supplyVoltage > 0) {
+        std::cerr << "La bateria solo se puede simular con --simulate" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (virtualBackend != nullptr) {
+        if (!commandsOutput.empty()) {
+            commands.open(commandsOutput);
+            if (!commands.is_open()) {
+                std::cerr << "No se pudo abrir el fichero " << commandsOutput << " para escritura" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            virtualBackend->setCommandLog(&commands);
+        }
+        PinsLib::Clock::set(virtualClock);
+        PinsLib::Backend::set(virtualBackend);
+    }
+
+    /*** Medida de la batería ***/
+    // Antes de calibrar, para que cada tabla de calibración se guarde con la tensión a la que se tomó
+    RoboCar::BatteryMonitor battery(batteryDevice);
+    if (!batteryDevice.empty()) {
+        if (!battery.open())
+            exit(EXIT_FAILURE);
+        RoboCar::BatteryMonitor::set(&battery);
+        std::cout << "Bateria: " << battery.getVoltage() << " V" << std::endl;
+    }
+
     /*** Gestión de la calibración de RoboCar ***/
     auto *robocar = new RoboCar::RoboCar();
+    robocar->setParameters(parameters);
+    robocar->setParameterStore(&parameterStore);
 
     if (calibrate) {
         robocar->calibrate();
@@ -103,24 +468,121 @@ int main(int argc, char **argv) {
             exit(EXIT_FAILURE);
         }
     }
+    if (sensorArray)
+        robocar->enableUltrasoundArray();
+
+    /*** Publicación del estado en memoria compartida ***/
+    // Si el programa termina de forma abrupta el segmento permanece, y se reinicia en la siguiente ejecución
+    RoboCar::LiveState liveState;
+    if (live) {
+        if (!liveState.create())
+            exit(EXIT_FAILURE);
+        liveState.setMode(mode);
+        RoboCar::LiveState::set(&liveState);
+    }
+
+    /*** Grabación de la sesión ***/
+    RoboCar::SessionRecorder recorder;
+    if (!recordFile.empty()) {
+        if (!recorder.open(recordFile))
+            exit(EXIT_FAILURE);
+        RoboCar::SessionRecorder::set(&recorder);
+    }
+
+    /*** Vigilancia de los plazos del bucle ***/
+    // Los ficheros de parada de los motores se abren ahora, para que la parada de emergencia no dependa de los pines
+    RoboCar::Watchdog loopWatchdog;
+    if (watchdog) {
+        std::vector<std::string> stopFiles;
+        robocar->getStopFiles(stopFiles);
+        for (const std::string &file : stopFiles) {
+            if (!loopWatchdog.addStopFile(file))
+                exit(EXIT_FAILURE);
+        }
+        if (!loopWatchdog.hasFastStop())
+            std::cerr << "Watchdog sin acceso directo a los motores: el coche se detendra desde el bucle" << std::endl;
+        RoboCar::Watchdog::set(&loopWatchdog);
+        loopWatchdog.start();
+    }
+
+    /*** Resumen de la misión ***/
+    // Se acumula en cada ciclo del modo y se escribe al terminar
+    RoboCar::MissionReport missionReport;
+    if (!reportFile.empty()) {
+        if (mode != "simple" && mode != "circuit") {
+            std::cerr << "El resumen de la mision solo esta disponible en los modos simple y circuit" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        RoboCar::MissionReport::set(&missionReport);
+    }
+
+    /*** Registro asíncrono de los mensajes del bucle de control ***/
+    // El bucle solo encola los mensajes; el hilo de escritura los formatea y escribe en bloque
+    RoboCar::Logger logger;
+    logger.start();
+    RoboCar::Logger::set(&logger);
 
     /*** Ejecución del algoritmo en función del modo ***/
-    if (mode.empty()) {
-        printHelp(argv);
-        exit(EXIT_FAILURE);
-    } else if (mode == "simple") {
-        RoboCarAlgorithms::simpleMode(robocar, time, limitDistance, maxSpeed);
-    } else if (mode == "twister" || mode == "tornado") {
-        RoboCarAlgorithms::twisterMode(robocar, time);
-    } else if (mode == "circuit") {
-        RoboCarAlgorithms::circuitMode(robocar, time, limitDistance, circuit);
-    } else {
-        std::cerr << "No se reconoce el modo << " << mode << std::endl;
-        printHelp(argv);
+    auto realStart = std::chrono::steady_clock::now();
+    long long virtualStart = PinsLib::Clock::get()->now();
+    bool completed = runMode(robocar);
+    RoboCar::Logger::set(nullptr);
+    logger.flush();
+    if (!completed)
         exit(EXIT_FAILURE);
+    long long virtualTime = PinsLib::Clock::get()->now() - virtualStart;
+    Navigation::Pose estimated = robocar->getPose();
+
+    if (!reportFile.empty()) {
+        RoboCar::MissionReport::set(nullptr);
+        if (missionReport.save(reportFile))
+            std::cout << "Resumen de la mision en " << reportFile << std::endl;
+    }
+
+    if (watchdog) {
+        loopWatchdog.close();
+        RoboCar::Watchdog::set(nullptr);
+        loopWatchdog.printReport(std::cout);
+    }
+    if (!batteryDevice.empty()) {
+        std::cout << "Bateria al terminar: " << battery.getVoltage() << " V" << std::endl;
+        RoboCar::BatteryMonitor::set(nullptr);
     }
 
     delete robocar;
+    parameterStore.stop();
+    parameterStore.printReport(std::cout);
+
+    RoboCar::LiveState::set(nullptr);
+    liveState.close();
+    RoboCar::SessionRecorder::set(nullptr);
+    recorder.close();
+
+    if (virtualBackend != nullptr) {
+        long long realTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - realStart).count();
+        std::cerr << (replayBackend != nullptr ? "Reproduccion" : "Simulacion") << " terminada: "
+                  << virtualTime / 1000 << " ms virtuales en " << realTime << " ms reales, "
+                  << virtualBackend->getCommandCount() << " comandos";
+        if (!commandsOutput.empty())
+            std::cerr << " en " << commandsOutput;
+        std::cerr << std::endl;
+        if (replayBackend != nullptr) {
+            std::cerr << "Duracion de la sesion grabada: " << replayBackend->getDuration() / 1000 << " ms" << std::endl;
+        } else {
+            Simulator::Pose pose = simBackend->getPose();
+            std::cerr << "Posicion final: (" << pose.x << ", " << pose.y << ") CM, " << pose.heading * 180.0f / M_PI
+                      << " grados. Recorrido: " << simBackend->getTravelled() << " CM. Colisiones: "
+                      << simBackend->getCollisions() << ". Ecos con diafonia: " << simBackend->getCrosstalkEchoes()
+                      << std::endl;
+            std::cerr << "Odometria (respecto al inicio): (" << estimated.x << ", " << estimated.y << ") CM, "
+                      << estimated.heading * 180.0f / M_PI << " grados" << std::endl;
+        }
+        PinsLib::Backend::set(nullptr);
+        PinsLib::Clock::set(nullptr);
+        delete virtualBackend;
+        delete virtualClock;
+    }
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
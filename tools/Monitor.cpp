@@ -0,0 +1,157 @@
+// Monitor del estado del coche en ejecución (RoboCar.out --live). Lee el segmento de memoria compartida a la
+// frecuencia indicada, sin interferir con el coche, y muestra periódicamente su estado. También permite enviarle
+// órdenes: detenerlo o limitar su velocidad.
+//
+// USO: ./RoboCarMonitor.out [--rate HZ] [--print HZ] [--time SEGUNDOS] [--stop | --resume] [--speedLimit TACOS/S]
+
+#include "RoboCar/LiveState.h"
+#include "PinsLib/Clock.h"
+#include <cmath>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Frecuencias (Hz) por defecto de lectura del estado y de presentación por pantalla
+#define DEFAULT_POLL_RATE           1000
+#define DEFAULT_PRINT_RATE          10
+
+// Tiempo (us) sin actualizaciones tras el que se avisa de que el coche no está publicando
+#define STALE_TIMEUMS               2000000
+
+void printHelp(char **argv) {
+    std::cout << "USO: " << argv[0] << " [OPCIONES]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  --name <NOMBRE>        Segmento de memoria compartida (por defecto = " << LIVE_STATE_NAME << ")" << std::endl;
+    std::cout << "  --rate <HZ>            Frecuencia de lectura del estado (por defecto = " << DEFAULT_POLL_RATE << ")" << std::endl;
+    std::cout << "  --print <HZ>           Frecuencia de presentacion (por defecto = " << DEFAULT_PRINT_RATE << ")" << std::endl;
+    std::cout << "  --time <SEGUNDOS>      Tiempo de monitorizacion (por defecto, hasta interrumpirlo)" << std::endl;
+    std::cout << "  --stop                 Ordena detener el coche y terminar el modo en curso" << std::endl;
+    std::cout << "  --resume               Retira la orden de detener el coche" << std::endl;
+    std::cout << "  --speedLimit <TACOS/S> Limita la velocidad de las ruedas (0 sin limite)" << std::endl;
+    std::cout << "  --help                 Muestra este menu de ayuda" << std::endl;
+}
+
+void printState(const RoboCar::LiveStateData &state, unsigned long long polls, unsigned long long retries) {
+    std::cout << std::fixed << std::setprecision(1)
+              << "[" << state.time / 1000000.0 << " s] " << state.mode;
+    if (state.segment >= 0)
+        std::cout << " tramo " << state.segment;
+    std::cout << " | vel. ref " << state.commandedLeft << "/" << state.commandedRight
+              << " medida " << state.measuredLeft << "/" << state.measuredRight
+              << " duty " << state.dutyLeft << "/" << state.dutyRight
+              << " | dist " << state.distance
+              << " | pos (" << state.x << ", " << state.y << ") " << state.heading * 180.0f / M_PI
+              << " | leds " << ((state.leds & LIVE_GREEN_LED) ? "V" : "-") << ((state.leds & LIVE_RED_LED) ? "R" : "-")
+              << " | lecturas " << polls << " (" << retries << " fallidas)" << std::endl;
+    for (int i = 0; i < state.stageCount && i < LIVE_MAX_STAGES; i++) {
+        const RoboCar::LiveStage &stage = state.stages[i];
+        std::cout << "    " << std::left << std::setw(LIVE_STAGE_NAME_SIZE) << stage.name << std::right
+                  << " ejec " << stage.runs << " overrun " << stage.overruns << " jit " << stage.lastJitter
+                  << " (max " << stage.maxJitter << ") dur " << stage.lastDuration << " us" << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+int main(int argc, char **argv) {
+    std::string name = LIVE_STATE_NAME;
+    int pollRate = DEFAULT_POLL_RATE, printRate = DEFAULT_PRINT_RATE, time = -1, speedLimit = -1;
+    bool stop = false, resume = false;
+
+    struct option long_options[] = {
+            {"name",       required_argument, nullptr, 'n'},
+            {"rate",       required_argument, nullptr, 'r'},
+            {"print",      required_argument, nullptr, 'p'},
+            {"time",       required_argument, nullptr, 't'},
+            {"stop",       no_argument,       nullptr, 's'},
+            {"resume",     no_argument,       nullptr, 'c'},
+            {"speedLimit", required_argument, nullptr, 'l'},
+            {"help",       no_argument,       nullptr, 'h'},
+            {nullptr,      0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'n':
+                name = optarg;
+                break;
+            case 'r':
+                pollRate = std::stoi(optarg);
+                break;
+            case 'p':
+                printRate = std::stoi(optarg);
+                break;
+            case 't':
+                time = std::stoi(optarg);
+                break;
+            case 's':
+                stop = true;
+                break;
+            case 'c':
+                resume = true;
+                break;
+            case 'l':
+                speedLimit = std::stoi(optarg);
+                break;
+            case 'h':
+            default:
+                printHelp(argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (pollRate <= 0 || printRate <= 0 || printRate > pollRate) {
+        std::cerr << "Las frecuencias han de ser positivas y la de presentacion no mayor que la de lectura" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    RoboCar::LiveState liveState;
+    if (!liveState.attach(name))
+        exit(EXIT_FAILURE);
+
+    // Órdenes: se envían y se termina
+    if (stop || resume || speedLimit >= 0) {
+        if (stop || resume)
+            liveState.requestStop(stop);
+        if (speedLimit >= 0)
+            liveState.setSpeedLimit(speedLimit);
+        std::cout << "Ordenes enviadas: " << (liveState.stopRequested() ? "detener" : "en marcha")
+                  << ", limite de velocidad " << liveState.getSpeedLimit() << " tacos/s" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    // Monitorización: lecturas periódicas con esperas absolutas
+    PinsLib::SystemClock clock;
+    long long period = 1000000 / pollRate, printPeriod = 1000000 / printRate;
+    long long start = clock.now(), next = start, nextPrint = start, lastChange = start;
+    unsigned long long polls = 0, retries = 0;
+    uint32_t lastUpdates = 0;
+    bool stale = false;
+    RoboCar::LiveStateData state;
+    while (time < 0 || clock.now() - start < 1000000LL * time) {
+        clock.sleepUntil(next);
+        next += period;
+        polls++;
+        if (!liveState.read(state)) {
+            retries++;
+            continue;
+        }
+
+        long long now = clock.now();
+        if (state.updates != lastUpdates) {
+            lastUpdates = state.updates;
+            lastChange = now;
+            stale = false;
+        } else if (!stale && now - lastChange > STALE_TIMEUMS) {
+            std::cout << "El coche no publica su estado desde hace " << (now - lastChange) / 1000000 << " s" << std::endl;
+            stale = true;
+        }
+        if (now >= nextPrint) {
+            nextPrint += printPeriod;
+            if (!stale)
+                printState(state, polls, retries);
+        }
+    }
+    return EXIT_SUCCESS;
+}
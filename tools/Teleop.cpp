@@ -0,0 +1,343 @@
+// Cliente de teleoperación para RoboCar.out --mode teleop. Permite enviar órdenes sueltas, recibir la telemetría y
+// medir el rendimiento del servidor: ráfagas de órdenes a la máxima velocidad posible (--bench) o un flujo sostenido a
+// la frecuencia indicada (--rate), con la latencia de ida y vuelta medida con PING.
+//
+// USO: ./RoboCarTeleop.out [--socket RUTA] <ORDEN>
+//   --velocity L,R | --maneuver stop|forward|backward|left|right | --speed TACOS/S | --led green|red,on|off|toggle
+//   --telemetry MS [--time SEGUNDOS]
+//   --bench ORDENES [--burst ORDENES_POR_ESCRITURA]
+//   --rate HZ [--time SEGUNDOS]
+
+#include "RoboCar/TeleopProtocol.h"
+#include "RoboCar/RoboCar.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Valores por defecto: órdenes por escritura en el modo --bench y duración (s) de --rate y --telemetry
+#define DEFAULT_BURST               32
+#define DEFAULT_TIME                5
+
+// En el modo --rate se envía un PING cada PING_INTERVAL órdenes para medir la latencia de ida y vuelta
+#define PING_INTERVAL               100
+
+namespace {
+
+    int connection = -1;
+    uint8_t input[4096];
+    size_t inputUsed = 0;
+
+    long long nowUms() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool connectTo(const std::string &path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        connection = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection == -1 || connect(connection, (sockaddr *) &address, sizeof(address)) == -1) {
+            std::cerr << "No se pudo conectar con el coche en " << path << " (--mode teleop)" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeAll(const uint8_t *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = write(connection, data, size);
+            if (written <= 0) {
+                perror("Teleop: write failed ");
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool sendFrame(RoboCar::TeleopFrameType type, const void *payload, uint8_t length) {
+        uint8_t frame[TELEOP_MAX_FRAME];
+        return writeAll(frame, RoboCar::encodeTeleopFrame(frame, type, payload, length));
+    }
+
+    /**
+     * @brief Espera a la siguiente trama del tipo indicado, descartando las demás
+     * @param payload Contenido de la trama (al menos TELEOP_MAX_PAYLOAD bytes)
+     * @return true si se ha recibido, false si se ha cerrado la conexión
+     */
+    bool receiveFrame(RoboCar::TeleopFrameType type, void *payload) {
+        while (true) {
+            RoboCar::TeleopFrame frame;
+            size_t consumed = RoboCar::decodeTeleopFrame(input, inputUsed, frame);
+            if (consumed > 0) {
+                bool found = frame.type == type;
+                if (found)
+                    memcpy(payload, frame.payload, frame.length);
+                memmove(input, input + consumed, inputUsed - consumed);
+                inputUsed -= consumed;
+                if (found)
+                    return true;
+                continue;
+            }
+            ssize_t bytes = read(connection, input + inputUsed, sizeof(input) - inputUsed);
+            if (bytes <= 0)
+                return false;
+            inputUsed += bytes;
+        }
+    }
+
+    /**
+     * @brief Envía un PING y espera su respuesta, que el servidor da una vez atendidas todas las órdenes anteriores
+     * @return Tiempo de ida y vuelta (us), -1 si se ha perdido la conexión
+     */
+    long long ping(uint32_t sequence) {
+        RoboCar::TeleopPing request = {sequence, nowUms()}, reply;
+        if (!sendFrame(RoboCar::TELEOP_PING, &request, sizeof(request)))
+            return -1;
+        do {
+            if (!receiveFrame(RoboCar::TELEOP_PONG, &reply))
+                return -1;
+        } while (reply.sequence != sequence);
+        return nowUms() - reply.clientTime;
+    }
+
+    void printServerStats() {
+        RoboCar::TeleopStats stats;
+        if (sendFrame(RoboCar::TELEOP_STATS, nullptr, 0) && receiveFrame(RoboCar::TELEOP_STATS_REPLY, &stats)) {
+            std::cout << "Servidor: " << stats.commands << " ordenes ejecutadas, " << stats.coalesced
+                      << " velocidades agrupadas en " << stats.batches << " rafagas. Latencia de actuacion: media "
+                      << stats.meanLatency << " us, max " << stats.maxLatency << " us" << std::endl;
+        }
+    }
+
+    void printRoundTrips(std::vector<long long> &roundTrips) {
+        if (roundTrips.empty())
+            return;
+        std::sort(roundTrips.begin(), roundTrips.end());
+        std::cout << "Ida y vuelta (us): p50 " << roundTrips[roundTrips.size() / 2] << ", p99 "
+                  << roundTrips[std::min(roundTrips.size() - 1, roundTrips.size() * 99 / 100)]
+                  << ", max " << roundTrips.back() << std::endl;
+    }
+
+    // Orden de velocidad de la prueba: un zigzag suave alrededor de la velocidad media
+    RoboCar::TeleopVelocity testVelocity(const RoboCar::TeleopHello &hello, long long index) {
+        int mean = (hello.minSpeed + hello.maxSpeed) / 2, amplitude = (hello.maxSpeed - hello.minSpeed) / 4;
+        int difference = (int) std::lround(amplitude * std::sin(index / 50.0));
+        return {(int16_t) (mean - difference), (int16_t) (mean + difference)};
+    }
+
+    /**
+     * @brief Envía las órdenes de velocidad lo más rápido posible, agrupadas en escrituras de burst órdenes, y espera
+     * a que el servidor las haya atendido todas
+     */
+    void bench(const RoboCar::TeleopHello &hello, long long total, int burst) {
+        std::vector<uint8_t> buffer(burst * TELEOP_MAX_FRAME);
+        long long start = nowUms(), sent = 0;
+        while (sent < total) {
+            size_t size = 0;
+            for (int i = 0; i < burst && sent < total; i++, sent++) {
+                RoboCar::TeleopVelocity velocity = testVelocity(hello, sent);
+                size += RoboCar::encodeTeleopFrame(buffer.data() + size, RoboCar::TELEOP_VELOCITY, &velocity, sizeof(velocity));
+            }
+            if (!writeAll(buffer.data(), size))
+                return;
+        }
+        if (ping(0) < 0)
+            return;
+        double seconds = (nowUms() - start) / 1000000.0;
+        std::cout << sent << " ordenes en " << seconds << " s: " << (long long) (sent / seconds) << " ordenes/s" << std::endl;
+
+        std::vector<long long> roundTrips;
+        for (uint32_t i = 1; i <= 1000; i++) {
+            long long roundTrip = ping(i);
+            if (roundTrip < 0)
+                return;
+            roundTrips.push_back(roundTrip);
+        }
+        printRoundTrips(roundTrips);
+    }
+
+    /**
+     * @brief Envía órdenes de velocidad de una en una a la frecuencia indicada, midiendo cada PING_INTERVAL órdenes
+     * la latencia de ida y vuelta
+     */
+    void stream(const RoboCar::TeleopHello &hello, int rate, int time) {
+        long long period = 1000000 / rate, start = nowUms(), next = start, end = start + 1000000LL * time, sent = 0;
+        std::vector<long long> roundTrips;
+        while (nowUms() < end) {
+            RoboCar::TeleopVelocity velocity = testVelocity(hello, sent);
+            if (!sendFrame(RoboCar::TELEOP_VELOCITY, &velocity, sizeof(velocity)))
+                return;
+            if (++sent % PING_INTERVAL == 0) {
+                long long roundTrip = ping((uint32_t) sent);
+                if (roundTrip < 0)
+                    return;
+                roundTrips.push_back(roundTrip);
+            }
+            next += period;
+            long long wait = next - nowUms();
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(wait));
+        }
+        double seconds = (nowUms() - start) / 1000000.0;
+        std::cout << sent << " ordenes en " << seconds << " s: " << (long long) (sent / seconds) << " ordenes/s" << std::endl;
+        printRoundTrips(roundTrips);
+        RoboCar::TeleopVelocity stop = {0, 0};
+        sendFrame(RoboCar::TELEOP_VELOCITY, &stop, sizeof(stop));
+    }
+
+    void telemetry(int period, int time) {
+        RoboCar::TeleopSubscribe subscribe = {(uint16_t) period};
+        if (!sendFrame(RoboCar::TELEOP_SUBSCRIBE, &subscribe, sizeof(subscribe)))
+            return;
+        long long end = nowUms() + 1000000LL * time;
+        RoboCar::TeleopTelemetry sample;
+        while (nowUms() < end && receiveFrame(RoboCar::TELEOP_TELEMETRY, &sample)) {
+            std::cout << "[" << sample.time / 1000000.0 << " s] pos (" << sample.x << ", " << sample.y << ") "
+                      << sample.heading * 180.0f / M_PI << " grados, distancia " << sample.distance << " CM, ruedas "
+                      << sample.leftVelocity << "/" << sample.rightVelocity << " tacos/s" << std::endl;
+        }
+    }
+
+    void printHelp(char **argv) {
+        std::cout << "USO: " << argv[0] << " [--socket RUTA] <ORDEN>" << std::endl;
+        std::cout << "  --velocity L,R            Velocidad de cada rueda (tacos/s, negativa hacia atras)" << std::endl;
+        std::cout << "  --maneuver <MANIOBRA>     stop, forward, backward, left o right" << std::endl;
+        std::cout << "  --speed <TACOS/S>         Velocidad de las maniobras" << std::endl;
+        std::cout << "  --led <COLOR>,<ACCION>    green o red; on, off o toggle" << std::endl;
+        std::cout << "  --telemetry <MS>          Muestra la telemetria con el periodo indicado durante --time" << std::endl;
+        std::cout << "  --bench <ORDENES>         Envia las ordenes en rafagas de --burst (por defecto = "
+                  << DEFAULT_BURST << ") lo mas rapido posible" << std::endl;
+        std::cout << "  --rate <HZ>               Envia ordenes a la frecuencia indicada durante --time (por defecto = "
+                  << DEFAULT_TIME << " s)" << std::endl;
+    }
+
+} /* namespace */
+
+int main(int argc, char **argv) {
+    std::string path = TELEOP_SOCKET_PATH, maneuver, led;
+    int left = 0, right = 0, speed = -1, telemetryPeriod = -1, rate = -1, burst = DEFAULT_BURST, time = DEFAULT_TIME;
+    long long benchCommands = -1;
+    bool velocity = false;
+
+    struct option long_options[] = {
+            {"socket",    required_argument, nullptr, 'u'},
+            {"velocity",  required_argument, nullptr, 'v'},
+            {"maneuver",  required_argument, nullptr, 'm'},
+            {"speed",     required_argument, nullptr, 's'},
+            {"led",       required_argument, nullptr, 'l'},
+            {"telemetry", required_argument, nullptr, 'y'},
+            {"bench",     required_argument, nullptr, 'b'},
+            {"burst",     required_argument, nullptr, 'B'},
+            {"rate",      required_argument, nullptr, 'r'},
+            {"time",      required_argument, nullptr, 't'},
+            {"help",      no_argument,       nullptr, 'h'},
+            {nullptr,     0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'u':
+                path = optarg;
+                break;
+            case 'v':
+                velocity = sscanf(optarg, "%d,%d", &left, &right) == 2;
+                if (!velocity) {
+                    std::cerr << "La velocidad se indica como L,R" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'm':
+                maneuver = optarg;
+                break;
+            case 's':
+                speed = std::stoi(optarg);
+                break;
+            case 'l':
+                led = optarg;
+                break;
+            case 'y':
+                telemetryPeriod = std::stoi(optarg);
+                break;
+            case 'b':
+                benchCommands = std::stoll(optarg);
+                break;
+            case 'B':
+                burst = std::max(1, std::stoi(optarg));
+                break;
+            case 'r':
+                rate = std::stoi(optarg);
+                break;
+            case 't':
+                time = std::stoi(optarg);
+                break;
+            case 'h':
+            default:
+                printHelp(argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!connectTo(path))
+        exit(EXIT_FAILURE);
+    RoboCar::TeleopHello hello;
+    if (!receiveFrame(RoboCar::TELEOP_HELLO, &hello) || hello.version != TELEOP_PROTOCOL_VERSION) {
+        std::cerr << "El coche utiliza una version distinta del protocolo" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (speed >= 0) {
+        RoboCar::TeleopSetSpeed command = {(int16_t) speed};
+        sendFrame(RoboCar::TELEOP_SET_SPEED, &command, sizeof(command));
+    }
+    if (velocity) {
+        RoboCar::TeleopVelocity command = {(int16_t) left, (int16_t) right};
+        sendFrame(RoboCar::TELEOP_VELOCITY, &command, sizeof(command));
+    }
+    if (!maneuver.empty()) {
+        const char *names[] = {"stop", "forward", "backward", "left", "right"};
+        int index = (int) (std::find(names, names + 5, maneuver) - names);
+        if (index == 5) {
+            std::cerr << "Maniobra desconocida: " << maneuver << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        RoboCar::TeleopManeuverCommand command = {(uint8_t) index};
+        sendFrame(RoboCar::TELEOP_MANEUVER, &command, sizeof(command));
+    }
+    if (!led.empty()) {
+        std::string::size_type comma = led.find(',');
+        std::string color = led.substr(0, comma), action = (comma == std::string::npos) ? "toggle" : led.substr(comma + 1);
+        RoboCar::TeleopLedCommand command = {(uint8_t) (color == "red" ? RoboCar::RED : RoboCar::GREEN),
+                                             (uint8_t) (action == "on" ? RoboCar::LED_ON :
+                                                        action == "off" ? RoboCar::LED_OFF : RoboCar::LED_TOGGLE)};
+        sendFrame(RoboCar::TELEOP_LED, &command, sizeof(command));
+    }
+
+    if (telemetryPeriod >= 0)
+        telemetry(telemetryPeriod, time);
+    else if (benchCommands > 0)
+        bench(hello, benchCommands, burst);
+    else if (rate > 0)
+        stream(hello, rate, time);
+    else
+        ping(0);
+
+    if (benchCommands > 0 || rate > 0)
+        printServerStats();
+    close(connection);
+    return EXIT_SUCCESS;
+}
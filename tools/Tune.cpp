@@ -0,0 +1,566 @@
+// Ajuste automático de los parámetros de comportamiento del coche (RoboCar::Parameters) sobre el simulador. Cada
+// candidato se evalúa en varios episodios simulados: giros temporizados en un escenario abierto (error de orientación),
+// el modo circuito (tiempo por vuelta) y el modo simple con la maniobra de tanteo en cada escenario (segundos por metro
+// recorrido), penalizando las colisiones. Los candidatos de cada generación se evalúan en paralelo, cada uno con su
+// propio reloj y backend, y la búsqueda es una estrategia evolutiva con adaptación de la covarianza (diagonal,
+// sep-CMA-ES). Un candidato se descarta en cuanto su coste parcial supera al del último seleccionado en la generación
+// anterior, sin terminar de simularlo. El mejor se escribe en un fichero que RoboCar.out carga al arrancar.
+// Necesita la calibración del coche simulado en el directorio actual (./RoboCar.out --calibrate --simulate ...)
+//
+// USO: ./RoboCarTune.out [--arena FICHERO]... [--circuit ESCENARIO,CIRCUITO] [--generations N] [--population N]
+//                        [--threads N] [--time SEGUNDOS] [--output FICHERO]
+
+#include "RoboCarAlgorithms.h"
+#include "RoboCar/RoboCar.h"
+#include "RoboCar/Parameters.h"
+#include "PinsLib/Clock.h"
+#include "Simulator/Arena.h"
+#include "Simulator/SimBackend.h"
+#include "Simulator/TaskPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Valores por defecto de los escenarios y de la búsqueda
+#define DEFAULT_ARENA               "arenas/box.arena"
+#define DEFAULT_CIRCUIT_ARENA       "arenas/loop.arena"
+#define DEFAULT_CIRCUIT             "arenas/loop.circuit"
+#define DEFAULT_GENERATIONS         20
+#define DEFAULT_POPULATION          12
+#define DEFAULT_TIME                30
+#define DEFAULT_OUTPUT              DEFAULT_PARAMETERS_FILE
+
+// Coste, en tiempo virtual, de cada operación sobre los pines (el mismo que en RoboCar.out --simulate)
+#define TUNE_IO_COST_UMS            60
+
+// Periodo (us, tiempo virtual) con el que se sigue la orientación del coche y se comprueba si se descarta el candidato
+#define TUNE_SAMPLE_UMS             20000
+
+// Pesos del coste (en segundos): por colisión y por grado de error medio en los giros temporizados
+#define TUNE_COLLISION_PENALTY      5.0
+#define TUNE_HEADING_WEIGHT         0.2
+
+// Recorrido (CM) y vueltas mínimas con los que se calculan los segundos por metro y por vuelta
+#define TUNE_MIN_TRAVEL_CM          10.0
+#define TUNE_MIN_LAPS               0.25
+
+// Escenario abierto (CM de lado) de los giros temporizados, ángulos (grados) que se prueban en cada sentido y espera
+// (us) tras cada giro para que el coche se detenga del todo antes de medir lo girado
+#define TUNE_OPEN_ARENA_CM          400.0f
+#define TUNE_TURN_ANGLES            {30, 90, 180}
+#define TUNE_TURN_SETTLE_UMS        500000
+
+// Paso inicial de la búsqueda, en el espacio normalizado [0, 1] de cada parámetro
+#define TUNE_INITIAL_STEP           0.3
+
+namespace {
+
+    // Parámetros que se ajustan y su rango de búsqueda
+    struct Range {
+        const char *name;
+        double minimum;
+        double maximum;
+    };
+    const Range RANGES[] = {
+            {"turnTime",         200000, 1000000},
+            {"turnStartDelay",   0,      300000},
+            {"speedGain",        1,      15},
+            {"distanceMeasures", 1,      15},
+            {"loopPeriod",       20000,  200000},
+            {"limitDistance",    20,     60},
+    };
+    const int DIMENSIONS = sizeof(RANGES) / sizeof(RANGES[0]);
+
+    /**
+     * @brief Pasa un punto del espacio normalizado (recortado a [0, 1]) a un juego de parámetros
+     */
+    RoboCar::Parameters decode(const std::vector<double> &point) {
+        double value[DIMENSIONS];
+        for (int i = 0; i < DIMENSIONS; i++)
+            value[i] = RANGES[i].minimum + std::min(1.0, std::max(0.0, point[i])) * (RANGES[i].maximum - RANGES[i].minimum);
+        RoboCar::Parameters parameters;
+        parameters.turnTime = std::llround(value[0]);
+        parameters.turnStartDelay = std::llround(value[1]);
+        parameters.speedGain = (float) value[2];
+        parameters.distanceMeasures = (int) std::lround(value[3]);
+        parameters.loopPeriod = std::llround(value[4]);
+        parameters.limitDistance = (int) std::lround(value[5]);
+        return parameters;
+    }
+
+    std::vector<double> encode(const RoboCar::Parameters &parameters) {
+        double value[DIMENSIONS] = {(double) parameters.turnTime, (double) parameters.turnStartDelay,
+                                    parameters.speedGain, (double) parameters.distanceMeasures,
+                                    (double) parameters.loopPeriod, (double) parameters.limitDistance};
+        std::vector<double> point(DIMENSIONS);
+        for (int i = 0; i < DIMENSIONS; i++)
+            point[i] = (value[i] - RANGES[i].minimum) / (RANGES[i].maximum - RANGES[i].minimum);
+        return point;
+    }
+
+    // Reloj de un episodio: sigue la orientación real del coche (para medir los giros) y el ángulo que recorre
+    // alrededor de un centro (para contar las vueltas al circuito) y, si el coste parcial del candidato supera el
+    // límite, lo descarta adelantando el tiempo hasta el final del episodio
+    class EpisodeClock : public PinsLib::VirtualClock {
+    private:
+        Simulator::SimBackend *backend = nullptr;
+        Simulator::Point centre = {0, 0};
+        long long nextSample = 0;
+        float heading = 0;
+        float bearing = 0;
+        double turned = 0;
+        double orbited = 0;
+
+        double baseCost = 0;
+        double cutoff = std::numeric_limits<double>::infinity();
+        long long end = 0;
+        bool discarded = false;
+
+    public:
+        void track(Simulator::SimBackend *backend, Simulator::Point centre) {
+            this->backend = backend;
+            this->centre = centre;
+            Simulator::Pose pose = backend->getPose();
+            heading = pose.heading;
+            bearing = std::atan2(pose.y - centre.y, pose.x - centre.x);
+        }
+
+        // Coste ya acumulado por el candidato, límite a partir del que se descarta y final (us) del episodio
+        void setCutoff(double baseCost, double cutoff, long long end) {
+            this->baseCost = baseCost;
+            this->cutoff = cutoff;
+            this->end = end;
+        }
+
+        // Ángulos (radianes, positivos hacia la izquierda) girado por el coche y recorrido alrededor del centro desde
+        // que se empezó a seguirlo, actualizados hasta el instante actual
+        double sample() {
+            backend->synchronize(time);
+            Simulator::Pose pose = backend->getPose();
+            float current = std::atan2(pose.y - centre.y, pose.x - centre.x);
+            turned += std::remainder(pose.heading - heading, 2.0f * (float) M_PI);
+            orbited += std::remainder(current - bearing, 2.0f * (float) M_PI);
+            heading = pose.heading;
+            bearing = current;
+            return turned;
+        }
+
+        double getOrbited() {
+            sample();
+            return orbited;
+        }
+
+        bool isDiscarded() const {
+            return discarded;
+        }
+
+        void sleep(long long ums) override {
+            if (ums > 0)
+                sleepUntil(time + ums);
+        }
+
+        void sleepUntil(long long time) override {
+            while (!discarded && nextSample <= time) {
+                if (nextSample > this->time)
+                    this->time = nextSample;
+                check();
+            }
+            if (time > this->time)
+                this->time = time;
+        }
+
+        void advance(long long ums) override {
+            if (ums <= 0)
+                return;
+            time += ums;
+            while (!discarded && nextSample <= time)
+                check();
+        }
+
+    private:
+        void check() {
+            nextSample += TUNE_SAMPLE_UMS;
+            if (backend == nullptr)
+                return;
+            sample();
+            if (baseCost + backend->getCollisions() * TUNE_COLLISION_PENALTY > cutoff) {
+                discarded = true;
+                if (end > time)
+                    time = end;
+            }
+        }
+    };
+
+    // Escenarios de la evaluación
+    struct Setup {
+        Simulator::Arena openArena;
+        std::vector<Simulator::Arena *> arenas;
+        Simulator::Arena circuitArena;
+        std::string circuit;
+        int time;
+    };
+
+    // Resultado de un candidato: coste total y sus componentes
+    struct Evaluation {
+        double cost = 0;
+        double headingError = 0;
+        double lapTime = 0;
+        double pace = 0;
+        long long collisions = 0;
+        bool calibrated = false;
+        bool discarded = false;
+    };
+
+    /**
+     * @brief Ejecuta un episodio: crea el coche con los parámetros indicados sobre un reloj y un backend propios del
+     * hilo actual y le aplica la prueba indicada
+     * @return false si el coche no está calibrado
+     */
+    template<typename Episode>
+    bool runEpisode(const Simulator::Arena &arena, const RoboCar::Parameters &parameters, EpisodeClock &clock,
+                    Simulator::SimBackend *&backend, Episode episode) {
+        // El centro del escenario es la referencia para contar las vueltas
+        float minX = 0, minY = 0, maxX = 0, maxY = 0;
+        for (const Simulator::Segment &wall : arena.getWalls()) {
+            minX = std::min({minX, wall.a.x, wall.b.x});
+            minY = std::min({minY, wall.a.y, wall.b.y});
+            maxX = std::max({maxX, wall.a.x, wall.b.x});
+            maxY = std::max({maxY, wall.a.y, wall.b.y});
+        }
+        backend = new Simulator::SimBackend(arena, &clock, TUNE_IO_COST_UMS);
+        PinsLib::Clock::setForThread(&clock);
+        PinsLib::Backend::setForThread(backend);
+        bool calibrated;
+        {
+            RoboCar::RoboCar car;
+            car.setParameters(parameters);
+            std::pair<int, int> results = car.loadCalibration();
+            calibrated = results.minimum != 0 || results.maximum != 0;
+            if (calibrated) {
+                clock.track(backend, {(minX + maxX) / 2, (minY + maxY) / 2});
+                episode(&car);
+            }
+        }
+        PinsLib::Backend::setForThread(nullptr);
+        PinsLib::Clock::setForThread(nullptr);
+        return calibrated;
+    }
+
+    /**
+     * @brief Evalúa un candidato. Los episodios más baratos van primero, para descartar cuanto antes a los malos
+     * @param cutoff Coste a partir del cual el candidato se descarta sin terminar los episodios (infinito para
+     * evaluarlo completo)
+     */
+    Evaluation evaluate(const RoboCar::Parameters &parameters, const Setup &setup, double cutoff) {
+        Evaluation evaluation;
+        Simulator::SimBackend *backend = nullptr;
+
+        // Giros temporizados: error medio entre el ángulo pedido y el girado
+        {
+            EpisodeClock clock;
+            int turns = 0;
+            double error = 0;
+            evaluation.calibrated = runEpisode(setup.openArena, parameters, clock, backend, [&](RoboCar::RoboCar *car) {
+                car->setMinSpeed();
+                for (int angle : TUNE_TURN_ANGLES) {
+                    for (int direction : {1, -1}) {
+                        double start = clock.sample();
+                        if (direction > 0)
+                            car->rotateLeft(angle);
+                        else
+                            car->rotateRight(angle);
+                        clock.sleep(TUNE_TURN_SETTLE_UMS);
+                        double turned = (clock.sample() - start) * 180.0 / M_PI;
+                        error += std::fabs(turned - direction * angle);
+                        turns++;
+                    }
+                }
+            });
+            evaluation.headingError = turns > 0 ? error / turns : 0;
+            evaluation.collisions += backend->getCollisions();
+            evaluation.cost += evaluation.headingError * TUNE_HEADING_WEIGHT +
+                               backend->getCollisions() * TUNE_COLLISION_PENALTY;
+            delete backend;
+        }
+        if (!evaluation.calibrated)
+            return evaluation;
+
+        // Circuito: segundos por vuelta (una vuelta son 360 grados recorridos alrededor del centro del escenario)
+        if (!setup.circuit.empty() && evaluation.cost <= cutoff) {
+            EpisodeClock clock;
+            clock.setCutoff(evaluation.cost, cutoff, 1000000LL * setup.time);
+            runEpisode(setup.circuitArena, parameters, clock, backend, [&](RoboCar::RoboCar *car) {
+                RoboCarAlgorithms::circuitMode(car, setup.time, parameters.limitDistance, setup.circuit);
+            });
+            double laps = std::max(std::fabs(clock.getOrbited()) / (2.0 * M_PI), TUNE_MIN_LAPS);
+            evaluation.lapTime = setup.time / laps;
+            evaluation.collisions += backend->getCollisions();
+            evaluation.cost += evaluation.lapTime + backend->getCollisions() * TUNE_COLLISION_PENALTY;
+            evaluation.discarded = clock.isDiscarded();
+            delete backend;
+        } else if (!setup.circuit.empty()) {
+            evaluation.discarded = true;
+        }
+
+        // Modo simple en cada escenario: segundos por metro recorrido
+        size_t i = 0;
+        for (; i < setup.arenas.size() && evaluation.cost <= cutoff; i++) {
+            EpisodeClock clock;
+            clock.setCutoff(evaluation.cost, cutoff, 1000000LL * setup.time);
+            runEpisode(*setup.arenas[i], parameters, clock, backend, [&](RoboCar::RoboCar *car) {
+                RoboCarAlgorithms::simpleMode(car, setup.time, parameters.limitDistance, false, 0);
+            });
+            double pace = setup.time / (std::max(backend->getTravelled(), TUNE_MIN_TRAVEL_CM) / 100.0);
+            evaluation.pace += pace;
+            evaluation.collisions += backend->getCollisions();
+            evaluation.cost += pace + backend->getCollisions() * TUNE_COLLISION_PENALTY;
+            evaluation.discarded = evaluation.discarded || clock.isDiscarded();
+            delete backend;
+        }
+
+        // Los episodios que no se han llegado a ejecutar no suman: el coste es una cota inferior del real
+        if (i < setup.arenas.size())
+            evaluation.discarded = true;
+        return evaluation;
+    }
+
+    void printEvaluation(const Evaluation &evaluation) {
+        std::cout << "coste " << evaluation.cost << " (error de giro " << evaluation.headingError << " grados, vuelta "
+                  << evaluation.lapTime << " s, " << evaluation.pace << " s/m, " << evaluation.collisions
+                  << " colisiones)" << std::endl;
+    }
+
+    // Destino de std::cout mientras se simulan los candidatos, para descartar los mensajes de los modos
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return c; }
+    };
+
+} /* namespace */
+
+void printHelp(char **argv) {
+    std::cout << "USO: " << argv[0] << " [OPCIONES]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  --arena <FICHERO>              Escenario del modo simple, se puede repetir (por defecto = " << DEFAULT_ARENA << ")" << std::endl;
+    std::cout << "  --circuit <ESCENARIO,CIRCUITO> Escenario y circuito del modo circuito (por defecto = " << DEFAULT_CIRCUIT_ARENA << "," << DEFAULT_CIRCUIT << ")" << std::endl;
+    std::cout << "  --generations <N>              Generaciones de la busqueda (por defecto = " << DEFAULT_GENERATIONS << ")" << std::endl;
+    std::cout << "  --population <N>               Candidatos por generacion (por defecto = " << DEFAULT_POPULATION << ")" << std::endl;
+    std::cout << "  --threads <N>                  Hilos de evaluacion (por defecto, tantos como nucleos)" << std::endl;
+    std::cout << "  --time <SEGUNDOS>              Duracion de cada episodio simulado (por defecto = " << DEFAULT_TIME << ")" << std::endl;
+    std::cout << "  --output <FICHERO>             Fichero de parametros resultante (por defecto = " << DEFAULT_OUTPUT << ")" << std::endl;
+    std::cout << "  --help                         Muestra este menu de ayuda" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> arenaFiles;
+    std::string circuitArenaFile = DEFAULT_CIRCUIT_ARENA, circuitFile = DEFAULT_CIRCUIT;
+    int generations = DEFAULT_GENERATIONS, population = DEFAULT_POPULATION, time = DEFAULT_TIME;
+    int threads = (int) std::thread::hardware_concurrency();
+    std::string output = DEFAULT_OUTPUT;
+
+    struct option long_options[] = {
+            {"arena",       required_argument, nullptr, 'a'},
+            {"circuit",     required_argument, nullptr, 'c'},
+            {"generations", required_argument, nullptr, 'g'},
+            {"population",  required_argument, nullptr, 'p'},
+            {"threads",     required_argument, nullptr, 'j'},
+            {"time",        required_argument, nullptr, 't'},
+            {"output",      required_argument, nullptr, 'o'},
+            {"help",        no_argument,       nullptr, 'h'},
+            {nullptr,       0,                 nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'a':
+                arenaFiles.push_back(optarg);
+                break;
+            case 'c': {
+                std::string value = optarg;
+                size_t comma = value.find(',');
+                if (comma == std::string::npos) {
+                    std::cerr << "El circuito se indica como ESCENARIO,CIRCUITO" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                circuitArenaFile = value.substr(0, comma);
+                circuitFile = value.substr(comma + 1);
+                break;
+            }
+            case 'g':
+                generations = std::stoi(optarg);
+                break;
+            case 'p':
+                population = std::stoi(optarg);
+                break;
+            case 'j':
+                threads = std::stoi(optarg);
+                break;
+            case 't':
+                time = std::stoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+            default:
+                printHelp(argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (generations < 1 || population < 4 || threads < 1 || time < 1) {
+        std::cerr << "Se necesitan al menos 1 generacion, 4 candidatos, 1 hilo y 1 segundo por episodio" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (arenaFiles.empty())
+        arenaFiles.push_back(DEFAULT_ARENA);
+
+    // Escenarios: el abierto para los giros se construye aquí, el resto se cargan de sus ficheros
+    Setup setup;
+    float side = TUNE_OPEN_ARENA_CM;
+    setup.openArena.addPolygon({{0, 0}, {side, 0}, {side, side}, {0, side}});
+    setup.openArena.setStart({side / 2, side / 2}, 0);
+    for (const std::string &file : arenaFiles) {
+        auto *arena = new Simulator::Arena();
+        if (!arena->load(file))
+            exit(EXIT_FAILURE);
+        setup.arenas.push_back(arena);
+    }
+    if (!setup.circuitArena.load(circuitArenaFile))
+        exit(EXIT_FAILURE);
+    setup.circuit = circuitFile;
+    setup.time = time;
+
+    // Referencia: los parámetros por defecto (ajustados a mano)
+    RoboCar::Parameters defaults;
+    NullBuffer nullBuffer;
+    std::streambuf *console = std::cout.rdbuf(&nullBuffer);
+    Evaluation reference = evaluate(defaults, setup, std::numeric_limits<double>::infinity());
+    std::cout.rdbuf(console);
+    if (!reference.calibrated) {
+        std::cerr << "El coche simulado no esta calibrado (./RoboCar.out --calibrate --simulate <ESCENARIO>)" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Parametros por defecto: ";
+    printEvaluation(reference);
+
+    // sep-CMA-ES: media, paso y covarianza diagonal en el espacio normalizado, partiendo de los valores por defecto
+    const int n = DIMENSIONS, lambda = population, mu = population / 2;
+    std::vector<double> weights(mu);
+    double weightSum = 0, weightSquares = 0;
+    for (int i = 0; i < mu; i++) {
+        weights[i] = std::log(mu + 0.5) - std::log(i + 1.0);
+        weightSum += weights[i];
+    }
+    for (double &weight : weights) {
+        weight /= weightSum;
+        weightSquares += weight * weight;
+    }
+    const double muEff = 1.0 / weightSquares;
+    const double cSigma = (muEff + 2) / (n + muEff + 5);
+    const double dSigma = 1 + 2 * std::max(0.0, std::sqrt((muEff - 1) / (n + 1)) - 1) + cSigma;
+    const double cc = (4 + muEff / n) / (n + 4 + 2 * muEff / n);
+    const double c1 = (n + 2) / 3.0 * 2 / ((n + 1.3) * (n + 1.3) + muEff);
+    const double cMu = std::min(1 - c1, (n + 2) / 3.0 * 2 * (muEff - 2 + 1 / muEff) / ((n + 2) * (n + 2) + muEff));
+    const double chiN = std::sqrt((double) n) * (1 - 1.0 / (4 * n) + 1.0 / (21.0 * n * n));
+
+    std::vector<double> mean = encode(defaults), variance(n, 1.0), pathSigma(n, 0.0), pathC(n, 0.0);
+    double sigma = TUNE_INITIAL_STEP;
+    std::mt19937 random(1);
+    std::normal_distribution<double> normal;
+
+    RoboCar::Parameters best = defaults;
+    Evaluation bestEvaluation = reference;
+    double cutoff = std::numeric_limits<double>::infinity();
+    long long evaluated = 0, discarded = 0;
+    auto realStart = std::chrono::steady_clock::now();
+
+    std::vector<std::vector<double>> points(lambda, std::vector<double>(n));
+    std::vector<Evaluation> evaluations(lambda);
+    Simulator::TaskPool pool(threads);
+    for (int generation = 0; generation < generations; generation++) {
+        // Muestreo (recortado al rango de cada parámetro) y evaluación en paralelo
+        for (int k = 0; k < lambda; k++) {
+            for (int i = 0; i < n; i++)
+                points[k][i] = std::min(1.0, std::max(0.0, mean[i] + sigma * std::sqrt(variance[i]) * normal(random)));
+            RoboCar::Parameters parameters = decode(points[k]);
+            pool.submit([&, k, parameters]() {
+                evaluations[k] = evaluate(parameters, setup, cutoff);
+            });
+        }
+        console = std::cout.rdbuf(&nullBuffer);
+        pool.wait();
+        std::cout.rdbuf(console);
+
+        std::vector<int> order(lambda);
+        for (int k = 0; k < lambda; k++)
+            order[k] = k;
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return evaluations[a].cost < evaluations[b].cost; });
+        for (const Evaluation &evaluation : evaluations) {
+            evaluated++;
+            if (evaluation.discarded)
+                discarded++;
+        }
+        const Evaluation &leader = evaluations[order[0]];
+        if (!leader.discarded && leader.cost < bestEvaluation.cost) {
+            best = decode(points[order[0]]);
+            bestEvaluation = leader;
+        }
+        cutoff = evaluations[order[mu - 1]].cost;
+
+        // Actualización de la media, de los caminos de evolución, de la covarianza diagonal y del paso
+        std::vector<double> previous = mean;
+        for (int i = 0; i < n; i++) {
+            mean[i] = 0;
+            for (int j = 0; j < mu; j++)
+                mean[i] += weights[j] * points[order[j]][i];
+        }
+        double pathSigmaNorm = 0;
+        for (int i = 0; i < n; i++) {
+            double step = (mean[i] - previous[i]) / sigma;
+            pathSigma[i] = (1 - cSigma) * pathSigma[i] + std::sqrt(cSigma * (2 - cSigma) * muEff) * step / std::sqrt(variance[i]);
+            pathSigmaNorm += pathSigma[i] * pathSigma[i];
+        }
+        pathSigmaNorm = std::sqrt(pathSigmaNorm);
+        bool hSigma = pathSigmaNorm / std::sqrt(1 - std::pow(1 - cSigma, 2.0 * (generation + 1))) < (1.4 + 2.0 / (n + 1)) * chiN;
+        for (int i = 0; i < n; i++) {
+            double step = (mean[i] - previous[i]) / sigma;
+            pathC[i] = (1 - cc) * pathC[i] + (hSigma ? std::sqrt(cc * (2 - cc) * muEff) * step : 0);
+            double rankMu = 0;
+            for (int j = 0; j < mu; j++) {
+                double y = (points[order[j]][i] - previous[i]) / sigma;
+                rankMu += weights[j] * y * y;
+            }
+            variance[i] = (1 - c1 - cMu) * variance[i] + c1 * (pathC[i] * pathC[i] + (hSigma ? 0 : cc * (2 - cc) * variance[i]))
+                          + cMu * rankMu;
+        }
+        sigma *= std::exp(cSigma / dSigma * (pathSigmaNorm / chiN - 1));
+
+        std::cout << "Generacion " << generation + 1 << ": mejor ";
+        printEvaluation(leader);
+    }
+    long long realTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - realStart).count();
+
+    std::cout << std::endl << "Evaluados " << evaluated << " candidatos en " << realTime << " ms con " << pool.getThreads()
+              << " hilos (" << discarded << " descartados antes de terminar)" << std::endl;
+    pool.printReport(std::cout);
+    std::cout << "Mejor: ";
+    printEvaluation(bestEvaluation);
+    best.print(std::cout);
+    for (Simulator::Arena *arena : setup.arenas)
+        delete arena;
+    if (!best.save(output))
+        exit(EXIT_FAILURE);
+    std::cout << "Parametros guardados en " << output << std::endl;
+    return 0;
+}